@@ -16,7 +16,15 @@
 #include "exp_cdc.h"
 #include "logging.h"
 #include "status.h"
+#include "telemetry.h"
+#include "ui_update.h"
+#include "history.h"
 #include "controls.h"
+#include "headless.h"
+#include "device_init.h"
+#include "ipc_server.h"
+#include "telemetry_export.h"
+#include "graph_trace.h"
 
 /******************************************************************************
  * Global Variables (defined here, declared extern in common.h)
@@ -26,6 +34,7 @@ int g_debugMode = 0;
 CmtThreadPoolHandle g_threadPool = 0;
 CmtThreadLockHandle g_busyLock = 0;
 int g_systemBusy = 0;
+int g_headlessMode = 0;
 
 // Queue managers
 PSBQueueManager *g_psbQueueMgr = NULL;
@@ -33,6 +42,34 @@ BioQueueManager *g_bioQueueMgr = NULL;
 DTBQueueManager *g_dtbQueueMgr = NULL;
 TNYQueueManager *g_tnyQueueMgr = NULL;
 
+// Startup steps, indexes into the table passed to DeviceInit_Run
+enum {
+    INIT_STEP_CDAQ = 0,
+    INIT_STEP_PSB_CONNECT,
+    INIT_STEP_PSB_SAFE_STATE,
+    INIT_STEP_BIO_CONNECT,
+    INIT_STEP_DTB_CONNECT,
+    INIT_STEP_DTB_CONFIGURE,
+    INIT_STEP_TNY_CONNECT,
+    INIT_STEP_TNY_PINS,
+    INIT_STEP_COUNT
+};
+
+static int g_dtbSlaveAddresses[DTB_NUM_DEVICES] = {DTB1_SLAVE_ADDRESS, DTB2_SLAVE_ADDRESS};
+
+/******************************************************************************
+ * Internal Function Prototypes
+ ******************************************************************************/
+static void ShutdownApplication(void);
+static int InitCDAQ(void);
+static int InitPSBConnect(void);
+static int InitPSBSafeState(void);
+static int InitBioLogicConnect(void);
+static int InitDTBConnect(void);
+static int InitDTBConfigure(void);
+static int InitTeensyConnect(void);
+static int InitTeensyPins(void);
+
 /******************************************************************************
  * Main Function
  ******************************************************************************/
@@ -40,10 +77,22 @@ int main (int argc, char *argv[]) {
     if (InitCVIRTE (0, argv, 0) == 0)
         return -1;    /* out of memory */
 	
+	DeviceQueue_SetThreadName("UI");
+	
+	// "-headless <config>" runs one experiment without loading any panel
+	const char *headlessConfig = Headless_GetConfigPath(argc, argv);
+	g_headlessMode = (headlessConfig != NULL);
+	
 	// Load and display loading panel first
-    int loadingPanelHandle = LoadPanel(0, "BatteryTester.uir", PANEL_LOAD);
-    DisplayPanel(loadingPanelHandle);
-    ProcessSystemEvents(); // Ensure panel displays immediately
+    int loadingPanelHandle = 0;
+    if (g_headlessMode) {
+        // Skipped UI calls against panel 0 must not stop the run
+        SetBreakOnLibraryErrors(0);
+    } else {
+        loadingPanelHandle = LoadPanel(0, "BatteryTester.uir", PANEL_LOAD);
+        DisplayPanel(loadingPanelHandle);
+        ProcessSystemEvents(); // Ensure panel displays immediately
+    }
 	
 	SetThreadExecutionState(ES_CONTINUOUS | ES_SYSTEM_REQUIRED | ES_DISPLAY_REQUIRED);
     
@@ -56,154 +105,43 @@ int main (int argc, char *argv[]) {
     // Initialize logging
     RegisterLoggingCleanup();
     
-	// Initialize cDAQ module if enabled
-	if (ENABLE_CDAQ) {
-	    LogMessage("Initializing cDAQ module...");
-	    int result = CDAQ_Initialize();
-	    if (result == SUCCESS) {
-	        LogMessage("cDAQ module initialized successfully");
-	    } else {
-	        LogError("Failed to initialize cDAQ module: %s", GetErrorString(result));
-	    }
-	}
+	// Bring up all devices at once; steps of one device run in order
+	DeviceInitStep initSteps[] = {
+	    [INIT_STEP_CDAQ]           = {"cDAQ", "Initializing", ENABLE_CDAQ, 0, InitCDAQ},
+	    [INIT_STEP_PSB_CONNECT]    = {"PSB", "Connecting", ENABLE_PSB, 0, InitPSBConnect},
+	    [INIT_STEP_PSB_SAFE_STATE] = {"PSB", "Setting safe state", ENABLE_PSB,
+	                                  DEVICE_INIT_STEP_BIT(INIT_STEP_PSB_CONNECT), InitPSBSafeState},
+	    [INIT_STEP_BIO_CONNECT]    = {"BioLogic", "Connecting", ENABLE_BIOLOGIC, 0, InitBioLogicConnect},
+	    [INIT_STEP_DTB_CONNECT]    = {"DTB", "Connecting", ENABLE_DTB, 0, InitDTBConnect},
+	    [INIT_STEP_DTB_CONFIGURE]  = {"DTB", "Configuring controllers", ENABLE_DTB,
+	                                  DEVICE_INIT_STEP_BIT(INIT_STEP_DTB_CONNECT), InitDTBConfigure},
+	    [INIT_STEP_TNY_CONNECT]    = {"Teensy", "Connecting", ENABLE_TNY, 0, InitTeensyConnect},
+	    [INIT_STEP_TNY_PINS]       = {"Teensy", "Setting pins", ENABLE_TNY,
+	                                  DEVICE_INIT_STEP_BIT(INIT_STEP_TNY_CONNECT), InitTeensyPins},
+	};
+	DeviceInit_Run(initSteps, INIT_STEP_COUNT, loadingPanelHandle);
 	
-    // Initialize PSB queue manager with specific port
-	if (ENABLE_PSB) {
-	    LogMessage("Initializing PSB queue manager on COM%d...", PSB_COM_PORT);
-	    g_psbQueueMgr = PSB_QueueInit(PSB_COM_PORT, PSB_SLAVE_ADDRESS, PSB_BAUD_RATE);
-	    
-	    if (g_psbQueueMgr) {
-	        PSB_SetGlobalQueueManager(g_psbQueueMgr);
-	        
-	        // Check if connected
-	        PSBQueueStats stats;
-	        PSB_QueueGetStats(g_psbQueueMgr, &stats);
-	        if (stats.isConnected) {
-	            LogMessage("PSB queue manager initialized and connected on COM%d", PSB_COM_PORT);
-	            
-	            // Initialize PSB to safe state
-	            LogMessage("Initializing PSB to safe state...");
-	            
-	            // First set safe limits
-	            int limitResult = PSB_SetSafeLimitsQueued(DEVICE_PRIORITY_NORMAL);
-	            if (limitResult != PSB_SUCCESS) {
-	                LogWarning("Failed to set all PSB safe limits: %s", PSB_GetErrorString(limitResult));
-	            }
-	            
-	            // Then zero all values
-	            int zeroResult = PSB_ZeroAllValuesQueued(DEVICE_PRIORITY_NORMAL);
-	            if (zeroResult != PSB_SUCCESS) {
-	                LogWarning("Failed to zero all PSB values: %s", PSB_GetErrorString(zeroResult));
-	            }
-	            
-	            LogMessage("PSB initialization complete");
-	        } else {
-	            LogWarning("PSB queue manager initialized but not connected on COM%d", PSB_COM_PORT);
-	        }
-	    } else {
-	        LogError("Failed to initialize PSB queue manager on COM%d", PSB_COM_PORT);
+	// Headless: run the experiment with status monitoring but no panel, then exit
+	if (g_headlessMode) {
+	    UIUpdate_Initialize();
+	    Telemetry_Initialize();
+	    History_Initialize();
+	    if (ENABLE_TELEMETRY_EXPORT) {
+	        TelemetryExport_Initialize();
 	    }
-	}
-
-	// Initialize BioLogic queue manager if BioLogic monitoring is enabled
-	if (ENABLE_BIOLOGIC) {
-	    LogMessage("Initializing BioLogic queue manager...");
-	    g_bioQueueMgr = BIO_QueueInit(BIOLOGIC_DEFAULT_ADDRESS);
-	    
-	    if (g_bioQueueMgr) {
-	        BIO_SetGlobalQueueManager(g_bioQueueMgr);
-	        LogMessage("BioLogic queue manager initialized");
+	    Status_Initialize(0);
+	    Status_Start();
+	    if (ENABLE_IPC_SERVER) {
+	        IPCServer_Start();
 	    }
-	}
-
-	// Initialize DTB queue manager with multiple devices
-	if (ENABLE_DTB) {
-	    LogMessage("Initializing DTB queue manager on COM%d with %d devices...", 
-	               DTB_COM_PORT, DTB_NUM_DEVICES);
 	    
-	    // Setup slave addresses array
-	    int dtbSlaveAddresses[DTB_NUM_DEVICES] = {DTB1_SLAVE_ADDRESS, DTB2_SLAVE_ADDRESS};
+	    int result = Headless_Run(headlessConfig);
 	    
-	    g_dtbQueueMgr = DTB_QueueInit(DTB_COM_PORT, DTB_BAUD_RATE, 
-	                                  dtbSlaveAddresses, DTB_NUM_DEVICES);
+	    ShutdownApplication();
+	    SetThreadExecutionState(ES_CONTINUOUS);
 	    
-	    if (g_dtbQueueMgr) {
-	        DTB_SetGlobalQueueManager(g_dtbQueueMgr);
-	        
-	        // Check if connected
-	        DTBQueueStats stats;
-	        DTB_QueueGetStats(g_dtbQueueMgr, &stats);
-	        if (stats.isConnected) {
-	            LogMessage("DTB queue manager initialized and connected on COM%d", DTB_COM_PORT);
-	            
-	            // Enable write access for all devices
-	            LogMessage("Enabling DTB write access for all devices...");
-	            int writeResult = DTB_EnableWriteAccessAllQueued(DEVICE_PRIORITY_NORMAL);
-	            if (writeResult != DTB_SUCCESS) {
-	                LogError("Failed to enable DTB write access for all devices: %s", 
-	                        DTB_GetErrorString(writeResult));
-	            } else {
-	                LogMessage("DTB write access enabled successfully for all devices");
-	            }
-	            
-	            // Configure all DTB devices for K-type thermocouple with PID control
-	            LogMessage("Configuring all DTB4848 devices for K-type thermocouple with PID control...");
-	            
-	            // Try to configure each device individually to provide better error reporting
-	            for (int i = 0; i < DTB_NUM_DEVICES; i++) {
-	                int slaveAddr = dtbSlaveAddresses[i];
-	                
-	                // Check current write access status for this device
-	                int writeEnabled = 0;
-	                int statusResult = DTB_GetWriteAccessStatusQueued(slaveAddr, &writeEnabled, DEVICE_PRIORITY_NORMAL);
-	                if (statusResult == DTB_SUCCESS) {
-	                    LogMessage("DTB slave %d write access currently: %s", 
-	                              slaveAddr, writeEnabled ? "ENABLED" : "DISABLED");
-	                }
-	                
-	                // Configure this device
-	                int configResult = DTB_ConfigureDefaultQueued(slaveAddr, DEVICE_PRIORITY_NORMAL);
-	                if (configResult == DTB_SUCCESS) {
-	                    LogMessage("DTB4848 slave %d configured successfully", slaveAddr);
-	                } else {
-	                    LogWarning("DTB4848 slave %d configuration failed: %s", 
-	                              slaveAddr, DTB_GetErrorString(configResult));
-	                    // Device may still work with existing configuration
-	                }
-	            }
-	            
-	            LogMessage("DTB initialization complete");
-	        } else {
-	            LogWarning("DTB queue manager initialized but not connected on COM%d", DTB_COM_PORT);
-	        }
-	    } else {
-	        LogError("Failed to initialize DTB queue manager on COM%d", DTB_COM_PORT);
-	    }
-	}
-	
-	// Initialize teensy manager
-	if (ENABLE_TNY) {
-	    LogMessage("Initializing Teensy queue manager on COM%d...", TNY_COM_PORT);
-	    g_tnyQueueMgr = TNY_QueueInit(TNY_COM_PORT, TNY_DEFAULT_BAUD_RATE);
-	    
-	    if (g_tnyQueueMgr) {
-	        TNY_SetGlobalQueueManager(g_tnyQueueMgr);
-	        
-	        // Check if connected
-	        TNYQueueStats stats;
-	        TNY_QueueGetStats(g_tnyQueueMgr, &stats);
-	        if (stats.isConnected) {
-	            LogMessage("Teensy queue manager initialized and connected on COM%d", TNY_COM_PORT);
-	            
-	            // Optional: Initialize pins to known state
-	            int lowPins[] = {0, 1};
-	            TNY_InitializePins(lowPins, 2, NULL, 0, DEVICE_PRIORITY_NORMAL);
-	        } else {
-	            LogWarning("Teensy queue manager initialized but not connected on COM%d", TNY_COM_PORT);
-	        }
-	    } else {
-	        LogError("Failed to initialize Teensy queue manager on COM%d", TNY_COM_PORT);
-	    }
+	    // Exit code: 0 completed, 1 failed, 2 cancelled
+	    return (result == SUCCESS) ? 0 : (result == ERR_CANCELLED) ? 2 : 1;
 	}
 	
 	// Load main panel
@@ -211,13 +149,25 @@ int main (int argc, char *argv[]) {
     if ((g_mainPanelHandle = LoadPanel(0, "BatteryTester.uir", PANEL)) < 0)
         return -1;
 	
-    // Initialize status and control modules
+    // Initialize the UI update bus, telemetry cache, history and graph traces, then status and control modules
+    UIUpdate_Initialize();
+    Telemetry_Initialize();
+    History_Initialize();
+    GraphTrace_Initialize();
+    if (ENABLE_TELEMETRY_EXPORT) {
+        TelemetryExport_Initialize();
+    }
     Status_Initialize(g_mainPanelHandle);
 	Controls_Initialize(g_mainPanelHandle);
     
     // Start both modules, which will use queue managers
     Status_Start();
     Controls_Start();
+    
+    // Local tools reach the tester through the IPC server once everything it serves is up
+    if (ENABLE_IPC_SERVER) {
+        IPCServer_Start();
+    }
 	
     // Display panel
     DisplayPanel(g_mainPanelHandle);
@@ -263,129 +213,7 @@ int CVICALLBACK PanelCallback(int panel, int event, void *callbackData,
                 }
             }
             
-            // Log shutdown
-            LogMessage("========================================");
-            LogMessage("Shutting down Battery Tester application");
-            LogMessage("========================================");
-            
-			// Check if CDC test is running and abort it
-			if (CDCExperiment_IsRunning()) {
-			    LogMessage("Aborting running CDC test...");
-			    CDCExperiment_Abort();
-			    
-			    // Give it a moment to clean up properly
-			    ProcessSystemEvents();
-			    Delay(0.5);
-			}
-			
-			// Check if Baseline test is running and abort it
-			if (BaselineExperiment_IsRunning()) {
-			    LogMessage("Aborting running Baseline test...");
-			    BaselineExperiment_Abort();
-			    
-			    // Give it a moment to clean up properly
-			    ProcessSystemEvents();
-			    Delay(0.5);
-			}
-			
-			// Disconnect all physical relay lines
-			const int pins[2] = {TNY_PSB_PIN, TNY_BIOLOGIC_PIN};
-			const int vals[2] = {TNY_STATE_DISCONNECTED, TNY_STATE_DISCONNECTED};
-			TNY_SetMultiplePinsQueued(pins, vals, 2, DEVICE_PRIORITY_HIGH);
-            
-            // Stop status monitoring first
-            LogMessage("Stopping status monitoring...");
-            Status_Stop();
-            
-            // The Status_Stop() function already waits for its threads to complete
-            // using CmtWaitForThreadPoolFunctionCompletion, so we just need a small
-            // delay to ensure everything is settled
-            ProcessSystemEvents();
-            Delay(0.2);
-			
-			// Clean up cDAQ module
-			if (ENABLE_CDAQ) {
-			    LogMessage("Cleaning up cDAQ module...");
-			    CDAQ_Cleanup();
-			}
-            
-            // Shutdown PSB queue manager
-			if (g_psbQueueMgr) {
-			    LogMessage("Shutting down PSB queue manager...");
-			    PSBQueueManager *tempMgr = g_psbQueueMgr;
-			    g_psbQueueMgr = NULL;  // Clear global pointer FIRST
-			    PSB_SetGlobalQueueManager(NULL);  // Clear global reference
-			    PSB_QueueShutdown(tempMgr);  // Then shutdown
-			}
-
-			// Shutdown BioLogic queue manager
-			if (g_bioQueueMgr) {
-			    LogMessage("Shutting down BioLogic queue manager...");
-			    BioQueueManager *tempMgr = g_bioQueueMgr;
-			    g_bioQueueMgr = NULL;  // Clear global pointer FIRST
-			    BIO_SetGlobalQueueManager(NULL);  // Clear global reference
-			    BIO_QueueShutdown(tempMgr);  // Then shutdown
-			}
-
-			// Shutdown DTB queue manager
-			if (g_dtbQueueMgr) {
-			    LogMessage("Shutting down DTB queue manager...");
-			    DTBQueueManager *tempMgr = g_dtbQueueMgr;
-			    g_dtbQueueMgr = NULL;  // Clear global pointer FIRST
-			    DTB_SetGlobalQueueManager(NULL);  // Clear global reference
-			    DTB_QueueShutdown(tempMgr);  // Then shutdown
-			}
-			
-			// Shutdown Teensy queue manager
-			if (g_tnyQueueMgr) {
-			    LogMessage("Shutting down Teensy queue manager...");
-			    TNYQueueManager *tempMgr = g_tnyQueueMgr;
-			    g_tnyQueueMgr = NULL;  // Clear global pointer FIRST
-			    TNY_SetGlobalQueueManager(NULL);  // Clear global reference
-			    TNY_QueueShutdown(tempMgr);  // Then shutdown
-			}
-
-			// All queue shutdown functions already wait for their threads
-			ProcessSystemEvents();
-			Delay(0.2);
-			
-			// Clean up CDC test module
-			LogMessage("Cleaning up CDC experiment module...");
-			CDCExperiment_Cleanup();
-			
-			// Clean up Baseline test module
-			LogMessage("Cleaning up Baseline experiment module...");
-			BaselineExperiment_Cleanup();
-            
-			LogMessage("Cleaning up controls module...");
-			Controls_Cleanup();
-
-			LogMessage("Cleaning up status monitoring...");
-			Status_Cleanup();
-            
-            // Clean up thread pool
-            if (g_threadPool) {
-                LogMessage("Shutting down thread pool...");
-                
-                // All worker threads should have completed by now since they all wait for their threads
-                
-                // Just give a small delay to ensure everything is cleaned up
-                ProcessSystemEvents();
-                Delay(0.1);
-                
-                CmtDiscardThreadPool(g_threadPool);
-                g_threadPool = 0;
-            }
-            
-            // Dispose of locks
-            if (g_busyLock) {
-                CmtDiscardLock(g_busyLock);
-                g_busyLock = 0;
-            }
-            
-            // Final cleanup
-            LogMessage("Cleanup complete. Exiting application.");
-            LogMessage("========================================");
+            ShutdownApplication();
             
             // Discard the panel
 			if (g_mainPanelHandle > 0) {
@@ -400,4 +228,308 @@ int CVICALLBACK PanelCallback(int panel, int event, void *callbackData,
             break;
     }
     return 0;
-}
\ No newline at end of file
+}
+
+/******************************************************************************
+ * Shutdown - stops experiments, devices and modules in dependency order.
+ * Used by the panel callback and at the end of a headless run.
+ ******************************************************************************/
+
+static void ShutdownApplication(void) {
+    // Log shutdown
+    LogMessage("========================================");
+    LogMessage("Shutting down Battery Tester application");
+    LogMessage("========================================");
+    
+    // Check if CDC test is running and abort it
+    if (CDCExperiment_IsRunning()) {
+        LogMessage("Aborting running CDC test...");
+        CDCExperiment_Abort();
+    
+        // Give it a moment to clean up properly
+        ProcessSystemEvents();
+        Delay(0.5);
+    }
+    
+    // Check if Baseline test is running and abort it
+    if (BaselineExperiment_IsRunning()) {
+        LogMessage("Aborting running Baseline test...");
+        BaselineExperiment_Abort();
+    
+        // Give it a moment to clean up properly
+        ProcessSystemEvents();
+        Delay(0.5);
+    }
+    
+    // Stop taking commands from local tools
+    IPCServer_Stop();
+    
+    // Disconnect all physical relay lines
+    const int pins[2] = {TNY_PSB_PIN, TNY_BIOLOGIC_PIN};
+    const int vals[2] = {TNY_STATE_DISCONNECTED, TNY_STATE_DISCONNECTED};
+    TNY_SetMultiplePinsQueued(pins, vals, 2, DEVICE_PRIORITY_HIGH);
+    
+    // Stop status monitoring first
+    LogMessage("Stopping status monitoring...");
+    Status_Stop();
+    
+    // The Status_Stop() function already waits for its threads to complete
+    // using CmtWaitForThreadPoolFunctionCompletion, so we just need a small
+    // delay to ensure everything is settled
+    ProcessSystemEvents();
+    Delay(0.2);
+    
+    // Clean up cDAQ module
+    if (ENABLE_CDAQ) {
+        LogMessage("Cleaning up cDAQ module...");
+        CDAQ_Cleanup();
+    }
+    
+    // Shutdown PSB queue manager
+    if (g_psbQueueMgr) {
+        LogMessage("Shutting down PSB queue manager...");
+        PSBQueueManager *tempMgr = g_psbQueueMgr;
+        g_psbQueueMgr = NULL;  // Clear global pointer FIRST
+        PSB_SetGlobalQueueManager(NULL);  // Clear global reference
+        PSB_QueueShutdown(tempMgr);  // Then shutdown
+    }
+
+    // Shutdown BioLogic queue manager
+    if (g_bioQueueMgr) {
+        LogMessage("Shutting down BioLogic queue manager...");
+        BioQueueManager *tempMgr = g_bioQueueMgr;
+        g_bioQueueMgr = NULL;  // Clear global pointer FIRST
+        BIO_SetGlobalQueueManager(NULL);  // Clear global reference
+        BIO_QueueShutdown(tempMgr);  // Then shutdown
+    }
+
+    // Shutdown DTB queue manager
+    if (g_dtbQueueMgr) {
+        LogMessage("Shutting down DTB queue manager...");
+        DTBQueueManager *tempMgr = g_dtbQueueMgr;
+        g_dtbQueueMgr = NULL;  // Clear global pointer FIRST
+        DTB_SetGlobalQueueManager(NULL);  // Clear global reference
+        DTB_QueueShutdown(tempMgr);  // Then shutdown
+    }
+    
+    // Shutdown Teensy queue manager
+    if (g_tnyQueueMgr) {
+        LogMessage("Shutting down Teensy queue manager...");
+        TNYQueueManager *tempMgr = g_tnyQueueMgr;
+        g_tnyQueueMgr = NULL;  // Clear global pointer FIRST
+        TNY_SetGlobalQueueManager(NULL);  // Clear global reference
+        TNY_QueueShutdown(tempMgr);  // Then shutdown
+    }
+
+    // All queue shutdown functions already wait for their threads
+    ProcessSystemEvents();
+    Delay(0.2);
+    
+    // Clean up CDC test module
+    LogMessage("Cleaning up CDC experiment module...");
+    CDCExperiment_Cleanup();
+    
+    // Clean up Baseline test module
+    LogMessage("Cleaning up Baseline experiment module...");
+    BaselineExperiment_Cleanup();
+    
+    LogMessage("Cleaning up controls module...");
+    Controls_Cleanup();
+
+    LogMessage("Cleaning up status monitoring...");
+    Status_Cleanup();
+    TelemetryExport_Cleanup();
+    History_Cleanup();
+    GraphTrace_Cleanup();
+    Telemetry_Cleanup();
+    UIUpdate_Cleanup();
+    
+    // Clean up thread pool
+    if (g_threadPool) {
+        LogMessage("Shutting down thread pool...");
+    
+        // All worker threads should have completed by now since they all wait for their threads
+    
+        // Just give a small delay to ensure everything is cleaned up
+        ProcessSystemEvents();
+        Delay(0.1);
+    
+        CmtDiscardThreadPool(g_threadPool);
+        g_threadPool = 0;
+    }
+    
+    // Dispose of locks
+    if (g_busyLock) {
+        CmtDiscardLock(g_busyLock);
+        g_busyLock = 0;
+    }
+    
+    // Final cleanup
+    LogMessage("Cleanup complete. Exiting application.");
+    LogMessage("========================================");
+}
+
+/******************************************************************************
+ * Device Initialization Steps - run concurrently by DeviceInit_Run, each on
+ * its own thread. Each returns SUCCESS or the error that stops its device.
+ ******************************************************************************/
+
+static int InitCDAQ(void) {
+    LogMessage("Initializing cDAQ module...");
+    int result = CDAQ_Initialize();
+    if (result == SUCCESS) {
+        LogMessage("cDAQ module initialized successfully");
+    } else {
+        LogError("Failed to initialize cDAQ module: %s", GetErrorString(result));
+    }
+    return result;
+}
+
+static int InitPSBConnect(void) {
+    LogMessage("Initializing PSB queue manager on COM%d...", PSB_COM_PORT);
+    g_psbQueueMgr = PSB_QueueInit(PSB_COM_PORT, PSB_SLAVE_ADDRESS, PSB_BAUD_RATE);
+    
+    if (!g_psbQueueMgr) {
+        LogError("Failed to initialize PSB queue manager on COM%d", PSB_COM_PORT);
+        return ERR_OPERATION_FAILED;
+    }
+    PSB_SetGlobalQueueManager(g_psbQueueMgr);
+    
+    // Check if connected
+    PSBQueueStats stats;
+    PSB_QueueGetStats(g_psbQueueMgr, &stats);
+    if (!stats.isConnected) {
+        LogWarning("PSB queue manager initialized but not connected on COM%d", PSB_COM_PORT);
+        return ERR_NOT_CONNECTED;
+    }
+    
+    LogMessage("PSB queue manager initialized and connected on COM%d", PSB_COM_PORT);
+    return SUCCESS;
+}
+
+static int InitPSBSafeState(void) {
+    LogMessage("Initializing PSB to safe state...");
+    
+    // First set safe limits
+    int limitResult = PSB_SetSafeLimitsQueued(DEVICE_PRIORITY_NORMAL);
+    if (limitResult != PSB_SUCCESS) {
+        LogWarning("Failed to set all PSB safe limits: %s", PSB_GetErrorString(limitResult));
+    }
+    
+    // Then zero all values
+    int zeroResult = PSB_ZeroAllValuesQueued(DEVICE_PRIORITY_NORMAL);
+    if (zeroResult != PSB_SUCCESS) {
+        LogWarning("Failed to zero all PSB values: %s", PSB_GetErrorString(zeroResult));
+    }
+    
+    LogMessage("PSB initialization complete");
+    return SUCCESS;
+}
+
+static int InitBioLogicConnect(void) {
+    LogMessage("Initializing BioLogic queue manager...");
+    g_bioQueueMgr = BIO_QueueInit(BIOLOGIC_DEFAULT_ADDRESS);
+    
+    if (!g_bioQueueMgr) {
+        LogError("Failed to initialize BioLogic queue manager");
+        return ERR_OPERATION_FAILED;
+    }
+    
+    BIO_SetGlobalQueueManager(g_bioQueueMgr);
+    LogMessage("BioLogic queue manager initialized");
+    return SUCCESS;
+}
+
+static int InitDTBConnect(void) {
+    LogMessage("Initializing DTB queue manager on COM%d with %d devices...", 
+               DTB_COM_PORT, DTB_NUM_DEVICES);
+    
+    g_dtbQueueMgr = DTB_QueueInit(DTB_COM_PORT, DTB_BAUD_RATE, 
+                                  g_dtbSlaveAddresses, DTB_NUM_DEVICES);
+    
+    if (!g_dtbQueueMgr) {
+        LogError("Failed to initialize DTB queue manager on COM%d", DTB_COM_PORT);
+        return ERR_OPERATION_FAILED;
+    }
+    DTB_SetGlobalQueueManager(g_dtbQueueMgr);
+    
+    // Check if connected
+    DTBQueueStats stats;
+    DTB_QueueGetStats(g_dtbQueueMgr, &stats);
+    if (!stats.isConnected) {
+        LogWarning("DTB queue manager initialized but not connected on COM%d", DTB_COM_PORT);
+        return ERR_NOT_CONNECTED;
+    }
+    
+    LogMessage("DTB queue manager initialized and connected on COM%d", DTB_COM_PORT);
+    return SUCCESS;
+}
+
+static int InitDTBConfigure(void) {
+    // Enable write access for all devices
+    LogMessage("Enabling DTB write access for all devices...");
+    int writeResult = DTB_EnableWriteAccessAllQueued(DEVICE_PRIORITY_NORMAL);
+    if (writeResult != DTB_SUCCESS) {
+        LogError("Failed to enable DTB write access for all devices: %s", 
+                DTB_GetErrorString(writeResult));
+    } else {
+        LogMessage("DTB write access enabled successfully for all devices");
+    }
+    
+    // Configure all DTB devices for K-type thermocouple with PID control
+    LogMessage("Configuring all DTB4848 devices for K-type thermocouple with PID control...");
+    
+    // Try to configure each device individually to provide better error reporting
+    for (int i = 0; i < DTB_NUM_DEVICES; i++) {
+        int slaveAddr = g_dtbSlaveAddresses[i];
+        
+        // Check current write access status for this device
+        int writeEnabled = 0;
+        int statusResult = DTB_GetWriteAccessStatusQueued(slaveAddr, &writeEnabled, DEVICE_PRIORITY_NORMAL);
+        if (statusResult == DTB_SUCCESS) {
+            LogMessage("DTB slave %d write access currently: %s", 
+                      slaveAddr, writeEnabled ? "ENABLED" : "DISABLED");
+        }
+        
+        // Configure this device
+        int configResult = DTB_ConfigureDefaultQueued(slaveAddr, DEVICE_PRIORITY_NORMAL);
+        if (configResult == DTB_SUCCESS) {
+            LogMessage("DTB4848 slave %d configured successfully", slaveAddr);
+        } else {
+            LogWarning("DTB4848 slave %d configuration failed: %s", 
+                      slaveAddr, DTB_GetErrorString(configResult));
+            // Device may still work with existing configuration
+        }
+    }
+    
+    LogMessage("DTB initialization complete");
+    return SUCCESS;
+}
+
+static int InitTeensyConnect(void) {
+    LogMessage("Initializing Teensy queue manager on COM%d...", TNY_COM_PORT);
+    g_tnyQueueMgr = TNY_QueueInit(TNY_COM_PORT, TNY_DEFAULT_BAUD_RATE);
+    
+    if (!g_tnyQueueMgr) {
+        LogError("Failed to initialize Teensy queue manager on COM%d", TNY_COM_PORT);
+        return ERR_OPERATION_FAILED;
+    }
+    TNY_SetGlobalQueueManager(g_tnyQueueMgr);
+    
+    // Check if connected
+    TNYQueueStats stats;
+    TNY_QueueGetStats(g_tnyQueueMgr, &stats);
+    if (!stats.isConnected) {
+        LogWarning("Teensy queue manager initialized but not connected on COM%d", TNY_COM_PORT);
+        return ERR_NOT_CONNECTED;
+    }
+    
+    LogMessage("Teensy queue manager initialized and connected on COM%d", TNY_COM_PORT);
+    return SUCCESS;
+}
+
+static int InitTeensyPins(void) {
+    // Initialize pins to known state
+    int lowPins[] = {0, 1};
+    return TNY_InitializePins(lowPins, 2, NULL, 0, DEVICE_PRIORITY_NORMAL);
+}
@@ -7,6 +7,8 @@
 #include "battery_utils.h"
 #include "logging.h"
 #include "status.h"
+#include "telemetry.h"
+#include "graph_trace.h"
 #include <ansi_c.h>
 
 /******************************************************************************
@@ -89,7 +91,7 @@ int Battery_GoToVoltage(VoltageTargetParams *params) {
     
     // Get current battery voltage to determine direction
     PSB_Status initialStatus;
-    result = PSB_GetStatusQueued(&initialStatus, DEVICE_PRIORITY_NORMAL);
+    result = Telemetry_GetPSBStatus(&initialStatus, TELEMETRY_MAX_AGE_FRESH, DEVICE_PRIORITY_NORMAL);
     if (result != PSB_SUCCESS) {
         LogError("Failed to read initial status: %s", PSB_GetErrorString(result));
         return result;
@@ -169,6 +171,16 @@ int Battery_GoToVoltage(VoltageTargetParams *params) {
     double lastTime = 0.0;
     int firstReading = 1;
     
+    // Graph traces, if graphs were provided
+    GraphTrace *currentTrace = NULL;
+    GraphTrace *voltageTrace = NULL;
+    if (params->graph1Handle > 0 && params->panelHandle > 0) {
+        currentTrace = GraphTrace_Create(params->panelHandle, params->graph1Handle, VAL_SOLID_CIRCLE, VAL_RED);
+    }
+    if (params->graph2Handle > 0 && params->panelHandle > 0) {
+        voltageTrace = GraphTrace_Create(params->panelHandle, params->graph2Handle, VAL_SOLID_CIRCLE, VAL_BLUE);
+    }
+    
 	LogMessage(params->wasCharging ? "Charging..." : "Discharging...");
 	
     // Update status
@@ -194,7 +206,7 @@ int Battery_GoToVoltage(VoltageTargetParams *params) {
             
             // Get current status
             PSB_Status status;
-            result = PSB_GetStatusQueued(&status, DEVICE_PRIORITY_NORMAL);
+            result = Telemetry_GetPSBStatus(&status, params->updateIntervalMs / 2, DEVICE_PRIORITY_NORMAL);
             if (result != PSB_SUCCESS) {
                 LogError("Failed to read status: %s", PSB_GetErrorString(result));
                 params->result = BATTERY_OP_ERROR;
@@ -209,14 +221,12 @@ int Battery_GoToVoltage(VoltageTargetParams *params) {
 			}
 			
 			// Update graphs if provided
-			if (params->graph1Handle > 0 && params->panelHandle > 0) {
-			    PlotPoint(params->panelHandle, params->graph1Handle, 
-			                  elapsedTime / 60.0, fabs(status.current), VAL_SOLID_CIRCLE, VAL_RED);
+			if (currentTrace) {
+			    GraphTrace_AddPoint(currentTrace, elapsedTime / 60.0, fabs(status.current));
 			}
 
-			if (params->graph2Handle > 0 && params->panelHandle > 0) {
-			    PlotPoint(params->panelHandle, params->graph2Handle, 
-			                  elapsedTime / 60.0, status.voltage, VAL_SOLID_CIRCLE, VAL_BLUE);
+			if (voltageTrace) {
+			    GraphTrace_AddPoint(voltageTrace, elapsedTime / 60.0, status.voltage);
 			}
             
             // Store final voltage
@@ -293,6 +303,10 @@ int Battery_GoToVoltage(VoltageTargetParams *params) {
     // Disable output
     PSB_SetOutputEnableQueued(0, DEVICE_PRIORITY_NORMAL);
     
+    // Final drawing stays on the graphs and follows zooms until they are cleared
+    GraphTrace_Finish(currentTrace);
+    GraphTrace_Finish(voltageTrace);
+    
     // Final status update
     char finalMsg[256];
     snprintf(finalMsg, sizeof(finalMsg), "%s complete: %.2f mAh, %.2f Wh in %.1f minutes", 
@@ -405,6 +419,16 @@ int Battery_TransferCapacity(CapacityTransferParams *params) {
     double lastTime = 0.0;
     int firstReading = 1;
     
+    // Graph traces, if graphs were provided
+    GraphTrace *currentTrace = NULL;
+    GraphTrace *voltageTrace = NULL;
+    if (params->graph1Handle > 0 && params->panelHandle > 0) {
+        currentTrace = GraphTrace_Create(params->panelHandle, params->graph1Handle, VAL_SOLID_CIRCLE, VAL_RED);
+    }
+    if (params->graph2Handle > 0 && params->panelHandle > 0) {
+        voltageTrace = GraphTrace_Create(params->panelHandle, params->graph2Handle, VAL_SOLID_CIRCLE, VAL_BLUE);
+    }
+    
     // Update status
     snprintf(statusMsg, sizeof(statusMsg), "%s...", 
              (params->mode == BATTERY_MODE_CHARGE) ? "Charging" : "Discharging");
@@ -430,7 +454,7 @@ int Battery_TransferCapacity(CapacityTransferParams *params) {
             
             // Get current status
             PSB_Status status;
-            result = PSB_GetStatusQueued(&status, DEVICE_PRIORITY_NORMAL);
+            result = Telemetry_GetPSBStatus(&status, params->updateIntervalMs / 2, DEVICE_PRIORITY_NORMAL);
             if (result != PSB_SUCCESS) {
                 LogError("Failed to read status during %s: %s", modeStr, PSB_GetErrorString(result));
                 params->result = BATTERY_OP_ERROR;
@@ -445,14 +469,12 @@ int Battery_TransferCapacity(CapacityTransferParams *params) {
             }
 			
 			// Update graphs if provided
-			if (params->graph1Handle > 0 && params->panelHandle > 0) {
-			    PlotPoint(params->panelHandle, params->graph1Handle, 
-			                  elapsedTime / 60.0, fabs(status.current), VAL_SOLID_CIRCLE, VAL_RED);
+			if (currentTrace) {
+			    GraphTrace_AddPoint(currentTrace, elapsedTime / 60.0, fabs(status.current));
 			}
 
-			if (params->graph2Handle > 0 && params->panelHandle > 0) {
-			    PlotPoint(params->panelHandle, params->graph2Handle, 
-			                  elapsedTime / 60.0, status.voltage, VAL_SOLID_CIRCLE, VAL_BLUE);
+			if (voltageTrace) {
+			    GraphTrace_AddPoint(voltageTrace, elapsedTime / 60.0, status.voltage);
 			}
             
             // Store final voltage
@@ -512,6 +534,10 @@ int Battery_TransferCapacity(CapacityTransferParams *params) {
     // Disable output
     PSB_SetOutputEnableQueued(0, DEVICE_PRIORITY_NORMAL);
     
+    // Final drawing stays on the graphs and follows zooms until they are cleared
+    GraphTrace_Finish(currentTrace);
+    GraphTrace_Finish(voltageTrace);
+    
     // Final status update
     char finalMsg[256];
     snprintf(finalMsg, sizeof(finalMsg), "%s complete: %.2f mAh in %.1f minutes", 
@@ -12,6 +12,9 @@
 #include "controls.h"
 #include "teensy_queue.h"
 #include "dtb4848_queue.h"
+#include "psb10000_queue.h"
+#include "biologic_queue.h"
+#include "log_index.h"
 
 /******************************************************************************
  * Static Functions
@@ -19,12 +22,18 @@
 
 static int CmdPromptSendThread();
 static void LogPromptTextbox(enum Status status, char *message);
+static void PromptTextboxOutput(enum Status status, const char *message, void *userData);
 static void DeferredPromptTextboxUpdate(void *data);
+static void CmdPromptPrint(CommandContext *ctx, enum Status status, const char *message);
 static int DeviceSelect(CommandContext *ctx);
 static int TeensyCommandManager(CommandContext *ctx);
 static int DTBCommandManager(CommandContext *ctx);
 static int ControlsCommandManager(CommandContext *ctx);
 static int DAQCommandManager(CommandContext *ctx);
+static int QueueCommandManager(CommandContext *ctx);
+static int LogCommandManager(CommandContext *ctx);
+static int LogQueryPrintLine(const char *line, time_t timestamp, void *userData);
+static int ParseQueryTime(const char *token, time_t now, time_t *result);
 
 /******************************************************************************
  * UI panel CVICALLBACKS
@@ -76,6 +85,18 @@ static void LogPromptTextbox(enum Status status, char *message) {
 	PostDeferredCall(DeferredPromptTextboxUpdate, data);
 }
 
+// Output function of commands typed into the prompt
+static void PromptTextboxOutput(enum Status status, const char *message, void *userData) {
+	LogPromptTextbox(status, (char*)message);
+}
+
+// Pass one line of command output to whoever ran the command
+static void CmdPromptPrint(CommandContext *ctx, enum Status status, const char *message) {
+	if (ctx->output) {
+		ctx->output(status, message, ctx->outputData);
+	}
+}
+
 // Callback function for the main UI thread to update the textbox
 static void DeferredPromptTextboxUpdate(void *callbackData) {
 	UIUpdateData *data = (UIUpdateData*)callbackData;
@@ -119,36 +140,68 @@ static int HexCharToInt(char c) {
  ******************************************************************************/
 
 static int CmdPromptSendThread() {
-	// Create command context
-	CommandContext *ctx = malloc(sizeof(CommandContext));
-	memset(ctx, 0, sizeof(CommandContext));
+	DeviceQueue_SetThreadName("Command Prompt");
 	
 	// Get the current string control content length
 	int commandLength;
 	GetCtrlAttribute(g_mainPanelHandle, PANEL_STR_CMD_PROMPT_INPUT, ATTR_STRING_TEXT_LENGTH, &commandLength);
 	
-	// Dynamically allocate memory for the command, trim it, store it in the context
+	// Dynamically allocate memory for the command
 	char *raw = malloc(commandLength + 1);
 	GetCtrlVal(g_mainPanelHandle, PANEL_STR_CMD_PROMPT_INPUT, raw);
+	
+	// Clear the control for the next command
+	SetCtrlVal(g_mainPanelHandle, PANEL_STR_CMD_PROMPT_INPUT, "");
+	
+	CmdPrompt_Execute(raw, PromptTextboxOutput, NULL);
+	free(raw);
+	
+	DeviceQueue_ClearThreadName();
+	return 0;		
+}
+
+int CmdPrompt_Execute(const char *command, CmdPromptOutputFunction output, void *userData) {
+	if (!command) {
+		return ERR_NULL_POINTER;
+	}
+	
+	// Create command context
+	CommandContext *ctx = malloc(sizeof(CommandContext));
+	char *raw = my_strdup(command);
+	if (!ctx || !raw) {
+		free(ctx);
+		free(raw);
+		return ERR_OUT_OF_MEMORY;
+	}
+	memset(ctx, 0, sizeof(CommandContext));
+	ctx->output = output;
+	ctx->outputData = userData;
+	
+	// Trim the command and store it in the context
 	char *trimmed = TrimWhitespace(raw);
 	ctx->command = my_strdup(trimmed);
 	free(raw);
+	if (!ctx->command) {
+		free(ctx);
+		return ERR_OUT_OF_MEMORY;
+	}
 	
-	// Clear the control for the next command
-	SetCtrlVal(g_mainPanelHandle, PANEL_STR_CMD_PROMPT_INPUT, "");
+	int result = SUCCESS;
 	
 	// Check to see if the command is the appropriate length
-	commandLength = strlen(ctx->command);
+	int commandLength = strlen(ctx->command);
 	ctx->commandLength = commandLength;
 	if (commandLength < 4) {
+		result = ERR_INVALID_PARAMETER;
 		goto cleanup;
-	} else if (commandLength > MESSAGE_LENGTH_LIMIT) {
-		LogPromptTextbox(CMD_ERROR, "Message Length Error: The command you've entered is too long.");
+	} else if (commandLength > (strncmp(ctx->command, "LOG", 3) == 0 ? LOG_QUERY_LENGTH_LIMIT : MESSAGE_LENGTH_LIMIT)) {
+		CmdPromptPrint(ctx, CMD_ERROR, "Message Length Error: The command you've entered is too long.");
+		result = ERR_INVALID_PARAMETER;
 		goto cleanup;
 	}
 	
-	// Log the input to the textbox so the user can see the send/response log
-	LogPromptTextbox(CMD_INPUT, ctx->command);
+	// Echo the input so the user can see the send/response log
+	CmdPromptPrint(ctx, CMD_INPUT, ctx->command);
 	
 	// Pass the command to the device selector
 	DeviceSelect(ctx);
@@ -157,7 +210,7 @@ cleanup:
 	free(ctx->command);
 	free(ctx);
 	
-	return 0;		
+	return result;
 }
 
 static int DeviceSelect(CommandContext *ctx) {
@@ -165,8 +218,11 @@ static int DeviceSelect(CommandContext *ctx) {
 	int deviceCode = (ctx->command[0] << 16 | ctx->command[1] << 8 | ctx->command[2]);
 	
 	// Remove first three characters specifying device
-	char *trimmed = malloc(ctx->commandLength - 2);	// Trim 3 characters but account for the \0 null termination character
-	trimmed = my_strdup(&ctx->command[3]);
+	char *trimmed = my_strdup(&ctx->command[3]);
+	if (!trimmed) {
+		CmdPromptPrint(ctx, CMD_ERROR, "Out of memory.");
+		return ERR_OUT_OF_MEMORY;
+	}
 	free(ctx->command);
 	ctx->command = trimmed;
 	ctx->commandLength -= 3;
@@ -189,8 +245,16 @@ static int DeviceSelect(CommandContext *ctx) {
 			DAQCommandManager(ctx);
 			break;
 			
+		case ('Q' << 16 | 'U' << 8 | 'E'):
+			QueueCommandManager(ctx);
+			break;
+			
+		case ('L' << 16 | 'O' << 8 | 'G'):
+			LogCommandManager(ctx);
+			break;
+			
 		default:
-			LogPromptTextbox(CMD_ERROR, "No such device.");
+			CmdPromptPrint(ctx, CMD_ERROR, "No such device.");
 	}
 	
 	return 0;
@@ -202,7 +266,7 @@ static int DeviceSelect(CommandContext *ctx) {
 
 static int TeensyCommandManager(CommandContext *ctx) {
 	if (strlen(ctx->command) != 4) {
-		LogPromptTextbox(CMD_ERROR, "Teensy serial commands must be exactly 4 characters.");
+		CmdPromptPrint(ctx, CMD_ERROR, "Teensy serial commands must be exactly 4 characters.");
 		return 0;
 	}
 	
@@ -213,18 +277,18 @@ static int TeensyCommandManager(CommandContext *ctx) {
 	if (error != SUCCESS) {
 		char message[1024];
 		snprintf(message, 1024, "Raw command failed: %d : %s", error, GetErrorString(error));
-		LogPromptTextbox(CMD_ERROR, message);
+		CmdPromptPrint(ctx, CMD_ERROR, message);
 		return -1;
 	}
 	
-	LogPromptTextbox(CMD_OUTPUT, response);
+	CmdPromptPrint(ctx, CMD_OUTPUT, response);
 	
 	return 0;
 }
 
 static int DTBCommandManager(CommandContext *ctx) {
 	if (ctx->commandLength < 3) {
-		LogPromptTextbox(CMD_ERROR, "DTB command too short. Specify slave hex.");
+		CmdPromptPrint(ctx, CMD_ERROR, "DTB command too short. Specify slave hex.");
 		return -1;
 	}
 	
@@ -232,14 +296,17 @@ static int DTBCommandManager(CommandContext *ctx) {
 	int low = HexCharToInt(ctx->command[1]);
 	
 	if (high < 0 || low < 0) {
-		LogPromptTextbox(CMD_ERROR, "Invalid hex slave address given.");
+		CmdPromptPrint(ctx, CMD_ERROR, "Invalid hex slave address given.");
 		return -1;
 	}
 	int slaveAddress = (high << 4) | low;
 	
 	// Remove first two characters slave address
-	char *trimmed = malloc(ctx->commandLength - 1);	// Trim 2 characters but account for the \0 null termination character
-	trimmed = my_strdup(&ctx->command[2]);
+	char *trimmed = my_strdup(&ctx->command[2]);
+	if (!trimmed) {
+		CmdPromptPrint(ctx, CMD_ERROR, "Out of memory.");
+		return ERR_OUT_OF_MEMORY;
+	}
 	free(ctx->command);
 	ctx->command = trimmed;
 	ctx->commandLength -= 2;
@@ -250,18 +317,18 @@ static int DTBCommandManager(CommandContext *ctx) {
 		if (error != SUCCESS) {
 			char message[1024];
 			snprintf(message, 1024, "Reset command failed: %d : %s", error, GetErrorString(error));
-			LogPromptTextbox(CMD_ERROR, message);
+			CmdPromptPrint(ctx, CMD_ERROR, message);
 			return -1;
 		}
 		
-		LogPromptTextbox(CMD_OUTPUT, "Reset command success.");
+		CmdPromptPrint(ctx, CMD_OUTPUT, "Reset command success.");
 	} else if (strcmp(ctx->command, "SETUP") == 0) {
 		int error = DTB_EnableWriteAccessQueued(slaveAddress, DEVICE_PRIORITY_HIGH);
 		
 		if (error != SUCCESS) {
 			char message[1024];
 			snprintf(message, 1024, "Write access command failed: %d : %s", error, GetErrorString(error));
-			LogPromptTextbox(CMD_ERROR, message);
+			CmdPromptPrint(ctx, CMD_ERROR, message);
 			return -1;
 		}
 		
@@ -270,24 +337,24 @@ static int DTBCommandManager(CommandContext *ctx) {
 		if (error != SUCCESS) {
 			char message[1024];
 			snprintf(message, 1024, "Configure command failed: %d : %s", error, GetErrorString(error));
-			LogPromptTextbox(CMD_ERROR, message);
+			CmdPromptPrint(ctx, CMD_ERROR, message);
 			return -1;
 		}
 		
-		LogPromptTextbox(CMD_OUTPUT, "Setup command success.");
+		CmdPromptPrint(ctx, CMD_OUTPUT, "Setup command success.");
 	} else if (strcmp(ctx->command, "AT") == 0) {
 		int error = DTB_StartAutoTuningQueued(slaveAddress, DEVICE_PRIORITY_HIGH);
 		
 		if (error != SUCCESS) {
 			char message[1024];
 			snprintf(message, 1024, "Autotune command failed: %d : %s", error, GetErrorString(error));
-			LogPromptTextbox(CMD_ERROR, message);
+			CmdPromptPrint(ctx, CMD_ERROR, message);
 			return -1;
 		}
 		
-		LogPromptTextbox(CMD_OUTPUT, "Autotune command success.");
+		CmdPromptPrint(ctx, CMD_OUTPUT, "Autotune command success.");
 	} else {
-		LogPromptTextbox(CMD_ERROR, "Invalid DTB command.");
+		CmdPromptPrint(ctx, CMD_ERROR, "Invalid DTB command.");
 	}
 	
 	return 0;
@@ -297,9 +364,9 @@ static int ControlsCommandManager(CommandContext *ctx) {
 	if (strcmp(ctx->command, "LOAD") == 0) {
 		// Try to reload the PSB and DTB values
 		Controls_UpdateFromDeviceStates();		
-		LogPromptTextbox(CMD_OUTPUT, "Update request completed.");
+		CmdPromptPrint(ctx, CMD_OUTPUT, "Update request completed.");
 	} else {
-		LogPromptTextbox(CMD_ERROR, "Invalid controls command.");
+		CmdPromptPrint(ctx, CMD_ERROR, "Invalid controls command.");
 	}
 	
 	return 0;
@@ -309,9 +376,255 @@ static int DAQCommandManager(CommandContext *ctx) {
 	if (0) {
 		// Insert command logic here
 	} else {
-		LogPromptTextbox(CMD_ERROR, "Invalid DAQ command.");
+		CmdPromptPrint(ctx, CMD_ERROR, "Invalid DAQ command.");
+	}
+	
+	return 0;
+}
+							
+
+// Print the pending and executing commands of a device queue, e.g. QUEPSB
+static int QueueCommandManager(CommandContext *ctx) {
+	static const char *stateNames[] = {"RUN", "QUE", "DEF"};
+	static const char *priorityNames[] = {"H", "N", "L"};
+	DeviceQueueManager *mgr = NULL;
+	
+	if (strcmp(ctx->command, "PSB") == 0) {
+		mgr = PSB_GetGlobalQueueManager();
+	} else if (strcmp(ctx->command, "DTB") == 0) {
+		mgr = DTB_GetGlobalQueueManager();
+	} else if (strcmp(ctx->command, "BIO") == 0) {
+		mgr = BIO_GetGlobalQueueManager();
+	} else if (strcmp(ctx->command, "TNY") == 0) {
+		mgr = TNY_GetGlobalQueueManager();
+	} else {
+		CmdPromptPrint(ctx, CMD_ERROR, "Invalid queue command. Use QUEPSB, QUEDTB, QUEBIO or QUETNY.");
+		return -1;
+	}
+	
+	if (!mgr) {
+		CmdPromptPrint(ctx, CMD_ERROR, "Queue manager not initialized.");
+		return -1;
+	}
+	
+	DeviceQueueSnapshot *snapshot = malloc(sizeof(DeviceQueueSnapshot));
+	if (!snapshot) {
+		CmdPromptPrint(ctx, CMD_ERROR, "Out of memory.");
+		return -1;
+	}
+	
+	int error = DeviceQueue_Snapshot(mgr, snapshot);
+	if (error != SUCCESS) {
+		char message[1024];
+		snprintf(message, 1024, "Queue snapshot failed: %d : %s", error, GetErrorString(error));
+		CmdPromptPrint(ctx, CMD_ERROR, message);
+		free(snapshot);
+		return -1;
+	}
+	
+	char line[256];
+	snprintf(line, sizeof(line), "%s: %s, %d command(s), txn %u", snapshot->deviceName,
+			 snapshot->isConnected ? "connected" : "disconnected", snapshot->totalCommands,
+			 snapshot->activeTransactionId);
+	CmdPromptPrint(ctx, CMD_OUTPUT, line);
+	
+	for (int i = 0; i < snapshot->entryCount; i++) {
+		DeviceQueueSnapshotEntry *entry = &snapshot->entries[i];
+		snprintf(line, sizeof(line), "%s %s #%d id=%u %s age=%.0fms txn=%u from=%s",
+				 stateNames[entry->state], priorityNames[entry->priority], entry->position,
+				 entry->id, entry->typeName, entry->ageMs, entry->transactionId,
+				 entry->submitter[0] ? entry->submitter : "?");
+		CmdPromptPrint(ctx, CMD_OUTPUT, line);
+	}
+	
+	if (snapshot->totalCommands > snapshot->entryCount) {
+		snprintf(line, sizeof(line), "... %d more not shown", snapshot->totalCommands - snapshot->entryCount);
+		CmdPromptPrint(ctx, CMD_OUTPUT, line);
 	}
 	
+	free(snapshot);
 	return 0;
 }
-							
\ No newline at end of file
+
+// Search the log segments through their indices, e.g.
+//   LOG DTB ERROR 202610170800 202610171200   DTB errors between two times
+//   LOG PSB ALL 168H HOURLY timeout           PSB timeouts per hour over the last week
+//   LOG PSB ALL 500                           PSB lines containing "500" in the last 24 hours
+//   LOGINDEX                                  Bring every segment index up to date
+// Times are hours ago with an H (48H) or YYYYmmddHHMM, the default window is
+// the last 24 hours. Other tokens, plain numbers included, are the text.
+static int LogCommandManager(CommandContext *ctx) {
+	static const char *levelNames[] = {"DEBUG", "INFO", "WARN", "ERROR"};
+	static const char *deviceNames[] = {"SYS", "PSB", "BIO", "DTB", "TNY", "DAQ"};
+	const char *usage = "Usage: LOG <ALL|SYS|PSB|BIO|DTB|TNY|DAQ> <ALL|DEBUG|INFO|WARN|ERROR> [from] [to] [HOURLY] [text], or LOGINDEX. Times are <hours>H or YYYYmmddHHMM.";
+	LogIndexQuery query = {0};
+	char *tokens[8];
+	int tokenCount = 0;
+	char *savePtr = NULL;
+	char message[1024];
+	int hourly = 0;
+	int timeCount = 0;
+	time_t now = time(NULL);
+	
+	for (char *token = my_strtok_r(ctx->command, " ", &savePtr); token && tokenCount < ARRAY_SIZE(tokens);
+		 token = my_strtok_r(NULL, " ", &savePtr)) {
+		tokens[tokenCount++] = token;
+	}
+	
+	double startTime = Timer();
+	
+	if (tokenCount == 1 && strcmp(tokens[0], "INDEX") == 0) {
+		int built = LogIndex_BuildAll();
+		if (built < 0) {
+			snprintf(message, sizeof(message), "Log indexing failed: %d : %s", built, GetErrorString(built));
+			CmdPromptPrint(ctx, CMD_ERROR, message);
+			return -1;
+		}
+		snprintf(message, sizeof(message), "Indexed %d log segment(s) in %.0f ms.", built, (Timer() - startTime) * 1000.0);
+		CmdPromptPrint(ctx, CMD_OUTPUT, message);
+		return 0;
+	}
+	
+	if (tokenCount < 2) {
+		CmdPromptPrint(ctx, CMD_ERROR, (char*)usage);
+		return -1;
+	}
+	
+	// Device
+	if (strcmp(tokens[0], "ALL") != 0) {
+		for (int i = 0; i < ARRAY_SIZE(deviceNames); i++) {
+			if (strcmp(tokens[0], deviceNames[i]) == 0) {
+				query.deviceMask = LOG_SINK_DEVICE(i);
+			}
+		}
+		if (query.deviceMask == 0) {
+			CmdPromptPrint(ctx, CMD_ERROR, (char*)usage);
+			return -1;
+		}
+	}
+	
+	// Lowest level
+	query.minLevel = LOG_LEVEL_NONE;
+	if (strcmp(tokens[1], "ALL") == 0) {
+		query.minLevel = LOG_LEVEL_DEBUG;
+	}
+	for (int i = 0; i < ARRAY_SIZE(levelNames); i++) {
+		if (strcmp(tokens[1], levelNames[i]) == 0) {
+			query.minLevel = (LogLevel)i;
+		}
+	}
+	if (query.minLevel == LOG_LEVEL_NONE) {
+		CmdPromptPrint(ctx, CMD_ERROR, (char*)usage);
+		return -1;
+	}
+	
+	// Window, HOURLY and the template text, in any order
+	query.startTime = now - 24 * 3600;
+	query.endTime = now;
+	for (int i = 2; i < tokenCount; i++) {
+		time_t when;
+		if (strcmp(tokens[i], "HOURLY") == 0) {
+			hourly = 1;
+		} else if (ParseQueryTime(tokens[i], now, &when) == SUCCESS && timeCount < 2) {
+			if (timeCount++ == 0) {
+				query.startTime = when;
+			} else {
+				query.endTime = when;
+			}
+		} else if (!query.templateText) {
+			query.templateText = tokens[i];
+		} else {
+			CmdPromptPrint(ctx, CMD_ERROR, (char*)usage);
+			return -1;
+		}
+	}
+	if (query.endTime < query.startTime) {
+		CmdPromptPrint(ctx, CMD_ERROR, "The query window ends before it starts.");
+		return -1;
+	}
+	
+	if (hourly) {
+		int bucketCount = (int)((query.endTime - query.startTime) / 3600) + 1;
+		int *counts = malloc(bucketCount * sizeof(int));
+		if (!counts) {
+			CmdPromptPrint(ctx, CMD_ERROR, "Out of memory.");
+			return -1;
+		}
+		
+		int total = LogIndex_Histogram(&query, 3600, counts, bucketCount);
+		if (total < 0) {
+			snprintf(message, sizeof(message), "Log query failed: %d : %s", total, GetErrorString(total));
+			CmdPromptPrint(ctx, CMD_ERROR, message);
+			free(counts);
+			return -1;
+		}
+		
+		for (int i = 0; i < bucketCount; i++) {
+			if (counts[i] > 0) {
+				char hourStr[64];
+				FormatTimestamp(query.startTime + (time_t)i * 3600, hourStr, sizeof(hourStr));
+				snprintf(message, sizeof(message), "%s  %d", hourStr, counts[i]);
+				CmdPromptPrint(ctx, CMD_OUTPUT, message);
+			}
+		}
+		free(counts);
+		
+		snprintf(message, sizeof(message), "%d line(s) matched in %.0f ms.", total, (Timer() - startTime) * 1000.0);
+		CmdPromptPrint(ctx, CMD_OUTPUT, message);
+		return 0;
+	}
+	
+	// The scan stops after the lines shown, the rest are counted from the
+	// indices without reading them
+	ctx->linesPrinted = 0;
+	int total = LogIndex_Query(&query, LogQueryPrintLine, ctx);
+	if (total >= LOG_QUERY_MAX_LINES) {
+		int count;
+		total = LogIndex_Histogram(&query, (int)(query.endTime - query.startTime) + 1, &count, 1);
+	}
+	if (total < 0) {
+		snprintf(message, sizeof(message), "Log query failed: %d : %s", total, GetErrorString(total));
+		CmdPromptPrint(ctx, CMD_ERROR, message);
+		return -1;
+	}
+	
+	snprintf(message, sizeof(message), "%d line(s) matched in %.0f ms%s", total, (Timer() - startTime) * 1000.0,
+			 total > ctx->linesPrinted ? ", first ones shown." : ".");
+	CmdPromptPrint(ctx, CMD_OUTPUT, message);
+	return 0;
+}
+
+// Print the first LOG_QUERY_MAX_LINES matches, then stop the query
+static int LogQueryPrintLine(const char *line, time_t timestamp, void *userData) {
+	CommandContext *ctx = (CommandContext*)userData;
+	
+	CmdPromptPrint(ctx, CMD_OUTPUT, line);
+	return ++ctx->linesPrinted >= LOG_QUERY_MAX_LINES;
+}
+
+// A query time is either hours before now with an H suffix (48H) or an
+// absolute YYYYmmddHHMM. A plain number is not a time, so it can be searched for.
+static int ParseQueryTime(const char *token, time_t now, time_t *result) {
+	int length = strlen(token);
+	int digits = strspn(token, "0123456789");
+	
+	if (digits > 0 && digits <= 6 && length == digits + 1 && toupper((unsigned char)token[digits]) == 'H') {
+		*result = now - (time_t)atoi(token) * 3600;
+		return SUCCESS;
+	}
+	
+	if (length == 12 && digits == 12) {
+		struct tm when = {0};
+		if (sscanf(token, "%4d%2d%2d%2d%2d", &when.tm_year, &when.tm_mon, &when.tm_mday,
+				   &when.tm_hour, &when.tm_min) != 5) {
+			return ERR_INVALID_PARAMETER;
+		}
+		when.tm_year -= 1900;
+		when.tm_mon -= 1;
+		when.tm_isdst = -1;
+		*result = mktime(&when);
+		return *result == (time_t)-1 ? ERR_INVALID_PARAMETER : SUCCESS;
+	}
+	
+	return ERR_INVALID_PARAMETER;
+}
@@ -9,6 +9,8 @@
 #define CMD_PROMPT_H
 
 #define MESSAGE_LENGTH_LIMIT 10
+#define LOG_QUERY_LENGTH_LIMIT 96	// LOG queries take arguments, see LogCommandManager
+#define LOG_QUERY_MAX_LINES 20		// Matching lines printed per LOG query
 #define OUTPUT_BUFFER_SIZE 1028
 
 typedef struct {
@@ -20,9 +22,24 @@ typedef struct {
 	char *message;
 } UIUpdateData;
 
+// Receives each line a command prints
+typedef void (*CmdPromptOutputFunction)(enum Status status, const char *message, void *userData);
+
 typedef struct {
 	char *command;
 	int commandLength;
+	CmdPromptOutputFunction output;
+	void *outputData;
+	int linesPrinted;
 } CommandContext;
 
+/**
+ * Run one prompt command, e.g. "DTB02SETUP" or "QUEPSB", on the calling thread
+ * @param command - Command text, surrounding whitespace is ignored
+ * @param output - Receives the echoed input and every output and error line
+ * @param userData - Passed through to output
+ * @return SUCCESS, ERR_INVALID_PARAMETER if the command is too short or too long, or error code
+ */
+int CmdPrompt_Execute(const char *command, CmdPromptOutputFunction output, void *userData);
+
 #endif
\ No newline at end of file
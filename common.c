@@ -11,6 +11,8 @@
 #include "dtb4848_dll.h"   // For DTB_GetErrorString
 #include "BatteryTester.h" // For UI control IDs
 #include "logging.h"       // For LogWarning
+#include "ui_update.h"     // For the DTB setpoint dimming
+#include "graph_trace.h"   // For clearing graphs that hold traces
 #include <errno.h>         // For errno
 #include <limits.h>        // For INT_MAX, INT_MIN
 #include <ctype.h>         // For isspace
@@ -315,10 +317,11 @@ void DimControlArray(int panel, int arrayID, int dim) {
             break;
 		
 		case DTB_CONTROL_ARR:
-			// DTB controls
-			SetCtrlAttribute(panel, PANEL_NUM_DTB_1_SETPOINT, ATTR_DIMMED, dim);
+			// DTB controls - the setpoint dimming also follows the DTB run
+			// state through the update bus, so it must be set through it here
+			UIUpdate_SetAttributeInt(panel, PANEL_NUM_DTB_1_SETPOINT, ATTR_DIMMED, dim);
 			SetCtrlAttribute(panel, PANEL_BTN_DTB_1_RUN_STOP, ATTR_DIMMED, dim);
-			SetCtrlAttribute(panel, PANEL_NUM_DTB_2_SETPOINT, ATTR_DIMMED, dim);
+			UIUpdate_SetAttributeInt(panel, PANEL_NUM_DTB_2_SETPOINT, ATTR_DIMMED, dim);
 			SetCtrlAttribute(panel, PANEL_BTN_DTB_2_RUN_STOP, ATTR_DIMMED, dim);
 			break;
             
@@ -329,6 +332,10 @@ void DimControlArray(int panel, int arrayID, int dim) {
 }
 
 void DimExperimentControls(int mainPanel, int tabPanel, int dim, int *controls, int numControls) {
+    if (mainPanel <= 0) {
+        return;
+    }
+    
     // Dim control arrays on main panel
     DimControlArray(mainPanel, BATTERY_CONSTANTS_ARR, dim);
     DimControlArray(mainPanel, MANUAL_CONTROL_ARR, dim);
@@ -364,6 +371,49 @@ void DimExperimentControls(int mainPanel, int tabPanel, int dim, int *controls,
     }
 }
 
+// Log popup text one line at a time, log lines must not contain line breaks
+static void LogPopupText(int isError, const char *title, const char *text) {
+    char line[MEDIUM_BUFFER_SIZE];
+    
+    if (isError) {
+        LogError("%s", title);
+    } else {
+        LogMessage("%s", title);
+    }
+    
+    while (text && *text) {
+        const char *end = strchr(text, '\n');
+        int length = end ? (int)(end - text) : (int)strlen(text);
+        
+        if (length > 0) {
+            snprintf(line, sizeof(line), "%.*s", length, text);
+            if (isError) {
+                LogError("  %s", line);
+            } else {
+                LogMessage("  %s", line);
+            }
+        }
+        text = end ? end + 1 : NULL;
+    }
+}
+
+int ExperimentConfirm(const char *title, const char *message) {
+    if (g_headlessMode) {
+        LogPopupText(0, title, message);
+        LogMessage("Headless run - continuing without confirmation");
+        return 1;
+    }
+    return ConfirmPopup(title, message);
+}
+
+void ExperimentNotify(const char *title, const char *message) {
+    if (g_headlessMode) {
+        LogPopupText(1, title, message);
+        return;
+    }
+    MessagePopup(title, message);
+}
+
 /******************************************************************************
  * Directory Utilities
  ******************************************************************************/
@@ -401,7 +451,7 @@ int CreateTimestampedDirectory(const char *baseDir, const char *prefix,
 
 void ClearAllGraphs(int panel, const int graphs[], int numGraphs) {
     for (int i = 0; i < numGraphs; i++) {
-        DeleteGraphPlot(panel, graphs[i], -1, VAL_DELAYED_DRAW);
+        GraphTrace_ClearGraph(panel, graphs[i]);
     }
 }
 
@@ -37,6 +37,8 @@
 #define ENABLE_DTB         1    // Enable DTB4848 monitoring
 #define ENABLE_TNY         1    // Enable Teensy monitoring
 #define ENABLE_CDAQ        1    // Enable cDAQ 9178
+#define ENABLE_IPC_SERVER  0    // Serve commands and telemetry on a local named pipe, see ipc_server.h
+#define ENABLE_TELEMETRY_EXPORT 1    // Publish telemetry in shared memory, see telemetry_export.h
 
 #define PSB_COM_PORT            3       // PSB 10000 COM port
 #define PSB_TARGET_SERIAL       "2872380001"  // Target PSB serial number
@@ -178,6 +180,9 @@ extern CmtThreadPoolHandle g_threadPool;
 extern CmtThreadLockHandle g_busyLock;
 extern int g_systemBusy;
 
+// Set when an experiment runs from a configuration file without the UI
+extern int g_headlessMode;
+
 //==============================================================================
 // Utility Macros
 //==============================================================================
@@ -386,6 +391,23 @@ void DimControlArray(int panel, int arrayID, int dim);
  */
 void DimExperimentControls(int mainPanel, int tabPanel, int dim, int *controls, int numControls);
 
+/**
+ * Ask the operator to confirm an experiment step. In headless mode the
+ * question is logged and answered yes.
+ * @param title - Popup title
+ * @param message - Question
+ * @return 1 to continue, 0 to cancel
+ */
+int ExperimentConfirm(const char *title, const char *message);
+
+/**
+ * Tell the operator why an experiment cannot go on. In headless mode the
+ * message is logged as an error.
+ * @param title - Popup title
+ * @param message - Explanation
+ */
+void ExperimentNotify(const char *title, const char *message);
+
 //==============================================================================
 // Common Constants
 //==============================================================================
@@ -430,6 +452,12 @@ void DimExperimentControls(int mainPanel, int tabPanel, int dim, int *controls,
 #define GEIS_TIMEOUT_MS        300000  // 5 minutes
 
 #define PSB_BATTERY_POWER_MAX  30      // 30W
+#define BATTERY_VOLTAGE_MIN    2.5     // Lowest charge/discharge target (V)
+#define BATTERY_VOLTAGE_MAX    4.3     // Highest charge/discharge target (V)
+
+// Charge/discharge target within the battery and PSB safe limits
+#define BATTERY_VOLTAGE_IN_RANGE(v) ((v) >= BATTERY_VOLTAGE_MIN && (v) <= BATTERY_VOLTAGE_MAX && \
+                                     (v) >= PSB_SAFE_VOLTAGE_MIN && (v) <= PSB_SAFE_VOLTAGE_MAX)
 
 //==============================================================================
 // Platform-specific definitions
@@ -12,6 +12,8 @@
 #include "dtb4848_queue.h"
 #include "teensy_queue.h"
 #include "status.h"
+#include "telemetry.h"
+#include "ui_update.h"
 #include "logging.h"
 
 /******************************************************************************
@@ -54,8 +56,6 @@ static int g_initialized = 0;
  * Internal Function Prototypes
  ******************************************************************************/
 
-static void CVICALLBACK DeferredControlUpdate(void* data);
-static void CVICALLBACK DeferredButtonTextUpdate(void* data);
 static void RemoteModeCallback(CommandID cmdId, PSBCommandType type, 
                               void *result, void *userData);
 static void HandleDTBRunStopAction(int deviceIndex, int panel, int control);
@@ -66,22 +66,11 @@ static void DTBRunStopQueueCallback(CommandID cmdId, DTBCommandType type,
 static void UpdateDTBButtonState(int deviceIndex, int isRunning);
 static void UpdateRemoteToggleState(int remoteMode);
 
-/******************************************************************************
- * UI Update Data Structures
- ******************************************************************************/
-
-typedef struct {
-    int control;
-    int intValue;    // For dimming/enabling
-    char strValue[MEDIUM_BUFFER_SIZE]; // For button text
-} ControlUpdateData;
-
 /******************************************************************************
  * Helper Function Prototypes
  ******************************************************************************/
 
 static bool IsValidDTBDeviceIndex(int deviceIndex);
-static int FindDTBDeviceByControl(int controlID);
 
 /******************************************************************************
  * Public Functions Implementation
@@ -174,7 +163,7 @@ void Controls_UpdateFromDeviceStates(void) {
         PSBQueueManager *psbQueueMgr = PSB_GetGlobalQueueManager();
         if (psbQueueMgr) {
             PSB_Status status;
-            if (PSB_GetStatusQueued(&status, DEVICE_PRIORITY_NORMAL) == PSB_SUCCESS) {
+            if (Telemetry_GetPSBStatus(&status, TELEMETRY_MAX_AGE_FRESH, DEVICE_PRIORITY_NORMAL) == PSB_SUCCESS) {
                 if (status.remoteMode != g_controls.lastKnownRemoteMode) {
                     g_controls.lastKnownRemoteMode = status.remoteMode;
                     UpdateRemoteToggleState(status.remoteMode);
@@ -195,7 +184,8 @@ void Controls_UpdateFromDeviceStates(void) {
                 
                 if (!device->runStateChangePending) {
                     DTB_Status status;
-                    if (DTB_GetStatusQueued(device->slaveAddress, &status, DEVICE_PRIORITY_NORMAL) == DTB_SUCCESS) {
+                    if (Telemetry_GetDTBStatus(device->slaveAddress, &status, TELEMETRY_MAX_AGE_FRESH,
+                                               DEVICE_PRIORITY_NORMAL) == DTB_SUCCESS) {
                         int stateChanged = (status.outputEnabled != device->lastKnownRunState);
                         int setpointChanged = (fabs(status.setPoint - device->lastKnownSetpoint) >= 0.1);
                         
@@ -231,6 +221,9 @@ int CVICALLBACK RemoteModeToggle(int panel, int control, int event,
                                 void *callbackData, int eventData1, int eventData2) {
     switch (event) {
         case EVENT_COMMIT:
+            // The user changed the toggle, so the update bus no longer knows what it shows
+            UIUpdate_Invalidate(panel, control);
+            
             // Check if remote mode change is already pending
             if (g_controls.remoteModeChangePending) {
                 // Reset toggle to last known state
@@ -548,59 +541,16 @@ static void UpdateDTBButtonState(int deviceIndex, int isRunning) {
     DTBDeviceControl *device = &g_controls.dtbDevices[deviceIndex];
     
     // Update button text
-    ControlUpdateData* textData = malloc(sizeof(ControlUpdateData));
-    if (textData) {
-        textData->control = device->runButtonControlID;
-        strcpy(textData->strValue, isRunning ? "Stop" : "Run");
-        PostDeferredCall(DeferredButtonTextUpdate, textData);
-    }
+    UIUpdate_SetAttributeString(g_controls.panelHandle, device->runButtonControlID,
+                                ATTR_LABEL_TEXT, isRunning ? "Stop" : "Run");
     
     // Update setpoint control dimming
-    ControlUpdateData* dimData = malloc(sizeof(ControlUpdateData));
-    if (dimData) {
-        dimData->control = device->setpointControlID;
-        dimData->intValue = isRunning ? 1 : 0; // 1 = dim, 0 = enable
-        PostDeferredCall(DeferredControlUpdate, dimData);
-    }
+    UIUpdate_SetAttributeInt(g_controls.panelHandle, device->setpointControlID,
+                             ATTR_DIMMED, isRunning ? 1 : 0); // 1 = dim, 0 = enable
 }
 
 static void UpdateRemoteToggleState(int remoteMode) {
-    ControlUpdateData* data = malloc(sizeof(ControlUpdateData));
-    if (data) {
-        data->control = PANEL_TOGGLE_REMOTE_MODE;
-        data->intValue = remoteMode;
-        PostDeferredCall(DeferredControlUpdate, data);
-    }
-}
-
-/******************************************************************************
- * Deferred Callback Functions
- ******************************************************************************/
-
-static void CVICALLBACK DeferredControlUpdate(void* data) {
-    ControlUpdateData* updateData = (ControlUpdateData*)data;
-    if (updateData && g_controls.panelHandle > 0) {
-        // Check if this is a DTB setpoint control by finding the device index
-        int deviceIndex = FindDTBDeviceByControl(updateData->control);
-        if (deviceIndex >= 0) {
-            // This is a DTB setpoint control - intValue is dimming state
-            SetCtrlAttribute(g_controls.panelHandle, updateData->control, 
-                           ATTR_DIMMED, updateData->intValue);
-        } else {
-            // For other controls, set the value
-            SetCtrlVal(g_controls.panelHandle, updateData->control, updateData->intValue);
-        }
-        free(updateData);
-    }
-}
-
-static void CVICALLBACK DeferredButtonTextUpdate(void* data) {
-    ControlUpdateData* updateData = (ControlUpdateData*)data;
-    if (updateData && g_controls.panelHandle > 0) {
-        SetCtrlAttribute(g_controls.panelHandle, updateData->control, 
-                        ATTR_LABEL_TEXT, updateData->strValue);
-        free(updateData);
-    }
+    UIUpdate_SetInt(g_controls.panelHandle, PANEL_TOGGLE_REMOTE_MODE, remoteMode);
 }
 
 /******************************************************************************
@@ -611,15 +561,6 @@ static bool IsValidDTBDeviceIndex(int deviceIndex) {
     return (deviceIndex >= 0 && deviceIndex < g_controls.numDTBDevices);
 }
 
-static int FindDTBDeviceByControl(int controlID) {
-    for (int i = 0; i < g_controls.numDTBDevices; i++) {
-        if (g_controls.dtbDevices[i].setpointControlID == controlID) {
-            return i;
-        }
-    }
-    return -1; // Not found
-}
-
 /******************************************************************************
  * TestTeensyCallback - Toggle callback to control Teensy pin 13
  * 
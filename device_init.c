@@ -0,0 +1,384 @@
+/******************************************************************************
+ * device_init.c
+ *
+ * Device Initialization Module Implementation
+ * The UI thread owns the graph: it starts every step whose dependencies have
+ * succeeded on a private thread pool, then sleeps until a step finishes or
+ * the progress display is due. A failed or disabled step never starts the
+ * steps that depend on it. Startup then takes as long as the slowest chain
+ * of dependent steps instead of the sum of all steps.
+ ******************************************************************************/
+
+#include "common.h"
+#include "device_init.h"
+#include "device_queue.h"
+#include "logging.h"
+
+/******************************************************************************
+ * Module Variables
+ ******************************************************************************/
+
+typedef enum {
+    DEVICE_INIT_PENDING = 0,
+    DEVICE_INIT_RUNNING,
+    DEVICE_INIT_SUCCEEDED,
+    DEVICE_INIT_FAILED,
+    DEVICE_INIT_SKIPPED,        // A dependency failed
+    DEVICE_INIT_DISABLED        // Disabled, or a dependency was
+} DeviceInitState;
+
+typedef struct {
+    const DeviceInitStep *step;
+    int row;
+    volatile DeviceInitState state;
+    int result;
+    double startTime;
+    double endTime;
+    CmtThreadFunctionID threadId;
+} DeviceInitTask;
+
+typedef struct {
+    const char *device;
+    int control;                // Progress text on the panel, 0 if none
+    char text[MEDIUM_BUFFER_SIZE];
+} DeviceInitRow;
+
+static struct {
+    CmtThreadLockHandle lock;   // Guards task state, results and times
+    HANDLE finishedEvent;       // Set by a worker when its step finishes
+    CmtThreadPoolHandle pool;
+
+    DeviceInitTask tasks[DEVICE_INIT_MAX_STEPS];
+    int numTasks;
+    DeviceInitRow rows[DEVICE_INIT_MAX_DEVICES];
+    int numRows;
+
+    int panel;
+    double startTime;
+} g_init = {0};
+
+/******************************************************************************
+ * Internal Function Prototypes
+ ******************************************************************************/
+
+static int DeviceInit_StartReadySteps(void);
+static int CVICALLBACK DeviceInit_StepThread(void *functionData);
+static void DeviceInit_CreateRows(void);
+static void DeviceInit_UpdateRows(void);
+static void DeviceInit_FormatRow(int row, char *text, int textSize);
+static void DeviceInit_LogReport(void);
+
+/******************************************************************************
+ * Public Interface Implementation
+ ******************************************************************************/
+
+int DeviceInit_Run(const DeviceInitStep *steps, int numSteps, int panel) {
+    if (!steps) {
+        return ERR_NULL_POINTER;
+    }
+    if (numSteps <= 0 || numSteps > DEVICE_INIT_MAX_STEPS) {
+        return ERR_INVALID_PARAMETER;
+    }
+
+    memset(&g_init, 0, sizeof(g_init));
+    g_init.panel = panel;
+
+    // One progress row per device, in the order the devices first appear
+    for (int i = 0; i < numSteps; i++) {
+        DeviceInitTask *task = &g_init.tasks[g_init.numTasks++];
+        task->step = &steps[i];
+
+        int row;
+        for (row = 0; row < g_init.numRows; row++) {
+            if (strcmp(g_init.rows[row].device, steps[i].device) == 0) {
+                break;
+            }
+        }
+        if (row == g_init.numRows) {
+            if (g_init.numRows == DEVICE_INIT_MAX_DEVICES) {
+                return ERR_INVALID_PARAMETER;
+            }
+            g_init.rows[g_init.numRows++].device = steps[i].device;
+        }
+        task->row = row;
+    }
+
+    if (CmtNewLock(NULL, 0, &g_init.lock) < 0) {
+        return ERR_THREAD_SYNC;
+    }
+    g_init.finishedEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (!g_init.finishedEvent) {
+        CmtDiscardLock(g_init.lock);
+        g_init.lock = 0;
+        return ERR_THREAD_SYNC;
+    }
+    if (CmtNewThreadPool(MIN(numSteps, DEVICE_INIT_MAX_DEVICES), &g_init.pool) < 0) {
+        CloseHandle(g_init.finishedEvent);
+        g_init.finishedEvent = NULL;
+        CmtDiscardLock(g_init.lock);
+        g_init.lock = 0;
+        return ERR_THREAD_POOL;
+    }
+
+    DeviceInit_CreateRows();
+    g_init.startTime = GetTimestamp();
+
+    // Start what is ready, wait for a step to finish, repeat
+    while (DeviceInit_StartReadySteps() > 0) {
+        WaitForSingleObject(g_init.finishedEvent, DEVICE_INIT_DISPLAY_MS);
+        DeviceInit_UpdateRows();
+        ProcessSystemEvents();
+    }
+
+    // Steps have finished, let their threads return before dropping the pool
+    for (int i = 0; i < g_init.numTasks; i++) {
+        if (g_init.tasks[i].threadId) {
+            CmtWaitForThreadPoolFunctionCompletion(g_init.pool, g_init.tasks[i].threadId,
+                                                   OPT_TP_PROCESS_EVENTS_WHILE_WAITING);
+            CmtReleaseThreadPoolFunctionID(g_init.pool, g_init.tasks[i].threadId);
+            g_init.tasks[i].threadId = 0;
+        }
+    }
+    CmtDiscardThreadPool(g_init.pool);
+    g_init.pool = 0;
+    CloseHandle(g_init.finishedEvent);
+    g_init.finishedEvent = NULL;
+
+    // Row formatting still takes the lock, so it goes last
+    DeviceInit_UpdateRows();
+    ProcessSystemEvents();
+    DeviceInit_LogReport();
+    CmtDiscardLock(g_init.lock);
+    g_init.lock = 0;
+
+    int failures = 0;
+    for (int i = 0; i < g_init.numTasks; i++) {
+        if (g_init.tasks[i].state == DEVICE_INIT_FAILED || g_init.tasks[i].state == DEVICE_INIT_SKIPPED) {
+            failures++;
+        }
+    }
+    return failures;
+}
+
+/******************************************************************************
+ * Internal Functions
+ ******************************************************************************/
+
+// Start every pending step whose dependencies succeeded and settle the ones
+// that can no longer run. Returns the number of steps running.
+static int DeviceInit_StartReadySteps(void) {
+    int running = 0;
+    bool changed = true;
+
+    CmtGetLock(g_init.lock);
+
+    // Settling one step can settle its dependents, so repeat until stable
+    while (changed) {
+        changed = false;
+
+        for (int i = 0; i < g_init.numTasks; i++) {
+            DeviceInitTask *task = &g_init.tasks[i];
+            if (task->state != DEVICE_INIT_PENDING) {
+                continue;
+            }
+
+            DeviceInitState blockedBy = DEVICE_INIT_PENDING;
+            bool ready = true;
+            for (int dep = 0; dep < g_init.numTasks; dep++) {
+                if (!(task->step->dependsOn & DEVICE_INIT_STEP_BIT(dep))) {
+                    continue;
+                }
+                DeviceInitState depState = g_init.tasks[dep].state;
+                if (depState == DEVICE_INIT_DISABLED) {
+                    blockedBy = DEVICE_INIT_DISABLED;
+                } else if ((depState == DEVICE_INIT_FAILED || depState == DEVICE_INIT_SKIPPED) &&
+                           blockedBy != DEVICE_INIT_DISABLED) {
+                    blockedBy = DEVICE_INIT_SKIPPED;
+                }
+                if (depState != DEVICE_INIT_SUCCEEDED) {
+                    ready = false;
+                }
+            }
+
+            if (!task->step->enabled || blockedBy != DEVICE_INIT_PENDING) {
+                task->state = task->step->enabled ? blockedBy : DEVICE_INIT_DISABLED;
+                changed = true;
+            } else if (ready) {
+                task->state = DEVICE_INIT_RUNNING;
+                task->startTime = GetTimestamp();
+                if (CmtScheduleThreadPoolFunction(g_init.pool, DeviceInit_StepThread, task, &task->threadId) < 0) {
+                    task->threadId = 0;
+                    task->result = ERR_THREAD_CREATE;
+                    task->endTime = task->startTime;
+                    task->state = DEVICE_INIT_FAILED;
+                }
+                changed = true;
+            }
+        }
+    }
+
+    for (int i = 0; i < g_init.numTasks; i++) {
+        if (g_init.tasks[i].state == DEVICE_INIT_RUNNING) {
+            running++;
+        }
+    }
+
+    // Nothing running but steps still pending - their dependencies can never be met
+    if (running == 0) {
+        for (int i = 0; i < g_init.numTasks; i++) {
+            if (g_init.tasks[i].state == DEVICE_INIT_PENDING) {
+                g_init.tasks[i].state = DEVICE_INIT_SKIPPED;
+                LogWarning("Device init step %s - %s has unresolvable dependencies",
+                           g_init.tasks[i].step->device, g_init.tasks[i].step->description);
+            }
+        }
+    }
+
+    CmtReleaseLock(g_init.lock);
+    return running;
+}
+
+static int CVICALLBACK DeviceInit_StepThread(void *functionData) {
+    DeviceInitTask *task = (DeviceInitTask*)functionData;
+    char threadName[DEVICE_QUEUE_THREAD_NAME_LENGTH];
+
+    snprintf(threadName, sizeof(threadName), "%s Init", task->step->device);
+    DeviceQueue_SetThreadName(threadName);
+
+    int result = task->step->function ? task->step->function() : SUCCESS;
+
+    CmtGetLock(g_init.lock);
+    task->result = result;
+    task->endTime = GetTimestamp();
+    task->state = (result == SUCCESS) ? DEVICE_INIT_SUCCEEDED : DEVICE_INIT_FAILED;
+    CmtReleaseLock(g_init.lock);
+
+    DeviceQueue_ClearThreadName();
+    SetEvent(g_init.finishedEvent);
+    return 0;
+}
+
+// Add one text row per device below the panel's contents
+static void DeviceInit_CreateRows(void) {
+    if (g_init.panel <= 0) {
+        return;
+    }
+
+    int height = 0;
+    GetPanelAttribute(g_init.panel, ATTR_HEIGHT, &height);
+
+    for (int row = 0; row < g_init.numRows; row++) {
+        int control = NewCtrl(g_init.panel, CTRL_TEXT_MSG, "", height + row * DEVICE_INIT_ROW_HEIGHT, 10);
+        g_init.rows[row].control = (control > 0) ? control : 0;
+    }
+
+    SetPanelAttribute(g_init.panel, ATTR_HEIGHT, height + g_init.numRows * DEVICE_INIT_ROW_HEIGHT + 10);
+    DeviceInit_UpdateRows();
+    ProcessDrawEvents();
+}
+
+static void DeviceInit_UpdateRows(void) {
+    if (g_init.panel <= 0) {
+        return;
+    }
+
+    for (int row = 0; row < g_init.numRows; row++) {
+        char text[MEDIUM_BUFFER_SIZE];
+        DeviceInit_FormatRow(row, text, sizeof(text));
+
+        if (g_init.rows[row].control && strcmp(text, g_init.rows[row].text) != 0) {
+            SetCtrlVal(g_init.panel, g_init.rows[row].control, text);
+            strcpy(g_init.rows[row].text, text);
+        }
+    }
+}
+
+// "PSB: Setting safe state... (2.1 s)", "PSB: ready (3.4 s)", "PSB: failed - Connecting: ..."
+static void DeviceInit_FormatRow(int row, char *text, int textSize) {
+    const char *device = g_init.rows[row].device;
+    const DeviceInitTask *runningTask = NULL;
+    const DeviceInitTask *failedTask = NULL;
+    bool anySkipped = false, anyPending = false, anySucceeded = false;
+    double firstStart = 0.0, lastEnd = 0.0;
+
+    CmtGetLock(g_init.lock);
+    for (int i = 0; i < g_init.numTasks; i++) {
+        const DeviceInitTask *task = &g_init.tasks[i];
+        if (task->row != row) {
+            continue;
+        }
+
+        switch (task->state) {
+            case DEVICE_INIT_RUNNING:   runningTask = runningTask ? runningTask : task; break;
+            case DEVICE_INIT_FAILED:    failedTask = failedTask ? failedTask : task; break;
+            case DEVICE_INIT_SKIPPED:   anySkipped = true; break;
+            case DEVICE_INIT_PENDING:   anyPending = true; break;
+            case DEVICE_INIT_SUCCEEDED: anySucceeded = true; break;
+            default: break;
+        }
+        if (task->startTime > 0.0 && (firstStart == 0.0 || task->startTime < firstStart)) {
+            firstStart = task->startTime;
+        }
+        lastEnd = MAX(lastEnd, task->endTime);
+    }
+
+    double elapsed = (runningTask ? GetTimestamp() : lastEnd) - firstStart;
+
+    if (runningTask) {
+        snprintf(text, textSize, "%s: %s... (%.1f s)", device, runningTask->step->description, elapsed);
+    } else if (failedTask) {
+        snprintf(text, textSize, "%s: failed - %s: %s", device, failedTask->step->description,
+                 GetErrorString(failedTask->result));
+    } else if (anySkipped) {
+        snprintf(text, textSize, "%s: not started, a required device failed", device);
+    } else if (anyPending) {
+        snprintf(text, textSize, "%s: waiting", device);
+    } else if (anySucceeded) {
+        snprintf(text, textSize, "%s: ready (%.1f s)", device, elapsed);
+    } else {
+        snprintf(text, textSize, "%s: disabled", device);
+    }
+    CmtReleaseLock(g_init.lock);
+}
+
+static void DeviceInit_LogReport(void) {
+    double total = GetTimestamp() - g_init.startTime;
+    double sum = 0.0;
+
+    for (int i = 0; i < g_init.numTasks; i++) {
+        const DeviceInitTask *task = &g_init.tasks[i];
+        if (task->state == DEVICE_INIT_SUCCEEDED || task->state == DEVICE_INIT_FAILED) {
+            sum += task->endTime - task->startTime;
+        }
+    }
+
+    LogMessage("Device initialization finished in %.1f s (steps took %.1f s in total)", total, sum);
+
+    for (int i = 0; i < g_init.numTasks; i++) {
+        const DeviceInitTask *task = &g_init.tasks[i];
+        switch (task->state) {
+            case DEVICE_INIT_SUCCEEDED:
+                LogMessage("  %s - %s: %.2f s (started at +%.2f s)", task->step->device,
+                           task->step->description, task->endTime - task->startTime,
+                           task->startTime - g_init.startTime);
+                break;
+            case DEVICE_INIT_FAILED:
+                LogWarning("  %s - %s: failed after %.2f s: %s", task->step->device,
+                           task->step->description, task->endTime - task->startTime,
+                           GetErrorString(task->result));
+                break;
+            case DEVICE_INIT_SKIPPED:
+                LogWarning("  %s - %s: skipped, a dependency failed", task->step->device,
+                           task->step->description);
+                break;
+            default:
+                break;
+        }
+    }
+
+    for (int row = 0; row < g_init.numRows; row++) {
+        char text[MEDIUM_BUFFER_SIZE];
+        DeviceInit_FormatRow(row, text, sizeof(text));
+        LogDebug("  %s", text);
+    }
+}
@@ -0,0 +1,55 @@
+/******************************************************************************
+ * device_init.h
+ *
+ * Device Initialization Module Header
+ * Runs startup steps as a dependency graph: every step whose dependencies
+ * have succeeded runs at once on its own thread, so devices on separate
+ * ports come up side by side. Progress is shown per device on the loading
+ * panel and a timing report is logged at the end.
+ ******************************************************************************/
+#ifndef DEVICE_INIT_H
+#define DEVICE_INIT_H
+
+#include "common.h"
+
+/******************************************************************************
+ * Configuration Constants
+ ******************************************************************************/
+#define DEVICE_INIT_MAX_STEPS           16      // Steps per graph
+#define DEVICE_INIT_MAX_DEVICES         8       // Progress rows
+#define DEVICE_INIT_DISPLAY_MS          100     // Progress refresh while steps run
+#define DEVICE_INIT_ROW_HEIGHT          20      // Progress row height on the loading panel
+
+// Dependency bit of the step at an index of the step array
+#define DEVICE_INIT_STEP_BIT(index)     (1u << (index))
+
+/******************************************************************************
+ * Type Definitions
+ ******************************************************************************/
+
+// Runs on a worker thread, returns SUCCESS or an error code
+typedef int (*DeviceInitFunction)(void);
+
+typedef struct {
+    const char *device;             // Progress row, e.g. "PSB"; steps of one device share it
+    const char *description;        // Shown while running, e.g. "Setting safe state"
+    int enabled;                    // 0 skips the step and everything depending on it
+    unsigned int dependsOn;         // DEVICE_INIT_STEP_BIT of steps that must succeed first
+    DeviceInitFunction function;
+} DeviceInitStep;
+
+/******************************************************************************
+ * Public Function Declarations
+ ******************************************************************************/
+
+/**
+ * Run all steps and return when every step has finished or been skipped.
+ * Call from the UI thread; events are processed while waiting.
+ * @param steps - Steps, in any order that lists dependencies by index
+ * @param numSteps - Number of steps, at most DEVICE_INIT_MAX_STEPS
+ * @param panel - Panel to add progress rows to, 0 for log output only
+ * @return Number of steps that failed or were skipped after a failure, or error code
+ */
+int DeviceInit_Run(const DeviceInitStep *steps, int numSteps, int panel);
+
+#endif // DEVICE_INIT_H
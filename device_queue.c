@@ -23,7 +23,7 @@ typedef enum {
 } CommandState;
 
 // Base command structure - reference counted for safe multi-threaded access
-typedef struct {
+typedef struct QueuedCommand {
     // Command identification
     DeviceCommandID id;
     int commandType;
@@ -49,6 +49,17 @@ typedef struct {
     
     // Transaction association
     DeviceTransactionHandle transactionId;
+    
+    // Latest time the submitter still wants a result, 0 = no limit of its own
+    double deadline;
+    
+    // Diagnostics - who submitted the command and where it is queued
+    int submitThreadId;
+    char submitter[DEVICE_QUEUE_THREAD_NAME_LENGTH];  // Thread name set when it was submitted
+    int experimentId;                   // Log tag of the submitting thread
+    int pendingIndex;                   // QueueIndex of the queue holding it, -1 if none
+    struct QueuedCommand *pendingPrev;  // Mirror of the queue order for snapshots,
+    struct QueuedCommand *pendingNext;  // guarded by queueManipulationLock
 } QueuedCommand;
 
 // Blocking command context - stack allocated by calling thread
@@ -75,8 +86,53 @@ typedef struct {
     
     // For tracking execution
     double startTime;
+    bool queued;                 // Commands are in the queues
+    double queueTime;            // When they were queued
+    
+    // Set under transactionLock by whoever completes the transaction: the
+    // processing thread when it starts it, or a cancel or offline expiry
+    // that takes its commands out of the queues before it started
+    bool claimed;
 } DeviceTransaction;
 
+// Statistics counter padded to a full cache line so counters written by
+// different threads never share a line
+#define DEVICE_QUEUE_CACHE_LINE_SIZE 64
+
+typedef struct {
+    volatile int value;
+    char padding[DEVICE_QUEUE_CACHE_LINE_SIZE - sizeof(int)];
+} PaddedCounter;
+
+// Reconnection worker handshake - whoever moves the state away from
+// RECONNECT_POSTED owns the device connection until it moves it back
+typedef enum {
+    RECONNECT_IDLE = 0,          // No worker scheduled
+    RECONNECT_POSTED,            // Worker scheduled, waiting for a pool thread
+    RECONNECT_RUNNING,           // Worker probing in the background
+    RECONNECT_INLINE             // Processing thread probing while the worker waits
+} ReconnectState;
+
+// Index of each queue in the per-queue statistics arrays
+typedef enum {
+    QUEUE_INDEX_HIGH = 0,
+    QUEUE_INDEX_NORMAL,
+    QUEUE_INDEX_LOW,
+    QUEUE_INDEX_DEFERRED,
+    QUEUE_INDEX_COUNT
+} QueueIndex;
+
+#define PRIORITY_QUEUE_COUNT QUEUE_INDEX_DEFERRED
+
+// Admission settings and overload state for one priority queue
+typedef struct {
+    volatile int capacity;
+    volatile DeviceAdmissionPolicy policy;
+    volatile int deadlineMs;
+    volatile int overloaded;
+    HANDLE spaceAvailableEvent;         // Auto-reset, set whenever a slot is freed
+} AdmissionControl;
+
 // Queue manager structure
 struct DeviceQueueManager {
     // Device adapter and context
@@ -103,8 +159,18 @@ struct DeviceQueueManager {
     
     // Connection state
     volatile int isConnected;
-    int reconnectAttempts;
-    double lastReconnectTime;
+    volatile int reconnectAttempts;
+    double nextProbeTime;               // Earliest time of the next reconnection attempt
+    double connectionLostTime;          // When the current outage started
+    volatile int offlineDeadlineMs;     // Negative = commands wait for the device indefinitely
+    
+    // Background reconnection worker, on a one-thread pool of its own so a
+    // long outage never holds a thread of the shared pool
+    CmtThreadPoolHandle reconnectPool;
+    volatile int reconnectState;        // ReconnectState
+    double reconnectPostTime;           // When the current worker was scheduled
+    CmtThreadFunctionID reconnectThreadId;
+    HANDLE connectedEvent;              // Auto-reset, set when a probe restores the connection
     
     // Command and transaction ID generation
     volatile DeviceCommandID nextCommandId;
@@ -118,11 +184,32 @@ struct DeviceQueueManager {
     // Current transaction state (for processing thread)
     volatile DeviceTransactionHandle currentTransactionId;
     CmtTSQHandle currentTransactionQueue;
-    
-    // Statistics
-    volatile int totalProcessed;
-    volatile int totalErrors;
-    CmtThreadLockHandle statsLock;
+    volatile DeviceTransactionHandle startingTransactionId;  // First command dequeued, not claimed yet
+    
+    // Statistics - updated with Interlocked operations, read without locks.
+    // Queue depths mirror the TSQs and are adjusted under queueManipulationLock
+    // together with the queue operation they describe.
+    PaddedCounter queueDepth[QUEUE_INDEX_COUNT];
+    PaddedCounter queueHighWater[QUEUE_INDEX_COUNT];
+    PaddedCounter totalProcessed;
+    PaddedCounter totalErrors;
+    PaddedCounter enqueueRetries;
+    PaddedCounter enqueueFailures;
+    PaddedCounter deferredDrops;
+    PaddedCounter reconnectCount;
+    PaddedCounter lastReconnectDurationMs;
+    PaddedCounter maxReconnectDurationMs;
+    PaddedCounter evictedCommands;
+    PaddedCounter offlineFailures;
+    
+    // Pending command lists mirroring each TSQ (guarded by queueManipulationLock)
+    QueuedCommand *pendingHead[QUEUE_INDEX_COUNT];
+    QueuedCommand *pendingTail[QUEUE_INDEX_COUNT];
+    
+    // Admission control per priority queue
+    AdmissionControl admission[PRIORITY_QUEUE_COUNT];
+    DeviceQueueOverloadCallback overloadCallback;
+    void *overloadUserData;
     
     // Logging
     LogDevice logDevice;
@@ -139,10 +226,31 @@ struct DeviceQueueManager {
 static QueuedCommand* Command_Create(DeviceQueueManager *mgr, int commandType, void *params);
 static void Command_AddRef(QueuedCommand *cmd);
 static void Command_Release(DeviceQueueManager *mgr, QueuedCommand *cmd);
+static void Command_CompleteBlocking(QueuedCommand *cmd, int errorCode);
+
+// Pending list helpers (caller holds queueManipulationLock)
+static void Pending_Add(DeviceQueueManager *mgr, CmtTSQHandle queue, QueuedCommand *cmd, bool atFront);
+static void Pending_Remove(DeviceQueueManager *mgr, QueuedCommand *cmd);
+static void Snapshot_FillEntry(DeviceQueueManager *mgr, const QueuedCommand *cmd, int state,
+                             int position, double now, DeviceQueueSnapshotEntry *entry);
+
+// Statistics helpers
+static void Stats_AdjustDepth(DeviceQueueManager *mgr, CmtTSQHandle queue, int delta);
+static void Stats_UpdateMax(volatile int *target, int value);
 
 // Command enqueuing helper
 static int EnqueueCommand(DeviceQueueManager *mgr, QueuedCommand *cmd, DevicePriority priority, int timeoutMs);
 
+// Admission control helpers
+static QueueIndex PriorityToIndex(DevicePriority priority);
+static int QueueToIndex(DeviceQueueManager *mgr, CmtTSQHandle queue);
+static CmtTSQHandle IndexToQueue(DeviceQueueManager *mgr, QueueIndex index);
+static int GetAdmissionWaitMs(AdmissionControl *admission, int timeoutMs);
+static QueuedCommand* EvictOldestCommand(DeviceQueueManager *mgr, CmtTSQHandle queue);
+static void SignalSpaceAvailable(DeviceQueueManager *mgr, CmtTSQHandle queue);
+static void SignalQueuesChanged(DeviceQueueManager *mgr);
+static void UpdateOverloadState(DeviceQueueManager *mgr, CmtTSQHandle queue);
+
 // Processing thread
 static int CVICALLBACK ProcessingThreadFunction(void *functionData);
 static int ExecuteDeviceCommand(DeviceQueueManager *mgr, QueuedCommand *cmd, void *result);
@@ -151,9 +259,19 @@ static int ExecuteDeviceCommand(DeviceQueueManager *mgr, QueuedCommand *cmd, voi
 static int ConnectDevice(DeviceQueueManager *mgr);
 static void DisconnectDevice(DeviceQueueManager *mgr);
 static int AttemptReconnection(DeviceQueueManager *mgr);
+static void ServiceReconnection(DeviceQueueManager *mgr);
+static int CVICALLBACK ReconnectThreadFunction(void *functionData);
+static void ExpireOfflineCommands(DeviceQueueManager *mgr);
+static int ExpireOfflineInQueue(CmtTSQHandle queue, double currentTime, DeviceQueueManager *mgr);
 
 // Transaction management
 static DeviceTransaction* FindTransaction(DeviceQueueManager *mgr, DeviceTransactionHandle id);
+static void FailTransaction(DeviceQueueManager *mgr, DeviceTransaction *txn, int errorCode);
+static int RemoveTransactionCommands(DeviceQueueManager *mgr, DeviceTransactionHandle txnId);
+static double TransactionOfflineDeadline(DeviceQueueManager *mgr, const DeviceTransaction *txn);
+static void FailEmptiedTransactions(DeviceQueueManager *mgr);
+static void CompleteTransaction(DeviceQueueManager *mgr, DeviceTransaction *txn,
+                              TransactionCommandResult *results, int resultCount);
 
 // Queue rebuilding for deferred commands
 static void RebuildQueueWithDeferredCommands(DeviceQueueManager *mgr, CmtTSQHandle targetQueue);
@@ -208,14 +326,37 @@ DeviceQueueManager* DeviceQueue_Create(const DeviceAdapter *adapter,
     mgr->shutdownRequested = 0;
     mgr->logDevice = LOG_DEVICE_NONE;
     mgr->currentCommand = NULL;
+    mgr->offlineDeadlineMs = DEVICE_QUEUE_OFFLINE_DEADLINE_MS;
     
-    // Create queues
+    // Create queues - priority queues are sized for the largest capacity,
+    // the configured capacity is enforced at admission
     int error = 0;
-    error |= CmtNewTSQ(DEVICE_QUEUE_HIGH_PRIORITY_SIZE, sizeof(QueuedCommand*), 0, &mgr->highPriorityQueue);
-    error |= CmtNewTSQ(DEVICE_QUEUE_NORMAL_PRIORITY_SIZE, sizeof(QueuedCommand*), 0, &mgr->normalPriorityQueue);
-    error |= CmtNewTSQ(DEVICE_QUEUE_LOW_PRIORITY_SIZE, sizeof(QueuedCommand*), 0, &mgr->lowPriorityQueue);
+    error |= CmtNewTSQ(DEVICE_QUEUE_MAX_CAPACITY, sizeof(QueuedCommand*), 0, &mgr->highPriorityQueue);
+    error |= CmtNewTSQ(DEVICE_QUEUE_MAX_CAPACITY, sizeof(QueuedCommand*), 0, &mgr->normalPriorityQueue);
+    error |= CmtNewTSQ(DEVICE_QUEUE_MAX_CAPACITY, sizeof(QueuedCommand*), 0, &mgr->lowPriorityQueue);
     error |= CmtNewTSQ(DEVICE_QUEUE_DEFERRED_SIZE, sizeof(QueuedCommand*), 0, &mgr->deferredCommandQueue);
     
+    // Default admission: block for up to DEVICE_QUEUE_ADMIT_DEADLINE_MS
+    const int defaultCapacity[PRIORITY_QUEUE_COUNT] = {
+        DEVICE_QUEUE_HIGH_PRIORITY_SIZE, DEVICE_QUEUE_NORMAL_PRIORITY_SIZE, DEVICE_QUEUE_LOW_PRIORITY_SIZE
+    };
+    for (int i = 0; i < PRIORITY_QUEUE_COUNT; i++) {
+        mgr->admission[i].capacity = defaultCapacity[i];
+        mgr->admission[i].policy = DEVICE_ADMIT_BLOCK;
+        mgr->admission[i].deadlineMs = DEVICE_QUEUE_ADMIT_DEADLINE_MS;
+        mgr->admission[i].spaceAvailableEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+        if (!mgr->admission[i].spaceAvailableEvent) error = -1;
+    }
+    
+    mgr->connectedEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (!mgr->connectedEvent) error = -1;
+    
+    // Without its own thread the processing thread probes inline while offline
+    if (CmtNewThreadPool(1, &mgr->reconnectPool) < 0) {
+        mgr->reconnectPool = 0;
+        LogWarning("DeviceQueue_Create: No reconnection thread for %s, reconnecting inline", adapter->deviceName);
+    }
+    
     if (error < 0) {
         LogError("DeviceQueue_Create: Failed to create queues");
         DeviceQueue_Destroy(mgr);
@@ -225,7 +366,6 @@ DeviceQueueManager* DeviceQueue_Create(const DeviceAdapter *adapter,
     // Create locks
     CmtNewLock(NULL, 0, &mgr->commandLock);
     CmtNewLock(NULL, 0, &mgr->transactionLock);
-    CmtNewLock(NULL, 0, &mgr->statsLock);
     CmtNewLock(NULL, 0, &mgr->currentCommandLock);
     CmtNewLock(NULL, 0, &mgr->queueManipulationLock);
     
@@ -243,7 +383,8 @@ DeviceQueueManager* DeviceQueue_Create(const DeviceAdapter *adapter,
         LogWarningEx(mgr->logDevice, "Failed initial connection to %s - will retry in background", 
                    adapter->deviceName);
         mgr->isConnected = 0;
-        mgr->lastReconnectTime = Timer();
+        mgr->connectionLostTime = Timer();
+        mgr->nextProbeTime = mgr->connectionLostTime + (DEVICE_QUEUE_RECONNECT_DELAY_MS / 1000.0);
     }
     
     // Start processing thread
@@ -282,6 +423,18 @@ void DeviceQueue_Destroy(DeviceQueueManager *mgr) {
                                              OPT_TP_PROCESS_EVENTS_WHILE_WAITING);
     }
     
+    // A reconnection worker sees the shutdown flag between probes
+    if (mgr->reconnectThreadId != 0) {
+        CmtWaitForThreadPoolFunctionCompletion(mgr->reconnectPool, mgr->reconnectThreadId,
+                                             OPT_TP_PROCESS_EVENTS_WHILE_WAITING);
+        CmtReleaseThreadPoolFunctionID(mgr->reconnectPool, mgr->reconnectThreadId);
+        mgr->reconnectThreadId = 0;
+    }
+    if (mgr->reconnectPool) {
+        CmtDiscardThreadPool(mgr->reconnectPool);
+        mgr->reconnectPool = 0;
+    }
+    
     // At this point, all queues should be empty
     // Verify and log if not
     int highCount = 0, normalCount = 0, lowCount = 0, deferredCount = 0;
@@ -308,8 +461,8 @@ void DeviceQueue_Destroy(DeviceQueueManager *mgr) {
             if (txnPtr && *txnPtr) {
                 DeviceTransaction *txn = *txnPtr;
                 
-                // Free transaction commands
-                for (int j = 0; j < txn->commandCount; j++) {
+                // Free transaction commands (committed commands belong to the queues)
+                for (int j = 0; j < txn->commandCount && !txn->committed; j++) {
                     if (txn->commands[j]) {
                         Command_Release(mgr, txn->commands[j]);
                     }
@@ -332,10 +485,14 @@ void DeviceQueue_Destroy(DeviceQueueManager *mgr) {
     // Dispose locks
     if (mgr->commandLock) CmtDiscardLock(mgr->commandLock);
     if (mgr->transactionLock) CmtDiscardLock(mgr->transactionLock);
-    if (mgr->statsLock) CmtDiscardLock(mgr->statsLock);
     if (mgr->currentCommandLock) CmtDiscardLock(mgr->currentCommandLock);
     if (mgr->queueManipulationLock) CmtDiscardLock(mgr->queueManipulationLock);
     
+    for (int i = 0; i < PRIORITY_QUEUE_COUNT; i++) {
+        if (mgr->admission[i].spaceAvailableEvent) CloseHandle(mgr->admission[i].spaceAvailableEvent);
+    }
+    if (mgr->connectedEvent) CloseHandle(mgr->connectedEvent);
+    
     free(mgr);
     LogMessage("Device queue manager shut down");
 }
@@ -356,19 +513,33 @@ void DeviceQueue_GetStats(DeviceQueueManager *mgr, DeviceQueueStats *stats) {
     
     memset(stats, 0, sizeof(DeviceQueueStats));
     
-    // Get queue lengths
-    CmtGetTSQAttribute(mgr->highPriorityQueue, ATTR_TSQ_ITEMS_IN_QUEUE, &stats->highPriorityQueued);
-    CmtGetTSQAttribute(mgr->normalPriorityQueue, ATTR_TSQ_ITEMS_IN_QUEUE, &stats->normalPriorityQueued);
-    CmtGetTSQAttribute(mgr->lowPriorityQueue, ATTR_TSQ_ITEMS_IN_QUEUE, &stats->lowPriorityQueued);
-    CmtGetTSQAttribute(mgr->deferredCommandQueue, ATTR_TSQ_ITEMS_IN_QUEUE, &stats->deferredQueued);
+    // Plain reads of aligned ints - each value is consistent on its own, the
+    // snapshot as a whole may straddle a concurrent update
+    stats->highPriorityQueued = mgr->queueDepth[QUEUE_INDEX_HIGH].value;
+    stats->normalPriorityQueued = mgr->queueDepth[QUEUE_INDEX_NORMAL].value;
+    stats->lowPriorityQueued = mgr->queueDepth[QUEUE_INDEX_LOW].value;
+    stats->deferredQueued = mgr->queueDepth[QUEUE_INDEX_DEFERRED].value;
+    
+    stats->highPriorityHighWater = mgr->queueHighWater[QUEUE_INDEX_HIGH].value;
+    stats->normalPriorityHighWater = mgr->queueHighWater[QUEUE_INDEX_NORMAL].value;
+    stats->lowPriorityHighWater = mgr->queueHighWater[QUEUE_INDEX_LOW].value;
+    stats->deferredHighWater = mgr->queueHighWater[QUEUE_INDEX_DEFERRED].value;
+    
+    stats->totalProcessed = mgr->totalProcessed.value;
+    stats->totalErrors = mgr->totalErrors.value;
+    stats->enqueueRetries = mgr->enqueueRetries.value;
+    stats->enqueueFailures = mgr->enqueueFailures.value;
+    stats->deferredDrops = mgr->deferredDrops.value;
     
-    CmtGetLock(mgr->statsLock);
-    stats->totalProcessed = mgr->totalProcessed;
-    stats->totalErrors = mgr->totalErrors;
     stats->reconnectAttempts = mgr->reconnectAttempts;
-    CmtReleaseLock(mgr->statsLock);
+    stats->reconnectCount = mgr->reconnectCount.value;
+    stats->lastReconnectDurationMs = mgr->lastReconnectDurationMs.value;
+    stats->maxReconnectDurationMs = mgr->maxReconnectDurationMs.value;
+    stats->evictedCommands = mgr->evictedCommands.value;
+    stats->offlineFailures = mgr->offlineFailures.value;
     
     stats->isConnected = mgr->isConnected;
+    stats->nextProbeInMs = mgr->isConnected ? 0 : MAX(0, (int)((mgr->nextProbeTime - Timer()) * 1000.0));
     stats->isProcessing = (mgr->processingThreadId != 0);
     
     stats->activeTransactionId = mgr->currentTransactionId;
@@ -428,79 +599,388 @@ static int EnqueueCommand(DeviceQueueManager *mgr, QueuedCommand *cmd, DevicePri
         return mgr && mgr->shutdownRequested ? ERR_CANCELLED : ERR_INVALID_PARAMETER;
     }
     
-    // Select queue based on priority
-    CmtTSQHandle queue;
-    const char *queueName;
-    switch (priority) {
-        case DEVICE_PRIORITY_HIGH:   queue = mgr->highPriorityQueue; queueName = "high"; break;
-        case DEVICE_PRIORITY_NORMAL: queue = mgr->normalPriorityQueue; queueName = "normal"; break;
-        case DEVICE_PRIORITY_LOW:    queue = mgr->lowPriorityQueue; queueName = "low"; break;
-        default:                     queue = mgr->normalPriorityQueue; queueName = "normal"; break;
-    }
+    QueueIndex index = PriorityToIndex(priority);
+    CmtTSQHandle queue = IndexToQueue(mgr, index);
+    AdmissionControl *admission = &mgr->admission[index];
     
-    double startTime = Timer();
-    double totalTimeout = (timeoutMs > 0) ? (timeoutMs / 1000.0) : -1.0;
+    int waitMs = GetAdmissionWaitMs(admission, timeoutMs);
+    double deadline = Timer() + waitMs / 1000.0;
+    bool waited = false;
     
-    for (int attempt = 0; attempt <= DEVICE_QUEUE_MAX_RETRIES; attempt++) {
-        // Check timeout and shutdown
+    // The capacity check and the write happen under the manipulation lock so
+    // the depth counter is exact; waiting for space happens outside it, on the
+    // queue's space-available event which the processing thread sets.
+    while (1) {
         if (mgr->shutdownRequested) return ERR_CANCELLED;
-        if (totalTimeout > 0 && (Timer() - startTime) >= totalTimeout) return ERR_TIMEOUT;
         
-        // Calculate attempt timeout
-        int attemptTimeout = TSQ_INFINITE_TIMEOUT;
-        if (timeoutMs >= 0) {
-            if (totalTimeout > 0) {
-                double remaining = totalTimeout - (Timer() - startTime);
-                attemptTimeout = (remaining > 0) ? MIN((int)(remaining * 1000), DEVICE_QUEUE_MAX_ATTEMPT_TIMEOUT_MS) : 0;
-                if (attemptTimeout <= 0) return ERR_TIMEOUT;
-            } else {
-                attemptTimeout = timeoutMs;
-            }
-        }
+        QueuedCommand *evicted = NULL;
+        int itemsWritten = 0;
         
-        // Attempt enqueue with lock coordination
         CmtGetLock(mgr->queueManipulationLock);
         if (mgr->shutdownRequested) {
             CmtReleaseLock(mgr->queueManipulationLock);
             return ERR_CANCELLED;
         }
         
-        int itemsWritten = CmtWriteTSQData(queue, &cmd, 1, attemptTimeout, NULL);
+        int depth = mgr->queueDepth[index].value;
+        if (depth >= admission->capacity && admission->policy == DEVICE_ADMIT_DROP_OLDEST) {
+            evicted = EvictOldestCommand(mgr, queue);
+            if (evicted) depth--;
+        }
+        
+        if (depth < admission->capacity) {
+            itemsWritten = CmtWriteTSQData(queue, &cmd, 1, 0, NULL);
+            if (itemsWritten == 1) {
+                Stats_AdjustDepth(mgr, queue, 1);
+                Pending_Add(mgr, queue, cmd, false);
+                depth++;
+            }
+        }
         CmtReleaseLock(mgr->queueManipulationLock);
         
+        if (evicted) {
+            LogWarningEx(mgr->logDevice, "Queue full - evicted command %u (%s) to admit command %u",
+                       evicted->id, mgr->adapter->getCommandTypeName(evicted->commandType), cmd->id);
+            InterlockedIncrement(&mgr->evictedCommands.value);
+            Command_CompleteBlocking(evicted, ERR_QUEUE_FULL);
+            Command_Release(mgr, evicted);
+        }
+        
+        UpdateOverloadState(mgr, queue);
+        
         if (itemsWritten == 1) {
-            if (attempt > 0) {
-                LogDebugEx(mgr->logDevice, "Enqueued command %u to %s queue after %d retries", 
-                         cmd->id, queueName, attempt);
+            // Pass the wakeup on if there is still room for another waiter
+            if (depth < admission->capacity) {
+                SetEvent(admission->spaceAvailableEvent);
             }
             return SUCCESS;
         }
         
-        // Handle failure
-        int errorCode = (itemsWritten == 0) ? ERR_TIMEOUT : ERR_QUEUE_FULL;
-        if (attempt >= DEVICE_QUEUE_MAX_RETRIES) {
-            LogErrorEx(mgr->logDevice, "Failed to enqueue command type %s after %d attempts", 
-                     mgr->adapter->getCommandTypeName(cmd->commandType), attempt + 1);
-            return errorCode;
+        // Queue at capacity. Only BLOCK waits, so only BLOCK can time out; the
+        // deadline means nothing to REJECT or to DROP_OLDEST with nothing to evict
+        double remaining = deadline - Timer();
+        bool expired = (waitMs > 0 && remaining <= 0);
+        if (itemsWritten < 0 || admission->policy != DEVICE_ADMIT_BLOCK || waitMs == 0 || expired) {
+            InterlockedIncrement(&mgr->enqueueFailures.value);
+            LogWarningEx(mgr->logDevice, "Rejected command type %s - queue at capacity (%d)", 
+                       mgr->adapter->getCommandTypeName(cmd->commandType), admission->capacity);
+            return (admission->policy == DEVICE_ADMIT_BLOCK && expired && itemsWritten >= 0) ?
+                   ERR_TIMEOUT : ERR_QUEUE_FULL;
         }
         
-        // Calculate backoff delay with jitter
-        int delayMs = DEVICE_QUEUE_BASE_RETRY_DELAY_MS << attempt;
-        delayMs = MIN(delayMs, DEVICE_QUEUE_MAX_RETRY_DELAY_MS);
-        delayMs += (rand() % (delayMs / 2 + 1)) - (delayMs / 4);  // 25% jitter
-        delayMs = MAX(delayMs, 1);
+        if (!waited) {
+            InterlockedIncrement(&mgr->enqueueRetries.value);
+            waited = true;
+        }
         
-        // Check if we have time for delay
-        if (totalTimeout > 0 && (Timer() - startTime + delayMs/1000.0) >= totalTimeout) {
-            return ERR_TIMEOUT;
+        // Wake on a freed slot; the slice bounds the wait if a wakeup went to another producer
+        int sliceMs = DEVICE_QUEUE_ADMIT_WAIT_SLICE_MS;
+        if (waitMs > 0) {
+            sliceMs = MIN(sliceMs, (int)(remaining * 1000.0) + 1);
         }
+        WaitForSingleObject(admission->spaceAvailableEvent, sliceMs);
+    }
+}
+
+/******************************************************************************
+ * Introspection
+ ******************************************************************************/
+
+// Submitter name of the calling thread. A command copies it when it is
+// created, so a pool thread running another function later cannot relabel it.
+static CmtTLVHandle g_threadNameTLV = 0;
+static volatile int g_threadNameState = 0;     // 0 = none, 1 = creating, 2 = ready
+
+static char* ThreadName_Get(void) {
+    if (g_threadNameState != 2) {
+        if (InterlockedCompareExchange(&g_threadNameState, 1, 0) == 0) {
+            char noName[DEVICE_QUEUE_THREAD_NAME_LENGTH] = "";
+            bool created = CmtNewThreadLocalVar(sizeof(noName), noName, NULL, NULL, &g_threadNameTLV) >= 0;
+            InterlockedExchange(&g_threadNameState, created ? 2 : 0);
+        } else {
+            while (g_threadNameState == 1) {
+                Delay(0.001);
+            }
+        }
+        if (g_threadNameState != 2) return NULL;
+    }
+    
+    char *name;
+    if (CmtGetThreadLocalVar(g_threadNameTLV, &name) < 0) return NULL;
+    return name;
+}
+
+void DeviceQueue_SetThreadName(const char *name) {
+    char *threadName = ThreadName_Get();
+    if (threadName) {
+        snprintf(threadName, DEVICE_QUEUE_THREAD_NAME_LENGTH, "%s", name ? name : "");
+    }
+}
+
+void DeviceQueue_ClearThreadName(void) {
+    DeviceQueue_SetThreadName(NULL);
+}
+
+const char* DeviceQueue_GetThreadName(void) {
+    const char *name = ThreadName_Get();
+    return name ? name : "";
+}
+
+int DeviceQueue_Snapshot(DeviceQueueManager *mgr, DeviceQueueSnapshot *snapshot) {
+    if (!mgr || !snapshot) return ERR_INVALID_PARAMETER;
+    
+    memset(snapshot, 0, sizeof(DeviceQueueSnapshot));
+    snprintf(snapshot->deviceName, sizeof(snapshot->deviceName), "%s", mgr->adapter->deviceName);
+    snapshot->isConnected = mgr->isConnected;
+    snapshot->activeTransactionId = mgr->currentTransactionId;
+    
+    double now = Timer();
+    
+    // The processing thread holds its reference while currentCommand is set
+    CmtGetLock(mgr->currentCommandLock);
+    if (mgr->currentCommand) {
+        Snapshot_FillEntry(mgr, (const QueuedCommand*)mgr->currentCommand, DEVICE_CMD_EXECUTING, 0, now,
+                         &snapshot->entries[snapshot->entryCount++]);
+        snapshot->totalCommands++;
+    }
+    CmtReleaseLock(mgr->currentCommandLock);
+    
+    // Walk the pending lists in the order the processing thread serves them
+    CmtGetLock(mgr->queueManipulationLock);
+    for (int index = 0; index < QUEUE_INDEX_COUNT; index++) {
+        int position = 0;
+        DeviceCommandSnapshotState state = (index == QUEUE_INDEX_DEFERRED) ? DEVICE_CMD_DEFERRED : DEVICE_CMD_QUEUED;
         
-        LogDebugEx(mgr->logDevice, "Retrying command %u in %dms (attempt %d/%d)", 
-                 cmd->id, delayMs, attempt + 1, DEVICE_QUEUE_MAX_RETRIES + 1);
-        Delay(delayMs / 1000.0);
+        for (QueuedCommand *cmd = mgr->pendingHead[index]; cmd; cmd = cmd->pendingNext) {
+            if (snapshot->entryCount < DEVICE_QUEUE_SNAPSHOT_MAX_ENTRIES) {
+                Snapshot_FillEntry(mgr, cmd, state, position, now,
+                                 &snapshot->entries[snapshot->entryCount++]);
+            }
+            snapshot->totalCommands++;
+            position++;
+        }
     }
+    CmtReleaseLock(mgr->queueManipulationLock);
     
-    return ERR_OPERATION_FAILED;
+    return SUCCESS;
+}
+
+static void Snapshot_FillEntry(DeviceQueueManager *mgr, const QueuedCommand *cmd, int state,
+                             int position, double now, DeviceQueueSnapshotEntry *entry) {
+    const char *typeName = mgr->adapter->getCommandTypeName ? 
+                          mgr->adapter->getCommandTypeName(cmd->commandType) : NULL;
+    
+    entry->id = cmd->id;
+    entry->commandType = cmd->commandType;
+    snprintf(entry->typeName, sizeof(entry->typeName), "%s", typeName ? typeName : "Unknown");
+    entry->priority = cmd->priority;
+    entry->state = (DeviceCommandSnapshotState)state;
+    entry->position = position;
+    entry->ageMs = (now - cmd->timestamp) * 1000.0;
+    entry->transactionId = cmd->transactionId;
+    entry->submitThreadId = cmd->submitThreadId;
+    snprintf(entry->submitter, sizeof(entry->submitter), "%s", cmd->submitter);
+}
+
+static void Pending_Add(DeviceQueueManager *mgr, CmtTSQHandle queue, QueuedCommand *cmd, bool atFront) {
+    int index = QueueToIndex(mgr, queue);
+    if (index < 0 || !cmd || cmd->pendingIndex >= 0) return;
+    
+    cmd->pendingIndex = index;
+    if (atFront) {
+        cmd->pendingPrev = NULL;
+        cmd->pendingNext = mgr->pendingHead[index];
+        if (mgr->pendingHead[index]) mgr->pendingHead[index]->pendingPrev = cmd;
+        else mgr->pendingTail[index] = cmd;
+        mgr->pendingHead[index] = cmd;
+    } else {
+        cmd->pendingNext = NULL;
+        cmd->pendingPrev = mgr->pendingTail[index];
+        if (mgr->pendingTail[index]) mgr->pendingTail[index]->pendingNext = cmd;
+        else mgr->pendingHead[index] = cmd;
+        mgr->pendingTail[index] = cmd;
+    }
+}
+
+static void Pending_Remove(DeviceQueueManager *mgr, QueuedCommand *cmd) {
+    if (!cmd || cmd->pendingIndex < 0) return;
+    
+    int index = cmd->pendingIndex;
+    if (cmd->pendingPrev) cmd->pendingPrev->pendingNext = cmd->pendingNext;
+    else mgr->pendingHead[index] = cmd->pendingNext;
+    if (cmd->pendingNext) cmd->pendingNext->pendingPrev = cmd->pendingPrev;
+    else mgr->pendingTail[index] = cmd->pendingPrev;
+    
+    cmd->pendingPrev = NULL;
+    cmd->pendingNext = NULL;
+    cmd->pendingIndex = -1;
+}
+
+/******************************************************************************
+ * Admission Control
+ ******************************************************************************/
+
+int DeviceQueue_SetAdmissionPolicy(DeviceQueueManager *mgr, DevicePriority priority,
+                                 int capacity, DeviceAdmissionPolicy policy, int deadlineMs) {
+    if (!mgr || priority < DEVICE_PRIORITY_HIGH || priority > DEVICE_PRIORITY_LOW ||
+        policy < DEVICE_ADMIT_BLOCK || policy > DEVICE_ADMIT_DROP_OLDEST) {
+        return ERR_INVALID_PARAMETER;
+    }
+    
+    AdmissionControl *admission = &mgr->admission[PriorityToIndex(priority)];
+    admission->capacity = CLAMP(capacity, 1, DEVICE_QUEUE_MAX_CAPACITY);
+    admission->policy = policy;
+    admission->deadlineMs = deadlineMs;
+    
+    // Capacity may have grown - let waiting producers re-check
+    SetEvent(admission->spaceAvailableEvent);
+    
+    LogDebugEx(mgr->logDevice, "Admission for priority %d: capacity %d, policy %d, deadline %d ms",
+             priority, admission->capacity, policy, deadlineMs);
+    return SUCCESS;
+}
+
+void DeviceQueue_SetOverloadCallback(DeviceQueueManager *mgr,
+                                   DeviceQueueOverloadCallback callback, void *userData) {
+    if (!mgr) return;
+    
+    // Notifiers read the pair without locking - publish the user data first
+    mgr->overloadCallback = NULL;
+    mgr->overloadUserData = userData;
+    mgr->overloadCallback = callback;
+}
+
+bool DeviceQueue_IsOverloaded(DeviceQueueManager *mgr, DevicePriority priority) {
+    if (!mgr || priority < DEVICE_PRIORITY_HIGH || priority > DEVICE_PRIORITY_LOW) return false;
+    return mgr->admission[PriorityToIndex(priority)].overloaded != 0;
+}
+
+static QueueIndex PriorityToIndex(DevicePriority priority) {
+    switch (priority) {
+        case DEVICE_PRIORITY_HIGH:   return QUEUE_INDEX_HIGH;
+        case DEVICE_PRIORITY_LOW:    return QUEUE_INDEX_LOW;
+        default:                     return QUEUE_INDEX_NORMAL;
+    }
+}
+
+static int QueueToIndex(DeviceQueueManager *mgr, CmtTSQHandle queue) {
+    if (queue == 0) return -1;
+    if (queue == mgr->highPriorityQueue) return QUEUE_INDEX_HIGH;
+    if (queue == mgr->normalPriorityQueue) return QUEUE_INDEX_NORMAL;
+    if (queue == mgr->lowPriorityQueue) return QUEUE_INDEX_LOW;
+    if (queue == mgr->deferredCommandQueue) return QUEUE_INDEX_DEFERRED;
+    return -1;
+}
+
+static CmtTSQHandle IndexToQueue(DeviceQueueManager *mgr, QueueIndex index) {
+    switch (index) {
+        case QUEUE_INDEX_HIGH:       return mgr->highPriorityQueue;
+        case QUEUE_INDEX_NORMAL:     return mgr->normalPriorityQueue;
+        case QUEUE_INDEX_LOW:        return mgr->lowPriorityQueue;
+        default:                     return mgr->deferredCommandQueue;
+    }
+}
+
+static int GetAdmissionWaitMs(AdmissionControl *admission, int timeoutMs) {
+    // The policy deadline bounded by the caller's timeout - zero never waits,
+    // negative on both sides waits until shutdown
+    int waitMs = admission->deadlineMs;
+    if (timeoutMs == 0) {
+        waitMs = 0;
+    } else if (timeoutMs > 0 && (waitMs < 0 || timeoutMs < waitMs)) {
+        waitMs = timeoutMs;
+    }
+    return waitMs;
+}
+
+// Remove the oldest command that is not part of a transaction. Caller holds
+// queueManipulationLock and releases the returned command after unlocking.
+static QueuedCommand* EvictOldestCommand(DeviceQueueManager *mgr, CmtTSQHandle queue) {
+    int queueSize = 0;
+    CmtGetTSQAttribute(queue, ATTR_TSQ_ITEMS_IN_QUEUE, &queueSize);
+    if (queueSize == 0) return NULL;
+    
+    QueuedCommand **commands = calloc(queueSize, sizeof(QueuedCommand*));
+    if (!commands) return NULL;
+    
+    int itemsRead = CmtReadTSQData(queue, commands, queueSize, 0, 0);
+    QueuedCommand *evicted = NULL;
+    int writeIdx = 0;
+    
+    for (int i = 0; i < itemsRead; i++) {
+        if (!evicted && commands[i] && commands[i]->transactionId == 0) {
+            evicted = commands[i];
+        } else {
+            commands[writeIdx++] = commands[i];
+        }
+    }
+    
+    if (writeIdx > 0) {
+        CmtWriteTSQData(queue, commands, writeIdx, TSQ_INFINITE_TIMEOUT, NULL);
+    }
+    if (evicted) {
+        Stats_AdjustDepth(mgr, queue, -1);
+        Pending_Remove(mgr, evicted);
+    }
+    
+    free(commands);
+    return evicted;
+}
+
+static void SignalSpaceAvailable(DeviceQueueManager *mgr, CmtTSQHandle queue) {
+    int index = QueueToIndex(mgr, queue);
+    if (index < 0 || index >= PRIORITY_QUEUE_COUNT) return;
+    
+    SetEvent(mgr->admission[index].spaceAvailableEvent);
+    UpdateOverloadState(mgr, queue);
+}
+
+// After a cancel - any priority queue may have freed slots
+static void SignalQueuesChanged(DeviceQueueManager *mgr) {
+    SignalSpaceAvailable(mgr, mgr->highPriorityQueue);
+    SignalSpaceAvailable(mgr, mgr->normalPriorityQueue);
+    SignalSpaceAvailable(mgr, mgr->lowPriorityQueue);
+}
+
+// Raise or clear the overload signal with hysteresis. Exactly one thread wins
+// each transition, so the callback fires once per change.
+static void UpdateOverloadState(DeviceQueueManager *mgr, CmtTSQHandle queue) {
+    int index = QueueToIndex(mgr, queue);
+    if (index < 0 || index >= PRIORITY_QUEUE_COUNT) return;
+    
+    AdmissionControl *admission = &mgr->admission[index];
+    int depth = mgr->queueDepth[index].value;
+    int newState;
+    
+    if (!admission->overloaded && depth * 100 >= admission->capacity * DEVICE_QUEUE_OVERLOAD_HIGH_PCT) {
+        newState = 1;
+    } else if (admission->overloaded && depth * 100 <= admission->capacity * DEVICE_QUEUE_OVERLOAD_LOW_PCT) {
+        newState = 0;
+    } else {
+        return;
+    }
+    
+    if (InterlockedCompareExchange(&admission->overloaded, newState, !newState) != !newState) {
+        return;  // Another thread made this transition
+    }
+    
+    DevicePriority priority = (index == QUEUE_INDEX_HIGH) ? DEVICE_PRIORITY_HIGH :
+                              (index == QUEUE_INDEX_LOW) ? DEVICE_PRIORITY_LOW : DEVICE_PRIORITY_NORMAL;
+    
+    if (newState) {
+        LogWarningEx(mgr->logDevice, "%s %s priority queue overloaded (%d/%d)", mgr->adapter->deviceName,
+                   priority == DEVICE_PRIORITY_HIGH ? "high" : priority == DEVICE_PRIORITY_LOW ? "low" : "normal",
+                   depth, admission->capacity);
+    } else {
+        LogMessageEx(mgr->logDevice, "%s %s priority queue load back to normal (%d/%d)", mgr->adapter->deviceName,
+                   priority == DEVICE_PRIORITY_HIGH ? "high" : priority == DEVICE_PRIORITY_LOW ? "low" : "normal",
+                   depth, admission->capacity);
+    }
+    
+    DeviceQueueOverloadCallback callback = mgr->overloadCallback;
+    if (callback) {
+        callback(mgr, priority, newState, mgr->overloadUserData);
+    }
 }
 
 /******************************************************************************
@@ -518,6 +998,10 @@ int DeviceQueue_CommandBlocking(DeviceQueueManager *mgr, int commandType,
     
     cmd->priority = priority;
     
+    // The caller stops waiting after its timeout - no point running the command later
+    double timeout = (timeoutMs > 0 ? timeoutMs : DEVICE_QUEUE_COMMAND_TIMEOUT_MS) / 1000.0;
+    cmd->deadline = cmd->timestamp + timeout;
+    
     // Create blocking context (stack allocated - owned by this thread)
     BlockingContext ctx = {0};
     ctx.errorCode = ERR_TIMEOUT;
@@ -544,7 +1028,7 @@ int DeviceQueue_CommandBlocking(DeviceQueueManager *mgr, int commandType,
     // Add reference for the queue
     Command_AddRef(cmd);
     
-    // Enqueue command with retry logic
+    // Enqueue command subject to the admission policy
     int enqueueResult = EnqueueCommand(mgr, cmd, priority, timeoutMs);
     if (enqueueResult != SUCCESS) {
         // Clean up
@@ -558,7 +1042,6 @@ int DeviceQueue_CommandBlocking(DeviceQueueManager *mgr, int commandType,
     
     // Wait for completion
     double startTime = Timer();
-    double timeout = (timeoutMs > 0 ? timeoutMs : 30000) / 1000.0;
     int finalError = ERR_TIMEOUT;
     
     while ((Timer() - startTime) < timeout) {
@@ -580,6 +1063,23 @@ int DeviceQueue_CommandBlocking(DeviceQueueManager *mgr, int commandType,
         Delay(0.001);
     }
     
+    // If we stopped waiting early, the command may still reference our stack
+    // context - pull it from the queues, or wait out an execution in progress
+    if (!ctx.completed) {
+        CmtGetLock(mgr->queueManipulationLock);
+        int removed = CancelCommandInQueue(mgr->highPriorityQueue, cmd->id, mgr) +
+                      CancelCommandInQueue(mgr->normalPriorityQueue, cmd->id, mgr) +
+                      CancelCommandInQueue(mgr->lowPriorityQueue, cmd->id, mgr) +
+                      CancelCommandInQueue(mgr->deferredCommandQueue, cmd->id, mgr);
+        CmtReleaseLock(mgr->queueManipulationLock);
+        SignalQueuesChanged(mgr);
+        
+        while (!removed && !ctx.completed) {
+            ProcessSystemEvents();
+            Delay(0.001);
+        }
+    }
+    
     // Copy result if successful
     if (finalError == SUCCESS) {
         mgr->adapter->copyCommandResult(commandType, result, ctx.result);
@@ -608,8 +1108,8 @@ DeviceCommandID DeviceQueue_CommandAsync(DeviceQueueManager *mgr, int commandTyp
     cmd->callback = callback;
     cmd->userData = userData;
     
-    // Enqueue command with retry logic
-    int enqueueResult = EnqueueCommand(mgr, cmd, priority, -1);  // -1 = infinite timeout
+    // Enqueue command subject to the admission policy
+    int enqueueResult = EnqueueCommand(mgr, cmd, priority, -1);  // -1 = admission policy deadline
     if (enqueueResult != SUCCESS) {
         Command_Release(mgr, cmd);
         return 0;
@@ -628,37 +1128,51 @@ int DeviceQueue_CancelAll(DeviceQueueManager *mgr) {
     
     // Cancel all commands in all queues
     while (CmtReadTSQData(mgr->highPriorityQueue, &cmd, 1, 0, 0) > 0) {
+        Stats_AdjustDepth(mgr, mgr->highPriorityQueue, -1);
         if (cmd) {
+            Pending_Remove(mgr, cmd);
+            Command_CompleteBlocking(cmd, ERR_CANCELLED);
             Command_Release(mgr, cmd);
             totalCancelled++;
         }
     }
     
     while (CmtReadTSQData(mgr->normalPriorityQueue, &cmd, 1, 0, 0) > 0) {
+        Stats_AdjustDepth(mgr, mgr->normalPriorityQueue, -1);
         if (cmd) {
+            Pending_Remove(mgr, cmd);
+            Command_CompleteBlocking(cmd, ERR_CANCELLED);
             Command_Release(mgr, cmd);
             totalCancelled++;
         }
     }
     
     while (CmtReadTSQData(mgr->lowPriorityQueue, &cmd, 1, 0, 0) > 0) {
+        Stats_AdjustDepth(mgr, mgr->lowPriorityQueue, -1);
         if (cmd) {
+            Pending_Remove(mgr, cmd);
+            Command_CompleteBlocking(cmd, ERR_CANCELLED);
             Command_Release(mgr, cmd);
             totalCancelled++;
         }
     }
     
     while (CmtReadTSQData(mgr->deferredCommandQueue, &cmd, 1, 0, 0) > 0) {
+        Stats_AdjustDepth(mgr, mgr->deferredCommandQueue, -1);
         if (cmd) {
+            Pending_Remove(mgr, cmd);
+            Command_CompleteBlocking(cmd, ERR_CANCELLED);
             Command_Release(mgr, cmd);
             totalCancelled++;
         }
     }
     
     CmtReleaseLock(mgr->queueManipulationLock);
+    SignalQueuesChanged(mgr);
     
     if (totalCancelled > 0) {
         LogMessageEx(mgr->logDevice, "Cancelled %d pending commands", totalCancelled);
+        FailEmptiedTransactions(mgr);
     }
     
     return SUCCESS;
@@ -678,9 +1192,11 @@ int DeviceQueue_CancelCommand(DeviceQueueManager *mgr, DeviceCommandID cmdId) {
     totalCancelled += CancelCommandInQueue(mgr->deferredCommandQueue, cmdId, mgr);
     
     CmtReleaseLock(mgr->queueManipulationLock);
+    SignalQueuesChanged(mgr);
     
     if (totalCancelled > 0) {
         LogDebugEx(mgr->logDevice, "Cancelled command ID %u", cmdId);
+        FailEmptiedTransactions(mgr);
         return SUCCESS;
     }
     
@@ -700,6 +1216,8 @@ static int CancelCommandInQueue(CmtTSQHandle queue, DeviceCommandID cmdId, Devic
     
     for (int i = 0; i < itemsRead; i++) {
         if (commands[i] && commands[i]->id == cmdId) {
+            Pending_Remove(mgr, commands[i]);
+            Command_CompleteBlocking(commands[i], ERR_CANCELLED);
             Command_Release(mgr, commands[i]);
             commands[i] = NULL;
             cancelled++;
@@ -718,6 +1236,7 @@ static int CancelCommandInQueue(CmtTSQHandle queue, DeviceCommandID cmdId, Devic
         if (writeIdx > 0) {
             CmtWriteTSQData(queue, commands, writeIdx, TSQ_INFINITE_TIMEOUT, NULL);
         }
+        Stats_AdjustDepth(mgr, queue, -cancelled);
     } else {
         // Write all back
         CmtWriteTSQData(queue, commands, itemsRead, TSQ_INFINITE_TIMEOUT, NULL);
@@ -740,10 +1259,12 @@ int DeviceQueue_CancelByType(DeviceQueueManager *mgr, int commandType) {
     totalCancelled += CancelByTypeInQueue(mgr->deferredCommandQueue, commandType, mgr);
     
     CmtReleaseLock(mgr->queueManipulationLock);
+    SignalQueuesChanged(mgr);
     
     if (totalCancelled > 0) {
         LogMessageEx(mgr->logDevice, "Cancelled %d commands of type %s", 
                    totalCancelled, mgr->adapter->getCommandTypeName(commandType));
+        FailEmptiedTransactions(mgr);
     }
     
     return SUCCESS;
@@ -762,6 +1283,8 @@ static int CancelByTypeInQueue(CmtTSQHandle queue, int commandType, DeviceQueueM
     
     for (int i = 0; i < itemsRead; i++) {
         if (commands[i] && commands[i]->commandType == commandType) {
+            Pending_Remove(mgr, commands[i]);
+            Command_CompleteBlocking(commands[i], ERR_CANCELLED);
             Command_Release(mgr, commands[i]);
             commands[i] = NULL;
             cancelled++;
@@ -780,6 +1303,7 @@ static int CancelByTypeInQueue(CmtTSQHandle queue, int commandType, DeviceQueueM
         if (writeIdx > 0) {
             CmtWriteTSQData(queue, commands, writeIdx, TSQ_INFINITE_TIMEOUT, NULL);
         }
+        Stats_AdjustDepth(mgr, queue, -cancelled);
     } else {
         CmtWriteTSQData(queue, commands, itemsRead, TSQ_INFINITE_TIMEOUT, NULL);
     }
@@ -802,10 +1326,12 @@ int DeviceQueue_CancelByAge(DeviceQueueManager *mgr, double ageSeconds) {
     totalCancelled += CancelByAgeInQueue(mgr->deferredCommandQueue, currentTime, ageSeconds, mgr);
     
     CmtReleaseLock(mgr->queueManipulationLock);
+    SignalQueuesChanged(mgr);
     
     if (totalCancelled > 0) {
         LogMessageEx(mgr->logDevice, "Cancelled %d commands older than %.1f seconds", 
                    totalCancelled, ageSeconds);
+        FailEmptiedTransactions(mgr);
     }
     
     return SUCCESS;
@@ -825,6 +1351,8 @@ static int CancelByAgeInQueue(CmtTSQHandle queue, double currentTime, double max
     
     for (int i = 0; i < itemsRead; i++) {
         if (commands[i] && (currentTime - commands[i]->timestamp) > maxAge) {
+            Pending_Remove(mgr, commands[i]);
+            Command_CompleteBlocking(commands[i], ERR_CANCELLED);
             Command_Release(mgr, commands[i]);
             commands[i] = NULL;
             cancelled++;
@@ -843,6 +1371,7 @@ static int CancelByAgeInQueue(CmtTSQHandle queue, double currentTime, double max
         if (writeIdx > 0) {
             CmtWriteTSQData(queue, commands, writeIdx, TSQ_INFINITE_TIMEOUT, NULL);
         }
+        Stats_AdjustDepth(mgr, queue, -cancelled);
     } else {
         CmtWriteTSQData(queue, commands, itemsRead, TSQ_INFINITE_TIMEOUT, NULL);
     }
@@ -863,23 +1392,24 @@ int DeviceQueue_CancelTransaction(DeviceQueueManager *mgr, DeviceTransactionHand
     }
     
     if (txn->committed) {
-        // Transaction already committed - need to cancel queued commands
+        // Claiming a queued transaction keeps the processing thread from
+        // starting it, and this thread completes it. One the processing
+        // thread already started is completed there once its remaining
+        // commands are gone, with those reported as cancelled.
+        bool claimed = txn->queued && !txn->claimed;
+        if (claimed) {
+            txn->claimed = true;
+        }
         CmtReleaseLock(mgr->transactionLock);
         
-        // Cancel commands in all queues with this transaction ID
-        int cancelled = 0;
-        CmtGetLock(mgr->queueManipulationLock);
-        
-        cancelled += CancelCommandsWithTransactionId(mgr->highPriorityQueue, txnId, mgr);
-        cancelled += CancelCommandsWithTransactionId(mgr->normalPriorityQueue, txnId, mgr);
-        cancelled += CancelCommandsWithTransactionId(mgr->lowPriorityQueue, txnId, mgr);
-        cancelled += CancelCommandsWithTransactionId(mgr->deferredCommandQueue, txnId, mgr);
-        
-        CmtReleaseLock(mgr->queueManipulationLock);
-        
+        int cancelled = RemoveTransactionCommands(mgr, txnId);
         LogMessageEx(mgr->logDevice, "Cancelled %d commands from transaction %u", 
                    cancelled, txnId);
-        return cancelled > 0 ? SUCCESS : ERR_OPERATION_FAILED;
+        
+        if (claimed) {
+            FailTransaction(mgr, txn, ERR_CANCELLED);
+        }
+        return (claimed || cancelled > 0) ? SUCCESS : ERR_OPERATION_FAILED;
     } else {
         // Transaction not committed - just remove from list
         int count = ListNumItems(mgr->uncommittedTransactions);
@@ -920,6 +1450,8 @@ static int CancelCommandsWithTransactionId(CmtTSQHandle queue, DeviceTransaction
     
     for (int i = 0; i < itemsRead; i++) {
         if (commands[i] && commands[i]->transactionId == txnId) {
+            Pending_Remove(mgr, commands[i]);
+            Command_CompleteBlocking(commands[i], ERR_CANCELLED);
             Command_Release(mgr, commands[i]);
             commands[i] = NULL;
             cancelled++;
@@ -938,6 +1470,7 @@ static int CancelCommandsWithTransactionId(CmtTSQHandle queue, DeviceTransaction
         if (writeIdx > 0) {
             CmtWriteTSQData(queue, commands, writeIdx, TSQ_INFINITE_TIMEOUT, NULL);
         }
+        Stats_AdjustDepth(mgr, queue, -cancelled);
     } else {
         CmtWriteTSQData(queue, commands, itemsRead, TSQ_INFINITE_TIMEOUT, NULL);
     }
@@ -1072,53 +1605,103 @@ int DeviceQueue_CommitTransaction(DeviceQueueManager *mgr, DeviceTransactionHand
     }
     
     // Select queue based on transaction priority
-    CmtTSQHandle queue;
-    switch (txn->priority) {
-        case DEVICE_PRIORITY_HIGH:   queue = mgr->highPriorityQueue; break;
-        case DEVICE_PRIORITY_NORMAL: queue = mgr->normalPriorityQueue; break;
-        case DEVICE_PRIORITY_LOW:    queue = mgr->lowPriorityQueue; break;
-        default: queue = mgr->normalPriorityQueue; break;
-    }
+    QueueIndex index = PriorityToIndex(txn->priority);
+    CmtTSQHandle queue = IndexToQueue(mgr, index);
+    AdmissionControl *admission = &mgr->admission[index];
     
     // Store transaction info for later use
     txn->callback = callback;
     txn->userData = userData;
     
-    // Store transaction info in each command
+    // Store transaction info in each command - the transaction's reference
+    // is handed over to the queue, the processing thread finds the
+    // transaction itself by ID
     for (int i = 0; i < txn->commandCount; i++) {
         txn->commands[i]->transactionId = txnId;
         txn->commands[i]->priority = txn->priority;
+    }
+    
+    // Freeze the transaction and take a copy of its commands - once they are
+    // queued the processing thread may complete and free it at any time
+    QueuedCommand *commands[DEVICE_MAX_TRANSACTION_COMMANDS];
+    int commandCount = txn->commandCount;
+    DevicePriority priority = txn->priority;
+    memcpy(commands, txn->commands, commandCount * sizeof(QueuedCommand*));
+    txn->committed = true;
+    CmtReleaseLock(mgr->transactionLock);
+    
+    // Queue all commands at once so the transaction stays contiguous. Wait for
+    // room outside both locks - the processing thread needs them to drain. A
+    // transaction larger than the capacity is admitted into an empty queue.
+    // DROP_OLDEST never evicts for a transaction, making room for several
+    // commands would drop as many unrelated ones, so it fails like REJECT.
+    int waitMs = GetAdmissionWaitMs(admission, -1);
+    double deadline = Timer() + waitMs / 1000.0;
+    int result = SUCCESS;
+    int queued = 0;
+    
+    while (!queued) {
+        if (mgr->shutdownRequested) {
+            result = ERR_CANCELLED;
+            break;
+        }
         
-        // Store transaction pointer in first command for later retrieval
-        if (i == 0) {
-            txn->commands[i]->blockingContext = (void*)txn;
+        CmtGetLock(mgr->queueManipulationLock);
+        int depth = mgr->queueDepth[index].value;
+        int freeSpace = 0;
+        CmtGetTSQAttribute(queue, ATTR_TSQ_QUEUE_FREE_SPACE, &freeSpace);
+        if ((depth == 0 || depth + commandCount <= admission->capacity) && freeSpace >= commandCount) {
+            queued = (CmtWriteTSQData(queue, commands, commandCount, 0, NULL) == commandCount);
+            if (queued) {
+                Stats_AdjustDepth(mgr, queue, commandCount);
+                for (int i = 0; i < commandCount; i++) {
+                    Pending_Add(mgr, queue, commands[i], false);
+                }
+                
+                // Still ours - the processing thread needs this lock to read them
+                CmtGetLock(mgr->transactionLock);
+                txn->queued = true;
+                txn->queueTime = Timer();
+                CmtReleaseLock(mgr->transactionLock);
+            }
         }
+        CmtReleaseLock(mgr->queueManipulationLock);
+        
+        UpdateOverloadState(mgr, queue);
+        if (queued) break;
         
-        // Add reference for the queue
-        Command_AddRef(txn->commands[i]);
+        double remaining = deadline - Timer();
+        if (admission->policy != DEVICE_ADMIT_BLOCK || waitMs == 0) {
+            result = ERR_QUEUE_FULL;
+            break;
+        }
+        if (waitMs > 0 && remaining <= 0) {
+            result = ERR_TIMEOUT;
+            break;
+        }
+        
+        int sliceMs = DEVICE_QUEUE_ADMIT_WAIT_SLICE_MS;
+        if (waitMs > 0) {
+            sliceMs = MIN(sliceMs, (int)(remaining * 1000.0) + 1);
+        }
+        WaitForSingleObject(admission->spaceAvailableEvent, sliceMs);
     }
     
-    // Queue all commands at once
-    int itemsWritten = CmtWriteTSQData(queue, txn->commands, txn->commandCount, 
-                                       TSQ_INFINITE_TIMEOUT, NULL);
-    
-    if (itemsWritten != txn->commandCount) {
-        // Failed to queue all commands - clean up
-        for (int i = 0; i < txn->commandCount; i++) {
-            Command_Release(mgr, txn->commands[i]);
-        }
+    if (!queued) {
+        // The transaction keeps its commands - the caller may retry or cancel it,
+        // otherwise it is freed by Destroy
+        CmtGetLock(mgr->transactionLock);
+        txn->committed = false;
         CmtReleaseLock(mgr->transactionLock);
-        LogError("Failed to queue transaction %u commands", txnId);
-        return ERR_QUEUE_FULL;
+        InterlockedIncrement(&mgr->enqueueFailures.value);
+        LogErrorEx(mgr->logDevice, "Failed to queue transaction %u commands: %s", txnId, GetErrorString(result));
+        return result;
     }
     
-    txn->committed = true;
-    CmtReleaseLock(mgr->transactionLock);
-    
     LogMessage("Committed transaction %u with %d commands to %s priority queue", 
-               txnId, txn->commandCount,
-               txn->priority == DEVICE_PRIORITY_HIGH ? "high" :
-               txn->priority == DEVICE_PRIORITY_NORMAL ? "normal" : "low");
+               txnId, commandCount,
+               priority == DEVICE_PRIORITY_HIGH ? "high" :
+               priority == DEVICE_PRIORITY_NORMAL ? "normal" : "low");
     
     return SUCCESS;
 }
@@ -1154,12 +1737,40 @@ static int CVICALLBACK ProcessingThreadFunction(void *functionData) {
             }
         }
         
-        // Check connection state (skip reconnection attempts during shutdown)
+        // While offline the reconnection worker probes the device - only fail
+        // the commands that cannot wait for it (skipped during shutdown)
         if (!mgr->isConnected && !mgr->shutdownRequested) {
-            if (Timer() - mgr->lastReconnectTime > (DEVICE_QUEUE_RECONNECT_DELAY_MS / 1000.0)) {
-                AttemptReconnection(mgr);
+            ServiceReconnection(mgr);
+            ExpireOfflineCommands(mgr);
+            
+            // The transaction in progress cannot wait past its deadline either
+            if (currentTransaction && transactionResults &&
+                TransactionOfflineDeadline(mgr, currentTransaction) < MAX(Timer(), mgr->nextProbeTime)) {
+                int removed = RemoveTransactionCommands(mgr, mgr->currentTransactionId);
+                InterlockedExchangeAdd(&mgr->offlineFailures.value, removed);
+                
+                for (int i = transactionCommandIndex; i < expectedTransactionCommands; i++) {
+                    transactionResults[i].commandType = 0;
+                    transactionResults[i].errorCode = ERR_NOT_CONNECTED;
+                    transactionResults[i].result = NULL;
+                }
+                
+                LogWarningEx(mgr->logDevice, "%s offline - failed transaction %u after %d of %d commands",
+                           mgr->adapter->deviceName, mgr->currentTransactionId,
+                           transactionCommandIndex, expectedTransactionCommands);
+                CompleteTransaction(mgr, currentTransaction, transactionResults, expectedTransactionCommands);
+                currentTransaction = NULL;
+                transactionResults = NULL;
+                transactionCommandIndex = 0;
+                expectedTransactionCommands = 0;
+                
+                CmtTSQHandle transactionQueue = mgr->currentTransactionQueue;
+                mgr->currentTransactionId = 0;
+                mgr->currentTransactionQueue = 0;
+                RebuildQueueWithDeferredCommands(mgr, transactionQueue);
             }
-            Delay(0.1);
+            
+            WaitForSingleObject(mgr->connectedEvent, DEVICE_QUEUE_OFFLINE_POLL_MS);
             continue;
         }
         
@@ -1169,9 +1780,12 @@ static int CVICALLBACK ProcessingThreadFunction(void *functionData) {
         // Get next command based on current state
         if (mgr->currentTransactionId != 0 && mgr->currentTransactionQueue != 0) {
             // In transaction mode - only read from current transaction queue
+            CmtGetLock(mgr->queueManipulationLock);
             int itemsRead = CmtReadTSQData(mgr->currentTransactionQueue, &cmd, 1, 0, 0);
             if (itemsRead > 0) {
                 cmdQueue = mgr->currentTransactionQueue;
+                Stats_AdjustDepth(mgr, cmdQueue, -1);
+                Pending_Remove(mgr, cmd);
                 
                 // Check if this command is part of current transaction
                 if (cmd->transactionId != mgr->currentTransactionId) {
@@ -1180,21 +1794,50 @@ static int CVICALLBACK ProcessingThreadFunction(void *functionData) {
                              cmd->id, cmd->transactionId, mgr->currentTransactionId);
                     
                     // Add to deferred queue
-                    if (CmtWriteTSQData(mgr->deferredCommandQueue, &cmd, 1, 0, NULL) <= 0) {
+                    if (CmtWriteTSQData(mgr->deferredCommandQueue, &cmd, 1, 0, NULL) > 0) {
+                        Stats_AdjustDepth(mgr, mgr->deferredCommandQueue, 1);
+                        Pending_Add(mgr, mgr->deferredCommandQueue, cmd, false);
+                    } else {
                         LogWarningEx(mgr->logDevice, "Deferred queue full - dropping command %u", cmd->id);
+                        InterlockedIncrement(&mgr->deferredDrops.value);
+                        Command_CompleteBlocking(cmd, ERR_QUEUE_FULL);
                         Command_Release(mgr, cmd);
                     }
                     cmd = NULL;
                 }
             }
+            CmtReleaseLock(mgr->queueManipulationLock);
+            
+            if (itemsRead > 0) {
+                SignalSpaceAvailable(mgr, mgr->currentTransactionQueue);
+            }
             
             // If no more transaction commands, complete the transaction
             if (!cmd) {
+                // Commands cancelled out from under the transaction never arrive -
+                // report them as cancelled so the callback still fires
+                if (currentTransaction && transactionResults) {
+                    for (int i = transactionCommandIndex; i < expectedTransactionCommands; i++) {
+                        transactionResults[i].commandType = 0;
+                        transactionResults[i].errorCode = ERR_CANCELLED;
+                        transactionResults[i].result = NULL;
+                    }
+                    
+                    LogWarningEx(mgr->logDevice, "Transaction %u ended with %d of %d commands executed",
+                               mgr->currentTransactionId, transactionCommandIndex, expectedTransactionCommands);
+                    CompleteTransaction(mgr, currentTransaction, transactionResults, expectedTransactionCommands);
+                }
+                currentTransaction = NULL;
+                transactionResults = NULL;
+                transactionCommandIndex = 0;
+                expectedTransactionCommands = 0;
+                
+                CmtTSQHandle transactionQueue = mgr->currentTransactionQueue;
                 mgr->currentTransactionId = 0;
                 mgr->currentTransactionQueue = 0;
                 
                 // Rebuild the transaction source queue with deferred commands
-                RebuildQueueWithDeferredCommands(mgr, cmdQueue);
+                RebuildQueueWithDeferredCommands(mgr, transactionQueue);
             }
         } else {
             // Normal mode - check all queues in priority order
@@ -1215,7 +1858,19 @@ static int CVICALLBACK ProcessingThreadFunction(void *functionData) {
                 }
             }
             
+            if (cmdQueue) {
+                Stats_AdjustDepth(mgr, cmdQueue, -1);
+                Pending_Remove(mgr, cmd);
+                
+                // Out of the queues but not claimed yet - not emptied by a cancel
+                mgr->startingTransactionId = cmd->transactionId;
+            }
+            
             CmtReleaseLock(mgr->queueManipulationLock);
+            
+            if (cmdQueue) {
+                SignalSpaceAvailable(mgr, cmdQueue);
+            }
         }
         
         // Process command if we have one
@@ -1225,11 +1880,7 @@ static int CVICALLBACK ProcessingThreadFunction(void *functionData) {
                 LogDebugEx(mgr->logDevice, "Releasing command %u during shutdown", cmd->id);
                 
                 // For blocking commands, signal cancellation
-                BlockingContext *blockingCtx = (BlockingContext*)cmd->blockingContext;
-                if (blockingCtx && cmd->transactionId == 0) {
-                    blockingCtx->errorCode = ERR_CANCELLED;
-                    blockingCtx->completed = 1;
-                }
+                Command_CompleteBlocking(cmd, ERR_CANCELLED);
                 
                 Command_Release(mgr, cmd);
                 continue;
@@ -1237,24 +1888,40 @@ static int CVICALLBACK ProcessingThreadFunction(void *functionData) {
             
             // Check if this starts a new transaction
             if (cmd->transactionId != 0 && mgr->currentTransactionId == 0) {
-                mgr->currentTransactionId = cmd->transactionId;
-                mgr->currentTransactionQueue = cmdQueue;
-                
-                // Get transaction info from first command
+                // Look the transaction up by ID - its first command may have been
+                // cancelled. One claimed by a cancel or an offline expiry, or
+                // already completed, has lost its other commands; this one is
+                // dropped too.
                 CmtGetLock(mgr->transactionLock);
-                currentTransaction = (DeviceTransaction*)cmd->blockingContext;
+                currentTransaction = FindTransaction(mgr, cmd->transactionId);
+                if (currentTransaction && currentTransaction->claimed) {
+                    currentTransaction = NULL;
+                }
                 if (currentTransaction) {
-                    // Allocate results array
-                    transactionResults = calloc(currentTransaction->commandCount, 
-                                              sizeof(TransactionCommandResult));
-                    transactionCommandIndex = 0;
-                    expectedTransactionCommands = currentTransaction->commandCount;
-                    currentTransaction->startTime = Timer();
-                    
-                    LogMessageEx(mgr->logDevice, "Starting transaction %u with %d commands", 
-                               mgr->currentTransactionId, expectedTransactionCommands);
+                    currentTransaction->claimed = true;
                 }
+                mgr->startingTransactionId = 0;
+                if (!currentTransaction) {
+                    CmtReleaseLock(mgr->transactionLock);
+                    LogDebugEx(mgr->logDevice, "Dropping command %u of finished transaction %u",
+                             cmd->id, cmd->transactionId);
+                    Command_Release(mgr, cmd);
+                    continue;
+                }
+                
+                mgr->currentTransactionId = cmd->transactionId;
+                mgr->currentTransactionQueue = cmdQueue;
+                
+                // Allocate results array
+                transactionResults = calloc(currentTransaction->commandCount, 
+                                          sizeof(TransactionCommandResult));
+                transactionCommandIndex = 0;
+                expectedTransactionCommands = currentTransaction->commandCount;
+                currentTransaction->startTime = Timer();
                 CmtReleaseLock(mgr->transactionLock);
+                
+                LogMessageEx(mgr->logDevice, "Starting transaction %u with %d commands", 
+                           mgr->currentTransactionId, expectedTransactionCommands);
             }
             
             // Check transaction timeout BEFORE executing command
@@ -1290,17 +1957,16 @@ static int CVICALLBACK ProcessingThreadFunction(void *functionData) {
                 errorCode = ExecuteDeviceCommand(mgr, cmd, result);
                 
                 // Update statistics
-                CmtGetLock(mgr->statsLock);
-                mgr->totalProcessed++;
+                InterlockedIncrement(&mgr->totalProcessed.value);
                 if (errorCode != SUCCESS) {
-                    mgr->totalErrors++;
+                    InterlockedIncrement(&mgr->totalErrors.value);
                 }
-                CmtReleaseLock(mgr->statsLock);
                 
                 // Handle connection loss
                 if (errorCode == ERR_COMM_FAILED || errorCode == ERR_TIMEOUT || errorCode == ERR_NOT_CONNECTED) {
+                    mgr->connectionLostTime = Timer();
+                    mgr->nextProbeTime = mgr->connectionLostTime + (DEVICE_QUEUE_RECONNECT_DELAY_MS / 1000.0);
                     mgr->isConnected = 0;
-                    mgr->lastReconnectTime = Timer();
                     LogWarningEx(mgr->logDevice, "Lost connection during command execution");
                 }
             } else {
@@ -1309,10 +1975,8 @@ static int CVICALLBACK ProcessingThreadFunction(void *functionData) {
                 result = mgr->adapter->createCommandResult(cmd->commandType);
                 
                 // Update statistics
-                CmtGetLock(mgr->statsLock);
-                mgr->totalProcessed++;
-                mgr->totalErrors++;
-                CmtReleaseLock(mgr->statsLock);
+                InterlockedIncrement(&mgr->totalProcessed.value);
+                InterlockedIncrement(&mgr->totalErrors.value);
             }
             
             // Handle result based on command type
@@ -1356,48 +2020,10 @@ static int CVICALLBACK ProcessingThreadFunction(void *functionData) {
                     
                     // Check if transaction complete
                     if (transactionCommandIndex >= expectedTransactionCommands) {
-                        // Transaction complete - call callback
-                        if (currentTransaction && currentTransaction->callback) {
-                            int successCount = 0, failureCount = 0;
-                            for (int i = 0; i < expectedTransactionCommands; i++) {
-                                if (transactionResults[i].errorCode == SUCCESS) {
-                                    successCount++;
-                                } else {
-                                    failureCount++;
-                                }
-                            }
-                            
-                            currentTransaction->callback(mgr->currentTransactionId, 
-                                                       successCount, failureCount,
-                                                       transactionResults, expectedTransactionCommands,
-                                                       currentTransaction->userData);
-                        }
-                        
-                        // Clean up transaction
-                        for (int i = 0; i < expectedTransactionCommands; i++) {
-                            if (transactionResults[i].result) {
-                                mgr->adapter->freeCommandResult(transactionResults[i].commandType,
-                                                              transactionResults[i].result);
-                            }
-                        }
-                        free(transactionResults);
+                        CompleteTransaction(mgr, currentTransaction, transactionResults,
+                                          expectedTransactionCommands);
                         transactionResults = NULL;
                         
-                        // Remove transaction from uncommitted list
-                        CmtGetLock(mgr->transactionLock);
-                        int count = ListNumItems(mgr->uncommittedTransactions);
-                        for (int i = 1; i <= count; i++) {
-                            DeviceTransaction **txnPtr = ListGetPtrToItem(mgr->uncommittedTransactions, i);
-                            if (txnPtr && *txnPtr && (*txnPtr)->id == mgr->currentTransactionId) {
-                                free(*txnPtr);
-                                ListRemoveItem(mgr->uncommittedTransactions, 0, i);
-                                break;
-                            }
-                        }
-                        CmtReleaseLock(mgr->transactionLock);
-                        
-                        LogMessageEx(mgr->logDevice, "Completed transaction %u", mgr->currentTransactionId);
-                        
                         // Reset transaction state
                         mgr->currentTransactionId = 0;
                         mgr->currentTransactionQueue = 0;
@@ -1405,6 +2031,9 @@ static int CVICALLBACK ProcessingThreadFunction(void *functionData) {
                         transactionCommandIndex = 0;
                         expectedTransactionCommands = 0;
                     }
+                } else {
+                    // Transaction already completed or unknown - nobody will collect the result
+                    mgr->adapter->freeCommandResult(cmd->commandType, result);
                 }
             } else if (blockingCtx) {
                 // Blocking non-transaction command
@@ -1453,56 +2082,68 @@ static void RebuildQueueWithDeferredCommands(DeviceQueueManager *mgr, CmtTSQHand
     int deferredCount = 0;
     CmtGetTSQAttribute(mgr->deferredCommandQueue, ATTR_TSQ_ITEMS_IN_QUEUE, &deferredCount);
     
-    if (deferredCount == 0) {
+    if (deferredCount == 0 || targetQueue == 0) {
         // No deferred commands, nothing to do
         return;
     }
     
     LogDebugEx(mgr->logDevice, "Rebuilding queue with %d deferred commands", deferredCount);
     
+    // Hold off enqueuers so the rebuilt queue cannot be filled underneath us
+    CmtGetLock(mgr->queueManipulationLock);
+    
     // Get count of remaining commands in target queue
     int remainingCount = 0;
     CmtGetTSQAttribute(targetQueue, ATTR_TSQ_ITEMS_IN_QUEUE, &remainingCount);
     
-    // Allocate arrays for commands
-    QueuedCommand **deferredCommands = calloc(deferredCount, sizeof(QueuedCommand*));
-    QueuedCommand **remainingCommands = NULL;
-    
-    if (remainingCount > 0) {
-        remainingCommands = calloc(remainingCount, sizeof(QueuedCommand*));
-    }
-    
-    if (!deferredCommands || (remainingCount > 0 && !remainingCommands)) {
+    // Allocate one array for deferred commands followed by remaining commands
+    QueuedCommand **commands = calloc(deferredCount + remainingCount, sizeof(QueuedCommand*));
+    if (!commands) {
+        CmtReleaseLock(mgr->queueManipulationLock);
         LogError("Failed to allocate memory for queue rebuilding");
-        free(deferredCommands);
-        free(remainingCommands);
         return;
     }
     
-    // Read all deferred commands
-    int actualDeferred = CmtReadTSQData(mgr->deferredCommandQueue, deferredCommands, deferredCount, 0, 0);
-    
-    // Read all remaining commands from target queue
+    // Read all deferred commands, then all remaining commands from target queue
+    int actualDeferred = CmtReadTSQData(mgr->deferredCommandQueue, commands, deferredCount, 0, 0);
     int actualRemaining = 0;
     if (remainingCount > 0) {
-        actualRemaining = CmtReadTSQData(targetQueue, remainingCommands, remainingCount, 0, 0);
+        actualRemaining = CmtReadTSQData(targetQueue, commands + actualDeferred, remainingCount, 0, 0);
     }
+    int total = MAX(actualDeferred, 0) + MAX(actualRemaining, 0);
     
     // Write back: deferred commands first, then remaining commands
-    if (actualDeferred > 0) {
-        CmtWriteTSQData(targetQueue, deferredCommands, actualDeferred, TSQ_INFINITE_TIMEOUT, NULL);
+    int written = (total > 0) ? CmtWriteTSQData(targetQueue, commands, total, 0, NULL) : 0;
+    written = MAX(written, 0);
+    
+    Stats_AdjustDepth(mgr, mgr->deferredCommandQueue, -MAX(actualDeferred, 0));
+    Stats_AdjustDepth(mgr, targetQueue, written - MAX(actualRemaining, 0));
+    
+    // Mirror the new order: dropped commands leave, deferred ones move to the front
+    for (int i = written; i < total; i++) {
+        Pending_Remove(mgr, commands[i]);
     }
+    for (int i = MIN(MAX(actualDeferred, 0), written) - 1; i >= 0; i--) {
+        Pending_Remove(mgr, commands[i]);
+        Pending_Add(mgr, targetQueue, commands[i], true);
+    }
+    
+    CmtReleaseLock(mgr->queueManipulationLock);
+    UpdateOverloadState(mgr, targetQueue);
     
-    if (actualRemaining > 0) {
-        CmtWriteTSQData(targetQueue, remainingCommands, actualRemaining, TSQ_INFINITE_TIMEOUT, NULL);
+    // Anything that no longer fits is dropped, same as a full deferred queue
+    for (int i = written; i < total; i++) {
+        LogWarningEx(mgr->logDevice, "Queue full while rebuilding - dropping command %u", commands[i]->id);
+        InterlockedIncrement(&mgr->deferredDrops.value);
+        Command_CompleteBlocking(commands[i], ERR_QUEUE_FULL);
+        Command_Release(mgr, commands[i]);
     }
     
     LogDebugEx(mgr->logDevice, "Queue rebuilt: %d deferred + %d remaining commands", 
              actualDeferred, actualRemaining);
     
     // Clean up
-    free(deferredCommands);
-    free(remainingCommands);
+    free(commands);
 }
 
 /******************************************************************************
@@ -1513,12 +2154,36 @@ static int ExecuteDeviceCommand(DeviceQueueManager *mgr, QueuedCommand *cmd, voi
         return ERR_OPERATION_FAILED;
     }
     
-    return mgr->adapter->executeCommand(mgr->deviceContext, 
-                                      cmd->commandType, 
-                                      cmd->params, 
-                                      result);
+    // Driver log lines belong to the experiment that submitted the command
+    int previousExperiment = LogGetThreadExperiment();
+    if (cmd->experimentId != previousExperiment) {
+        LogSetThreadExperiment(cmd->experimentId);
+    }
+    
+    int error = mgr->adapter->executeCommand(mgr->deviceContext, 
+                                           cmd->commandType, 
+                                           cmd->params, 
+                                           result);
+    
+    if (cmd->experimentId != previousExperiment) {
+        LogSetThreadExperiment(previousExperiment);
+    }
+    return error;
 }
 
+/******************************************************************************
+ * Connection Recovery
+ ******************************************************************************/
+
+int DeviceQueue_SetOfflineDeadline(DeviceQueueManager *mgr, int deadlineMs) {
+    if (!mgr) return ERR_INVALID_PARAMETER;
+    
+    InterlockedExchange(&mgr->offlineDeadlineMs, deadlineMs);
+    return SUCCESS;
+}
+
+// Only called by the owner of the reconnection handshake while the processing
+// thread is holding off, so the probe has the device to itself
 static int AttemptReconnection(DeviceQueueManager *mgr) {
     LogMessageEx(mgr->logDevice, "Attempting to reconnect to %s...", mgr->adapter->deviceName);
     
@@ -1528,8 +2193,14 @@ static int AttemptReconnection(DeviceQueueManager *mgr) {
     int result = ConnectDevice(mgr);
     
     if (result == SUCCESS) {
-        mgr->isConnected = 1;
+        int outageMs = (int)((Timer() - mgr->connectionLostTime) * 1000.0);
+        InterlockedIncrement(&mgr->reconnectCount.value);
+        InterlockedExchange(&mgr->lastReconnectDurationMs.value, outageMs);
+        Stats_UpdateMax(&mgr->maxReconnectDurationMs.value, outageMs);
+        
         mgr->reconnectAttempts = 0;
+        InterlockedExchange(&mgr->isConnected, 1);
+        SetEvent(mgr->connectedEvent);
         LogMessageEx(mgr->logDevice, "Successfully reconnected to %s", mgr->adapter->deviceName);
         return SUCCESS;
     }
@@ -1537,15 +2208,199 @@ static int AttemptReconnection(DeviceQueueManager *mgr) {
     // Calculate next retry delay with exponential backoff
     double delay = DEVICE_QUEUE_RECONNECT_DELAY_MS * pow(2, MIN(mgr->reconnectAttempts - 1, 5));
     delay = MIN(delay, DEVICE_QUEUE_MAX_RECONNECT_DELAY);
-    mgr->lastReconnectTime = Timer() + (delay / 1000.0);
+    mgr->nextProbeTime = Timer() + (delay / 1000.0);
     
     LogWarningEx(mgr->logDevice, "Reconnection failed, next attempt in %.1f seconds", delay / 1000.0);
     return ERR_COMM_FAILED;
 }
 
+// Keep a reconnection worker scheduled on the manager's reconnection pool. If
+// the worker has not started (the previous one is still exiting) or there is
+// no pool, the processing thread probes inline, so recovery never waits.
+static void ServiceReconnection(DeviceQueueManager *mgr) {
+    if (mgr->reconnectPool &&
+        InterlockedCompareExchange(&mgr->reconnectState, RECONNECT_POSTED, RECONNECT_IDLE) == RECONNECT_IDLE) {
+        // The previous worker has gone idle and is on its way out
+        if (mgr->reconnectThreadId != 0) {
+            CmtWaitForThreadPoolFunctionCompletion(mgr->reconnectPool, mgr->reconnectThreadId, 0);
+            CmtReleaseThreadPoolFunctionID(mgr->reconnectPool, mgr->reconnectThreadId);
+            mgr->reconnectThreadId = 0;
+        }
+        
+        mgr->reconnectPostTime = Timer();
+        int error = CmtScheduleThreadPoolFunction(mgr->reconnectPool, ReconnectThreadFunction,
+                                                mgr, &mgr->reconnectThreadId);
+        if (error != 0) {
+            mgr->reconnectThreadId = 0;
+            InterlockedExchange(&mgr->reconnectState, RECONNECT_IDLE);
+            LogWarningEx(mgr->logDevice, "Failed to start reconnection worker for %s", mgr->adapter->deviceName);
+        }
+    }
+    
+    if (Timer() < mgr->nextProbeTime) return;
+    
+    if (mgr->reconnectState == RECONNECT_IDLE) {
+        AttemptReconnection(mgr);
+    } else if ((Timer() - mgr->reconnectPostTime) > (DEVICE_QUEUE_OFFLINE_POLL_MS / 1000.0) &&
+               InterlockedCompareExchange(&mgr->reconnectState, RECONNECT_INLINE, RECONNECT_POSTED) == RECONNECT_POSTED) {
+        AttemptReconnection(mgr);
+        InterlockedExchange(&mgr->reconnectState, RECONNECT_POSTED);
+    }
+}
+
+static int CVICALLBACK ReconnectThreadFunction(void *functionData) {
+    DeviceQueueManager *mgr = (DeviceQueueManager*)functionData;
+    
+    // Wait out an inline probe before taking over the connection
+    while (InterlockedCompareExchange(&mgr->reconnectState, RECONNECT_RUNNING, RECONNECT_POSTED) != RECONNECT_POSTED) {
+        Delay(0.01);
+    }
+    
+    while (!mgr->isConnected && !mgr->shutdownRequested) {
+        double waitMs = (mgr->nextProbeTime - Timer()) * 1000.0;
+        if (waitMs > 0) {
+            Delay(MIN(waitMs, DEVICE_QUEUE_OFFLINE_POLL_MS) / 1000.0);
+            continue;
+        }
+        
+        AttemptReconnection(mgr);
+    }
+    
+    InterlockedExchange(&mgr->reconnectState, RECONNECT_IDLE);
+    return 0;
+}
+
+// Fail every queued command whose deadline has passed or will pass before the
+// next reconnection attempt. With no offline deadline, blocking commands are
+// still failed at their own timeout.
+static void ExpireOfflineCommands(DeviceQueueManager *mgr) {
+    int totalExpired = 0;
+    double currentTime = Timer();
+    
+    CmtGetLock(mgr->queueManipulationLock);
+    
+    totalExpired += ExpireOfflineInQueue(mgr->highPriorityQueue, currentTime, mgr);
+    totalExpired += ExpireOfflineInQueue(mgr->normalPriorityQueue, currentTime, mgr);
+    totalExpired += ExpireOfflineInQueue(mgr->lowPriorityQueue, currentTime, mgr);
+    totalExpired += ExpireOfflineInQueue(mgr->deferredCommandQueue, currentTime, mgr);
+    
+    CmtReleaseLock(mgr->queueManipulationLock);
+    
+    if (totalExpired > 0) {
+        SignalQueuesChanged(mgr);
+        InterlockedExchangeAdd(&mgr->offlineFailures.value, totalExpired);
+        LogWarningEx(mgr->logDevice, "%s offline - failed %d queued commands that cannot wait for reconnection",
+                   mgr->adapter->deviceName, totalExpired);
+    }
+    
+    // Committed transactions that have not started fail as a whole, one at a
+    // time: claim one whose deadline falls before the next probe, take its
+    // commands out of the queues and call its callback once
+    double horizon = MAX(currentTime, mgr->nextProbeTime);
+    while (1) {
+        DeviceTransaction *expired = NULL;
+        
+        CmtGetLock(mgr->transactionLock);
+        int count = ListNumItems(mgr->uncommittedTransactions);
+        for (int i = 1; i <= count && !expired; i++) {
+            DeviceTransaction **txnPtr = ListGetPtrToItem(mgr->uncommittedTransactions, i);
+            DeviceTransaction *txn = txnPtr ? *txnPtr : NULL;
+            if (txn && txn->queued && !txn->claimed && TransactionOfflineDeadline(mgr, txn) < horizon) {
+                txn->claimed = true;
+                expired = txn;
+            }
+        }
+        CmtReleaseLock(mgr->transactionLock);
+        
+        if (!expired) break;
+        
+        DeviceTransactionHandle txnId = expired->id;
+        int removed = RemoveTransactionCommands(mgr, txnId);
+        InterlockedExchangeAdd(&mgr->offlineFailures.value, removed);
+        LogWarningEx(mgr->logDevice, "%s offline - failed transaction %u (%d queued commands) that cannot wait for reconnection",
+                   mgr->adapter->deviceName, txnId, removed);
+        FailTransaction(mgr, expired, ERR_NOT_CONNECTED);
+    }
+}
+
+static int ExpireOfflineInQueue(CmtTSQHandle queue, double currentTime, DeviceQueueManager *mgr) {
+    int queueSize = 0;
+    CmtGetTSQAttribute(queue, ATTR_TSQ_ITEMS_IN_QUEUE, &queueSize);
+    if (queueSize == 0) return 0;
+    
+    QueuedCommand **commands = calloc(queueSize, sizeof(QueuedCommand*));
+    if (!commands) return 0;
+    
+    int itemsRead = CmtReadTSQData(queue, commands, queueSize, 0, 0);
+    int expired = 0;
+    
+    // A command queued during the outage gets the full offline deadline
+    int offlineDeadlineMs = mgr->offlineDeadlineMs;
+    double horizon = MAX(currentTime, mgr->nextProbeTime);
+    
+    for (int i = 0; i < itemsRead; i++) {
+        QueuedCommand *cmd = commands[i];
+        if (!cmd || cmd->transactionId != 0) continue;
+        
+        double deadline = cmd->deadline;
+        if (offlineDeadlineMs >= 0) {
+            double offlineDeadline = MAX(cmd->timestamp, mgr->connectionLostTime) + offlineDeadlineMs / 1000.0;
+            deadline = (deadline > 0) ? MIN(deadline, offlineDeadline) : offlineDeadline;
+        }
+        
+        if (deadline > 0 && deadline < horizon) {
+            Pending_Remove(mgr, cmd);
+            Command_CompleteBlocking(cmd, ERR_NOT_CONNECTED);
+            Command_Release(mgr, cmd);
+            commands[i] = NULL;
+            expired++;
+        }
+    }
+    
+    // Write back the commands that can still wait
+    if (expired > 0) {
+        int writeIdx = 0;
+        for (int i = 0; i < itemsRead; i++) {
+            if (commands[i] != NULL) {
+                commands[writeIdx++] = commands[i];
+            }
+        }
+        
+        if (writeIdx > 0) {
+            CmtWriteTSQData(queue, commands, writeIdx, TSQ_INFINITE_TIMEOUT, NULL);
+        }
+        Stats_AdjustDepth(mgr, queue, -expired);
+    } else if (itemsRead > 0) {
+        CmtWriteTSQData(queue, commands, itemsRead, TSQ_INFINITE_TIMEOUT, NULL);
+    }
+    
+    free(commands);
+    return expired;
+}
+
 /******************************************************************************
  * Internal Helper Functions
  ******************************************************************************/
+static void Stats_AdjustDepth(DeviceQueueManager *mgr, CmtTSQHandle queue, int delta) {
+    int index = QueueToIndex(mgr, queue);
+    if (index < 0 || delta == 0) return;
+    
+    // InterlockedExchangeAdd returns the value before the add
+    int depth = InterlockedExchangeAdd(&mgr->queueDepth[index].value, delta) + delta;
+    if (delta > 0) {
+        Stats_UpdateMax(&mgr->queueHighWater[index].value, depth);
+    }
+}
+
+static void Stats_UpdateMax(volatile int *target, int value) {
+    int current = *target;
+    while (value > current) {
+        int previous = InterlockedCompareExchange(target, value, current);
+        if (previous == current) break;
+        current = previous;
+    }
+}
+
 static QueuedCommand* Command_Create(DeviceQueueManager *mgr, int commandType, void *params) {
     CmtGetLock(mgr->commandLock);
     DeviceCommandID cmdId = mgr->nextCommandId++;
@@ -1559,6 +2414,10 @@ static QueuedCommand* Command_Create(DeviceQueueManager *mgr, int commandType, v
     cmd->timestamp = Timer();
     cmd->state = CMD_STATE_QUEUED;
     cmd->refCount = 1;  // Initial reference
+    cmd->submitThreadId = CmtGetCurrentThreadID();
+    snprintf(cmd->submitter, sizeof(cmd->submitter), "%s", DeviceQueue_GetThreadName());
+    cmd->experimentId = LogGetThreadExperiment();
+    cmd->pendingIndex = -1;
     
     // Create reference lock
     if (CmtNewLock(NULL, 0, &cmd->refLock) < 0) {
@@ -1607,6 +2466,148 @@ static void Command_Release(DeviceQueueManager *mgr, QueuedCommand *cmd) {
     }
 }
 
+static void Command_CompleteBlocking(QueuedCommand *cmd, int errorCode) {
+    // Wake a blocking caller whose command will never reach the device.
+    // The caller owns the context and may return as soon as completed is set.
+    BlockingContext *ctx = (BlockingContext*)cmd->blockingContext;
+    if (ctx && cmd->transactionId == 0) {
+        ctx->errorCode = errorCode;
+        ctx->completed = 1;
+    }
+}
+
+static void CompleteTransaction(DeviceQueueManager *mgr, DeviceTransaction *txn,
+                              TransactionCommandResult *results, int resultCount) {
+    DeviceTransactionHandle txnId = txn->id;
+    
+    if (txn->callback) {
+        int successCount = 0, failureCount = 0;
+        for (int i = 0; i < resultCount; i++) {
+            if (results[i].errorCode == SUCCESS) {
+                successCount++;
+            } else {
+                failureCount++;
+            }
+        }
+        
+        txn->callback(txnId, successCount, failureCount, results, resultCount, txn->userData);
+    }
+    
+    // Clean up results
+    for (int i = 0; i < resultCount; i++) {
+        if (results[i].result) {
+            mgr->adapter->freeCommandResult(results[i].commandType, results[i].result);
+        }
+    }
+    free(results);
+    
+    // Remove transaction from uncommitted list
+    CmtGetLock(mgr->transactionLock);
+    int count = ListNumItems(mgr->uncommittedTransactions);
+    for (int i = 1; i <= count; i++) {
+        DeviceTransaction **txnPtr = ListGetPtrToItem(mgr->uncommittedTransactions, i);
+        if (txnPtr && *txnPtr == txn) {
+            ListRemoveItem(mgr->uncommittedTransactions, 0, i);
+            free(txn);
+            break;
+        }
+    }
+    CmtReleaseLock(mgr->transactionLock);
+    
+    LogMessageEx(mgr->logDevice, "Completed transaction %u", txnId);
+}
+
+// Complete a claimed transaction that never started: every command reports
+// errorCode and the callback fires once
+static void FailTransaction(DeviceQueueManager *mgr, DeviceTransaction *txn, int errorCode) {
+    int resultCount = txn->commandCount;
+    TransactionCommandResult *results = calloc(resultCount, sizeof(TransactionCommandResult));
+    if (!results) {
+        LogErrorEx(mgr->logDevice, "Failed to allocate results for transaction %u", txn->id);
+        resultCount = 0;
+    }
+    
+    // The queues released the commands themselves, only their count is left
+    for (int i = 0; i < resultCount; i++) {
+        results[i].commandType = 0;
+        results[i].errorCode = errorCode;
+        results[i].result = NULL;
+    }
+    
+    CompleteTransaction(mgr, txn, results, resultCount);
+}
+
+// Take every queued command of a transaction out of the queues
+static int RemoveTransactionCommands(DeviceQueueManager *mgr, DeviceTransactionHandle txnId) {
+    int removed = 0;
+    
+    CmtGetLock(mgr->queueManipulationLock);
+    removed += CancelCommandsWithTransactionId(mgr->highPriorityQueue, txnId, mgr);
+    removed += CancelCommandsWithTransactionId(mgr->normalPriorityQueue, txnId, mgr);
+    removed += CancelCommandsWithTransactionId(mgr->lowPriorityQueue, txnId, mgr);
+    removed += CancelCommandsWithTransactionId(mgr->deferredCommandQueue, txnId, mgr);
+    CmtReleaseLock(mgr->queueManipulationLock);
+    
+    if (removed > 0) {
+        SignalQueuesChanged(mgr);
+    }
+    return removed;
+}
+
+// Complete committed transactions that never started and lost every queued
+// command to CancelCommand, CancelByType, CancelByAge or CancelAll, which
+// would otherwise never call back. Partly cancelled transactions still run
+// and report their missing commands as cancelled.
+static void FailEmptiedTransactions(DeviceQueueManager *mgr) {
+    while (1) {
+        DeviceTransaction *emptied = NULL;
+        
+        CmtGetLock(mgr->queueManipulationLock);
+        CmtGetLock(mgr->transactionLock);
+        int count = ListNumItems(mgr->uncommittedTransactions);
+        for (int i = 1; i <= count && !emptied; i++) {
+            DeviceTransaction **txnPtr = ListGetPtrToItem(mgr->uncommittedTransactions, i);
+            DeviceTransaction *txn = txnPtr ? *txnPtr : NULL;
+            if (!txn || !txn->queued || txn->claimed || txn->id == mgr->startingTransactionId) {
+                continue;
+            }
+            
+            bool queued = false;
+            for (int index = 0; index < QUEUE_INDEX_COUNT && !queued; index++) {
+                for (QueuedCommand *cmd = mgr->pendingHead[index]; cmd && !queued; cmd = cmd->pendingNext) {
+                    queued = (cmd->transactionId == txn->id);
+                }
+            }
+            if (!queued) {
+                txn->claimed = true;
+                emptied = txn;
+            }
+        }
+        CmtReleaseLock(mgr->transactionLock);
+        CmtReleaseLock(mgr->queueManipulationLock);
+        
+        if (!emptied) break;
+        
+        LogMessageEx(mgr->logDevice, "Transaction %u lost all its commands to cancellation", emptied->id);
+        FailTransaction(mgr, emptied, ERR_CANCELLED);
+    }
+}
+
+// Latest time a committed transaction may wait for an offline device: its
+// own timeout, counted from when it started or else when it was queued, and
+// the offline deadline if one is set. Caller holds transactionLock or is the
+// processing thread running the transaction.
+static double TransactionOfflineDeadline(DeviceQueueManager *mgr, const DeviceTransaction *txn) {
+    double since = (txn->startTime > 0) ? txn->startTime : txn->queueTime;
+    double deadline = since + txn->timeoutMs / 1000.0;
+    
+    int offlineDeadlineMs = mgr->offlineDeadlineMs;
+    if (offlineDeadlineMs >= 0) {
+        deadline = MIN(deadline, MAX(since, mgr->connectionLostTime) + offlineDeadlineMs / 1000.0);
+    }
+    return deadline;
+}
+
 static DeviceTransaction* FindTransaction(DeviceQueueManager *mgr, DeviceTransactionHandle id) {
     // Must be called with transaction lock held
     int count = ListNumItems(mgr->uncommittedTransactions);
@@ -17,27 +17,34 @@
  * Configuration Constants
  ******************************************************************************/
 
-// Queue depths
+// Queue depths (default capacities, adjustable with DeviceQueue_SetAdmissionPolicy)
 #define DEVICE_QUEUE_HIGH_PRIORITY_SIZE    20
 #define DEVICE_QUEUE_NORMAL_PRIORITY_SIZE  20
 #define DEVICE_QUEUE_LOW_PRIORITY_SIZE     20
 #define DEVICE_QUEUE_DEFERRED_SIZE         20
+#define DEVICE_QUEUE_MAX_CAPACITY          128  // Upper bound for any priority queue capacity
 
 // Default timeouts
 #define DEVICE_QUEUE_COMMAND_TIMEOUT_MS    30000
 #define DEVICE_QUEUE_RECONNECT_DELAY_MS    1000
 #define DEVICE_QUEUE_MAX_RECONNECT_DELAY   30000
+#define DEVICE_QUEUE_OFFLINE_DEADLINE_MS   10000 // Longest a queued command waits for a lost device
+#define DEVICE_QUEUE_OFFLINE_POLL_MS       100  // Deadline check interval while the device is offline
 
-// Command enqueue retry configuration
-#define DEVICE_QUEUE_MAX_RETRIES           3
-#define DEVICE_QUEUE_BASE_RETRY_DELAY_MS   1
-#define DEVICE_QUEUE_MAX_RETRY_DELAY_MS    10
-#define DEVICE_QUEUE_MAX_ATTEMPT_TIMEOUT_MS 1000
+// Admission control
+#define DEVICE_QUEUE_ADMIT_DEADLINE_MS     1000 // Default wait for space under DEVICE_ADMIT_BLOCK
+#define DEVICE_QUEUE_ADMIT_WAIT_SLICE_MS   50   // Longest single wait before re-checking for space
+#define DEVICE_QUEUE_OVERLOAD_HIGH_PCT     75   // Depth (% of capacity) that raises the overload signal
+#define DEVICE_QUEUE_OVERLOAD_LOW_PCT      25   // Depth (% of capacity) that clears it
 
 // Transaction limits
 #define DEVICE_MAX_TRANSACTION_COMMANDS    20
 #define DEVICE_DEFAULT_TRANSACTION_TIMEOUT_MS  60000
 
+// Introspection
+#define DEVICE_QUEUE_SNAPSHOT_MAX_ENTRIES  64
+#define DEVICE_QUEUE_THREAD_NAME_LENGTH    32
+
 /******************************************************************************
  * Type Definitions
  ******************************************************************************/
@@ -55,6 +62,14 @@ typedef enum {
     DEVICE_PRIORITY_LOW = 2      // Status queries
 } DevicePriority;
 
+// Admission policy applied when a priority queue is at capacity
+typedef enum {
+    DEVICE_ADMIT_BLOCK = 0,      // Wait for space until the admission deadline (default)
+    DEVICE_ADMIT_REJECT,         // Fail immediately with ERR_QUEUE_FULL, whatever the deadline
+    DEVICE_ADMIT_DROP_OLDEST     // Evict the oldest non-transaction command in the queue, or fail
+                                 // with ERR_QUEUE_FULL if there is none; transactions fail as under REJECT
+} DeviceAdmissionPolicy;
+
 // Transaction behavior flags
 typedef enum {
     DEVICE_TXN_CONTINUE_ON_ERROR = 0x00,  // Continue executing commands even if one fails
@@ -79,6 +94,13 @@ typedef void (*DeviceTransactionCallback)(DeviceTransactionHandle txn,
                                         int resultCount,
                                         void *userData);
 
+// Overload notification - raised (overloaded = 1) when a priority queue fills
+// past DEVICE_QUEUE_OVERLOAD_HIGH_PCT of its capacity, cleared (overloaded = 0)
+// once it drains below DEVICE_QUEUE_OVERLOAD_LOW_PCT. Called from producer or
+// processing threads, so it must be short and must not queue device commands.
+typedef void (*DeviceQueueOverloadCallback)(DeviceQueueManager *mgr, DevicePriority priority,
+                                          int overloaded, void *userData);
+
 /******************************************************************************
  * Device Adapter Interface
  ******************************************************************************/
@@ -125,8 +147,56 @@ typedef struct {
     int isProcessing;
     int activeTransactionId;     // Non-zero if transaction is executing
     int isInTransactionMode;     // 1 if processing thread is in transaction mode
+    
+    // Peak queue depths since the manager was created
+    int highPriorityHighWater;
+    int normalPriorityHighWater;
+    int lowPriorityHighWater;
+    int deferredHighWater;
+    
+    int enqueueRetries;          // Enqueues that had to wait for space
+    int enqueueFailures;         // Commands rejected with ERR_QUEUE_FULL or ERR_TIMEOUT
+    int deferredDrops;           // Commands dropped because a deferred rebuild overflowed
+    int reconnectCount;          // Successful reconnections after a lost connection
+    int lastReconnectDurationMs; // Outage length of the most recent reconnection
+    int maxReconnectDurationMs;  // Longest outage seen
+    int evictedCommands;         // Commands evicted by DEVICE_ADMIT_DROP_OLDEST
+    int offlineFailures;         // Commands failed with ERR_NOT_CONNECTED during an outage
+    int nextProbeInMs;           // Time until the next reconnection attempt, 0 if connected
 } DeviceQueueStats;
 
+/******************************************************************************
+ * Queue Snapshot
+ ******************************************************************************/
+
+typedef enum {
+    DEVICE_CMD_EXECUTING = 0,
+    DEVICE_CMD_QUEUED,
+    DEVICE_CMD_DEFERRED          // Held back while another transaction runs
+} DeviceCommandSnapshotState;
+
+typedef struct {
+    DeviceCommandID id;
+    int commandType;
+    char typeName[48];
+    DevicePriority priority;
+    DeviceCommandSnapshotState state;
+    int position;                // Place in its queue, 0 = next to run
+    double ageMs;                // Time since the command was submitted
+    DeviceTransactionHandle transactionId;
+    int submitThreadId;
+    char submitter[DEVICE_QUEUE_THREAD_NAME_LENGTH];  // Submitting thread's name, "" if unset
+} DeviceQueueSnapshotEntry;
+
+typedef struct {
+    char deviceName[64];
+    int isConnected;
+    DeviceTransactionHandle activeTransactionId;
+    int totalCommands;           // Executing plus pending, may exceed entryCount
+    int entryCount;
+    DeviceQueueSnapshotEntry entries[DEVICE_QUEUE_SNAPSHOT_MAX_ENTRIES];
+} DeviceQueueSnapshot;
+
 /******************************************************************************
  * Queue Manager Functions
  ******************************************************************************/
@@ -146,9 +216,64 @@ void* DeviceQueue_GetDeviceContext(DeviceQueueManager *mgr);
 // Check if queue manager is running
 bool DeviceQueue_IsRunning(DeviceQueueManager *mgr);
 
-// Get queue statistics
+// Get queue statistics - lock-free, cheap enough to poll from a UI timer
 void DeviceQueue_GetStats(DeviceQueueManager *mgr, DeviceQueueStats *stats);
 
+/******************************************************************************
+ * Introspection
+ ******************************************************************************/
+
+// Capture the executing command followed by every pending command in the
+// order it will run (high, normal, low, then deferred). Reads a mirror of the
+// queues under the queue lock - the queues themselves are not touched.
+int DeviceQueue_Snapshot(DeviceQueueManager *mgr, DeviceQueueSnapshot *snapshot);
+
+// Name the commands the calling thread submits, so snapshots can show who
+// submitted them. Pool functions set it on entry and clear it before they
+// return, since their thread goes on to run other functions.
+void DeviceQueue_SetThreadName(const char *name);
+
+// Clear the calling thread's name
+void DeviceQueue_ClearThreadName(void);
+
+// The calling thread's name, "" if unset
+const char* DeviceQueue_GetThreadName(void);
+
+/******************************************************************************
+ * Admission Control
+ ******************************************************************************/
+
+// Set capacity, admission policy and blocking deadline for one priority queue.
+// capacity is clamped to 1..DEVICE_QUEUE_MAX_CAPACITY; a negative deadlineMs
+// blocks until space is available or the queue shuts down. Blocking commands
+// never wait longer than their own timeout, and a zero timeout never waits.
+// The deadline applies to DEVICE_ADMIT_BLOCK only; ERR_TIMEOUT means it ran
+// out, ERR_QUEUE_FULL that the policy refused the command without waiting.
+int DeviceQueue_SetAdmissionPolicy(DeviceQueueManager *mgr, DevicePriority priority,
+                                 int capacity, DeviceAdmissionPolicy policy, int deadlineMs);
+
+// Subscribe to overload notifications (NULL to unsubscribe)
+void DeviceQueue_SetOverloadCallback(DeviceQueueManager *mgr,
+                                   DeviceQueueOverloadCallback callback, void *userData);
+
+// Check whether a priority queue is currently signalling overload
+bool DeviceQueue_IsOverloaded(DeviceQueueManager *mgr, DevicePriority priority);
+
+/******************************************************************************
+ * Connection Recovery
+ ******************************************************************************/
+
+// Lost connections are re-established by a background worker with exponential
+// backoff; the processing thread resumes as soon as a probe succeeds. While the
+// device is offline, queued commands fail with ERR_NOT_CONNECTED once they have
+// waited deadlineMs, or earlier if their deadline falls before the next probe.
+// Blocking commands are also bounded by their own timeout. A committed
+// transaction fails as a whole, its callback reporting ERR_NOT_CONNECTED for
+// every command not executed, at the same deadline or at its own timeout,
+// counted from its start or else from when it was queued. A negative
+// deadlineMs keeps other commands queued until the device returns.
+int DeviceQueue_SetOfflineDeadline(DeviceQueueManager *mgr, int deadlineMs);
+
 /******************************************************************************
  * Command Queueing Functions
  ******************************************************************************/
@@ -195,11 +320,15 @@ int DeviceQueue_SetTransactionTimeout(DeviceQueueManager *mgr,
 int DeviceQueue_AddToTransaction(DeviceQueueManager *mgr, DeviceTransactionHandle txn,
                                int commandType, void *params);
 
-// Commit transaction (async) - guarantees sequential execution
+// Commit transaction (async) - guarantees sequential execution. Follows the
+// priority queue's admission policy; if the commands cannot be admitted the
+// transaction stays uncommitted and may be committed again or cancelled.
 int DeviceQueue_CommitTransaction(DeviceQueueManager *mgr, DeviceTransactionHandle txn,
                                 DeviceTransactionCallback callback, void *userData);
 
-// Cancel transaction (only works if not yet executing)
+// Cancel transaction. A committed one still calls back: with ERR_CANCELLED for
+// every command if it had not started, otherwise once its running command ends.
+// Transactions emptied by the other cancel functions also call back cancelled.
 int DeviceQueue_CancelTransaction(DeviceQueueManager *mgr, DeviceTransactionHandle txn);
 
 // Check if currently in a transaction
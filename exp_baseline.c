@@ -11,6 +11,10 @@
 #include "logging.h"
 #include "status.h"
 #include "battery_utils.h"
+#include "telemetry.h"
+#include "history.h"
+#include "graph_trace.h"
+#include "ui_update.h"
 #include <ansi_c.h>
 #include <analysis.h>
 #include <utility.h>
@@ -41,6 +45,7 @@ static const int controls[4] = {
 static int BaselineExperimentThread(void *functionData);
 
 // Setup and verification functions
+static int ValidateExperimentParams(const BaselineExperimentParams *params);
 static int VerifyAllDevicesAndInitialize(BaselineExperimentContext *ctx);
 static int CreateExperimentFileSystem(BaselineExperimentContext *ctx);
 static int SaveExperimentSettings(BaselineExperimentContext *ctx);
@@ -267,9 +272,9 @@ int CVICALLBACK StartBaselineExperimentCallback(int panel, int control, int even
     CmtGetLock(g_busyLock);
     if (g_systemBusy) {
         CmtReleaseLock(g_busyLock);
-        MessagePopup("System Busy", 
-                     "Another operation is in progress.\n"
-                     "Please wait for it to complete before starting the baseline experiment.");
+        ExperimentNotify("System Busy", 
+                         "Another operation is in progress.\n"
+                         "Please wait for it to complete before starting the baseline experiment.");
         return 0;
     }
     g_systemBusy = 1;
@@ -300,23 +305,10 @@ int CVICALLBACK StartBaselineExperimentCallback(int panel, int control, int even
     GetCtrlVal(g_mainPanelHandle, PANEL_NUM_SET_DISCHARGE_I, &g_experimentContext.params.dischargeCurrent);
     
     // Preliminary validation
-    if (ENABLE_DTB && (g_experimentContext.params.targetTemperature < 5.0 || g_experimentContext.params.targetTemperature > 80.0)) {
+    if (ValidateExperimentParams(&g_experimentContext.params) != SUCCESS) {
         CmtGetLock(g_busyLock);
         g_systemBusy = 0;
         CmtReleaseLock(g_busyLock);
-        
-        MessagePopup("Invalid Temperature", 
-                     "Target temperature must be between 5C and 80C for safety.");
-        return 0;
-    }
-    
-    if (g_experimentContext.params.eisInterval <= 0 || g_experimentContext.params.eisInterval > 50) {
-        CmtGetLock(g_busyLock);
-        g_systemBusy = 0;
-        CmtReleaseLock(g_busyLock);
-        
-        MessagePopup("Invalid EIS Interval", 
-                     "EIS interval must be between 1% and 50% SOC.");
         return 0;
     }
     
@@ -350,13 +342,62 @@ int CVICALLBACK StartBaselineExperimentCallback(int panel, int control, int even
         g_systemBusy = 0;
         CmtReleaseLock(g_busyLock);
         
-        MessagePopup("Error", "Failed to start baseline experiment thread.");
+        ExperimentNotify("Error", "Failed to start baseline experiment thread.");
         return 0;
     }
     
     return 0;
 }
 
+int BaselineExperiment_RunHeadless(const BaselineExperimentParams *params) {
+    if (!params) {
+        return ERR_NULL_POINTER;
+    }
+    if (BaselineExperiment_IsRunning()) {
+        return ERR_INVALID_STATE;
+    }
+    
+    // Check if system is busy
+    CmtGetLock(g_busyLock);
+    if (g_systemBusy) {
+        CmtReleaseLock(g_busyLock);
+        LogError("Another operation is in progress, baseline experiment not started");
+        return ERR_INVALID_STATE;
+    }
+    g_systemBusy = 1;
+    CmtReleaseLock(g_busyLock);
+    
+    // Same context as a UI start, without panel, controls or graphs
+    memset(&g_experimentContext, 0, sizeof(g_experimentContext));
+    g_experimentContext.state = BASELINE_STATE_PREPARING;
+    g_experimentContext.params = *params;
+    
+    int result = ValidateExperimentParams(&g_experimentContext.params);
+    if (result == SUCCESS) {
+        result = VerifyAllDevicesAndInitialize(&g_experimentContext);
+    }
+    if (result != SUCCESS) {
+        CmtGetLock(g_busyLock);
+        g_systemBusy = 0;
+        CmtReleaseLock(g_busyLock);
+        
+        g_experimentContext.state = BASELINE_STATE_ERROR;
+        return result;
+    }
+    
+    // Run on the calling thread, the thread function releases the system
+    BaselineExperimentThread(&g_experimentContext);
+    
+    switch (g_experimentContext.state) {
+        case BASELINE_STATE_COMPLETED:
+            return SUCCESS;
+        case BASELINE_STATE_CANCELLED:
+            return ERR_CANCELLED;
+        default:
+            return ERR_OPERATION_FAILED;
+    }
+}
+
 int BaselineExperiment_IsRunning(void) {
     return !(g_experimentContext.state == BASELINE_STATE_IDLE ||
              g_experimentContext.state == BASELINE_STATE_COMPLETED ||
@@ -414,6 +455,11 @@ static int BaselineExperimentThread(void *functionData) {
     char message[LARGE_BUFFER_SIZE];
     int result = SUCCESS;
     
+    DeviceQueue_SetThreadName("Baseline Experiment");
+    
+    // Everything this thread and its device commands log goes to experiment.log
+    ctx->logExperimentId = LogNewExperimentId();
+    LogSetThreadExperiment(ctx->logExperimentId);
     LogMessage("=== Starting Baseline Battery Experiment ===");
     
     // Record experiment start time
@@ -460,7 +506,7 @@ static int BaselineExperimentThread(void *functionData) {
         ctx->params.logInterval,
         ENABLE_DTB ? " and establish temperature" : "");
     
-    int response = ConfirmPopup("Confirm Baseline Experiment", message);
+    int response = ExperimentConfirm("Confirm Baseline Experiment", message);
     if (!response || CheckCancellation(ctx)) {
         LogMessage("Baseline experiment cancelled by user");
         ctx->state = BASELINE_STATE_CANCELLED;
@@ -471,12 +517,15 @@ static int BaselineExperimentThread(void *functionData) {
     result = CreateExperimentFileSystem(ctx);
     if (result != SUCCESS || CheckCancellation(ctx)) {
         LogError("Failed to create experiment file system");
-        MessagePopup("Error", "Failed to create experiment directory.\nPlease check disk space and permissions.");
+        ExperimentNotify("Error", "Failed to create experiment directory.\nPlease check disk space and permissions.");
         ctx->state = BASELINE_STATE_ERROR;
         goto cleanup;
     }
     
-	SetExternalLogFile(g_experimentContext.baselineExperimentLog);
+	if (ctx->baselineExperimentLog) {
+	    LogSinkFilter filter = {0, LOG_LEVEL_DEBUG, ctx->logExperimentId};
+	    ctx->experimentLogSink = LogSinkAddFile(ctx->baselineExperimentLog, &filter);
+	}
 	
     // Save experiment settings for future reference
     SaveExperimentSettings(ctx);
@@ -600,7 +649,7 @@ cleanup:
     }
     
     SetCtrlVal(ctx->tabPanelHandle, ctx->statusControl, finalStatus);
-    SetCtrlVal(ctx->mainPanelHandle, PANEL_STR_PSB_STATUS, finalStatus);
+    UIUpdate_SetString(ctx->mainPanelHandle, PANEL_STR_PSB_STATUS, finalStatus);
     
     // Restore button text and UI
     SetCtrlAttribute(ctx->tabPanelHandle, ctx->buttonControl, ATTR_LABEL_TEXT, "Start");
@@ -614,6 +663,10 @@ cleanup:
     // Clear thread ID
     g_experimentThreadId = 0;
     
+    // The pool thread may run something else next
+    LogSetThreadExperiment(LOG_EXPERIMENT_ANY);
+    DeviceQueue_ClearThreadName();
+    
     return 0;
 }
 
@@ -621,38 +674,75 @@ cleanup:
  * Setup and Verification Functions
  ******************************************************************************/
 
+static int ValidateExperimentParams(const BaselineExperimentParams *params) {
+    if (ENABLE_DTB && (params->targetTemperature < 5.0 || params->targetTemperature > 80.0)) {
+        ExperimentNotify("Invalid Temperature", 
+                         "Target temperature must be between 5C and 80C for safety.");
+        return ERR_INVALID_PARAMETER;
+    }
+    
+    if (params->eisInterval <= 0 || params->eisInterval > 50) {
+        ExperimentNotify("Invalid EIS Interval", 
+                         "EIS interval must be between 1% and 50% SOC.");
+        return ERR_INVALID_PARAMETER;
+    }
+    
+    if (!BATTERY_VOLTAGE_IN_RANGE(params->chargeVoltage) ||
+        !BATTERY_VOLTAGE_IN_RANGE(params->dischargeVoltage) ||
+        params->chargeVoltage <= params->dischargeVoltage) {
+        char message[256];
+        snprintf(message, sizeof(message),
+                 "Charge voltage (%.3f V) and discharge voltage (%.3f V) must be between\n"
+                 "%.2f V and %.2f V, with the charge voltage above the discharge voltage.",
+                 params->chargeVoltage, params->dischargeVoltage,
+                 BATTERY_VOLTAGE_MIN, BATTERY_VOLTAGE_MAX);
+        ExperimentNotify("Invalid Voltages", message);
+        return ERR_INVALID_PARAMETER;
+    }
+    
+    if (params->logInterval == 0 || params->currentThreshold <= 0.0 ||
+        params->chargeCurrent <= 0.0 || params->dischargeCurrent <= 0.0) {
+        ExperimentNotify("Invalid Parameters", 
+                         "Charge and discharge settings, current threshold and log interval\n"
+                         "must all be set before running the baseline experiment.");
+        return ERR_INVALID_PARAMETER;
+    }
+    
+    return SUCCESS;
+}
+
 static int VerifyAllDevicesAndInitialize(BaselineExperimentContext *ctx) {
     // Check PSB connection (REQUIRED)
     PSBQueueManager *psbQueueMgr = PSB_GetGlobalQueueManager();
     if (!psbQueueMgr) {
-        MessagePopup("PSB Not Connected", 
-                     "The PSB power supply is not connected.\n"
-                     "Please ensure it is connected before running the baseline experiment.");
+        ExperimentNotify("PSB Not Connected", 
+                         "The PSB power supply is not connected.\n"
+                         "Please ensure it is connected before running the baseline experiment.");
         return ERR_NOT_CONNECTED;
     }
     
     ctx->psbHandle = PSB_QueueGetHandle(psbQueueMgr);
     if (!ctx->psbHandle || !ctx->psbHandle->isConnected) {
-        MessagePopup("PSB Not Connected", 
-                     "The PSB power supply is not connected.\n"
-                     "Please ensure it is connected before running the baseline experiment.");
+        ExperimentNotify("PSB Not Connected", 
+                         "The PSB power supply is not connected.\n"
+                         "Please ensure it is connected before running the baseline experiment.");
         return ERR_NOT_CONNECTED;
     }
     
     // Check BioLogic connection (REQUIRED)
     BioQueueManager *bioQueueMgr = BIO_GetGlobalQueueManager();
     if (!bioQueueMgr) {
-        MessagePopup("BioLogic Not Connected", 
-                     "The BioLogic potentiostat is not connected.\n"
-                     "Please ensure it is connected before running the baseline experiment.");
+        ExperimentNotify("BioLogic Not Connected", 
+                         "The BioLogic potentiostat is not connected.\n"
+                         "Please ensure it is connected before running the baseline experiment.");
         return ERR_NOT_CONNECTED;
     }
     
     ctx->biologicID = BIO_QueueGetDeviceID(bioQueueMgr);
     if (ctx->biologicID < 0) {
-        MessagePopup("BioLogic Not Connected", 
-                     "The BioLogic potentiostat is not connected.\n"
-                     "Please ensure it is connected before running the baseline experiment.");
+        ExperimentNotify("BioLogic Not Connected", 
+                         "The BioLogic potentiostat is not connected.\n"
+                         "Please ensure it is connected before running the baseline experiment.");
         return ERR_NOT_CONNECTED;
     }
     
@@ -660,9 +750,9 @@ static int VerifyAllDevicesAndInitialize(BaselineExperimentContext *ctx) {
     if (ENABLE_DTB) {
         DTBQueueManager *dtbQueueMgr = DTB_GetGlobalQueueManager();
         if (!dtbQueueMgr) {
-            MessagePopup("DTB Not Connected", 
-                         "The DTB temperature controller is REQUIRED for baseline experiments.\n"
-                         "Please ensure it is connected before running.");
+            ExperimentNotify("DTB Not Connected", 
+                             "The DTB temperature controller is REQUIRED for baseline experiments.\n"
+                             "Please ensure it is connected before running.");
             return ERR_NOT_CONNECTED;
         }
     } else {
@@ -672,25 +762,25 @@ static int VerifyAllDevicesAndInitialize(BaselineExperimentContext *ctx) {
     // Check Teensy connection (REQUIRED for relay control)
     TNYQueueManager *tnyQueueMgr = TNY_GetGlobalQueueManager();
     if (!tnyQueueMgr) {
-        MessagePopup("Teensy Not Connected", 
-                     "The Teensy relay controller is not connected.\n"
-                     "Please ensure it is connected before running the baseline experiment.");
+        ExperimentNotify("Teensy Not Connected", 
+                         "The Teensy relay controller is not connected.\n"
+                         "Please ensure it is connected before running the baseline experiment.");
         return ERR_NOT_CONNECTED;
     }
     
     // Verify PSB is in safe state
     PSB_Status status;
-    if (PSB_GetStatusQueued(&status, DEVICE_PRIORITY_NORMAL) == PSB_SUCCESS) {
+    if (Telemetry_GetPSBStatus(&status, TELEMETRY_MAX_AGE_FRESH, DEVICE_PRIORITY_NORMAL) == PSB_SUCCESS) {
         if (status.outputEnabled) {
-            MessagePopup("PSB Output Enabled", 
-                         "The PSB output must be disabled before starting the experiment.\n"
-                         "Please turn off the output and try again.");
+            ExperimentNotify("PSB Output Enabled", 
+                             "The PSB output must be disabled before starting the experiment.\n"
+                             "Please turn off the output and try again.");
             return ERR_INVALID_STATE;
         }
     } else {
-        MessagePopup("Communication Error", 
-                     "Failed to communicate with the PSB.\n"
-                     "Please check the connection and try again.");
+        ExperimentNotify("Communication Error", 
+                         "Failed to communicate with the PSB.\n"
+                         "Please check the connection and try again.");
         return ERR_COMM_FAILED;
     }
     
@@ -1373,6 +1463,9 @@ static int RunPhase3_EISCharge(BaselineExperimentContext *ctx) {
     ctx->lastCurrent = 0.0;
     ctx->lastTime = 0.0;
     
+    GraphTrace *currentTrace = GraphTrace_Create(ctx->mainPanelHandle, ctx->graph1Handle,
+                                                 VAL_SOLID_CIRCLE, VAL_RED);
+    
     int nextTargetIndex = 1;  // Skip 0% as we already measured it
     int lowCurrentReadings = 0;
     const int MIN_LOW_CURRENT_READINGS = 5;
@@ -1404,7 +1497,7 @@ static int RunPhase3_EISCharge(BaselineExperimentContext *ctx) {
         
         // Get current PSB status
         PSB_Status status;
-        result = PSB_GetStatusQueued(&status, DEVICE_PRIORITY_NORMAL);
+        result = Telemetry_GetPSBStatus(&status, BASELINE_STATUS_MAX_AGE_MS, DEVICE_PRIORITY_NORMAL);
         if (result != PSB_SUCCESS) {
             LogError("Failed to read PSB status: %s", PSB_GetErrorString(result));
             break;
@@ -1437,8 +1530,7 @@ static int RunPhase3_EISCharge(BaselineExperimentContext *ctx) {
         // Update graphs if needed
         if ((currentTime - ctx->lastGraphUpdate) >= 1.0) {
             double elapsedTime_min = elapsedTime / 60.0;  // Convert to minutes
-			PlotPoint(ctx->mainPanelHandle, ctx->graph1Handle, 
-                  elapsedTime_min, fabs(status.current), VAL_SOLID_CIRCLE, VAL_RED);
+            GraphTrace_AddPoint(currentTrace, elapsedTime_min, fabs(status.current));
             ctx->lastGraphUpdate = currentTime;
         }
         
@@ -1545,6 +1637,7 @@ static int RunPhase3_EISCharge(BaselineExperimentContext *ctx) {
     
     // Ensure output is disabled
     PSB_SetOutputEnableQueued(0, DEVICE_PRIORITY_NORMAL);
+    GraphTrace_Finish(currentTrace);
     
     // Close phase log file
     if (ctx->currentPhaseLogFile) {
@@ -1760,7 +1853,8 @@ static int WaitForTargetTemperature(BaselineExperimentContext *ctx) {
         if ((currentTime - lastCheckTime) >= BASELINE_TEMP_CHECK_INTERVAL) {
             DTB_Status dtbStatuses[MAX_DTB_DEVICES];
             int numDevices = 0;
-            int result = DTB_GetStatusAllQueued(dtbStatuses, &numDevices, DEVICE_PRIORITY_NORMAL);
+            int result = Telemetry_GetDTBStatusAll(dtbStatuses, &numDevices, BASELINE_TEMP_MAX_AGE_MS,
+                                                   DEVICE_PRIORITY_NORMAL);
             
             if (result == DTB_SUCCESS) {
                 int devicesInTolerance = 0;
@@ -1863,7 +1957,8 @@ static int StabilizeTemperature(BaselineExperimentContext *ctx) {
         if ((currentTime - lastCheckTime) >= BASELINE_TEMP_CHECK_INTERVAL) {
             DTB_Status dtbStatuses[MAX_DTB_DEVICES];
             int numDevices = 0;
-            int result = DTB_GetStatusAllQueued(dtbStatuses, &numDevices, DEVICE_PRIORITY_NORMAL);
+            int result = Telemetry_GetDTBStatusAll(dtbStatuses, &numDevices, BASELINE_TEMP_MAX_AGE_MS,
+                                                   DEVICE_PRIORITY_NORMAL);
             
             if (result == DTB_SUCCESS) {
                 int devicesInTolerance = 0;
@@ -2237,6 +2332,16 @@ static int RunOCVMeasurement(BaselineExperimentContext *ctx, BaselineEISMeasurem
         if (convData->numPoints > 0 && convData->numVariables >= 2 && convData->data[1] != NULL) {
             int lastPoint = convData->numPoints - 1;
             measurement->ocvVoltage = convData->data[1][lastPoint];
+            
+            // Record Ewe, placing the technique's relative times so the last point is now
+            if (convData->data[0] != NULL) {
+                double endTime = GetTimestamp();
+                for (int i = 0; i < convData->numPoints; i++) {
+                    History_Add(HISTORY_CHANNEL_BIO_EWE,
+                               endTime - (convData->data[0][lastPoint] - convData->data[0][i]),
+                               convData->data[1][i]);
+                }
+            }
             LogDebug("OCV measurement complete: %.3f V", measurement->ocvVoltage);
         } else {
             LogWarning("OCV data incomplete - using 0.0 V");
@@ -2430,7 +2535,8 @@ static int ReadAllTemperatures(BaselineExperimentContext *ctx, TemperatureDataPo
         DTB_Status dtbStatuses[MAX_DTB_DEVICES];
         int numDevices = 0;
         
-        if (DTB_GetStatusAllQueued(dtbStatuses, &numDevices, DEVICE_PRIORITY_NORMAL) == DTB_SUCCESS) {
+        if (Telemetry_GetDTBStatusAll(dtbStatuses, &numDevices, BASELINE_TEMP_MAX_AGE_MS,
+                                      DEVICE_PRIORITY_NORMAL) == DTB_SUCCESS) {
             double tempSum = 0.0;
             tempData->dtbDeviceCount = numDevices;
             
@@ -2518,6 +2624,10 @@ static int LogPhaseDataPoint(BaselineExperimentContext *ctx, const char *format,
  ******************************************************************************/
 
 static int ConfigureExperimentGraphs(BaselineExperimentContext *ctx) {
+    if (ctx->mainPanelHandle <= 0) {
+        return SUCCESS;
+    }
+    
     // Configure main graphs for experiment - TIME IN MINUTES
     double maxCurrent = MAX(ctx->params.chargeCurrent, ctx->params.dischargeCurrent);
     ConfigureGraph(ctx->mainPanelHandle, ctx->graph1Handle, 
@@ -2534,6 +2644,8 @@ static int ConfigureExperimentGraphs(BaselineExperimentContext *ctx) {
 }
 
 static void UpdateOCVGraph(BaselineExperimentContext *ctx, BaselineEISMeasurement *measurement) {
+    if (ctx->mainPanelHandle <= 0) return;
+    
     PlotPoint(ctx->mainPanelHandle, ctx->graph2Handle, 
                   measurement->actualSOC, measurement->ocvVoltage, 
                   VAL_SOLID_CIRCLE, VAL_BLUE);
@@ -2567,7 +2679,7 @@ static void UpdateOCVGraph(BaselineExperimentContext *ctx, BaselineEISMeasuremen
 }
 
 static void UpdateNyquistPlot(BaselineExperimentContext *ctx, BaselineEISMeasurement *measurement) {
-    if (measurement->numPoints == 0) return;
+    if (ctx->mainPanelHandle <= 0 || measurement->numPoints == 0) return;
     
     // Clear previous plot
     DeleteGraphPlot(ctx->mainPanelHandle, ctx->graphBiologicHandle, -1, VAL_DELAYED_DRAW);
@@ -2595,6 +2707,8 @@ static void UpdateNyquistPlot(BaselineExperimentContext *ctx, BaselineEISMeasure
 }
 
 static void ClearAllExperimentGraphs(BaselineExperimentContext *ctx) {
+    if (ctx->mainPanelHandle <= 0) return;
+    
     int graphs[] = {ctx->graph1Handle, ctx->graph2Handle, ctx->graphBiologicHandle};
     ClearAllGraphs(ctx->mainPanelHandle, graphs, 3);
 }
@@ -2744,7 +2858,10 @@ static void CleanupExperiment(BaselineExperimentContext *ctx) {
     ClosePhaseLogFile(ctx);
 	
 	// Close experiment log
-	ClearExternalLogFile();
+	if (ctx->experimentLogSink > 0) {
+	    LogSinkRemove(ctx->experimentLogSink);
+	    ctx->experimentLogSink = 0;
+	}
 	if (ctx->baselineExperimentLog) {
 	    fclose(ctx->baselineExperimentLog);
 	    ctx->baselineExperimentLog = NULL;
@@ -9,6 +9,7 @@
 #define EXP_BASELINE_H
 
 #include "common.h"
+#include "logging.h"
 #include "psb10000_dll.h"
 #include "psb10000_queue.h"
 #include "biologic_dll.h"
@@ -25,12 +26,14 @@
 
 // Battery Settling Time
 #define BASELINE_SETTLING_TIME          60.0    // Seconds to wait for battery relaxation after operations
+#define BASELINE_STATUS_MAX_AGE_MS      250     // PSB readings this recent come from the telemetry cache
 
 // Temperature Control Constants (when ENABLE_DTB is 1)
 #define BASELINE_TEMP_TOLERANCE         2.0     // C tolerance for temperature target
 #define BASELINE_TEMP_CHECK_INTERVAL    10.0    // Seconds between temperature checks
 #define BASELINE_TEMP_TIMEOUT_SEC       1800    // 30 minutes max wait for temperature
 #define BASELINE_TEMP_STABILIZE_TIME    300     // 5 minutes stabilization after reaching target
+#define BASELINE_TEMP_MAX_AGE_MS        1000    // DTB readings this recent come from the telemetry cache
 
 // EIS Retry and Timeout
 #define BASELINE_MAX_EIS_RETRY          2       // Retry failed measurements twice
@@ -99,7 +102,7 @@ typedef enum {
     BASELINE_PHASE_4       // Discharge to 50%
 } BaselineExperimentPhase;
 
-// Experiment parameters from UI
+// Experiment parameters from UI or a headless run configuration
 typedef struct {
     double targetTemperature;    // DTB target temperature (C)
     double eisInterval;          // SOC percentage between EIS measurements
@@ -227,6 +230,8 @@ typedef struct {
     char currentPhaseDirectory[MAX_PATH_LENGTH];
     FILE *currentPhaseLogFile;      // Current phase data log
 	FILE *baselineExperimentLog;    // Experiment log file
+	int logExperimentId;            // Tags this experiment's log lines
+	LogSinkHandle experimentLogSink; // Routes them to baselineExperimentLog
     
     // UI handles
     int mainPanelHandle;
@@ -261,6 +266,14 @@ int CVICALLBACK StartBaselineExperimentCallback(int panel, int control, int even
                                                void *callbackData, int eventData1, 
                                                int eventData2);
 
+/**
+ * Run a baseline experiment without the UI on the calling thread and return
+ * when it ends. Confirmations are answered yes and progress goes to the log.
+ * @param params - Experiment parameters
+ * @return SUCCESS when completed, ERR_CANCELLED if aborted, or error code
+ */
+int BaselineExperiment_RunHeadless(const BaselineExperimentParams *params);
+
 /**
  * Check if a baseline experiment is running
  * @return 1 if running, 0 if not
@@ -10,6 +10,8 @@
 #include "teensy_queue.h"
 #include "logging.h"
 #include "status.h"
+#include "telemetry.h"
+#include "ui_update.h"
 #include <ansi_c.h>
 #include <utility.h>
 
@@ -36,10 +38,12 @@ static const int g_numCdcControls = sizeof(g_cdcControls) / sizeof(g_cdcControls
 
 static int CDCExperimentThread(void *functionData);
 static int StartCDCOperation(int panel, int control, CDCOperationMode mode);
+static int ClaimPSBForOperation(PSB_Handle **psbHandle);
 static int VerifyBatteryState(CDCExperimentContext *ctx);
 static int RunOperation(CDCExperimentContext *ctx);
 static void UpdateGraph(CDCExperimentContext *ctx, double current, double time);
 static void RestoreUI(CDCExperimentContext *ctx);
+static void SetStatusText(CDCExperimentContext *ctx, const char *text);
 static const char* GetModeName(CDCOperationMode mode);
 
 /******************************************************************************
@@ -80,6 +84,49 @@ int CDCExperiment_GetMode(void) {
     return -1;
 }
 
+int CDCExperiment_RunHeadless(CDCOperationMode mode, const CDCExperimentParams *params) {
+    if (!params) {
+        return ERR_NULL_POINTER;
+    }
+    if (params->targetCurrent <= 0.0 || params->currentThreshold <= 0.0 || params->logInterval == 0) {
+        LogError("Invalid %s parameters", GetModeName(mode));
+        return ERR_INVALID_PARAMETER;
+    }
+    if (!BATTERY_VOLTAGE_IN_RANGE(params->targetVoltage)) {
+        LogError("%s target voltage %.3f V is outside %.2f - %.2f V", GetModeName(mode),
+                 params->targetVoltage, BATTERY_VOLTAGE_MIN, BATTERY_VOLTAGE_MAX);
+        return ERR_INVALID_PARAMETER;
+    }
+    if (CDCExperiment_IsRunning()) {
+        return ERR_INVALID_STATE;
+    }
+    
+    PSB_Handle *psbHandle = NULL;
+    int result = ClaimPSBForOperation(&psbHandle);
+    if (result != SUCCESS) {
+        return result;
+    }
+    
+    // Same context as a UI start, without panel or controls
+    memset(&g_experimentContext, 0, sizeof(g_experimentContext));
+    g_experimentContext.state = CDC_STATE_PREPARING;
+    g_experimentContext.mode = mode;
+    g_experimentContext.psbHandle = psbHandle;
+    g_experimentContext.params = *params;
+    
+    // Run on the calling thread, the thread function releases the system
+    CDCExperimentThread(&g_experimentContext);
+    
+    switch (g_experimentContext.state) {
+        case CDC_STATE_COMPLETED:
+            return SUCCESS;
+        case CDC_STATE_CANCELLED:
+            return ERR_CANCELLED;
+        default:
+            return ERR_OPERATION_FAILED;
+    }
+}
+
 /******************************************************************************
  * Common Start Function
  ******************************************************************************/
@@ -93,64 +140,9 @@ static int StartCDCOperation(int panel, int control, CDCOperationMode mode) {
         return 0;
     }
     
-    // Check if system is busy
-    CmtGetLock(g_busyLock);
-    if (g_systemBusy) {
-        CmtReleaseLock(g_busyLock);
-        MessagePopup("System Busy", 
-                     "Another operation is in progress.\n"
-                     "Please wait for it to complete before starting.");
-        return 0;
-    }
-    g_systemBusy = 1;
-    CmtReleaseLock(g_busyLock);
-    
-    // Check PSB connection
-    PSBQueueManager *psbQueueMgr = PSB_GetGlobalQueueManager();
-    if (!psbQueueMgr) {
-        CmtGetLock(g_busyLock);
-        g_systemBusy = 0;
-        CmtReleaseLock(g_busyLock);
-        
-        MessagePopup("PSB Not Connected", 
-                     "The PSB power supply is not connected.\n"
-                     "Please ensure it is connected before running.");
-        return 0;
-    }
-    
-    PSB_Handle *psbHandle = PSB_QueueGetHandle(psbQueueMgr);
-    if (!psbHandle || !psbHandle->isConnected) {
-        CmtGetLock(g_busyLock);
-        g_systemBusy = 0;
-        CmtReleaseLock(g_busyLock);
-        
-        MessagePopup("PSB Not Connected", 
-                     "The PSB power supply is not connected.\n"
-                     "Please ensure it is connected before running.");
-        return 0;
-    }
-    
-    // Check that PSB output is disabled
-    PSB_Status status;
-    if (PSB_GetStatusQueued(&status, DEVICE_PRIORITY_NORMAL) == PSB_SUCCESS) {
-        if (status.outputEnabled) {
-            CmtGetLock(g_busyLock);
-            g_systemBusy = 0;
-            CmtReleaseLock(g_busyLock);
-            
-            MessagePopup("PSB Output Enabled", 
-                         "The PSB output must be disabled before starting.\n"
-                         "Please turn off the output and try again.");
-            return 0;
-        }
-    } else {
-        CmtGetLock(g_busyLock);
-        g_systemBusy = 0;
-        CmtReleaseLock(g_busyLock);
-        
-        MessagePopup("Communication Error", 
-                     "Failed to communicate with the PSB.\n"
-                     "Please check the connection and try again.");
+    // Claim the system and check the PSB
+    PSB_Handle *psbHandle = NULL;
+    if (ClaimPSBForOperation(&psbHandle) != SUCCESS) {
         return 0;
     }
     
@@ -173,6 +165,8 @@ static int StartCDCOperation(int panel, int control, CDCOperationMode mode) {
         GetCtrlVal(g_mainPanelHandle, PANEL_NUM_SET_DISCHARGE_I, &g_experimentContext.params.targetCurrent);
     }
     
+    GetCtrlVal(g_mainPanelHandle, PANEL_NUM_SET_CHARGE_I, &g_experimentContext.params.chargeCurrent);
+    GetCtrlVal(g_mainPanelHandle, PANEL_NUM_SET_DISCHARGE_I, &g_experimentContext.params.dischargeCurrent);
     GetCtrlVal(panel, CDC_NUM_CURRENT_THRESHOLD, &g_experimentContext.params.currentThreshold);
     GetCtrlVal(panel, CDC_NUM_INTERVAL, &g_experimentContext.params.logInterval);
     
@@ -215,6 +209,61 @@ static int StartCDCOperation(int panel, int control, CDCOperationMode mode) {
     return 0;
 }
 
+// Mark the system busy and check that the PSB is connected with its output off.
+// On failure the system is released again and the reason reported.
+static int ClaimPSBForOperation(PSB_Handle **psbHandle) {
+    // Check if system is busy
+    CmtGetLock(g_busyLock);
+    if (g_systemBusy) {
+        CmtReleaseLock(g_busyLock);
+        ExperimentNotify("System Busy", 
+                         "Another operation is in progress.\n"
+                         "Please wait for it to complete before starting.");
+        return ERR_INVALID_STATE;
+    }
+    g_systemBusy = 1;
+    CmtReleaseLock(g_busyLock);
+    
+    const char *title = NULL;
+    const char *message = NULL;
+    int result = SUCCESS;
+    
+    // Check PSB connection
+    PSBQueueManager *psbQueueMgr = PSB_GetGlobalQueueManager();
+    PSB_Handle *handle = psbQueueMgr ? PSB_QueueGetHandle(psbQueueMgr) : NULL;
+    PSB_Status status;
+    
+    if (!handle || !handle->isConnected) {
+        title = "PSB Not Connected";
+        message = "The PSB power supply is not connected.\n"
+                  "Please ensure it is connected before running.";
+        result = ERR_NOT_CONNECTED;
+    } else if (Telemetry_GetPSBStatus(&status, TELEMETRY_MAX_AGE_FRESH, DEVICE_PRIORITY_NORMAL) != PSB_SUCCESS) {
+        title = "Communication Error";
+        message = "Failed to communicate with the PSB.\n"
+                  "Please check the connection and try again.";
+        result = ERR_COMM_FAILED;
+    } else if (status.outputEnabled) {
+        // Check that PSB output is disabled
+        title = "PSB Output Enabled";
+        message = "The PSB output must be disabled before starting.\n"
+                  "Please turn off the output and try again.";
+        result = ERR_INVALID_STATE;
+    }
+    
+    if (result != SUCCESS) {
+        CmtGetLock(g_busyLock);
+        g_systemBusy = 0;
+        CmtReleaseLock(g_busyLock);
+        
+        ExperimentNotify(title, message);
+        return result;
+    }
+    
+    *psbHandle = handle;
+    return SUCCESS;
+}
+
 /******************************************************************************
  * Experiment Thread Implementation
  ******************************************************************************/
@@ -224,6 +273,7 @@ static int CDCExperimentThread(void *functionData) {
     char message[LARGE_BUFFER_SIZE];
     int result = SUCCESS;
     
+    DeviceQueue_SetThreadName("CDC Experiment");
     LogMessage("=== Starting %s Operation ===", GetModeName(ctx->mode));
     
     // Record experiment start time
@@ -249,7 +299,7 @@ static int CDCExperimentThread(void *functionData) {
         ctx->params.currentThreshold,
         ctx->params.logInterval);
     
-    int response = ConfirmPopup("Confirm Parameters", message);
+    int response = ExperimentConfirm("Confirm Parameters", message);
     if (!response || ctx->state == CDC_STATE_CANCELLED) {
         LogMessage("CDC operation cancelled by user");
         ctx->state = CDC_STATE_CANCELLED;
@@ -262,7 +312,7 @@ static int CDCExperimentThread(void *functionData) {
     
     if (result != PSB_SUCCESS) {
         LogError("Failed to initialize PSB to safe state: %s", PSB_GetErrorString(result));
-        MessagePopup("Error", "Failed to initialize PSB to safe state.\nPlease check the connection and try again.");
+        ExperimentNotify("Error", "Failed to initialize PSB to safe state.\nPlease check the connection and try again.");
         ctx->state = CDC_STATE_ERROR;
         goto cleanup;
     }
@@ -282,18 +332,20 @@ static int CDCExperimentThread(void *functionData) {
         goto cleanup;
     }
     
-    // Configure graph using common utility
-    ConfigureGraph(ctx->mainPanelHandle, ctx->graphHandle, 
-                   "Current vs Time", "Time (s)", "Current (A)", 
-                   0.0, ctx->params.targetCurrent * 1.1);
-	
-	// Clear any existing plots
-	DeleteGraphPlot(ctx->mainPanelHandle, ctx->graphHandle, -1, VAL_DELAYED_DRAW);
+    // Configure graph using common utility, headless runs have none
+    if (ctx->mainPanelHandle > 0) {
+        ConfigureGraph(ctx->mainPanelHandle, ctx->graphHandle, 
+                       "Current vs Time", "Time (s)", "Current (A)", 
+                       0.0, ctx->params.targetCurrent * 1.1);
+        
+        // Clear any existing plots and the previous run's trace
+        GraphTrace_ClearGraph(ctx->mainPanelHandle, ctx->graphHandle);
+        ctx->currentTrace = GraphTrace_Create(ctx->mainPanelHandle, ctx->graphHandle, VAL_SOLID_CIRCLE, VAL_RED);
+    }
     
     // Run the operation
     LogMessage("Starting %s operation...", GetModeName(ctx->mode));
-    SetCtrlVal(ctx->mainPanelHandle, PANEL_STR_PSB_STATUS, 
-               ctx->mode == CDC_MODE_CHARGE ? "Charging battery..." : "Discharging battery...");
+    SetStatusText(ctx, ctx->mode == CDC_MODE_CHARGE ? "Charging battery..." : "Discharging battery...");
     
     result = RunOperation(ctx);
     if (result != SUCCESS || ctx->state == CDC_STATE_CANCELLED) {
@@ -309,30 +361,29 @@ static int CDCExperimentThread(void *functionData) {
 cleanup:
 	// Turn off PSB output
     PSB_SetOutputEnableQueued(0, DEVICE_PRIORITY_NORMAL);
+    
+    // Final drawing stays on the graph and follows zooms until the next run
+    GraphTrace_Finish(ctx->currentTrace);
+    ctx->currentTrace = NULL;
 	
 	// Disconnect PSB to battery using Teensy relay
 	result = TNY_SetPinQueued(TNY_PSB_PIN, TNY_STATE_DISCONNECTED, DEVICE_PRIORITY_NORMAL);
     if (result != SUCCESS) {
         LogError("Failed to disconnect PSB via relay: %s", PSB_GetErrorString(result));
+        DeviceQueue_ClearThreadName();
         return result;
     }
     
     // Update status based on final state
     if (ctx->state == CDC_STATE_COMPLETED) {
-        SetCtrlVal(ctx->mainPanelHandle, PANEL_STR_PSB_STATUS, 
-                   ctx->mode == CDC_MODE_CHARGE ? "Charge complete" : 
-                                                  "Discharge complete");
+        SetStatusText(ctx, ctx->mode == CDC_MODE_CHARGE ? "Charge complete" : "Discharge complete");
     } else if (ctx->state == CDC_STATE_CANCELLED) {
-        SetCtrlVal(ctx->mainPanelHandle, PANEL_STR_PSB_STATUS, "Operation cancelled");
+        SetStatusText(ctx, "Operation cancelled");
     } else {
-        SetCtrlVal(ctx->mainPanelHandle, PANEL_STR_PSB_STATUS, "Operation failed");
+        SetStatusText(ctx, "Operation failed");
     }
     
-    // Restore button text
-    SetCtrlAttribute(ctx->tabPanelHandle, ctx->activeButtonControl, ATTR_LABEL_TEXT, 
-                    ctx->mode == CDC_MODE_CHARGE ? "Charge" : "Discharge");
-    
-    // Restore UI
+    // Restore button text and controls
     RestoreUI(ctx);
     
     // Clear busy flag
@@ -343,6 +394,8 @@ cleanup:
     // Clear thread ID
     g_experimentThreadId = 0;
     
+    DeviceQueue_ClearThreadName();
+    
     return 0;
 }
 
@@ -362,7 +415,7 @@ static int VerifyBatteryState(CDCExperimentContext *ctx) {
     
     // Get current battery voltage
 	PSB_Status status;
-    int error = PSB_GetStatusQueued(&status, DEVICE_PRIORITY_NORMAL);
+    int error = Telemetry_GetPSBStatus(&status, CDC_STATUS_MAX_AGE_MS, DEVICE_PRIORITY_NORMAL);
 	
     if (error != PSB_SUCCESS) {
         LogError("Failed to read PSB status: %s", PSB_GetErrorString(error));
@@ -396,7 +449,7 @@ static int VerifyBatteryState(CDCExperimentContext *ctx) {
             return ERR_CANCELLED;
         }
         
-        int response = ConfirmPopup("Battery State", message);
+        int response = ExperimentConfirm("Battery State", message);
         if (!response || ctx->state == CDC_STATE_CANCELLED) {
             LogMessage("User cancelled due to battery already being %s", stateStr);
             return ERR_CANCELLED;
@@ -421,10 +474,9 @@ static int RunOperation(CDCExperimentContext *ctx) {
     // Configure experiment parameters
     LogMessage("Configuring experiment parameters...");
     
-    // Get charge and discharge current values from UI (both needed for PSB configuration)
-    double chargeCurrent, dischargeCurrent;
-    GetCtrlVal(g_mainPanelHandle, PANEL_NUM_SET_CHARGE_I, &chargeCurrent);
-    GetCtrlVal(g_mainPanelHandle, PANEL_NUM_SET_DISCHARGE_I, &dischargeCurrent);
+    // Charge and discharge currents are both needed for PSB configuration
+    double chargeCurrent = ctx->params.chargeCurrent;
+    double dischargeCurrent = ctx->params.dischargeCurrent;
     
     // Set both source and sink current values to allow backflow
     result = PSB_SetCurrentQueued(chargeCurrent, DEVICE_PRIORITY_NORMAL);
@@ -513,7 +565,7 @@ static int RunOperation(CDCExperimentContext *ctx) {
         
         // Get current status
 		PSB_Status status;
-        result = PSB_GetStatusQueued(&status, DEVICE_PRIORITY_NORMAL);
+        result = Telemetry_GetPSBStatus(&status, CDC_STATUS_MAX_AGE_MS, DEVICE_PRIORITY_NORMAL);
 		
         if (result != PSB_SUCCESS) {
             LogError("Failed to read status: %s", PSB_GetErrorString(result));
@@ -575,9 +627,11 @@ static int RunOperation(CDCExperimentContext *ctx) {
 }
 
 static void UpdateGraph(CDCExperimentContext *ctx, double current, double time) {
-    // Use common utility function for plotting
-    PlotPoint(ctx->mainPanelHandle, ctx->graphHandle, 
-                  time, fabs(current), VAL_SOLID_CIRCLE, VAL_RED);
+    if (!ctx->currentTrace) {
+        return;
+    }
+    
+    GraphTrace_AddPoint(ctx->currentTrace, time, fabs(current));
     
     // Check if Y-axis needs rescaling
     double yMin, yMax;
@@ -591,11 +645,26 @@ static void UpdateGraph(CDCExperimentContext *ctx, double current, double time)
 }
 
 static void RestoreUI(CDCExperimentContext *ctx) {
+    if (ctx->tabPanelHandle <= 0) {
+        return;
+    }
+    
+    // Restore button text
+    SetCtrlAttribute(ctx->tabPanelHandle, ctx->activeButtonControl, ATTR_LABEL_TEXT, 
+                    ctx->mode == CDC_MODE_CHARGE ? "Charge" : "Discharge");
+    
     // Re-enable all controls
     DimExperimentControls(ctx->mainPanelHandle, ctx->tabPanelHandle, 0, 
                                  (int*)g_cdcControls, g_numCdcControls);
 }
 
+static void SetStatusText(CDCExperimentContext *ctx, const char *text) {
+    if (ctx->mainPanelHandle > 0) {
+        // The status monitor writes this control through the update bus too
+        UIUpdate_SetString(ctx->mainPanelHandle, PANEL_STR_PSB_STATUS, text);
+    }
+}
+
 static const char* GetModeName(CDCOperationMode mode) {
     return (mode == CDC_MODE_CHARGE) ? "Charge" : "Discharge";
 }
@@ -11,6 +11,7 @@
 #include "common.h"
 #include "psb10000_dll.h"
 #include "psb10000_queue.h"
+#include "graph_trace.h"
 
 /******************************************************************************
  * Configuration Constants
@@ -25,6 +26,9 @@
 // Maximum operation duration for safety (hours)
 #define CDC_MAX_DURATION_H             10.0     // 10 hour timeout
 
+// Oldest PSB reading the operation acts on (ms), newer ones come from the telemetry cache
+#define CDC_STATUS_MAX_AGE_MS          200
+
 // Power limit to avoid CP mode (Watts)
 #define CDC_POWER_LIMIT_W              20.0     // 20W limit prevents CP mode
 
@@ -48,12 +52,14 @@ typedef enum {
     CDC_STATE_CANCELLED
 } CDCExperimentState;
 
-// Experiment parameters from UI
+// Experiment parameters from UI or a headless run configuration
 typedef struct {
     double targetVoltage;       // Target voltage (charge or discharge)
     double targetCurrent;       // Target current (charge or discharge)
     double currentThreshold;    // Current threshold to stop
     unsigned int logInterval;   // Measurement/update interval in seconds
+    double chargeCurrent;       // PSB source current limit
+    double dischargeCurrent;    // PSB sink current limit
 } CDCExperimentParams;
 
 // Experiment context
@@ -78,6 +84,7 @@ typedef struct {
     int tabPanelHandle;         // Tab panel handle
     int activeButtonControl;    // Which button was pressed (charge or discharge)
     int graphHandle;            // Graph control (PANEL_GRAPH_1)
+    GraphTrace *currentTrace;   // Current vs time on graphHandle
     
     // PSB handle
     PSB_Handle *psbHandle;
@@ -110,4 +117,9 @@ int CDCExperiment_GetMode(void);
 // Abort a running CDC operation
 int CDCExperiment_Abort(void);
 
+// Run a CDC operation without the UI on the calling thread, returns when it ends.
+// Confirmations are answered yes, progress goes to the log.
+// Returns SUCCESS when completed, ERR_CANCELLED if aborted, or an error code.
+int CDCExperiment_RunHeadless(CDCOperationMode mode, const CDCExperimentParams *params);
+
 #endif // EXP_CDC_H
\ No newline at end of file
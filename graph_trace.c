@@ -0,0 +1,467 @@
+/******************************************************************************
+ * graph_trace.c
+ *
+ * Graph Trace Module Implementation
+ * Replaces a PlotPoint per sample. All points stay in the trace; each drawing
+ * deletes the trace's previous plot and plots, per pixel column of the
+ * visible x range, the lowest and highest point in that column, in x order.
+ * Every extreme stays visible while the graph never holds more than one plot
+ * of at most two points per column for the trace.
+ * Traces are registered with the module and redrawn when the user zooms or
+ * changes an axis. A finished trace stays registered for that until its graph
+ * is cleared with GraphTrace_ClearGraph, which the next run does.
+ ******************************************************************************/
+
+#include "common.h"
+#include "graph_trace.h"
+#include "logging.h"
+
+/******************************************************************************
+ * Module Types
+ ******************************************************************************/
+
+struct GraphTrace {
+    int panel;
+    int graph;
+    int pointStyle;
+    int color;
+    CmtThreadLockHandle lock;
+
+    // Full resolution points, x ascending
+    double *x;
+    double *y;
+    int count;
+    int capacity;
+
+    // Decimated points of the last drawing
+    double *plotX;
+    double *plotY;
+    int plotCapacity;
+    int plotHandle;             // 0 if nothing is drawn
+
+    // What the last drawing covered
+    double lastRenderTime;
+    int lastAxisMode;
+    double lastAxisMin;
+    double lastAxisMax;
+
+    bool finished;              // The run let go of it, the module frees it
+};
+
+/******************************************************************************
+ * Module Variables
+ ******************************************************************************/
+
+static struct {
+    int initialized;
+    CmtThreadLockHandle lock;   // Guards the registry, taken before a trace lock
+    GraphTrace *traces[GRAPH_TRACE_MAX_TRACES];
+    volatile int renderPosted;  // A deferred redraw is pending
+} g_graphTrace = {0};
+
+/******************************************************************************
+ * Internal Function Prototypes
+ ******************************************************************************/
+
+static int GraphTrace_RenderLocked(GraphTrace *trace);
+static bool GraphTrace_RangeChanged(GraphTrace *trace);
+static bool GraphTrace_Register(GraphTrace *trace);
+static void GraphTrace_Free(GraphTrace *trace);
+static int CVICALLBACK GraphTrace_GraphCallback(int panel, int control, int event,
+                                                void *callbackData, int eventData1, int eventData2);
+static void CVICALLBACK GraphTrace_DeferredRender(void *callbackData);
+static int GraphTrace_Decimate(GraphTrace *trace, double xMin, double xMax, int columns);
+static int GraphTrace_FindFirst(const GraphTrace *trace, double x, bool inclusive);
+
+/******************************************************************************
+ * Public Interface Implementation
+ ******************************************************************************/
+
+int GraphTrace_Initialize(void) {
+    if (g_graphTrace.initialized) {
+        return SUCCESS;
+    }
+
+    memset(&g_graphTrace, 0, sizeof(g_graphTrace));
+    if (CmtNewLock(NULL, 0, &g_graphTrace.lock) < 0) {
+        LogError("Failed to create graph trace lock");
+        return ERR_THREAD_SYNC;
+    }
+
+    g_graphTrace.initialized = 1;
+    return SUCCESS;
+}
+
+void GraphTrace_Cleanup(void) {
+    if (!g_graphTrace.initialized) {
+        return;
+    }
+
+    CmtGetLock(g_graphTrace.lock);
+    g_graphTrace.initialized = 0;
+    for (int i = 0; i < GRAPH_TRACE_MAX_TRACES; i++) {
+        GraphTrace *trace = g_graphTrace.traces[i];
+        g_graphTrace.traces[i] = NULL;
+        if (trace && trace->finished) {
+            GraphTrace_Free(trace);
+        }
+    }
+    CmtReleaseLock(g_graphTrace.lock);
+
+    CmtDiscardLock(g_graphTrace.lock);
+    g_graphTrace.lock = 0;
+}
+
+GraphTrace* GraphTrace_Create(int panel, int graph, int pointStyle, int color) {
+    if (panel <= 0 || graph <= 0) {
+        return NULL;
+    }
+
+    GraphTrace *trace = calloc(1, sizeof(GraphTrace));
+    if (!trace) {
+        LogError("Failed to allocate graph trace");
+        return NULL;
+    }
+
+    trace->panel = panel;
+    trace->graph = graph;
+    trace->pointStyle = pointStyle;
+    trace->color = color;
+    trace->capacity = GRAPH_TRACE_INITIAL_CAPACITY;
+    trace->x = malloc(trace->capacity * sizeof(double));
+    trace->y = malloc(trace->capacity * sizeof(double));
+
+    if (!trace->x || !trace->y || CmtNewLock(NULL, 0, &trace->lock) < 0) {
+        LogError("Failed to initialize graph trace");
+        free(trace->x);
+        free(trace->y);
+        free(trace);
+        return NULL;
+    }
+
+    // Without a registry slot the trace still draws, just not on zoom
+    if (!GraphTrace_Register(trace)) {
+        LogWarning("Graph trace not redrawn on zoom, %d traces already registered", GRAPH_TRACE_MAX_TRACES);
+    }
+
+    return trace;
+}
+
+void GraphTrace_Finish(GraphTrace *trace) {
+    if (!trace) {
+        return;
+    }
+
+    CmtGetLock(trace->lock);
+    if (trace->count > 0) {
+        GraphTrace_RenderLocked(trace);
+    }
+    CmtReleaseLock(trace->lock);
+
+    // A registered trace stays for zoom redraws until its graph is cleared
+    bool kept = false;
+    if (g_graphTrace.initialized) {
+        CmtGetLock(g_graphTrace.lock);
+        for (int i = 0; i < GRAPH_TRACE_MAX_TRACES && !kept; i++) {
+            if (g_graphTrace.traces[i] == trace) {
+                trace->finished = true;
+                kept = true;
+            }
+        }
+        CmtReleaseLock(g_graphTrace.lock);
+    }
+
+    if (!kept) {
+        GraphTrace_Free(trace);
+    }
+}
+
+void GraphTrace_ClearGraph(int panel, int graph) {
+    if (g_graphTrace.initialized) {
+        CmtGetLock(g_graphTrace.lock);
+        for (int i = 0; i < GRAPH_TRACE_MAX_TRACES; i++) {
+            GraphTrace *trace = g_graphTrace.traces[i];
+            if (!trace || trace->panel != panel || trace->graph != graph) {
+                continue;
+            }
+            if (trace->finished) {
+                g_graphTrace.traces[i] = NULL;
+                GraphTrace_Free(trace);
+            } else {
+                // Still running, the plot is deleted below and redrawn on the next point
+                CmtGetLock(trace->lock);
+                trace->plotHandle = 0;
+                CmtReleaseLock(trace->lock);
+            }
+        }
+        CmtReleaseLock(g_graphTrace.lock);
+    }
+
+    DeleteGraphPlot(panel, graph, -1, VAL_DELAYED_DRAW);
+}
+
+int GraphTrace_AddPoint(GraphTrace *trace, double x, double y) {
+    if (!trace) {
+        return ERR_NULL_POINTER;
+    }
+
+    CmtGetLock(trace->lock);
+
+    if (trace->count >= trace->capacity) {
+        int newCapacity = trace->capacity * 2;
+        double *newX = realloc(trace->x, newCapacity * sizeof(double));
+        if (newX) {
+            trace->x = newX;
+        }
+        double *newY = realloc(trace->y, newCapacity * sizeof(double));
+        if (newY) {
+            trace->y = newY;
+        }
+        if (!newX || !newY) {
+            CmtReleaseLock(trace->lock);
+            LogError("Graph trace full at %d points", trace->count);
+            return ERR_OUT_OF_MEMORY;
+        }
+        trace->capacity = newCapacity;
+    }
+
+    // Keep x ascending for the range searches
+    if (trace->count > 0) {
+        x = MAX(x, trace->x[trace->count - 1]);
+    }
+    trace->x[trace->count] = x;
+    trace->y[trace->count] = y;
+    trace->count++;
+
+    // Redraw on the render interval, or right away if the user zoomed or panned
+    int result = SUCCESS;
+    if (GraphTrace_RangeChanged(trace) || (Timer() - trace->lastRenderTime) * 1000.0 >= GRAPH_TRACE_RENDER_MS) {
+        result = GraphTrace_RenderLocked(trace);
+    }
+
+    CmtReleaseLock(trace->lock);
+    return result;
+}
+
+int GraphTrace_Render(GraphTrace *trace) {
+    if (!trace) {
+        return ERR_NULL_POINTER;
+    }
+
+    CmtGetLock(trace->lock);
+    int result = GraphTrace_RenderLocked(trace);
+    CmtReleaseLock(trace->lock);
+
+    return result;
+}
+
+int GraphTrace_GetCount(GraphTrace *trace) {
+    return trace ? trace->count : 0;
+}
+
+/******************************************************************************
+ * Internal Functions
+ ******************************************************************************/
+
+// Put the trace in a free registry slot and hook its graph's zoom and axis
+// events. Caller does not hold the registry lock.
+static bool GraphTrace_Register(GraphTrace *trace) {
+    if (!g_graphTrace.initialized) {
+        return false;
+    }
+
+    bool registered = false;
+    CmtGetLock(g_graphTrace.lock);
+    for (int i = 0; i < GRAPH_TRACE_MAX_TRACES && !registered; i++) {
+        if (!g_graphTrace.traces[i]) {
+            g_graphTrace.traces[i] = trace;
+            registered = true;
+        }
+    }
+    CmtReleaseLock(g_graphTrace.lock);
+
+    // The graphs have no callback of their own, installing again is harmless
+    if (registered) {
+        InstallCtrlCallback(trace->panel, trace->graph, GraphTrace_GraphCallback, NULL);
+    }
+    return registered;
+}
+
+static void GraphTrace_Free(GraphTrace *trace) {
+    CmtDiscardLock(trace->lock);
+    free(trace->x);
+    free(trace->y);
+    free(trace->plotX);
+    free(trace->plotY);
+    free(trace);
+}
+
+// The axis range is applied after the event returns, so redraw from a
+// deferred call. One pending call covers any number of events.
+static int CVICALLBACK GraphTrace_GraphCallback(int panel, int control, int event,
+                                                void *callbackData, int eventData1, int eventData2) {
+    if (event == EVENT_ZOOM || event == EVENT_AXIS_VAL_CHANGE) {
+        if (InterlockedCompareExchange(&g_graphTrace.renderPosted, 1, 0) == 0) {
+            if (PostDeferredCall(GraphTrace_DeferredRender, NULL) < 0) {
+                InterlockedExchange(&g_graphTrace.renderPosted, 0);
+            }
+        }
+    }
+    return 0;
+}
+
+// Redraw every registered trace whose graph now shows another x range
+static void CVICALLBACK GraphTrace_DeferredRender(void *callbackData) {
+    InterlockedExchange(&g_graphTrace.renderPosted, 0);
+    if (!g_graphTrace.initialized) {
+        return;
+    }
+
+    CmtGetLock(g_graphTrace.lock);
+    for (int i = 0; i < GRAPH_TRACE_MAX_TRACES; i++) {
+        GraphTrace *trace = g_graphTrace.traces[i];
+        if (!trace) {
+            continue;
+        }
+        CmtGetLock(trace->lock);
+        if (GraphTrace_RangeChanged(trace)) {
+            GraphTrace_RenderLocked(trace);
+        }
+        CmtReleaseLock(trace->lock);
+    }
+    CmtReleaseLock(g_graphTrace.lock);
+}
+
+// Caller holds trace->lock. True if the visible x range differs from the one
+// last drawn.
+static bool GraphTrace_RangeChanged(GraphTrace *trace) {
+    int mode;
+    double axisMin, axisMax;
+    GetAxisScalingMode(trace->panel, trace->graph, VAL_BOTTOM_XAXIS, &mode, &axisMin, &axisMax);
+    return (mode != trace->lastAxisMode) ||
+           (mode == VAL_MANUAL && (axisMin != trace->lastAxisMin || axisMax != trace->lastAxisMax));
+}
+
+// Caller holds trace->lock
+static int GraphTrace_RenderLocked(GraphTrace *trace) {
+    trace->lastRenderTime = Timer();
+
+    int mode;
+    double axisMin, axisMax;
+    GetAxisScalingMode(trace->panel, trace->graph, VAL_BOTTOM_XAXIS, &mode, &axisMin, &axisMax);
+    trace->lastAxisMode = mode;
+    trace->lastAxisMin = axisMin;
+    trace->lastAxisMax = axisMax;
+
+    if (trace->count == 0) {
+        return SUCCESS;
+    }
+
+    // An autoscaled axis shows everything
+    double xMin = trace->x[0];
+    double xMax = trace->x[trace->count - 1];
+    if (mode == VAL_MANUAL) {
+        xMin = axisMin;
+        xMax = axisMax;
+    }
+
+    int columns = 0;
+    if (GetCtrlAttribute(trace->panel, trace->graph, ATTR_PLOT_AREA_WIDTH, &columns) < 0 || columns <= 0) {
+        columns = GRAPH_TRACE_DEFAULT_COLUMNS;
+    }
+
+    if (trace->plotCapacity < 2 * columns) {
+        free(trace->plotX);
+        free(trace->plotY);
+        trace->plotX = malloc(2 * columns * sizeof(double));
+        trace->plotY = malloc(2 * columns * sizeof(double));
+        trace->plotCapacity = (trace->plotX && trace->plotY) ? 2 * columns : 0;
+        if (trace->plotCapacity == 0) {
+            LogError("Failed to allocate graph trace plot buffer");
+            return ERR_OUT_OF_MEMORY;
+        }
+    }
+
+    int numPoints = GraphTrace_Decimate(trace, xMin, xMax, columns);
+
+    if (trace->plotHandle > 0) {
+        DeleteGraphPlot(trace->panel, trace->graph, trace->plotHandle, VAL_DELAYED_DRAW);
+        trace->plotHandle = 0;
+    }
+    if (numPoints > 0) {
+        int plotHandle = PlotXY(trace->panel, trace->graph, trace->plotX, trace->plotY, numPoints,
+                                VAL_DOUBLE, VAL_DOUBLE, VAL_SCATTER,
+                                trace->pointStyle, VAL_SOLID, 1, trace->color);
+        if (plotHandle < 0) {
+            return ERR_OPERATION_FAILED;
+        }
+        trace->plotHandle = plotHandle;
+    }
+
+    return SUCCESS;
+}
+
+// Fill plotX/plotY with at most 2 * columns points, return how many
+static int GraphTrace_Decimate(GraphTrace *trace, double xMin, double xMax, int columns) {
+    int first = GraphTrace_FindFirst(trace, xMin, true);
+    int end = GraphTrace_FindFirst(trace, xMax, false);
+    int numPoints = 0;
+
+    // Few enough to draw as they are
+    if (end - first <= 2 * columns) {
+        for (int i = first; i < end; i++) {
+            trace->plotX[numPoints] = trace->x[i];
+            trace->plotY[numPoints] = trace->y[i];
+            numPoints++;
+        }
+        return numPoints;
+    }
+
+    double scale = (xMax > xMin) ? columns / (xMax - xMin) : 0.0;
+    int i = first;
+
+    while (i < end) {
+        int column = MIN((int)((trace->x[i] - xMin) * scale), columns - 1);
+        int minIndex = i;
+        int maxIndex = i;
+
+        for (i++; i < end && MIN((int)((trace->x[i] - xMin) * scale), columns - 1) == column; i++) {
+            if (trace->y[i] < trace->y[minIndex]) {
+                minIndex = i;
+            }
+            if (trace->y[i] > trace->y[maxIndex]) {
+                maxIndex = i;
+            }
+        }
+
+        // In x order so the trace keeps its shape
+        int firstIndex = MIN(minIndex, maxIndex);
+        int secondIndex = MAX(minIndex, maxIndex);
+        trace->plotX[numPoints] = trace->x[firstIndex];
+        trace->plotY[numPoints] = trace->y[firstIndex];
+        numPoints++;
+        if (secondIndex != firstIndex) {
+            trace->plotX[numPoints] = trace->x[secondIndex];
+            trace->plotY[numPoints] = trace->y[secondIndex];
+            numPoints++;
+        }
+    }
+
+    return numPoints;
+}
+
+// First point at or after x (inclusive) or after x (not inclusive)
+static int GraphTrace_FindFirst(const GraphTrace *trace, double x, bool inclusive) {
+    int low = 0;
+    int high = trace->count;
+
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (inclusive ? (trace->x[mid] < x) : (trace->x[mid] <= x)) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
@@ -0,0 +1,97 @@
+/******************************************************************************
+ * graph_trace.h
+ *
+ * Graph Trace Module Header
+ * Keeps every point of a graph trace in memory and draws it as one plot,
+ * decimated to the minimum and maximum of each pixel column of the visible
+ * x range, so a long run costs the graph the same as a short one. Traces are
+ * redrawn when the user zooms, and kept for that until their graph is cleared.
+ ******************************************************************************/
+#ifndef GRAPH_TRACE_H
+#define GRAPH_TRACE_H
+
+#include "common.h"
+
+/******************************************************************************
+ * Configuration Constants
+ ******************************************************************************/
+#define GRAPH_TRACE_RENDER_MS           1000    // Redraw at most this often while points arrive
+#define GRAPH_TRACE_INITIAL_CAPACITY    1024    // Points, doubled as needed
+#define GRAPH_TRACE_DEFAULT_COLUMNS     600     // Used if the plot area width is unavailable
+#define GRAPH_TRACE_MAX_TRACES          16      // Registered traces, running and finished
+
+/******************************************************************************
+ * Type Definitions
+ ******************************************************************************/
+
+typedef struct GraphTrace GraphTrace;
+
+/******************************************************************************
+ * Public Function Declarations
+ ******************************************************************************/
+
+/**
+ * Initialize the trace registry. Traces created before this still draw, but
+ * are not redrawn on zoom.
+ * @return SUCCESS or error code
+ */
+int GraphTrace_Initialize(void);
+
+/**
+ * Free every finished trace and the registry
+ */
+void GraphTrace_Cleanup(void);
+
+/**
+ * Create an empty trace on a graph. Points must be added in increasing x order.
+ * @param panel - Panel handle
+ * @param graph - Graph control
+ * @param pointStyle - Point style, e.g. VAL_SOLID_CIRCLE
+ * @param color - Plot color
+ * @return New trace, or NULL on failure
+ */
+GraphTrace* GraphTrace_Create(int panel, int graph, int pointStyle, int color);
+
+/**
+ * End of the run: draw the trace a last time and hand it to the module. It
+ * keeps being redrawn on zoom until GraphTrace_ClearGraph clears its graph.
+ * The caller must not use the trace afterwards.
+ * @param trace - Trace to finish, may be NULL
+ */
+void GraphTrace_Finish(GraphTrace *trace);
+
+/**
+ * Delete every plot on a graph and free its finished traces. Use instead of
+ * DeleteGraphPlot(..., -1, ...) on graphs that hold traces, e.g. when the
+ * next run starts.
+ * @param panel - Panel handle
+ * @param graph - Graph control
+ */
+void GraphTrace_ClearGraph(int panel, int graph);
+
+/**
+ * Add a point. The trace is redrawn when GRAPH_TRACE_RENDER_MS has passed
+ * since the last drawing, or when the visible x range changed (zoom or pan).
+ * @param trace - Trace
+ * @param x - X value, not less than the previous point's
+ * @param y - Y value
+ * @return SUCCESS or error code
+ */
+int GraphTrace_AddPoint(GraphTrace *trace, double x, double y);
+
+/**
+ * Redraw the trace now for the graph's current x range. Zoom and axis
+ * changes already redraw registered traces.
+ * @param trace - Trace
+ * @return SUCCESS or error code
+ */
+int GraphTrace_Render(GraphTrace *trace);
+
+/**
+ * Number of points held
+ * @param trace - Trace
+ * @return Point count, 0 for NULL
+ */
+int GraphTrace_GetCount(GraphTrace *trace);
+
+#endif // GRAPH_TRACE_H
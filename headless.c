@@ -0,0 +1,400 @@
+/******************************************************************************
+ * headless.c
+ *
+ * Headless Run Module Implementation
+ * The experiment engines run unchanged on the main thread with no panel
+ * loaded: their confirmations are answered yes, their popups become log
+ * errors and their graph and control updates are skipped. Every log line is
+ * copied to stdout (and to the configured log file), and a progress line
+ * with the latest PSB reading from the history store is added at a fixed
+ * interval.
+ ******************************************************************************/
+
+#include "common.h"
+#include "headless.h"
+#include "exp_cdc.h"
+#include "exp_baseline.h"
+#include "history.h"
+#include "logging.h"
+#include "device_queue.h"
+#include <ctype.h>
+#include <limits.h>
+
+/******************************************************************************
+ * Module Variables
+ ******************************************************************************/
+
+static struct {
+    HeadlessConfig config;
+    double startTime;
+    HANDLE stopEvent;               // Set to end the progress thread
+    CmtThreadFunctionID progressThreadId;
+} g_headless = {0};
+
+/******************************************************************************
+ * Internal Function Prototypes
+ ******************************************************************************/
+
+static int Headless_ParseLine(HeadlessConfig *config, char *line, int lineNumber);
+static int Headless_ParseDouble(const char *value, double *result);
+static int Headless_ParseInt(const char *value, int *result);
+static int Headless_CheckVoltage(const char *path, const char *key, double voltage);
+static bool Headless_KeyEquals(const char *a, const char *b);
+static const char* Headless_GetExperimentName(HeadlessExperiment experiment);
+static int Headless_RunExperiment(const HeadlessConfig *config);
+static void Headless_AttachConsole(void);
+static int CVICALLBACK Headless_ProgressThread(void *functionData);
+static BOOL WINAPI Headless_ConsoleHandler(DWORD ctrlType);
+
+/******************************************************************************
+ * Public Interface Implementation
+ ******************************************************************************/
+
+const char* Headless_GetConfigPath(int argc, char *argv[]) {
+    for (int i = 1; i < argc - 1; i++) {
+        if (Headless_KeyEquals(argv[i], HEADLESS_ARG)) {
+            return argv[i + 1];
+        }
+    }
+    return NULL;
+}
+
+int Headless_LoadConfig(const char *path, HeadlessConfig *config) {
+    if (!path || !config) {
+        return ERR_NULL_POINTER;
+    }
+
+    memset(config, 0, sizeof(HeadlessConfig));
+    config->progressInterval = HEADLESS_PROGRESS_INTERVAL_S;
+    config->chargeVoltage = HEADLESS_VOLTAGE_UNSET;
+    config->dischargeVoltage = HEADLESS_VOLTAGE_UNSET;
+
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        LogError("Cannot open headless configuration %s", path);
+        return ERR_BASE_FILE;
+    }
+
+    char line[HEADLESS_MAX_LINE_LEN];
+    int lineNumber = 0;
+    int result = SUCCESS;
+
+    while (result == SUCCESS && fgets(line, sizeof(line), file)) {
+        lineNumber++;
+        result = Headless_ParseLine(config, line, lineNumber);
+    }
+    fclose(file);
+
+    if (result != SUCCESS) {
+        return result;
+    }
+    if (config->experiment == HEADLESS_EXPERIMENT_NONE) {
+        LogError("%s does not set Experiment (cdc_charge, cdc_discharge or baseline)", path);
+        return ERR_INVALID_PARAMETER;
+    }
+
+    // Reject bad voltages here, before any device is touched
+    bool needCharge = (config->experiment != HEADLESS_EXPERIMENT_CDC_DISCHARGE);
+    bool needDischarge = (config->experiment != HEADLESS_EXPERIMENT_CDC_CHARGE);
+    if ((needCharge && Headless_CheckVoltage(path, "Charge_Voltage_V", config->chargeVoltage) != SUCCESS) ||
+        (needDischarge && Headless_CheckVoltage(path, "Discharge_Voltage_V", config->dischargeVoltage) != SUCCESS)) {
+        return ERR_INVALID_PARAMETER;
+    }
+    if (config->experiment == HEADLESS_EXPERIMENT_BASELINE &&
+        config->chargeVoltage <= config->dischargeVoltage) {
+        LogError("%s: Charge_Voltage_V must be above Discharge_Voltage_V", path);
+        return ERR_INVALID_PARAMETER;
+    }
+
+    return SUCCESS;
+}
+
+int Headless_Run(const char *configPath) {
+    Headless_AttachConsole();
+
+    int result = Headless_LoadConfig(configPath, &g_headless.config);
+    if (result != SUCCESS) {
+        return result;
+    }
+
+    HeadlessConfig *config = &g_headless.config;
+    if (config->debug) {
+        g_debugMode = 1;
+    }
+
+    // Progress goes to stdout, everything to the log file if one is set
+    LogSinkFilter consoleFilter = {0, config->debug ? LOG_LEVEL_DEBUG : LOG_LEVEL_INFO, LOG_EXPERIMENT_ANY};
+    LogSinkHandle consoleSink = LogSinkAddFile(stdout, &consoleFilter);
+    LogSinkHandle fileSink = 0;
+    if (config->logFile[0]) {
+        LogSinkFilter fileFilter = {0, LOG_LEVEL_DEBUG, LOG_EXPERIMENT_ANY};
+        fileSink = LogSinkOpen(config->logFile, &fileFilter);
+        if (fileSink <= 0) {
+            LogWarning("Cannot open headless log file %s: %s", config->logFile, GetErrorString(fileSink));
+        }
+    }
+
+    LogMessage("Headless %s run from %s", Headless_GetExperimentName(config->experiment), configPath);
+
+    SetConsoleCtrlHandler(Headless_ConsoleHandler, TRUE);
+
+    g_headless.startTime = GetTimestamp();
+    g_headless.stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    g_headless.progressThreadId = 0;
+    if (g_headless.stopEvent && config->progressInterval > 0) {
+        CmtScheduleThreadPoolFunction(g_threadPool, Headless_ProgressThread, NULL,
+                                      &g_headless.progressThreadId);
+    }
+
+    result = Headless_RunExperiment(config);
+
+    if (g_headless.progressThreadId) {
+        SetEvent(g_headless.stopEvent);
+        CmtWaitForThreadPoolFunctionCompletion(g_threadPool, g_headless.progressThreadId,
+                                               OPT_TP_PROCESS_EVENTS_WHILE_WAITING);
+        g_headless.progressThreadId = 0;
+    }
+    if (g_headless.stopEvent) {
+        CloseHandle(g_headless.stopEvent);
+        g_headless.stopEvent = NULL;
+    }
+
+    SetConsoleCtrlHandler(Headless_ConsoleHandler, FALSE);
+
+    if (result == SUCCESS) {
+        LogMessage("Headless run completed after %.1f minutes", (GetTimestamp() - g_headless.startTime) / 60.0);
+    } else {
+        LogError("Headless run ended: %s", GetErrorString(result));
+    }
+
+    LogFlush();
+    if (fileSink > 0) {
+        LogSinkRemove(fileSink);
+    }
+    if (consoleSink > 0) {
+        LogSinkRemove(consoleSink);
+    }
+
+    return result;
+}
+
+/******************************************************************************
+ * Internal Functions
+ ******************************************************************************/
+
+static int Headless_ParseLine(HeadlessConfig *config, char *line, int lineNumber) {
+    char *text = TrimWhitespace(line);
+    if (text[0] == '\0' || text[0] == '#' || text[0] == ';' || text[0] == '[') {
+        return SUCCESS;
+    }
+
+    char *separator = strchr(text, '=');
+    if (!separator) {
+        LogError("Headless configuration line %d is not Key=Value: %s", lineNumber, text);
+        return ERR_INVALID_PARAMETER;
+    }
+    *separator = '\0';
+    const char *key = TrimWhitespace(text);
+    const char *value = TrimWhitespace(separator + 1);
+
+    int result = SUCCESS;
+    int intValue = 0;
+
+    if (Headless_KeyEquals(key, "Experiment")) {
+        if (Headless_KeyEquals(value, "cdc_charge")) {
+            config->experiment = HEADLESS_EXPERIMENT_CDC_CHARGE;
+        } else if (Headless_KeyEquals(value, "cdc_discharge")) {
+            config->experiment = HEADLESS_EXPERIMENT_CDC_DISCHARGE;
+        } else if (Headless_KeyEquals(value, "baseline")) {
+            config->experiment = HEADLESS_EXPERIMENT_BASELINE;
+        } else {
+            result = ERR_INVALID_PARAMETER;
+        }
+    } else if (Headless_KeyEquals(key, "Charge_Voltage_V")) {
+        result = Headless_ParseDouble(value, &config->chargeVoltage);
+    } else if (Headless_KeyEquals(key, "Discharge_Voltage_V")) {
+        result = Headless_ParseDouble(value, &config->dischargeVoltage);
+    } else if (Headless_KeyEquals(key, "Charge_Current_A")) {
+        result = Headless_ParseDouble(value, &config->chargeCurrent);
+    } else if (Headless_KeyEquals(key, "Discharge_Current_A")) {
+        result = Headless_ParseDouble(value, &config->dischargeCurrent);
+    } else if (Headless_KeyEquals(key, "Current_Threshold_A")) {
+        result = Headless_ParseDouble(value, &config->currentThreshold);
+    } else if (Headless_KeyEquals(key, "Log_Interval_s")) {
+        result = Headless_ParseInt(value, &intValue);
+        if (result == SUCCESS && intValue <= 0) {
+            result = ERR_INVALID_PARAMETER;
+        }
+        config->logInterval = (unsigned int)intValue;
+    } else if (Headless_KeyEquals(key, "Target_Temperature_C")) {
+        // Saved as "N/A (DTB disabled)" when there is no temperature control
+        if (Headless_ParseDouble(value, &config->targetTemperature) != SUCCESS) {
+            config->targetTemperature = 0.0;
+        }
+    } else if (Headless_KeyEquals(key, "EIS_Interval_Percent")) {
+        result = Headless_ParseDouble(value, &config->eisInterval);
+    } else if (Headless_KeyEquals(key, "Progress_Interval_s")) {
+        result = Headless_ParseInt(value, &config->progressInterval);
+    } else if (Headless_KeyEquals(key, "Debug")) {
+        result = Headless_ParseInt(value, &config->debug);
+    } else if (Headless_KeyEquals(key, "Log_File")) {
+        strncpy(config->logFile, value, sizeof(config->logFile) - 1);
+        config->logFile[sizeof(config->logFile) - 1] = '\0';
+    }
+
+    if (result != SUCCESS) {
+        LogError("Headless configuration line %d: invalid value for %s: %s", lineNumber, key, value);
+    }
+    return result;
+}
+
+static int Headless_ParseDouble(const char *value, double *result) {
+    char *end;
+    double parsed = strtod(value, &end);
+    if (end == value || *TrimWhitespace(end) != '\0') {
+        return ERR_INVALID_PARAMETER;
+    }
+    *result = parsed;
+    return SUCCESS;
+}
+
+static int Headless_ParseInt(const char *value, int *result) {
+    char *end;
+    long parsed = strtol(value, &end, 10);
+    if (end == value || *TrimWhitespace(end) != '\0' || parsed < INT_MIN || parsed > INT_MAX) {
+        return ERR_INVALID_PARAMETER;
+    }
+    *result = (int)parsed;
+    return SUCCESS;
+}
+
+// Case-insensitive comparison, keys are matched as the settings file writes them
+static int Headless_CheckVoltage(const char *path, const char *key, double voltage) {
+    if (voltage == HEADLESS_VOLTAGE_UNSET) {
+        LogError("%s does not set %s", path, key);
+        return ERR_INVALID_PARAMETER;
+    }
+    if (!BATTERY_VOLTAGE_IN_RANGE(voltage)) {
+        LogError("%s: %s=%.3f is outside %.2f - %.2f V", path, key, voltage,
+                 BATTERY_VOLTAGE_MIN, BATTERY_VOLTAGE_MAX);
+        return ERR_INVALID_PARAMETER;
+    }
+    return SUCCESS;
+}
+
+static bool Headless_KeyEquals(const char *a, const char *b) {
+    while (*a && *b) {
+        if (tolower((unsigned char)*a) != tolower((unsigned char)*b)) {
+            return false;
+        }
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+static const char* Headless_GetExperimentName(HeadlessExperiment experiment) {
+    switch (experiment) {
+        case HEADLESS_EXPERIMENT_CDC_CHARGE: return "CDC charge";
+        case HEADLESS_EXPERIMENT_CDC_DISCHARGE: return "CDC discharge";
+        case HEADLESS_EXPERIMENT_BASELINE: return "baseline";
+        default: return "unknown";
+    }
+}
+
+static int Headless_RunExperiment(const HeadlessConfig *config) {
+    switch (config->experiment) {
+        case HEADLESS_EXPERIMENT_CDC_CHARGE:
+        case HEADLESS_EXPERIMENT_CDC_DISCHARGE: {
+            bool charge = (config->experiment == HEADLESS_EXPERIMENT_CDC_CHARGE);
+            CDCExperimentParams params = {0};
+            params.targetVoltage = charge ? config->chargeVoltage : config->dischargeVoltage;
+            params.targetCurrent = charge ? config->chargeCurrent : config->dischargeCurrent;
+            params.currentThreshold = config->currentThreshold;
+            params.logInterval = config->logInterval;
+            params.chargeCurrent = config->chargeCurrent;
+            params.dischargeCurrent = config->dischargeCurrent;
+            return CDCExperiment_RunHeadless(charge ? CDC_MODE_CHARGE : CDC_MODE_DISCHARGE, &params);
+        }
+
+        case HEADLESS_EXPERIMENT_BASELINE: {
+            BaselineExperimentParams params = {0};
+            params.targetTemperature = config->targetTemperature;
+            params.eisInterval = config->eisInterval;
+            params.currentThreshold = config->currentThreshold;
+            params.logInterval = config->logInterval;
+            params.chargeVoltage = config->chargeVoltage;
+            params.dischargeVoltage = config->dischargeVoltage;
+            params.chargeCurrent = config->chargeCurrent;
+            params.dischargeCurrent = config->dischargeCurrent;
+            return BaselineExperiment_RunHeadless(&params);
+        }
+
+        default:
+            return ERR_INVALID_PARAMETER;
+    }
+}
+
+static int CVICALLBACK Headless_ProgressThread(void *functionData) {
+    DeviceQueue_SetThreadName("Headless Progress");
+    DWORD periodMs = (DWORD)g_headless.config.progressInterval * 1000;
+
+    while (WaitForSingleObject(g_headless.stopEvent, periodMs) == WAIT_TIMEOUT) {
+        double elapsedMin = (GetTimestamp() - g_headless.startTime) / 60.0;
+        double voltage, current, power;
+
+        if (History_GetLatest(HISTORY_CHANNEL_PSB_VOLTAGE, NULL, &voltage) == SUCCESS &&
+            History_GetLatest(HISTORY_CHANNEL_PSB_CURRENT, NULL, &current) == SUCCESS &&
+            History_GetLatest(HISTORY_CHANNEL_PSB_POWER, NULL, &power) == SUCCESS) {
+            LogMessage("Progress %.1f min: %.3f V, %.3f A, %.2f W", elapsedMin, voltage, current, power);
+        } else {
+            LogMessage("Progress %.1f min: no PSB reading yet", elapsedMin);
+        }
+    }
+
+    DeviceQueue_ClearThreadName();
+    return 0;
+}
+
+// The tester is a GUI-subsystem program and starts without a console. Use
+// the console of the shell that started it, or open one, so stdout and the
+// Ctrl+C handler work. Output the shell redirected to a file or pipe stays
+// redirected.
+static void Headless_AttachConsole(void) {
+    HANDLE output = GetStdHandle(STD_OUTPUT_HANDLE);
+    HANDLE error = GetStdHandle(STD_ERROR_HANDLE);
+    bool outputRedirected = output != NULL && output != INVALID_HANDLE_VALUE;
+    bool errorRedirected = error != NULL && error != INVALID_HANDLE_VALUE;
+
+    if (!AttachConsole(ATTACH_PARENT_PROCESS) && !AllocConsole()) {
+        if (!outputRedirected) {
+            LogWarning("No console for headless output, use Log_File to keep the log");
+        }
+        return;
+    }
+
+    if (!outputRedirected) {
+        freopen("CONOUT$", "w", stdout);
+    }
+    if (!errorRedirected) {
+        freopen("CONOUT$", "w", stderr);
+    }
+}
+
+// Console thread: Ctrl+C, Ctrl+Break or closing the console cancels the run
+static BOOL WINAPI Headless_ConsoleHandler(DWORD ctrlType) {
+    switch (ctrlType) {
+        case CTRL_C_EVENT:
+        case CTRL_BREAK_EVENT:
+        case CTRL_CLOSE_EVENT:
+            LogWarning("Headless run interrupted, cancelling experiment...");
+            if (CDCExperiment_IsRunning()) {
+                CDCExperiment_Abort();
+            }
+            if (BaselineExperiment_IsRunning()) {
+                BaselineExperiment_Abort();
+            }
+            return TRUE;
+    }
+    return FALSE;
+}
@@ -0,0 +1,79 @@
+/******************************************************************************
+ * headless.h
+ *
+ * Headless Run Module Header
+ * Runs one CDC or baseline experiment from a configuration file without the
+ * user interface, reporting progress on stdout and optionally to a log file
+ ******************************************************************************/
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include "common.h"
+
+/******************************************************************************
+ * Configuration Constants
+ ******************************************************************************/
+#define HEADLESS_ARG                    "-headless"     // Command line switch, followed by the config path
+#define HEADLESS_PROGRESS_INTERVAL_S    30              // Default seconds between progress lines
+#define HEADLESS_MAX_LINE_LEN           256             // Longest configuration line
+#define HEADLESS_VOLTAGE_UNSET          -1.0            // Voltage key missing from the configuration
+
+/******************************************************************************
+ * Type Definitions
+ ******************************************************************************/
+
+typedef enum {
+    HEADLESS_EXPERIMENT_NONE = 0,
+    HEADLESS_EXPERIMENT_CDC_CHARGE,
+    HEADLESS_EXPERIMENT_CDC_DISCHARGE,
+    HEADLESS_EXPERIMENT_BASELINE
+} HeadlessExperiment;
+
+// Everything a run needs. Keys are those of the experiment_settings.ini a
+// baseline run saves, so a saved run can be repeated by adding Experiment=.
+typedef struct {
+    HeadlessExperiment experiment;  // Experiment = cdc_charge | cdc_discharge | baseline
+    double chargeVoltage;           // Charge_Voltage_V
+    double dischargeVoltage;        // Discharge_Voltage_V
+    double chargeCurrent;           // Charge_Current_A
+    double dischargeCurrent;        // Discharge_Current_A
+    double currentThreshold;        // Current_Threshold_A
+    unsigned int logInterval;       // Log_Interval_s
+    double targetTemperature;       // Target_Temperature_C (baseline only)
+    double eisInterval;             // EIS_Interval_Percent (baseline only)
+    int progressInterval;           // Progress_Interval_s, 0 for no progress lines
+    int debug;                      // Debug=1 also prints debug lines
+    char logFile[MAX_PATH_LENGTH];  // Log_File, copy of every line, empty for none
+} HeadlessConfig;
+
+/******************************************************************************
+ * Public Function Declarations
+ ******************************************************************************/
+
+/**
+ * Find the headless switch on the command line
+ * @param argc - Argument count from main
+ * @param argv - Arguments from main
+ * @return Configuration file path, or NULL for a normal UI start
+ */
+const char* Headless_GetConfigPath(int argc, char *argv[]);
+
+/**
+ * Read a configuration file of Key=Value lines. Blank lines, lines starting
+ * with '#' or ';', [section] headers and unknown keys are skipped.
+ * @param path - Configuration file
+ * @param config - Receives the configuration
+ * @return SUCCESS or error code
+ */
+int Headless_LoadConfig(const char *path, HeadlessConfig *config);
+
+/**
+ * Load the configuration and run its experiment on the calling thread.
+ * Devices, telemetry and status monitoring must already be running.
+ * Ctrl+C cancels the experiment.
+ * @param configPath - Configuration file
+ * @return SUCCESS when the experiment completed, ERR_CANCELLED, or error code
+ */
+int Headless_Run(const char *configPath);
+
+#endif // HEADLESS_H
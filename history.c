@@ -0,0 +1,466 @@
+/******************************************************************************
+ * history.c
+ *
+ * Telemetry History Module Implementation
+ * Each channel is a ring of fixed-size segments holding sample times and
+ * values in separate arrays, so searches walk contiguous times. Every segment
+ * but the newest is full, which maps a sample number straight to its segment
+ * and slot; time lookups are a binary search over sample numbers. Segments
+ * keep a min/max/sum summary for bucketed queries.
+ ******************************************************************************/
+
+#include "common.h"
+#include "history.h"
+#include "telemetry.h"
+#include "telemetry_export.h"
+#include "dtb4848_queue.h"
+#include "logging.h"
+
+/******************************************************************************
+ * Module Variables
+ ******************************************************************************/
+
+typedef struct {
+    double times[HISTORY_SEGMENT_SAMPLES];
+    double values[HISTORY_SEGMENT_SAMPLES];
+    int count;
+    double minValue;
+    double maxValue;
+    double sum;
+} HistorySegment;
+
+typedef struct {
+    HistorySegment *segments;   // Ring of HISTORY_SEGMENTS_PER_CHANNEL
+    int firstSegment;           // Ring index of the oldest segment
+    int segmentCount;           // Segments in use, oldest first
+    int added;                  // Samples ever added; the oldest stored is number added - stored
+} HistoryChannelData;
+
+static struct {
+    volatile int initialized;
+    CmtThreadLockHandle lock;
+    HistoryChannelData channels[HISTORY_CHANNEL_COUNT];
+    int telemetrySubscription;
+} g_history = {0};
+
+/******************************************************************************
+ * Internal Function Prototypes
+ ******************************************************************************/
+
+static void History_TelemetryCallback(const TelemetrySnapshot *snapshot, void *userData);
+static int History_SampleCount(const HistoryChannelData *data);
+static double History_SampleTime(const HistoryChannelData *data, int sample);
+static HistorySegment* History_SampleSegment(const HistoryChannelData *data, int sample);
+static int History_LowerBound(const HistoryChannelData *data, double time, bool inclusive);
+
+/******************************************************************************
+ * Public Interface Implementation
+ ******************************************************************************/
+
+int History_Initialize(void) {
+    if (g_history.initialized) {
+        return SUCCESS;
+    }
+
+    memset(&g_history, 0, sizeof(g_history));
+
+    if (CmtNewLock(NULL, 0, &g_history.lock) < 0) {
+        LogError("Failed to create history lock");
+        return ERR_THREAD_SYNC;
+    }
+
+    for (int i = 0; i < HISTORY_CHANNEL_COUNT; i++) {
+        g_history.channels[i].segments = calloc(HISTORY_SEGMENTS_PER_CHANNEL, sizeof(HistorySegment));
+        if (!g_history.channels[i].segments) {
+            LogError("Failed to allocate history for %s", History_GetChannelName(i));
+            History_Cleanup();
+            return ERR_OUT_OF_MEMORY;
+        }
+    }
+
+    g_history.initialized = 1;
+
+    // PSB and DTB readings arrive through the telemetry cache whoever took them
+    g_history.telemetrySubscription = Telemetry_Subscribe(History_TelemetryCallback, NULL);
+
+    LogMessage("Telemetry history initialized (%d channels, %d samples each)",
+               HISTORY_CHANNEL_COUNT, HISTORY_CHANNEL_CAPACITY);
+    return SUCCESS;
+}
+
+void History_Cleanup(void) {
+    Telemetry_Unsubscribe(g_history.telemetrySubscription);
+    g_history.telemetrySubscription = 0;
+
+    if (g_history.lock) {
+        CmtGetLock(g_history.lock);
+    }
+    g_history.initialized = 0;
+    for (int i = 0; i < HISTORY_CHANNEL_COUNT; i++) {
+        free(g_history.channels[i].segments);
+        memset(&g_history.channels[i], 0, sizeof(HistoryChannelData));
+    }
+    if (g_history.lock) {
+        CmtReleaseLock(g_history.lock);
+        CmtDiscardLock(g_history.lock);
+        g_history.lock = 0;
+    }
+}
+
+int History_Add(int channel, double timestamp, double value) {
+    if (channel < 0 || channel >= HISTORY_CHANNEL_COUNT) {
+        return ERR_INVALID_PARAMETER;
+    }
+    if (!g_history.initialized) {
+        return ERR_NOT_INITIALIZED;
+    }
+
+    CmtGetLock(g_history.lock);
+    HistoryChannelData *data = &g_history.channels[channel];
+
+    // Readings published from different threads can arrive slightly out of order
+    int total = History_SampleCount(data);
+    if (total > 0) {
+        timestamp = MAX(timestamp, History_SampleTime(data, total - 1));
+    }
+
+    HistorySegment *segment = (data->segmentCount > 0) ? History_SampleSegment(data, total - 1) : NULL;
+    if (!segment || segment->count >= HISTORY_SEGMENT_SAMPLES) {
+        if (data->segmentCount < HISTORY_SEGMENTS_PER_CHANNEL) {
+            data->segmentCount++;
+        } else {
+            // Reuse the oldest segment
+            data->firstSegment = (data->firstSegment + 1) % HISTORY_SEGMENTS_PER_CHANNEL;
+        }
+        segment = &data->segments[(data->firstSegment + data->segmentCount - 1) % HISTORY_SEGMENTS_PER_CHANNEL];
+        segment->count = 0;
+        segment->minValue = value;
+        segment->maxValue = value;
+        segment->sum = 0.0;
+    }
+
+    segment->times[segment->count] = timestamp;
+    segment->values[segment->count] = value;
+    segment->count++;
+    segment->minValue = MIN(segment->minValue, value);
+    segment->maxValue = MAX(segment->maxValue, value);
+    segment->sum += value;
+    data->added++;
+
+    // Under the lock so the export ring keeps the order samples were stored in
+    TelemetryExport_Publish(channel, timestamp, value);
+
+    CmtReleaseLock(g_history.lock);
+    return SUCCESS;
+}
+
+int History_GetLatest(int channel, double *timestamp, double *value) {
+    if (!value) {
+        return ERR_NULL_POINTER;
+    }
+    if (channel < 0 || channel >= HISTORY_CHANNEL_COUNT) {
+        return ERR_INVALID_PARAMETER;
+    }
+    if (!g_history.initialized) {
+        return ERR_NOT_INITIALIZED;
+    }
+
+    int result = ERR_NOT_INITIALIZED;
+    CmtGetLock(g_history.lock);
+    HistoryChannelData *data = &g_history.channels[channel];
+    int total = History_SampleCount(data);
+    if (total > 0) {
+        HistorySegment *segment = History_SampleSegment(data, total - 1);
+        if (timestamp) {
+            *timestamp = segment->times[segment->count - 1];
+        }
+        *value = segment->values[segment->count - 1];
+        result = SUCCESS;
+    }
+    CmtReleaseLock(g_history.lock);
+
+    return result;
+}
+
+int History_Count(int channel, double startTime, double endTime) {
+    if (channel < 0 || channel >= HISTORY_CHANNEL_COUNT) {
+        return ERR_INVALID_PARAMETER;
+    }
+    if (!g_history.initialized) {
+        return ERR_NOT_INITIALIZED;
+    }
+
+    CmtGetLock(g_history.lock);
+    HistoryChannelData *data = &g_history.channels[channel];
+    int first = History_LowerBound(data, startTime, true);
+    int end = History_LowerBound(data, endTime, false);
+    CmtReleaseLock(g_history.lock);
+
+    return MAX(0, end - first);
+}
+
+int History_GetRange(int channel, double startTime, double endTime,
+                     double *times, double *values, int maxSamples) {
+    if (!values) {
+        return ERR_NULL_POINTER;
+    }
+    if (channel < 0 || channel >= HISTORY_CHANNEL_COUNT || maxSamples < 0) {
+        return ERR_INVALID_PARAMETER;
+    }
+    if (!g_history.initialized) {
+        return ERR_NOT_INITIALIZED;
+    }
+
+    CmtGetLock(g_history.lock);
+    HistoryChannelData *data = &g_history.channels[channel];
+    int sample = History_LowerBound(data, startTime, true);
+    int end = History_LowerBound(data, endTime, false);
+    int copied = 0;
+
+    // Copy a segment run at a time
+    while (sample < end && copied < maxSamples) {
+        HistorySegment *segment = History_SampleSegment(data, sample);
+        int slot = sample % HISTORY_SEGMENT_SAMPLES;
+        int run = MIN(MIN(segment->count - slot, end - sample), maxSamples - copied);
+
+        if (times) {
+            memcpy(&times[copied], &segment->times[slot], run * sizeof(double));
+        }
+        memcpy(&values[copied], &segment->values[slot], run * sizeof(double));
+        copied += run;
+        sample += run;
+    }
+    CmtReleaseLock(g_history.lock);
+
+    return copied;
+}
+
+int History_GetBuckets(int channel, double startTime, double bucketSeconds,
+                       HistoryBucket *buckets, int bucketCount) {
+    if (!buckets) {
+        return ERR_NULL_POINTER;
+    }
+    if (channel < 0 || channel >= HISTORY_CHANNEL_COUNT || bucketSeconds <= 0.0 || bucketCount <= 0) {
+        return ERR_INVALID_PARAMETER;
+    }
+    if (!g_history.initialized) {
+        return ERR_NOT_INITIALIZED;
+    }
+
+    memset(buckets, 0, bucketCount * sizeof(HistoryBucket));
+    double endTime = startTime + bucketCount * bucketSeconds;
+    int summarized = 0;
+
+    CmtGetLock(g_history.lock);
+    HistoryChannelData *data = &g_history.channels[channel];
+    int sample = History_LowerBound(data, startTime, true);
+    int end = History_LowerBound(data, endTime, true);
+
+    while (sample < end) {
+        HistorySegment *segment = History_SampleSegment(data, sample);
+        int slot = sample % HISTORY_SEGMENT_SAMPLES;
+        int bucket = MIN((int)((segment->times[slot] - startTime) / bucketSeconds), bucketCount - 1);
+        HistoryBucket *target = &buckets[bucket];
+
+        // Whole segment inside one bucket - use its summary
+        int lastSlot = segment->count - 1;
+        if (slot == 0 && sample + segment->count <= end &&
+            MIN((int)((segment->times[lastSlot] - startTime) / bucketSeconds), bucketCount - 1) == bucket) {
+            if (target->count == 0) {
+                target->min = segment->minValue;
+                target->max = segment->maxValue;
+            } else {
+                target->min = MIN(target->min, segment->minValue);
+                target->max = MAX(target->max, segment->maxValue);
+            }
+            target->count += segment->count;
+            target->mean += segment->sum;       // Sum until the end
+            summarized += segment->count;
+            sample += segment->count;
+            continue;
+        }
+
+        double value = segment->values[slot];
+        if (target->count == 0) {
+            target->min = value;
+            target->max = value;
+        } else {
+            target->min = MIN(target->min, value);
+            target->max = MAX(target->max, value);
+        }
+        target->count++;
+        target->mean += value;
+        summarized++;
+        sample++;
+    }
+    CmtReleaseLock(g_history.lock);
+
+    for (int i = 0; i < bucketCount; i++) {
+        if (buckets[i].count > 0) {
+            buckets[i].mean /= buckets[i].count;
+        }
+    }
+
+    return summarized;
+}
+
+int History_GetPosition(int channel) {
+    if (channel < 0 || channel >= HISTORY_CHANNEL_COUNT) {
+        return ERR_INVALID_PARAMETER;
+    }
+    if (!g_history.initialized) {
+        return ERR_NOT_INITIALIZED;
+    }
+
+    CmtGetLock(g_history.lock);
+    int position = g_history.channels[channel].added;
+    CmtReleaseLock(g_history.lock);
+
+    return position;
+}
+
+int History_SummarizeSince(int channel, int *position, HistoryBucket *summary, double *lastValue) {
+    if (!position || !summary) {
+        return ERR_NULL_POINTER;
+    }
+    if (channel < 0 || channel >= HISTORY_CHANNEL_COUNT) {
+        return ERR_INVALID_PARAMETER;
+    }
+    if (!g_history.initialized) {
+        return ERR_NOT_INITIALIZED;
+    }
+
+    memset(summary, 0, sizeof(HistoryBucket));
+
+    CmtGetLock(g_history.lock);
+    HistoryChannelData *data = &g_history.channels[channel];
+    int end = History_SampleCount(data);
+    int oldest = data->added - end;
+    int sample = MAX(*position - oldest, 0);
+    int first = sample;
+
+    while (sample < end) {
+        HistorySegment *segment = History_SampleSegment(data, sample);
+        int slot = sample % HISTORY_SEGMENT_SAMPLES;
+        double minValue, maxValue, sum;
+        int run;
+
+        // Whole segment - use its summary
+        if (slot == 0) {
+            run = segment->count;
+            minValue = segment->minValue;
+            maxValue = segment->maxValue;
+            sum = segment->sum;
+        } else {
+            run = segment->count - slot;
+            minValue = maxValue = segment->values[slot];
+            sum = 0.0;
+            for (int i = slot; i < segment->count; i++) {
+                minValue = MIN(minValue, segment->values[i]);
+                maxValue = MAX(maxValue, segment->values[i]);
+                sum += segment->values[i];
+            }
+        }
+
+        summary->min = (summary->count == 0) ? minValue : MIN(summary->min, minValue);
+        summary->max = (summary->count == 0) ? maxValue : MAX(summary->max, maxValue);
+        summary->count += run;
+        summary->mean += sum;           // Sum until the end
+        sample += run;
+    }
+
+    if (end > first && lastValue) {
+        HistorySegment *segment = History_SampleSegment(data, end - 1);
+        *lastValue = segment->values[segment->count - 1];
+    }
+    *position = data->added;
+    CmtReleaseLock(g_history.lock);
+
+    if (summary->count > 0) {
+        summary->mean /= summary->count;
+    }
+    return summary->count;
+}
+
+const char* History_GetChannelName(int channel) {
+    static const char *names[] = {
+        "PSB Voltage", "PSB Current", "PSB Power", "TC0", "TC1", "BioLogic Ewe"
+    };
+    static const char *dtbNames[] = {"DTB%d Temperature", "DTB%d Setpoint"};
+    static char dtbName[HISTORY_CHANNEL_COUNT][32];
+
+    if (channel >= 0 && channel < HISTORY_CHANNEL_DTB_BASE) {
+        return names[channel];
+    }
+    if (channel >= HISTORY_CHANNEL_DTB_BASE && channel < HISTORY_CHANNEL_COUNT) {
+        int dtbChannel = channel - HISTORY_CHANNEL_DTB_BASE;
+        snprintf(dtbName[channel], sizeof(dtbName[channel]), dtbNames[dtbChannel % 2], dtbChannel / 2 + 1);
+        return dtbName[channel];
+    }
+    return "Unknown";
+}
+
+/******************************************************************************
+ * Internal Functions
+ ******************************************************************************/
+
+static void History_TelemetryCallback(const TelemetrySnapshot *snapshot, void *userData) {
+    if (snapshot->source == TELEMETRY_SOURCE_PSB) {
+        History_Add(HISTORY_CHANNEL_PSB_VOLTAGE, snapshot->timestamp, snapshot->data.psb.voltage);
+        History_Add(HISTORY_CHANNEL_PSB_CURRENT, snapshot->timestamp, snapshot->data.psb.current);
+        History_Add(HISTORY_CHANNEL_PSB_POWER, snapshot->timestamp, snapshot->data.psb.power);
+        return;
+    }
+
+    DTBQueueManager *dtbMgr = DTB_GetGlobalQueueManager();
+    DTBDeviceContext *ctx = dtbMgr ? (DTBDeviceContext*)DeviceQueue_GetDeviceContext(dtbMgr) : NULL;
+    if (!ctx) {
+        return;
+    }
+
+    for (int i = 0; i < ctx->numDevices && i < DTB_NUM_DEVICES; i++) {
+        if (ctx->slaveAddresses[i] == snapshot->slaveAddress) {
+            History_Add(HISTORY_CHANNEL_DTB_PV(i), snapshot->timestamp, snapshot->data.dtb.processValue);
+            History_Add(HISTORY_CHANNEL_DTB_SP(i), snapshot->timestamp, snapshot->data.dtb.setPoint);
+            return;
+        }
+    }
+}
+
+// Caller holds g_history.lock for all of the following
+
+static int History_SampleCount(const HistoryChannelData *data) {
+    if (data->segmentCount == 0) {
+        return 0;
+    }
+    const HistorySegment *newest =
+        &data->segments[(data->firstSegment + data->segmentCount - 1) % HISTORY_SEGMENTS_PER_CHANNEL];
+    return (data->segmentCount - 1) * HISTORY_SEGMENT_SAMPLES + newest->count;
+}
+
+// Sample numbers count from the oldest stored sample
+static HistorySegment* History_SampleSegment(const HistoryChannelData *data, int sample) {
+    int segment = (data->firstSegment + sample / HISTORY_SEGMENT_SAMPLES) % HISTORY_SEGMENTS_PER_CHANNEL;
+    return &data->segments[segment];
+}
+
+static double History_SampleTime(const HistoryChannelData *data, int sample) {
+    return History_SampleSegment(data, sample)->times[sample % HISTORY_SEGMENT_SAMPLES];
+}
+
+// First sample at or after time (inclusive) or after time (not inclusive)
+static int History_LowerBound(const HistoryChannelData *data, double time, bool inclusive) {
+    int low = 0;
+    int high = History_SampleCount(data);
+
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        double sampleTime = History_SampleTime(data, mid);
+        if (inclusive ? (sampleTime < time) : (sampleTime <= time)) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
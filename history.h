@@ -0,0 +1,148 @@
+/******************************************************************************
+ * history.h
+ *
+ * Telemetry History Module Header
+ * Keeps a time series of every device reading in memory so graphs, checks and
+ * the command prompt can look back without asking the hardware again
+ ******************************************************************************/
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "common.h"
+
+/******************************************************************************
+ * Configuration Constants
+ ******************************************************************************/
+#define HISTORY_SEGMENT_SAMPLES         512     // Samples per segment
+#define HISTORY_SEGMENTS_PER_CHANNEL    128     // Oldest segment is dropped when full
+#define HISTORY_CHANNEL_CAPACITY        (HISTORY_SEGMENT_SAMPLES * HISTORY_SEGMENTS_PER_CHANNEL)
+
+/******************************************************************************
+ * Type Definitions
+ ******************************************************************************/
+
+typedef enum {
+    HISTORY_CHANNEL_PSB_VOLTAGE = 0,
+    HISTORY_CHANNEL_PSB_CURRENT,
+    HISTORY_CHANNEL_PSB_POWER,
+    HISTORY_CHANNEL_TC0,
+    HISTORY_CHANNEL_TC1,
+    HISTORY_CHANNEL_BIO_EWE,
+    HISTORY_CHANNEL_DTB_BASE            // Process value and set point of each DTB follow
+} HistoryChannel;
+
+// DTB channels by index in the DTB device context
+#define HISTORY_CHANNEL_DTB_PV(index)   (HISTORY_CHANNEL_DTB_BASE + 2 * (index))
+#define HISTORY_CHANNEL_DTB_SP(index)   (HISTORY_CHANNEL_DTB_BASE + 2 * (index) + 1)
+#define HISTORY_CHANNEL_COUNT           (HISTORY_CHANNEL_DTB_BASE + 2 * DTB_NUM_DEVICES)
+
+// Summary of the samples in one time bucket
+typedef struct {
+    int count;                  // 0 if the bucket holds no samples
+    double min;
+    double max;
+    double mean;
+} HistoryBucket;
+
+/******************************************************************************
+ * Public Function Declarations
+ ******************************************************************************/
+
+/**
+ * Allocate the channel storage and start recording telemetry readings.
+ * Call after Telemetry_Initialize.
+ * @return SUCCESS or error code
+ */
+int History_Initialize(void);
+
+/**
+ * Stop recording and free all stored samples
+ */
+void History_Cleanup(void);
+
+/**
+ * Record one sample. Timestamps are GetTimestamp() seconds; a sample older
+ * than the newest one of its channel is stored at the newest one's time.
+ * @param channel - Channel to add to
+ * @param timestamp - When the value was measured
+ * @param value - Measured value
+ * @return SUCCESS or error code
+ */
+int History_Add(int channel, double timestamp, double value);
+
+/**
+ * Get the newest sample of a channel
+ * @param channel - Channel to read
+ * @param timestamp - Receives the sample time, may be NULL
+ * @param value - Receives the value
+ * @return SUCCESS, or ERR_NOT_INITIALIZED if the channel is empty
+ */
+int History_GetLatest(int channel, double *timestamp, double *value);
+
+/**
+ * Count the samples of a channel in [startTime, endTime]
+ * @param channel - Channel to read
+ * @param startTime - Start of the window (inclusive)
+ * @param endTime - End of the window (inclusive)
+ * @return Number of samples, or error code
+ */
+int History_Count(int channel, double startTime, double endTime);
+
+/**
+ * Copy the samples of a channel in [startTime, endTime], oldest first
+ * @param channel - Channel to read
+ * @param startTime - Start of the window (inclusive)
+ * @param endTime - End of the window (inclusive)
+ * @param times - Receives the sample times, may be NULL
+ * @param values - Receives the values
+ * @param maxSamples - Size of the arrays; later samples are left out
+ * @return Number of samples copied, or error code
+ */
+int History_GetRange(int channel, double startTime, double endTime,
+                     double *times, double *values, int maxSamples);
+
+/**
+ * Summarize a channel in equal time buckets starting at startTime.
+ * Segments that fall inside one bucket are summarized without visiting
+ * their samples.
+ * @param channel - Channel to read
+ * @param startTime - Start of the first bucket
+ * @param bucketSeconds - Bucket length, buckets[i] covers
+ *                        [startTime + i * bucketSeconds, startTime + (i + 1) * bucketSeconds)
+ * @param buckets - Receives the summaries
+ * @param bucketCount - Number of buckets
+ * @return Number of samples summarized, or error code
+ */
+int History_GetBuckets(int channel, double startTime, double bucketSeconds,
+                       HistoryBucket *buckets, int bucketCount);
+
+/**
+ * Get the number of samples ever added to a channel, the position a reader
+ * of History_SummarizeSince starts from to see only new samples
+ * @param channel - Channel
+ * @return Sample count, or error code
+ */
+int History_GetPosition(int channel);
+
+/**
+ * Summarize the samples added to a channel since a position, in the order
+ * they were added. Unlike a time window this covers every sample exactly
+ * once, also those stamped before the previous call. Samples dropped from
+ * the history before the call are skipped.
+ * @param channel - Channel to read
+ * @param position - Samples added before the first one to summarize,
+ *                   advanced past the samples summarized
+ * @param summary - Receives the count, min, max and mean
+ * @param lastValue - Receives the newest summarized value, may be NULL
+ * @return Number of samples summarized, or error code
+ */
+int History_SummarizeSince(int channel, int *position, HistoryBucket *summary, double *lastValue);
+
+/**
+ * Get a channel's display name, e.g. "PSB Voltage"
+ * @param channel - Channel
+ * @return Name, "Unknown" for an invalid channel
+ */
+const char* History_GetChannelName(int channel);
+
+#endif // HISTORY_H
@@ -0,0 +1,885 @@
+/******************************************************************************
+ * ipc_server.c
+ *
+ * Local IPC Server Module Implementation
+ * One thread accepts pipe clients and hands each to its own client thread,
+ * which reads request lines and answers them in order; prompt commands run
+ * on that thread through CmdPrompt_Execute, so a slow device only holds up
+ * the client that asked. One publisher thread serves every stream: when a
+ * stream is due it summarizes the samples the history store received since
+ * the last interval and writes the same line to each subscribed client.
+ ******************************************************************************/
+
+#include "common.h"
+#include "ipc_server.h"
+#include "cmd_prompt.h"
+#include "history.h"
+#include "logging.h"
+#include "device_queue.h"
+#include "psb10000_queue.h"
+#include "biologic_queue.h"
+#include "dtb4848_queue.h"
+#include "teensy_queue.h"
+
+/******************************************************************************
+ * Module Variables
+ ******************************************************************************/
+
+typedef struct {
+    int inUse;
+    HANDLE pipe;                    // NULL once the client is closed
+    HANDLE readEvent;               // Overlapped reads
+    HANDLE writeEvent;              // Overlapped writes
+    HANDLE closeEvent;              // Set when a write fails, ends the client thread
+    CmtThreadLockHandle writeLock;  // Keeps replies and stream lines whole
+    CmtThreadFunctionID threadId;
+    unsigned int generation;        // Connection number of the slot, changed under both locks
+} IPCClient;
+
+typedef struct {
+    int inUse;
+    int id;                         // Stream number sent to clients
+    int channel;
+    int intervalMs;
+    unsigned int clients;           // Bit per client slot
+    int position;                   // History position of the next sample to summarize
+    double nextTime;                // When the next summary is due
+} IPCStream;
+
+// A stream summary taken under the lock, sent after it is released
+typedef struct {
+    unsigned int clients;
+    unsigned int generations[IPC_SERVER_MAX_CLIENTS];  // Connection each client bit was for
+    char line[MEDIUM_BUFFER_SIZE];
+} IPCStreamLine;
+
+// Lines a command printed, as the contents of two JSON arrays
+typedef struct {
+    char output[IPC_SERVER_MAX_RESPONSE_LEN / 2];
+    int outputLength;
+    char errors[IPC_SERVER_MAX_RESPONSE_LEN / 2];
+    int errorsLength;
+    int errorCount;
+} IPCCommandOutput;
+
+static struct {
+    volatile int running;
+    CmtThreadLockHandle lock;       // Guards client slots and streams
+    HANDLE stopEvent;               // Manual reset, ends every server thread
+    HANDLE wakeEvent;               // A stream was added
+    CmtThreadPoolHandle pool;
+    CmtThreadFunctionID acceptThreadId;
+    CmtThreadFunctionID publishThreadId;
+
+    IPCClient clients[IPC_SERVER_MAX_CLIENTS];
+    IPCStream streams[IPC_SERVER_MAX_STREAMS];
+    int nextStreamId;
+} g_ipc = {0};
+
+/******************************************************************************
+ * Internal Function Prototypes
+ ******************************************************************************/
+
+static void IPCServer_FreeResources(void);
+static int CVICALLBACK IPCServer_AcceptThread(void *functionData);
+static int CVICALLBACK IPCServer_ClientThread(void *functionData);
+static int CVICALLBACK IPCServer_PublishThread(void *functionData);
+static void IPCServer_AddClient(HANDLE pipe);
+static void IPCServer_CloseClient(IPCClient *client);
+static int IPCServer_Write(IPCClient *client, unsigned int generation, const char *line);
+static bool IPCServer_FormatStream(IPCStream *stream, double now, IPCStreamLine *pending);
+
+static void IPCServer_HandleRequest(IPCClient *client, char *line);
+static void IPCServer_HandleCommand(IPCClient *client, int id, const char *request);
+static void IPCServer_HandleStats(IPCClient *client, int id, const char *request);
+static void IPCServer_HandleChannels(IPCClient *client, int id);
+static void IPCServer_HandleSubscribe(IPCClient *client, int id, const char *request);
+static void IPCServer_HandleUnsubscribe(IPCClient *client, int id, const char *request);
+static void IPCServer_ReplyError(IPCClient *client, int id, const char *message);
+static void IPCServer_CommandOutput(enum Status status, const char *message, void *userData);
+
+static int IPCServer_JsonGetString(const char *json, const char *key, char *value, int valueSize);
+static int IPCServer_JsonGetNumber(const char *json, const char *key, double *value);
+static const char* IPCServer_JsonFindValue(const char *json, const char *key);
+static int IPCServer_JsonEscape(const char *text, char *buffer, int bufferSize);
+static void IPCServer_JsonAppendString(char *buffer, int bufferSize, int *length, const char *text);
+
+/******************************************************************************
+ * Public Interface Implementation
+ ******************************************************************************/
+
+int IPCServer_Start(void) {
+    if (g_ipc.running) {
+        return SUCCESS;
+    }
+
+    memset(&g_ipc, 0, sizeof(g_ipc));
+
+    if (CmtNewLock(NULL, 0, &g_ipc.lock) < 0) {
+        LogError("Failed to create IPC server lock");
+        return ERR_THREAD_SYNC;
+    }
+
+    g_ipc.stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    g_ipc.wakeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    bool created = g_ipc.stopEvent && g_ipc.wakeEvent;
+
+    for (int i = 0; i < IPC_SERVER_MAX_CLIENTS && created; i++) {
+        IPCClient *client = &g_ipc.clients[i];
+        client->readEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        client->writeEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        client->closeEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        created = client->readEvent && client->writeEvent && client->closeEvent &&
+                  CmtNewLock(NULL, 0, &client->writeLock) >= 0;
+    }
+    if (!created) {
+        LogError("Failed to create IPC server events");
+        IPCServer_FreeResources();
+        return ERR_THREAD_SYNC;
+    }
+
+    // Accept and publish threads plus one thread per client
+    if (CmtNewThreadPool(IPC_SERVER_MAX_CLIENTS + 2, &g_ipc.pool) < 0) {
+        LogError("Failed to create IPC server thread pool");
+        IPCServer_FreeResources();
+        return ERR_THREAD_POOL;
+    }
+
+    g_ipc.running = 1;
+
+    if (CmtScheduleThreadPoolFunction(g_ipc.pool, IPCServer_AcceptThread, NULL, &g_ipc.acceptThreadId) < 0 ||
+        CmtScheduleThreadPoolFunction(g_ipc.pool, IPCServer_PublishThread, NULL, &g_ipc.publishThreadId) < 0) {
+        LogError("Failed to start IPC server threads");
+        IPCServer_Stop();
+        return ERR_THREAD_CREATE;
+    }
+
+    LogMessage("IPC server listening on %s", IPC_SERVER_PIPE_NAME);
+    return SUCCESS;
+}
+
+void IPCServer_Stop(void) {
+    if (!g_ipc.running) {
+        return;
+    }
+
+    g_ipc.running = 0;
+    SetEvent(g_ipc.stopEvent);
+
+    // Client threads finish the request they are running, then see the stop event
+    if (g_ipc.acceptThreadId) {
+        CmtWaitForThreadPoolFunctionCompletion(g_ipc.pool, g_ipc.acceptThreadId,
+                                               OPT_TP_PROCESS_EVENTS_WHILE_WAITING);
+    }
+    if (g_ipc.publishThreadId) {
+        CmtWaitForThreadPoolFunctionCompletion(g_ipc.pool, g_ipc.publishThreadId,
+                                               OPT_TP_PROCESS_EVENTS_WHILE_WAITING);
+    }
+    for (int i = 0; i < IPC_SERVER_MAX_CLIENTS; i++) {
+        if (g_ipc.clients[i].threadId) {
+            CmtWaitForThreadPoolFunctionCompletion(g_ipc.pool, g_ipc.clients[i].threadId,
+                                                   OPT_TP_PROCESS_EVENTS_WHILE_WAITING);
+            CmtReleaseThreadPoolFunctionID(g_ipc.pool, g_ipc.clients[i].threadId);
+            g_ipc.clients[i].threadId = 0;
+        }
+    }
+
+    IPCServer_FreeResources();
+    LogMessage("IPC server stopped");
+}
+
+int IPCServer_IsRunning(void) {
+    return g_ipc.running;
+}
+
+/******************************************************************************
+ * Server Threads
+ ******************************************************************************/
+
+static void IPCServer_FreeResources(void) {
+    if (g_ipc.pool) {
+        CmtDiscardThreadPool(g_ipc.pool);
+        g_ipc.pool = 0;
+    }
+
+    for (int i = 0; i < IPC_SERVER_MAX_CLIENTS; i++) {
+        IPCClient *client = &g_ipc.clients[i];
+        if (client->readEvent) CloseHandle(client->readEvent);
+        if (client->writeEvent) CloseHandle(client->writeEvent);
+        if (client->closeEvent) CloseHandle(client->closeEvent);
+        if (client->writeLock) CmtDiscardLock(client->writeLock);
+        memset(client, 0, sizeof(IPCClient));
+    }
+
+    if (g_ipc.stopEvent) {
+        CloseHandle(g_ipc.stopEvent);
+        g_ipc.stopEvent = NULL;
+    }
+    if (g_ipc.wakeEvent) {
+        CloseHandle(g_ipc.wakeEvent);
+        g_ipc.wakeEvent = NULL;
+    }
+    if (g_ipc.lock) {
+        CmtDiscardLock(g_ipc.lock);
+        g_ipc.lock = 0;
+    }
+}
+
+static int CVICALLBACK IPCServer_AcceptThread(void *functionData) {
+    HANDLE connectEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    HANDLE events[2] = {connectEvent, g_ipc.stopEvent};
+    bool first = true;
+
+    while (WaitForSingleObject(g_ipc.stopEvent, 0) != WAIT_OBJECT_0) {
+        // Local clients only, one pipe instance per client. The first must be
+        // the pipe's first instance, so another process cannot own the name.
+        DWORD openMode = PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0);
+        HANDLE pipe = CreateNamedPipe(IPC_SERVER_PIPE_NAME, openMode,
+                                      PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                                      PIPE_UNLIMITED_INSTANCES, IPC_SERVER_MAX_RESPONSE_LEN,
+                                      IPC_SERVER_MAX_LINE_LEN, 0, NULL);
+        if (pipe == INVALID_HANDLE_VALUE) {
+            DWORD error = GetLastError();
+            if (first && error == ERROR_ACCESS_DENIED) {
+                LogError("IPC pipe %s is already in use by another process, IPC server not accepting clients",
+                         IPC_SERVER_PIPE_NAME);
+                break;
+            }
+            LogError("Failed to create IPC pipe %s (error %lu)", IPC_SERVER_PIPE_NAME, error);
+            WaitForSingleObject(g_ipc.stopEvent, 1000);
+            continue;
+        }
+        first = false;
+
+        OVERLAPPED overlapped = {0};
+        overlapped.hEvent = connectEvent;
+        DWORD unused = 0;
+        BOOL connected = ConnectNamedPipe(pipe, &overlapped);
+
+        if (!connected) {
+            DWORD error = GetLastError();
+            if (error == ERROR_PIPE_CONNECTED) {
+                connected = TRUE;
+            } else if (error == ERROR_IO_PENDING) {
+                if (WaitForMultipleObjects(2, events, FALSE, INFINITE) == WAIT_OBJECT_0) {
+                    connected = GetOverlappedResult(pipe, &overlapped, &unused, FALSE);
+                } else {
+                    CancelIo(pipe);
+                    GetOverlappedResult(pipe, &overlapped, &unused, TRUE);
+                }
+            }
+        }
+
+        if (connected) {
+            IPCServer_AddClient(pipe);
+        } else {
+            CloseHandle(pipe);
+        }
+    }
+
+    CloseHandle(connectEvent);
+    return 0;
+}
+
+static void IPCServer_AddClient(HANDLE pipe) {
+    IPCClient *client = NULL;
+
+    CmtGetLock(g_ipc.lock);
+    for (int i = 0; i < IPC_SERVER_MAX_CLIENTS && !client; i++) {
+        if (!g_ipc.clients[i].inUse) {
+            client = &g_ipc.clients[i];
+        }
+    }
+    if (client) {
+        client->inUse = 1;
+        CmtGetLock(client->writeLock);
+        client->pipe = pipe;
+        client->generation++;
+        CmtReleaseLock(client->writeLock);
+        ResetEvent(client->closeEvent);
+    }
+    CmtReleaseLock(g_ipc.lock);
+
+    if (!client) {
+        LogWarning("IPC client refused, %d clients already connected", IPC_SERVER_MAX_CLIENTS);
+        DisconnectNamedPipe(pipe);
+        CloseHandle(pipe);
+        return;
+    }
+
+    // The slot's previous thread has closed its client, let it return
+    if (client->threadId) {
+        CmtWaitForThreadPoolFunctionCompletion(g_ipc.pool, client->threadId, 0);
+        CmtReleaseThreadPoolFunctionID(g_ipc.pool, client->threadId);
+        client->threadId = 0;
+    }
+
+    if (CmtScheduleThreadPoolFunction(g_ipc.pool, IPCServer_ClientThread, client, &client->threadId) < 0) {
+        LogError("Failed to start IPC client thread");
+        client->threadId = 0;
+        IPCServer_CloseClient(client);
+        return;
+    }
+
+    LogMessage("IPC client %d connected", (int)(client - g_ipc.clients));
+}
+
+static int CVICALLBACK IPCServer_ClientThread(void *functionData) {
+    IPCClient *client = (IPCClient*)functionData;
+    HANDLE events[3] = {client->readEvent, g_ipc.stopEvent, client->closeEvent};
+    char buffer[IPC_SERVER_MAX_LINE_LEN + 1];
+    int length = 0;
+
+    DeviceQueue_SetThreadName("IPC Client");
+
+    while (1) {
+        OVERLAPPED overlapped = {0};
+        overlapped.hEvent = client->readEvent;
+        DWORD received = 0;
+
+        BOOL ok = ReadFile(client->pipe, buffer + length, IPC_SERVER_MAX_LINE_LEN - length, &received, &overlapped);
+        if (!ok && GetLastError() == ERROR_IO_PENDING) {
+            if (WaitForMultipleObjects(3, events, FALSE, INFINITE) != WAIT_OBJECT_0) {
+                CancelIo(client->pipe);
+                GetOverlappedResult(client->pipe, &overlapped, &received, TRUE);
+                break;
+            }
+            ok = GetOverlappedResult(client->pipe, &overlapped, &received, FALSE);
+        }
+        if (!ok || received == 0) {
+            break;      // Client closed its end
+        }
+
+        length += received;
+        buffer[length] = '\0';
+
+        // Answer every complete line, keep the partial one
+        char *start = buffer;
+        char *newline;
+        while ((newline = strchr(start, '\n')) != NULL) {
+            *newline = '\0';
+            IPCServer_HandleRequest(client, start);
+            start = newline + 1;
+        }
+        length -= (int)(start - buffer);
+        memmove(buffer, start, length);
+
+        if (length >= IPC_SERVER_MAX_LINE_LEN) {
+            IPCServer_ReplyError(client, 0, "Request too long");
+            break;
+        }
+    }
+
+    IPCServer_CloseClient(client);
+    DeviceQueue_ClearThreadName();
+    return 0;
+}
+
+static void IPCServer_CloseClient(IPCClient *client) {
+    unsigned int bit = 1u << (client - g_ipc.clients);
+
+    CmtGetLock(g_ipc.lock);
+
+    for (int i = 0; i < IPC_SERVER_MAX_STREAMS; i++) {
+        IPCStream *stream = &g_ipc.streams[i];
+        stream->clients &= ~bit;
+        if (stream->inUse && stream->clients == 0) {
+            stream->inUse = 0;
+        }
+    }
+
+    CmtGetLock(client->writeLock);
+    DisconnectNamedPipe(client->pipe);
+    CloseHandle(client->pipe);
+    client->pipe = NULL;
+    CmtReleaseLock(client->writeLock);
+
+    client->inUse = 0;
+    CmtReleaseLock(g_ipc.lock);
+
+    LogMessage("IPC client %d disconnected", (int)(client - g_ipc.clients));
+}
+
+// Write one whole line to the given connection of the client slot; a line
+// for an earlier connection of a reused slot is dropped. A client that does
+// not take it within the write timeout is closed, so one stalled reader
+// cannot hold up the streams.
+static int IPCServer_Write(IPCClient *client, unsigned int generation, const char *line) {
+    int result = SUCCESS;
+    DWORD length = (DWORD)strlen(line);
+    DWORD written = 0;
+
+    CmtGetLock(client->writeLock);
+
+    if (!client->pipe || client->generation != generation ||
+        WaitForSingleObject(client->closeEvent, 0) == WAIT_OBJECT_0) {
+        CmtReleaseLock(client->writeLock);
+        return ERR_NOT_CONNECTED;
+    }
+
+    OVERLAPPED overlapped = {0};
+    overlapped.hEvent = client->writeEvent;
+
+    BOOL ok = WriteFile(client->pipe, line, length, &written, &overlapped);
+    if (!ok && GetLastError() == ERROR_IO_PENDING) {
+        if (WaitForSingleObject(client->writeEvent, IPC_SERVER_WRITE_TIMEOUT_MS) == WAIT_OBJECT_0) {
+            ok = GetOverlappedResult(client->pipe, &overlapped, &written, FALSE);
+        } else {
+            CancelIo(client->pipe);
+            GetOverlappedResult(client->pipe, &overlapped, &written, TRUE);
+            ok = FALSE;
+        }
+    }
+
+    if (!ok || written != length) {
+        SetEvent(client->closeEvent);
+        result = ERR_COMM_FAILED;
+    }
+
+    CmtReleaseLock(client->writeLock);
+    return result;
+}
+
+static int CVICALLBACK IPCServer_PublishThread(void *functionData) {
+    HANDLE events[2] = {g_ipc.stopEvent, g_ipc.wakeEvent};
+    static IPCStreamLine pending[IPC_SERVER_MAX_STREAMS];   // Publish thread only
+
+    while (1) {
+        double now = GetTimestamp();
+        double nextDue = now + 1.0;
+        int pendingCount = 0;
+
+        CmtGetLock(g_ipc.lock);
+        for (int i = 0; i < IPC_SERVER_MAX_STREAMS; i++) {
+            IPCStream *stream = &g_ipc.streams[i];
+            if (!stream->inUse) {
+                continue;
+            }
+            if (now >= stream->nextTime) {
+                if (IPCServer_FormatStream(stream, now, &pending[pendingCount])) {
+                    pendingCount++;
+                }
+
+                // Keep the cadence, but do not catch up on missed intervals
+                stream->nextTime += stream->intervalMs / 1000.0;
+                if (stream->nextTime <= now) {
+                    stream->nextTime = now + stream->intervalMs / 1000.0;
+                }
+            }
+            nextDue = MIN(nextDue, stream->nextTime);
+        }
+        CmtReleaseLock(g_ipc.lock);
+
+        // Write outside the lock, so a slow client holds up only the streams,
+        // not requests, subscriptions or disconnects. A client closed or
+        // replaced since the lock was released is skipped by IPCServer_Write.
+        for (int i = 0; i < pendingCount; i++) {
+            for (int j = 0; j < IPC_SERVER_MAX_CLIENTS; j++) {
+                if (pending[i].clients & (1u << j)) {
+                    IPCServer_Write(&g_ipc.clients[j], pending[i].generations[j], pending[i].line);
+                }
+            }
+        }
+
+        DWORD waitMs = (DWORD)MAX(0.0, (nextDue - GetTimestamp()) * 1000.0);
+        if (WaitForMultipleObjects(2, events, FALSE, waitMs) == WAIT_OBJECT_0) {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+// Caller holds g_ipc.lock. Summarize the samples added since the last
+// interval once, for the line and subscribers in pending; quiet intervals
+// give no line. Progress is kept by history position rather than time, so
+// samples stamped before the last interval ended are still counted once.
+static bool IPCServer_FormatStream(IPCStream *stream, double now, IPCStreamLine *pending) {
+    HistoryBucket bucket = {0};
+    double lastValue = 0.0;
+
+    int count = History_SummarizeSince(stream->channel, &stream->position, &bucket, &lastValue);
+    if (count <= 0) {
+        return false;
+    }
+
+    snprintf(pending->line, sizeof(pending->line),
+             "{\"stream\":%d,\"t\":%.3f,\"n\":%d,\"last\":%.6g,\"min\":%.6g,\"max\":%.6g,\"mean\":%.6g}\n",
+             stream->id, now, bucket.count, lastValue, bucket.min, bucket.max, bucket.mean);
+    pending->clients = stream->clients;
+    for (int j = 0; j < IPC_SERVER_MAX_CLIENTS; j++) {
+        pending->generations[j] = g_ipc.clients[j].generation;
+    }
+    return true;
+}
+
+/******************************************************************************
+ * Requests
+ ******************************************************************************/
+
+static void IPCServer_HandleRequest(IPCClient *client, char *line) {
+    char op[32];
+    double id = 0;
+
+    char *request = TrimWhitespace(line);
+    if (request[0] == '\0') {
+        return;
+    }
+
+    IPCServer_JsonGetNumber(request, "id", &id);
+
+    if (IPCServer_JsonGetString(request, "op", op, sizeof(op)) != SUCCESS) {
+        IPCServer_ReplyError(client, (int)id, "Missing op");
+    } else if (strcmp(op, "command") == 0) {
+        IPCServer_HandleCommand(client, (int)id, request);
+    } else if (strcmp(op, "stats") == 0) {
+        IPCServer_HandleStats(client, (int)id, request);
+    } else if (strcmp(op, "channels") == 0) {
+        IPCServer_HandleChannels(client, (int)id);
+    } else if (strcmp(op, "subscribe") == 0) {
+        IPCServer_HandleSubscribe(client, (int)id, request);
+    } else if (strcmp(op, "unsubscribe") == 0) {
+        IPCServer_HandleUnsubscribe(client, (int)id, request);
+    } else if (strcmp(op, "ping") == 0) {
+        char reply[SMALL_BUFFER_SIZE];
+        snprintf(reply, sizeof(reply), "{\"id\":%d,\"ok\":true}\n", (int)id);
+        IPCServer_Write(client, client->generation, reply);
+    } else {
+        IPCServer_ReplyError(client, (int)id, "Unknown op");
+    }
+}
+
+// Run a prompt command and return what it printed
+static void IPCServer_HandleCommand(IPCClient *client, int id, const char *request) {
+    char command[IPC_SERVER_MAX_LINE_LEN];
+
+    if (IPCServer_JsonGetString(request, "command", command, sizeof(command)) != SUCCESS) {
+        IPCServer_ReplyError(client, id, "Missing command");
+        return;
+    }
+
+    IPCCommandOutput *output = calloc(1, sizeof(IPCCommandOutput));
+    char *reply = malloc(IPC_SERVER_MAX_RESPONSE_LEN + SMALL_BUFFER_SIZE);
+    if (!output || !reply) {
+        free(output);
+        free(reply);
+        IPCServer_ReplyError(client, id, "Out of memory");
+        return;
+    }
+
+    int result = CmdPrompt_Execute(command, IPCServer_CommandOutput, output);
+    if (result != SUCCESS && output->errorCount == 0) {
+        output->errorCount++;
+        IPCServer_JsonAppendString(output->errors, sizeof(output->errors), &output->errorsLength,
+                                   GetErrorString(result));
+    }
+
+    snprintf(reply, IPC_SERVER_MAX_RESPONSE_LEN + SMALL_BUFFER_SIZE,
+             "{\"id\":%d,\"ok\":%s,\"output\":[%s],\"errors\":[%s]}\n",
+             id, output->errorCount == 0 ? "true" : "false", output->output, output->errors);
+    IPCServer_Write(client, client->generation, reply);
+
+    free(reply);
+    free(output);
+}
+
+static void IPCServer_CommandOutput(enum Status status, const char *message, void *userData) {
+    IPCCommandOutput *output = (IPCCommandOutput*)userData;
+
+    switch (status) {
+        case CMD_OUTPUT:
+            IPCServer_JsonAppendString(output->output, sizeof(output->output), &output->outputLength, message);
+            break;
+        case CMD_ERROR:
+            output->errorCount++;
+            IPCServer_JsonAppendString(output->errors, sizeof(output->errors), &output->errorsLength, message);
+            break;
+        default:
+            break;      // The client knows what it sent
+    }
+}
+
+static void IPCServer_HandleStats(IPCClient *client, int id, const char *request) {
+    char device[16];
+    DeviceQueueManager *mgr = NULL;
+    char reply[MEDIUM_BUFFER_SIZE * 4];
+
+    if (IPCServer_JsonGetString(request, "device", device, sizeof(device)) != SUCCESS) {
+        IPCServer_ReplyError(client, id, "Missing device");
+        return;
+    }
+
+    if (strcmp(device, "PSB") == 0) {
+        mgr = PSB_GetGlobalQueueManager();
+    } else if (strcmp(device, "DTB") == 0) {
+        mgr = DTB_GetGlobalQueueManager();
+    } else if (strcmp(device, "BIO") == 0) {
+        mgr = BIO_GetGlobalQueueManager();
+    } else if (strcmp(device, "TNY") == 0) {
+        mgr = TNY_GetGlobalQueueManager();
+    } else {
+        IPCServer_ReplyError(client, id, "Unknown device, use PSB, DTB, BIO or TNY");
+        return;
+    }
+
+    if (!mgr) {
+        IPCServer_ReplyError(client, id, "Queue manager not initialized");
+        return;
+    }
+
+    DeviceQueueStats stats;
+    DeviceQueue_GetStats(mgr, &stats);
+
+    snprintf(reply, sizeof(reply),
+             "{\"id\":%d,\"ok\":true,\"device\":\"%s\",\"connected\":%d,\"processing\":%d,"
+             "\"queued\":[%d,%d,%d,%d],\"high_water\":[%d,%d,%d,%d],"
+             "\"processed\":%d,\"errors\":%d,\"enqueue_retries\":%d,\"enqueue_failures\":%d,"
+             "\"evicted\":%d,\"offline_failures\":%d,\"reconnects\":%d,\"next_probe_ms\":%d}\n",
+             id, device, stats.isConnected, stats.isProcessing,
+             stats.highPriorityQueued, stats.normalPriorityQueued, stats.lowPriorityQueued, stats.deferredQueued,
+             stats.highPriorityHighWater, stats.normalPriorityHighWater, stats.lowPriorityHighWater,
+             stats.deferredHighWater, stats.totalProcessed, stats.totalErrors, stats.enqueueRetries,
+             stats.enqueueFailures, stats.evictedCommands, stats.offlineFailures, stats.reconnectCount,
+             stats.nextProbeInMs);
+    IPCServer_Write(client, client->generation, reply);
+}
+
+static void IPCServer_HandleChannels(IPCClient *client, int id) {
+    char reply[LARGE_BUFFER_SIZE];
+    char names[LARGE_BUFFER_SIZE];
+    int length = 0;
+
+    names[0] = '\0';
+    for (int i = 0; i < HISTORY_CHANNEL_COUNT; i++) {
+        IPCServer_JsonAppendString(names, sizeof(names), &length, History_GetChannelName(i));
+    }
+
+    snprintf(reply, sizeof(reply), "{\"id\":%d,\"ok\":true,\"channels\":[%s]}\n", id, names);
+    IPCServer_Write(client, client->generation, reply);
+}
+
+// Join the stream for this channel and interval, creating it if no client has
+static void IPCServer_HandleSubscribe(IPCClient *client, int id, const char *request) {
+    char name[64];
+    double number = 0;
+    double interval = 1000;
+    int channel = -1;
+    IPCStream *stream = NULL;
+    char reply[SMALL_BUFFER_SIZE];
+
+    // Channel by index or by name
+    if (IPCServer_JsonGetNumber(request, "channel", &number) == SUCCESS) {
+        channel = (int)number;
+    } else if (IPCServer_JsonGetString(request, "channel", name, sizeof(name)) == SUCCESS) {
+        for (int i = 0; i < HISTORY_CHANNEL_COUNT; i++) {
+            if (strcmp(name, History_GetChannelName(i)) == 0) {
+                channel = i;
+            }
+        }
+    }
+    if (channel < 0 || channel >= HISTORY_CHANNEL_COUNT) {
+        IPCServer_ReplyError(client, id, "Unknown channel");
+        return;
+    }
+
+    IPCServer_JsonGetNumber(request, "interval_ms", &interval);
+    int intervalMs = MAX((int)interval, IPC_SERVER_MIN_INTERVAL_MS);
+
+    CmtGetLock(g_ipc.lock);
+    for (int i = 0; i < IPC_SERVER_MAX_STREAMS && !stream; i++) {
+        if (g_ipc.streams[i].inUse && g_ipc.streams[i].channel == channel &&
+            g_ipc.streams[i].intervalMs == intervalMs) {
+            stream = &g_ipc.streams[i];
+        }
+    }
+    for (int i = 0; i < IPC_SERVER_MAX_STREAMS && !stream; i++) {
+        if (!g_ipc.streams[i].inUse) {
+            stream = &g_ipc.streams[i];
+            memset(stream, 0, sizeof(IPCStream));
+            stream->inUse = 1;
+            stream->id = ++g_ipc.nextStreamId;
+            stream->channel = channel;
+            stream->intervalMs = intervalMs;
+            stream->position = MAX(History_GetPosition(channel), 0);
+            stream->nextTime = GetTimestamp() + intervalMs / 1000.0;
+            SetEvent(g_ipc.wakeEvent);
+        }
+    }
+    if (stream) {
+        stream->clients |= 1u << (client - g_ipc.clients);
+        snprintf(reply, sizeof(reply), "{\"id\":%d,\"ok\":true,\"stream\":%d,\"interval_ms\":%d}\n",
+                 id, stream->id, intervalMs);
+    }
+    CmtReleaseLock(g_ipc.lock);
+
+    if (stream) {
+        IPCServer_Write(client, client->generation, reply);
+    } else {
+        IPCServer_ReplyError(client, id, "Too many streams");
+    }
+}
+
+static void IPCServer_HandleUnsubscribe(IPCClient *client, int id, const char *request) {
+    double number = 0;
+    bool found = false;
+    char reply[SMALL_BUFFER_SIZE];
+
+    if (IPCServer_JsonGetNumber(request, "stream", &number) != SUCCESS) {
+        IPCServer_ReplyError(client, id, "Missing stream");
+        return;
+    }
+
+    unsigned int bit = 1u << (client - g_ipc.clients);
+
+    CmtGetLock(g_ipc.lock);
+    for (int i = 0; i < IPC_SERVER_MAX_STREAMS; i++) {
+        IPCStream *stream = &g_ipc.streams[i];
+        if (stream->inUse && stream->id == (int)number && (stream->clients & bit)) {
+            stream->clients &= ~bit;
+            if (stream->clients == 0) {
+                stream->inUse = 0;
+            }
+            found = true;
+        }
+    }
+    CmtReleaseLock(g_ipc.lock);
+
+    if (!found) {
+        IPCServer_ReplyError(client, id, "Not subscribed to that stream");
+        return;
+    }
+
+    snprintf(reply, sizeof(reply), "{\"id\":%d,\"ok\":true}\n", id);
+    IPCServer_Write(client, client->generation, reply);
+}
+
+static void IPCServer_ReplyError(IPCClient *client, int id, const char *message) {
+    char escaped[MEDIUM_BUFFER_SIZE];
+    char reply[MEDIUM_BUFFER_SIZE + SMALL_BUFFER_SIZE];
+
+    IPCServer_JsonEscape(message, escaped, sizeof(escaped));
+    snprintf(reply, sizeof(reply), "{\"id\":%d,\"ok\":false,\"error\":\"%s\"}\n", id, escaped);
+    IPCServer_Write(client, client->generation, reply);
+}
+
+/******************************************************************************
+ * JSON Helpers - flat request objects of string and number members only
+ ******************************************************************************/
+
+static int IPCServer_JsonGetString(const char *json, const char *key, char *value, int valueSize) {
+    const char *p = IPCServer_JsonFindValue(json, key);
+    if (!p || *p != '"') {
+        return ERR_INVALID_PARAMETER;
+    }
+
+    int length = 0;
+    for (p++; *p && *p != '"'; p++) {
+        char c = *p;
+        if (c == '\\' && p[1]) {
+            p++;
+            switch (*p) {
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                case 'r': c = '\r'; break;
+                default:  c = *p;   break;    // \" \\ \/
+            }
+        }
+        if (length < valueSize - 1) {
+            value[length++] = c;
+        }
+    }
+    value[length] = '\0';
+
+    return (*p == '"') ? SUCCESS : ERR_INVALID_PARAMETER;
+}
+
+static int IPCServer_JsonGetNumber(const char *json, const char *key, double *value) {
+    const char *p = IPCServer_JsonFindValue(json, key);
+    if (!p) {
+        return ERR_INVALID_PARAMETER;
+    }
+
+    char *end;
+    double number = strtod(p, &end);
+    if (end == p) {
+        return ERR_INVALID_PARAMETER;
+    }
+
+    *value = number;
+    return SUCCESS;
+}
+
+// Start of the value of "key": at top level, or NULL
+static const char* IPCServer_JsonFindValue(const char *json, const char *key) {
+    int keyLength = strlen(key);
+    bool inString = false;
+    int depth = 0;
+
+    for (const char *p = json; *p; p++) {
+        if (inString) {
+            if (*p == '\\' && p[1]) {
+                p++;
+            } else if (*p == '"') {
+                inString = false;
+            }
+            continue;
+        }
+
+        if (*p == '{' || *p == '[') {
+            depth++;
+        } else if (*p == '}' || *p == ']') {
+            depth--;
+        } else if (*p == '"') {
+            // A key is a string at depth 1 followed by a colon
+            if (depth == 1 && strncmp(p + 1, key, keyLength) == 0 && p[1 + keyLength] == '"') {
+                const char *q = p + 2 + keyLength;
+                while (*q == ' ' || *q == '\t') q++;
+                if (*q == ':') {
+                    for (q++; *q == ' ' || *q == '\t'; q++);
+                    return q;
+                }
+            }
+            inString = true;
+        }
+    }
+
+    return NULL;
+}
+
+static int IPCServer_JsonEscape(const char *text, char *buffer, int bufferSize) {
+    int length = 0;
+
+    for (const unsigned char *p = (const unsigned char*)text; *p; p++) {
+        char escape[8];
+        if (*p == '"' || *p == '\\') {
+            snprintf(escape, sizeof(escape), "\\%c", *p);
+        } else if (*p < 0x20) {
+            snprintf(escape, sizeof(escape), "\\u%04x", *p);
+        } else {
+            escape[0] = *p;
+            escape[1] = '\0';
+        }
+
+        int escapeLength = strlen(escape);
+        if (length + escapeLength >= bufferSize) {
+            break;
+        }
+        memcpy(buffer + length, escape, escapeLength);
+        length += escapeLength;
+    }
+    buffer[length] = '\0';
+
+    return length;
+}
+
+// Add a quoted, comma separated array element; elements that do not fit are left out
+static void IPCServer_JsonAppendString(char *buffer, int bufferSize, int *length, const char *text) {
+    char escaped[MEDIUM_BUFFER_SIZE * 2];
+    int escapedLength = IPCServer_JsonEscape(text, escaped, sizeof(escaped));
+
+    if (*length + escapedLength + 4 > bufferSize) {
+        return;
+    }
+
+    *length += snprintf(buffer + *length, bufferSize - *length, "%s\"%s\"", *length > 0 ? "," : "", escaped);
+}
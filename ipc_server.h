@@ -0,0 +1,64 @@
+/******************************************************************************
+ * ipc_server.h
+ *
+ * Local IPC Server Module Header
+ * Lets tools on the same machine run prompt commands, read queue statistics
+ * and stream telemetry from a running tester over a named pipe. Requests and
+ * replies are single-line JSON objects:
+ *
+ *   {"op":"command","id":1,"command":"DTB02SETUP"}
+ *       -> {"id":1,"ok":true,"output":["Setup command success."],"errors":[]}
+ *   {"op":"stats","id":2,"device":"PSB"}
+ *       -> {"id":2,"ok":true,"device":"PSB","connected":1,"queued":[0,1,3,0],...}
+ *   {"op":"channels","id":3}
+ *       -> {"id":3,"ok":true,"channels":["PSB Voltage","PSB Current",...]}
+ *   {"op":"subscribe","id":4,"channel":"PSB Voltage","interval_ms":500}
+ *       -> {"id":4,"ok":true,"stream":1}
+ *       then {"stream":1,"t":812.503,"n":5,"last":3.712,"min":3.710,"max":3.714,"mean":3.712}
+ *            per interval with new samples
+ *   {"op":"unsubscribe","id":5,"stream":1}
+ *       -> {"id":5,"ok":true}
+ *
+ * Streams are summaries of the history store, so subscribers never cause a
+ * device read, and clients asking for the same channel at the same interval
+ * share one stream that is summarized and formatted once per interval.
+ ******************************************************************************/
+#ifndef IPC_SERVER_H
+#define IPC_SERVER_H
+
+#include "common.h"
+
+/******************************************************************************
+ * Configuration Constants
+ ******************************************************************************/
+#define IPC_SERVER_PIPE_NAME            "\\\\.\\pipe\\BatteryTester"
+#define IPC_SERVER_MAX_CLIENTS          8
+#define IPC_SERVER_MAX_STREAMS          32      // Distinct channel and interval pairs
+#define IPC_SERVER_MAX_LINE_LEN         512     // Longest request
+#define IPC_SERVER_MAX_RESPONSE_LEN     8192    // Longer command output is cut short
+#define IPC_SERVER_MIN_INTERVAL_MS      50      // Fastest stream
+#define IPC_SERVER_WRITE_TIMEOUT_MS     1000    // A client that reads no faster is dropped
+
+/******************************************************************************
+ * Public Function Declarations
+ ******************************************************************************/
+
+/**
+ * Create the pipe and start accepting clients. Call after the history store
+ * and the device queues are up.
+ * @return SUCCESS or error code
+ */
+int IPCServer_Start(void);
+
+/**
+ * Disconnect all clients, wait for their running commands and stop the server
+ */
+void IPCServer_Stop(void);
+
+/**
+ * Check if the server is accepting clients
+ * @return 1 if running, 0 otherwise
+ */
+int IPCServer_IsRunning(void);
+
+#endif // IPC_SERVER_H
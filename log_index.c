@@ -0,0 +1,757 @@
+/******************************************************************************
+ * log_index.c
+ *
+ * Log Index Module
+ * Writes and reads the .idx sidecars of the text logs and answers device /
+ * level / message queries from them, so multi-day runs can be searched
+ * without a full text scan of every log file
+ ******************************************************************************/
+
+#include "common.h"
+#include "log_index.h"
+#include <stdint.h>
+#include <ctype.h>
+
+/******************************************************************************
+ * Module Constants
+ ******************************************************************************/
+#define LOG_INDEX_LINE_LEN          4096    // Longer lines are indexed by their first part only
+#define LOG_INDEX_INITIAL_SLOTS     256     // Template id set slots while querying (power of 2)
+
+/******************************************************************************
+ * Internal Types
+ ******************************************************************************/
+
+// Converts line dates to time_t, mktime runs once per minute of log
+typedef struct {
+    char minute[17];            // "YYYY-mm-dd HH:MM"
+    time_t minuteStart;
+} TimeCache;
+
+// Template ids matching a query, open addressing on the id
+typedef struct {
+    uint32_t *slots;            // 0 for empty, so id 0 is kept in hasZero
+    int slotCount;
+    int count;
+    bool hasZero;
+} TemplateIdSet;
+
+// Receives each line entry matching a query, returns nonzero to stop
+typedef int (*MatchFunction)(const LogIndexEntry *entry, void *data);
+
+// Reads the matching lines of one log file for QueryFile
+typedef struct {
+    const char *logPath;
+    FILE *logFile;
+    char *line;
+    LogIndexLineCallback callback;
+    void *userData;
+    int passed;
+    bool stopped;               // The callback asked to stop
+    int result;
+} LineReader;
+
+// Counts matches per time bucket for LogIndex_Histogram
+typedef struct {
+    time_t startTime;
+    int bucketSeconds;
+    int *counts;
+    int bucketCount;
+    int total;
+} HistogramCounter;
+
+/******************************************************************************
+ * Module Variables
+ ******************************************************************************/
+
+// Level and device names as written by logging.c
+static const char* g_levelNames[LOG_INDEX_LEVEL_COUNT] = {
+    "DEBUG", "INFO", "WARN", "ERROR"
+};
+
+static const char* g_deviceNames[LOG_DEVICE_COUNT] = {
+    "", "PSB", "BIO", "DTB", "TNY", "DAQ"
+};
+
+/******************************************************************************
+ * Static Function Declarations
+ ******************************************************************************/
+static void BuildIndexPath(const char *logPath, char *indexPath, int pathSize);
+static bool ParseLogLine(const char *line, TimeCache *cache, time_t *timestamp,
+                         LogLevel *level, LogDevice *device, const char **message);
+static uint32_t MakeTemplate(const char *message, char *text, int textSize);
+static bool Writer_AddTemplate(LogIndexWriter *writer, uint32_t id);
+static bool IsActiveSegment(const char *logPath);
+static int TemplateIdSet_Add(TemplateIdSet *set, uint32_t id);
+static bool TemplateIdSet_Contains(const TemplateIdSet *set, uint32_t id);
+static int ScanIndex(const char *logPath, const LogIndexQuery *query, MatchFunction match,
+                     void *data, bool *stop);
+static int PassLine(const LogIndexEntry *entry, void *data);
+static int CountLine(const LogIndexEntry *entry, void *data);
+static int QueryFile(const char *logPath, const LogIndexQuery *query,
+                     LogIndexLineCallback callback, void *userData, bool *stop);
+static bool ContainsNoCase(const char *text, const char *part);
+static bool IsValidQuery(const LogIndexQuery *query);
+
+/******************************************************************************
+ * Writing
+ ******************************************************************************/
+
+// The index sits next to the log with its extension replaced
+static void BuildIndexPath(const char *logPath, char *indexPath, int pathSize) {
+    snprintf(indexPath, pathSize, "%s", logPath);
+
+    char *dot = strrchr(indexPath, '.');
+    char *separator = strrchr(indexPath, PATH_SEPARATOR_CHAR);
+    if (dot && (!separator || dot > separator)) {
+        *dot = '\0';
+    }
+
+    int length = (int)strlen(indexPath);
+    snprintf(indexPath + length, pathSize - length, "%s", LOG_INDEX_FILE_EXT);
+}
+
+// Split "<date time>[.us] [+mono] [T<id>] [LEVEL] [DEV] message". The fields
+// in brackets after the date are optional so older logs index as well. Lines
+// that are not log records (anchors, "=== ... ===" banners) return false.
+static bool ParseLogLine(const char *line, TimeCache *cache, time_t *timestamp,
+                         LogLevel *level, LogDevice *device, const char **message) {
+    int year, month, day, hour, minute, second;
+
+    if (sscanf(line, "%4d-%2d-%2d %2d:%2d:%2d", &year, &month, &day, &hour, &minute, &second) != 6) {
+        return false;
+    }
+
+    if (strncmp(line, cache->minute, 16) != 0) {
+        struct tm when = {0};
+        when.tm_year = year - 1900;
+        when.tm_mon = month - 1;
+        when.tm_mday = day;
+        when.tm_hour = hour;
+        when.tm_min = minute;
+        when.tm_isdst = -1;
+        cache->minuteStart = mktime(&when);
+        memcpy(cache->minute, line, 16);
+        cache->minute[16] = '\0';
+    }
+    *timestamp = cache->minuteStart + second;
+
+    const char *p = line + 19;
+    if (*p == '.') {
+        p++;
+        while (isdigit((unsigned char)*p)) p++;
+    }
+    if (p[0] == ' ' && p[1] == '+') {
+        p += 2;
+        while (isdigit((unsigned char)*p) || *p == '.') p++;
+    }
+    while (*p == ' ') p++;
+    if (p[0] == '[' && p[1] == 'T' && isdigit((unsigned char)p[2])) {
+        const char *end = strchr(p, ']');
+        if (!end) {
+            return false;
+        }
+        p = end + 1;
+        while (*p == ' ') p++;
+    }
+
+    if (*p++ != '[') {
+        return false;
+    }
+    *level = LOG_LEVEL_NONE;
+    for (int i = 0; i < LOG_INDEX_LEVEL_COUNT; i++) {
+        int length = (int)strlen(g_levelNames[i]);
+        if (strncmp(p, g_levelNames[i], length) == 0 && p[length] == ']') {
+            *level = (LogLevel)i;
+            p += length + 1;
+            break;
+        }
+    }
+    if (*level == LOG_LEVEL_NONE) {
+        return false;
+    }
+    while (*p == ' ') p++;
+
+    *device = LOG_DEVICE_NONE;
+    if (*p == '[') {
+        for (int i = 1; i < LOG_DEVICE_COUNT; i++) {
+            int length = (int)strlen(g_deviceNames[i]);
+            if (strncmp(p + 1, g_deviceNames[i], length) == 0 && p[length + 1] == ']') {
+                *device = (LogDevice)i;
+                p += length + 2;
+                while (*p == ' ') p++;
+                break;
+            }
+        }
+    }
+
+    *message = p;
+    return true;
+}
+
+// Replace every number (decimal, fractional or 0x hex) with '#' and return
+// the FNV-1a hash of the result. The text is cut to textSize, the hash is not.
+static uint32_t MakeTemplate(const char *message, char *text, int textSize) {
+    uint32_t hash = 2166136261u;
+    int length = 0;
+    const char *p = message;
+
+    while (*p && *p != '\r' && *p != '\n') {
+        char c = *p;
+        if (isdigit((unsigned char)c)) {
+            if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X') && isxdigit((unsigned char)p[2])) {
+                p += 2;
+                while (isxdigit((unsigned char)*p)) p++;
+            } else {
+                while (isdigit((unsigned char)*p) || (*p == '.' && isdigit((unsigned char)p[1]))) p++;
+            }
+            c = '#';
+        } else {
+            p++;
+        }
+
+        hash = (hash ^ (unsigned char)c) * 16777619u;
+        if (length < textSize - 1) {
+            text[length++] = c;
+        }
+    }
+
+    text[length] = '\0';
+    return hash;
+}
+
+int LogIndex_OpenWriter(LogIndexWriter *writer, const char *indexPath) {
+    if (!writer || !indexPath) {
+        return ERR_NULL_POINTER;
+    }
+
+    memset(writer, 0, sizeof(*writer));
+    writer->header.magic = LOG_INDEX_MAGIC;
+    writer->header.version = LOG_INDEX_VERSION;
+
+    writer->file = fopen(indexPath, "wb");
+    if (!writer->file) {
+        return ERR_OPERATION_FAILED;
+    }
+    if (fwrite(&writer->header, sizeof(writer->header), 1, writer->file) != 1) {
+        fclose(writer->file);
+        writer->file = NULL;
+        return ERR_OPERATION_FAILED;
+    }
+
+    return SUCCESS;
+}
+
+// Remember a template id, returns false if it is new to the file. Once the
+// table is half full new templates are written again at each use, which
+// costs space but no correctness.
+static bool Writer_AddTemplate(LogIndexWriter *writer, uint32_t id) {
+    if (id == 0) {
+        return false;
+    }
+
+    uint32_t slot = id & (LOG_INDEX_WRITER_TEMPLATES - 1);
+    while (writer->templates[slot]) {
+        if (writer->templates[slot] == id) {
+            return true;
+        }
+        slot = (slot + 1) & (LOG_INDEX_WRITER_TEMPLATES - 1);
+    }
+
+    if (writer->templateCount * 2 < LOG_INDEX_WRITER_TEMPLATES) {
+        writer->templates[slot] = id;
+        writer->templateCount++;
+    }
+    return false;
+}
+
+void LogIndex_AddLine(LogIndexWriter *writer, time_t timestamp, int64_t offset,
+                      LogLevel level, LogDevice device, const char *message) {
+    char text[LOG_INDEX_TEMPLATE_LEN];
+    LogIndexEntry entry;
+
+    if (!writer || !writer->file || !message) {
+        return;
+    }
+
+    memset(text, 0, sizeof(text));
+    memset(&entry, 0, sizeof(entry));
+    entry.timestamp = (int64_t)timestamp;
+    entry.offset = offset;
+    entry.templateId = MakeTemplate(message, text, sizeof(text));
+    entry.device = (uint8_t)device;
+    entry.level = (uint8_t)level;
+
+    if (!Writer_AddTemplate(writer, entry.templateId)) {
+        entry.kind = LOG_INDEX_ENTRY_TEMPLATE;
+        fwrite(&entry, sizeof(entry), 1, writer->file);
+        fwrite(text, sizeof(text), 1, writer->file);
+    }
+
+    entry.kind = LOG_INDEX_ENTRY_LINE;
+    if (fwrite(&entry, sizeof(entry), 1, writer->file) == 1) {
+        if (writer->header.firstTime == 0 || entry.timestamp < writer->header.firstTime) {
+            writer->header.firstTime = entry.timestamp;
+        }
+        if (entry.timestamp > writer->header.lastTime) {
+            writer->header.lastTime = entry.timestamp;
+        }
+    }
+}
+
+// The header goes out after the entries it describes, readers stop at the
+// first incomplete entry so they never read past what has been written
+void LogIndex_SyncWriter(LogIndexWriter *writer, int64_t indexedSize) {
+    if (!writer || !writer->file) {
+        return;
+    }
+
+    writer->header.indexedSize = indexedSize;
+    fflush(writer->file);
+    fseek(writer->file, 0, SEEK_SET);
+    fwrite(&writer->header, sizeof(writer->header), 1, writer->file);
+    fseek(writer->file, 0, SEEK_END);
+    fflush(writer->file);
+}
+
+void LogIndex_CloseWriter(LogIndexWriter *writer, int64_t indexedSize) {
+    if (!writer || !writer->file) {
+        return;
+    }
+
+    LogIndex_SyncWriter(writer, indexedSize);
+    fclose(writer->file);
+    writer->file = NULL;
+}
+
+// The segment being written belongs to the logger's own writer
+static bool IsActiveSegment(const char *logPath) {
+    char path[MAX_PATH_LENGTH];
+    int first, last;
+
+    if (GetLogSegments(&first, &last) <= 0) {
+        return false;
+    }
+    GetLogSegmentPath(last, path, sizeof(path));
+    return strcmp(path, logPath) == 0;
+}
+
+int LogIndex_BuildFile(const char *logPath) {
+    char indexPath[MAX_PATH_LENGTH];
+    LogIndexFileHeader header;
+
+    if (!logPath) {
+        return ERR_NULL_POINTER;
+    }
+    if (IsActiveSegment(logPath)) {
+        return 0;
+    }
+
+    BuildIndexPath(logPath, indexPath, sizeof(indexPath));
+
+    FILE *logFile = fopen(logPath, "rb");
+    if (!logFile) {
+        return ERR_OPERATION_FAILED;
+    }
+    fseek(logFile, 0, SEEK_END);
+    int64_t sourceSize = (int64_t)ftell(logFile);
+
+    // Logs are only ever appended to, so an index in the current format
+    // covering no more than the file is extended from where it ends
+    FILE *indexFile = fopen(indexPath, "r+b");
+    bool extend = indexFile && fread(&header, sizeof(header), 1, indexFile) == 1 &&
+                  header.magic == LOG_INDEX_MAGIC && header.version == LOG_INDEX_VERSION &&
+                  header.indexedSize <= sourceSize;
+    if (extend && header.indexedSize == sourceSize) {
+        fclose(indexFile);
+        fclose(logFile);
+        return 0;
+    }
+
+    char *line = malloc(LOG_INDEX_LINE_LEN);
+    LogIndexWriter *writer = malloc(sizeof(LogIndexWriter));
+    int result = SUCCESS;
+
+    if (!line || !writer) {
+        if (indexFile) fclose(indexFile);
+        result = ERR_OUT_OF_MEMORY;
+        goto cleanup;
+    }
+
+    int64_t offset = 0;
+    if (extend) {
+        memset(writer, 0, sizeof(*writer));
+        writer->file = indexFile;
+        writer->header = header;
+        fseek(indexFile, 0, SEEK_END);
+        offset = header.indexedSize;
+    } else {
+        if (indexFile) fclose(indexFile);
+        result = LogIndex_OpenWriter(writer, indexPath);
+        if (result != SUCCESS) {
+            goto cleanup;
+        }
+    }
+
+    // Stop at the size measured above, and before a last line still being
+    // written - it is indexed once it is complete
+    TimeCache cache = {{0}, 0};
+    int64_t indexedSize = offset;
+    fseek(logFile, (long)offset, SEEK_SET);
+    while (offset < sourceSize && fgets(line, LOG_INDEX_LINE_LEN, logFile) != NULL) {
+        int64_t lineOffset = offset;
+        offset = (int64_t)ftell(logFile);
+
+        int length = (int)strlen(line);
+        if (offset >= sourceSize && (length == 0 || line[length - 1] != '\n')) {
+            break;
+        }
+        indexedSize = offset;
+
+        time_t timestamp;
+        LogLevel level;
+        LogDevice device;
+        const char *message;
+        if (ParseLogLine(line, &cache, &timestamp, &level, &device, &message)) {
+            LogIndex_AddLine(writer, timestamp, lineOffset, level, device, message);
+        }
+    }
+
+    LogIndex_CloseWriter(writer, indexedSize);
+    result = (!extend || indexedSize > header.indexedSize) ? 1 : 0;
+
+cleanup:
+    fclose(logFile);
+    free(writer);
+    free(line);
+
+    return result;
+}
+
+int LogIndex_BuildAll(void) {
+    char path[MAX_PATH_LENGTH];
+    int first, last;
+    int built = 0;
+
+    int count = GetLogSegments(&first, &last);
+    if (count <= 0) {
+        return count;
+    }
+
+    for (int number = first; number < last; number++) {
+        GetLogSegmentPath(number, path, sizeof(path));
+        if (LogIndex_BuildFile(path) == 1) {
+            built++;
+        }
+    }
+
+    return built;
+}
+
+/******************************************************************************
+ * Querying
+ ******************************************************************************/
+
+static bool IsValidQuery(const LogIndexQuery *query) {
+    return query && query->endTime >= query->startTime &&
+           query->minLevel >= LOG_LEVEL_DEBUG && query->minLevel <= LOG_LEVEL_ERROR;
+}
+
+static int TemplateIdSet_Add(TemplateIdSet *set, uint32_t id) {
+    if (id == 0) {
+        set->hasZero = true;
+        return SUCCESS;
+    }
+
+    // Keep the table at most half full
+    if ((set->count + 1) * 2 > set->slotCount) {
+        int slotCount = set->slotCount ? set->slotCount * 2 : LOG_INDEX_INITIAL_SLOTS;
+        uint32_t *slots = calloc(slotCount, sizeof(uint32_t));
+        if (!slots) {
+            return ERR_OUT_OF_MEMORY;
+        }
+        for (int i = 0; i < set->slotCount; i++) {
+            if (set->slots[i]) {
+                uint32_t slot = set->slots[i] & (slotCount - 1);
+                while (slots[slot]) slot = (slot + 1) & (slotCount - 1);
+                slots[slot] = set->slots[i];
+            }
+        }
+        free(set->slots);
+        set->slots = slots;
+        set->slotCount = slotCount;
+    }
+
+    uint32_t slot = id & (set->slotCount - 1);
+    while (set->slots[slot]) {
+        if (set->slots[slot] == id) {
+            return SUCCESS;
+        }
+        slot = (slot + 1) & (set->slotCount - 1);
+    }
+    set->slots[slot] = id;
+    set->count++;
+    return SUCCESS;
+}
+
+static bool TemplateIdSet_Contains(const TemplateIdSet *set, uint32_t id) {
+    if (id == 0) {
+        return set->hasZero;
+    }
+    if (set->count == 0) {
+        return false;
+    }
+
+    uint32_t slot = id & (set->slotCount - 1);
+    while (set->slots[slot]) {
+        if (set->slots[slot] == id) {
+            return true;
+        }
+        slot = (slot + 1) & (set->slotCount - 1);
+    }
+    return false;
+}
+
+// Bring a log file's index up to date and pass its line entries matching a
+// query to a function, in log file order. Returns the number of matches, and
+// sets *stop when the function asks to stop. Only the index is read.
+static int ScanIndex(const char *logPath, const LogIndexQuery *query, MatchFunction match,
+                     void *data, bool *stop) {
+    char indexPath[MAX_PATH_LENGTH];
+    char text[LOG_INDEX_TEMPLATE_LEN];
+    LogIndexFileHeader header;
+    LogIndexEntry entry;
+    TemplateIdSet templates = {0};
+    bool byTemplate = query->templateText && query->templateText[0];
+    int64_t lastOffset = -1;
+    int matches = 0;
+
+    int result = LogIndex_BuildFile(logPath);
+    if (result < 0) {
+        return result;
+    }
+
+    // A log whose index could not be written is not searchable, like LogQuery
+    BuildIndexPath(logPath, indexPath, sizeof(indexPath));
+    FILE *indexFile = fopen(indexPath, "rb");
+    if (!indexFile) {
+        return 0;
+    }
+
+    if (fread(&header, sizeof(header), 1, indexFile) != 1 ||
+        header.magic != LOG_INDEX_MAGIC || header.version != LOG_INDEX_VERSION) {
+        fclose(indexFile);
+        return 0;
+    }
+
+    // The header's times cover the lines up to its last sync, which for the
+    // segment being written is at most a flush interval old
+    if (header.firstTime == 0 ||
+        header.lastTime < (int64_t)query->startTime || header.firstTime > (int64_t)query->endTime) {
+        fclose(indexFile);
+        return 0;
+    }
+
+    result = SUCCESS;
+    while (result == SUCCESS && fread(&entry, sizeof(entry), 1, indexFile) == 1) {
+        if (entry.kind == LOG_INDEX_ENTRY_TEMPLATE) {
+            if (fread(text, sizeof(text), 1, indexFile) != 1) {
+                break;
+            }
+            text[sizeof(text) - 1] = '\0';
+            if (byTemplate && ContainsNoCase(text, query->templateText)) {
+                result = TemplateIdSet_Add(&templates, entry.templateId);
+            }
+            continue;
+        }
+
+        // Lines indexed again after a crash
+        if (entry.offset <= lastOffset) {
+            continue;
+        }
+        lastOffset = entry.offset;
+
+        if (entry.timestamp < (int64_t)query->startTime || entry.timestamp > (int64_t)query->endTime ||
+            entry.level < query->minLevel || entry.level >= LOG_INDEX_LEVEL_COUNT ||
+            entry.device >= LOG_DEVICE_COUNT) {
+            continue;
+        }
+        if (query->deviceMask != 0 && !(query->deviceMask & LOG_SINK_DEVICE(entry.device))) {
+            continue;
+        }
+        if (byTemplate && !TemplateIdSet_Contains(&templates, entry.templateId)) {
+            continue;
+        }
+
+        matches++;
+        if (match(&entry, data) != 0) {
+            *stop = true;
+            break;
+        }
+    }
+
+    fclose(indexFile);
+    free(templates.slots);
+
+    return result == SUCCESS ? matches : result;
+}
+
+static bool ContainsNoCase(const char *text, const char *part) {
+    for (; *text; text++) {
+        int i = 0;
+        while (part[i] && text[i] &&
+               tolower((unsigned char)text[i]) == tolower((unsigned char)part[i])) {
+            i++;
+        }
+        if (part[i] == '\0') {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int PassLine(const LogIndexEntry *entry, void *data) {
+    LineReader *reader = (LineReader*)data;
+
+    if (!reader->logFile) {
+        reader->logFile = fopen(reader->logPath, "rb");
+        reader->line = malloc(LOG_INDEX_LINE_LEN);
+        if (!reader->logFile || !reader->line) {
+            reader->result = reader->logFile ? ERR_OUT_OF_MEMORY : ERR_OPERATION_FAILED;
+            return 1;
+        }
+    }
+
+    if (fseek(reader->logFile, (long)entry->offset, SEEK_SET) != 0 ||
+        fgets(reader->line, LOG_INDEX_LINE_LEN, reader->logFile) == NULL) {
+        return 1;
+    }
+    reader->line[strcspn(reader->line, "\r\n")] = '\0';
+    reader->passed++;
+
+    if (reader->callback(reader->line, (time_t)entry->timestamp, reader->userData) != 0) {
+        reader->stopped = true;
+        return 1;
+    }
+    return 0;
+}
+
+// Pass the matching lines of one log file to the callback, returns how many.
+// Sets *stop when the callback asks to stop.
+static int QueryFile(const char *logPath, const LogIndexQuery *query,
+                     LogIndexLineCallback callback, void *userData, bool *stop) {
+    LineReader reader = {logPath, NULL, NULL, callback, userData, 0, false, SUCCESS};
+    bool scanStopped = false;
+
+    int result = ScanIndex(logPath, query, PassLine, &reader, &scanStopped);
+
+    if (reader.logFile) fclose(reader.logFile);
+    free(reader.line);
+
+    if (result < 0) {
+        return result;
+    }
+    if (reader.result != SUCCESS) {
+        return reader.result;
+    }
+
+    *stop = reader.stopped;
+    return reader.passed;
+}
+
+int LogIndex_QueryFile(const char *logPath, const LogIndexQuery *query,
+                       LogIndexLineCallback callback, void *userData) {
+    bool stop = false;
+
+    if (!logPath || !callback) {
+        return ERR_NULL_POINTER;
+    }
+    if (!IsValidQuery(query)) {
+        return ERR_INVALID_PARAMETER;
+    }
+
+    return QueryFile(logPath, query, callback, userData, &stop);
+}
+
+int LogIndex_Query(const LogIndexQuery *query, LogIndexLineCallback callback, void *userData) {
+    char path[MAX_PATH_LENGTH];
+    int first, last;
+    int total = 0;
+    bool stop = false;
+
+    if (!callback) {
+        return ERR_NULL_POINTER;
+    }
+    if (!IsValidQuery(query)) {
+        return ERR_INVALID_PARAMETER;
+    }
+
+    int count = GetLogSegments(&first, &last);
+    if (count <= 0) {
+        return count;
+    }
+
+    // Make sure the segment being written and its index are on disk
+    LogFlush();
+    for (int number = first; number <= last && !stop; number++) {
+        GetLogSegmentPath(number, path, sizeof(path));
+        if (!FileExists(path)) {
+            continue;   // Pruned while we were looking
+        }
+
+        int result = QueryFile(path, query, callback, userData, &stop);
+        if (result < 0) {
+            return result;
+        }
+        total += result;
+    }
+
+    return total;
+}
+
+static int CountLine(const LogIndexEntry *entry, void *data) {
+    HistogramCounter *counter = (HistogramCounter*)data;
+
+    int64_t bucket = (entry->timestamp - (int64_t)counter->startTime) / counter->bucketSeconds;
+    if (bucket >= 0 && bucket < counter->bucketCount) {
+        counter->counts[bucket]++;
+        counter->total++;
+    }
+    return 0;
+}
+
+int LogIndex_Histogram(const LogIndexQuery *query, int bucketSeconds, int *counts, int bucketCount) {
+    char path[MAX_PATH_LENGTH];
+    int first, last;
+    bool stop = false;
+
+    if (!counts) {
+        return ERR_NULL_POINTER;
+    }
+    if (!IsValidQuery(query) || bucketSeconds <= 0 || bucketCount <= 0) {
+        return ERR_INVALID_PARAMETER;
+    }
+
+    memset(counts, 0, bucketCount * sizeof(int));
+    HistogramCounter counter = {query->startTime, bucketSeconds, counts, bucketCount, 0};
+
+    int count = GetLogSegments(&first, &last);
+    if (count <= 0) {
+        return count;
+    }
+
+    LogFlush();
+    for (int number = first; number <= last; number++) {
+        GetLogSegmentPath(number, path, sizeof(path));
+        if (!FileExists(path)) {
+            continue;
+        }
+
+        int result = ScanIndex(path, query, CountLine, &counter, &stop);
+        if (result < 0) {
+            return result;
+        }
+    }
+
+    return counter.total;
+}
@@ -0,0 +1,179 @@
+/******************************************************************************
+ * log_index.h
+ *
+ * Log Index Module Header
+ * Defines the .idx sidecar kept next to each text log (log segments,
+ * experiment.log, recovered crash logs) and answers device / level / message
+ * queries from it. The logger appends to the index of the segment it is
+ * writing as each line goes out; other log files are indexed here, picking
+ * up from where their index ends.
+ ******************************************************************************/
+
+#ifndef LOG_INDEX_H
+#define LOG_INDEX_H
+
+#include "common.h"
+#include "logging.h"
+#include <stdint.h>
+
+/******************************************************************************
+ * Configuration Constants
+ ******************************************************************************/
+#define LOG_INDEX_FILE_EXT          ".idx"  // Sidecar written next to each indexed log file
+#define LOG_INDEX_MAGIC             0x3258494Cu  // "LIX2"
+#define LOG_INDEX_VERSION           2
+#define LOG_INDEX_TEMPLATE_LEN      96      // Template text kept per message template
+#define LOG_INDEX_LEVEL_COUNT       (LOG_LEVEL_ERROR + 1)
+#define LOG_INDEX_WRITER_TEMPLATES  4096    // Template ids a writer remembers (power of 2)
+
+/******************************************************************************
+ * Index File Layout
+ ******************************************************************************/
+// An .idx file is a header followed by entries in log file order: one line
+// entry per log record, and a template entry, followed by the template text,
+// before the first line using each template. Line entries whose offset does
+// not increase repeat lines indexed before (after a crash) and are ignored.
+
+typedef enum {
+    LOG_INDEX_ENTRY_LINE = 1,
+    LOG_INDEX_ENTRY_TEMPLATE        // Followed by LOG_INDEX_TEMPLATE_LEN bytes of text
+} LogIndexEntryKind;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    int64_t indexedSize;        // Log file bytes the entries cover
+    int64_t firstTime;          // Oldest and newest line time, to skip whole files
+    int64_t lastTime;
+} LogIndexFileHeader;
+
+typedef struct {
+    int64_t timestamp;          // Local wall time of the line, seconds
+    int64_t offset;             // Byte offset of the line in the log file
+    uint32_t templateId;        // Hash of the full template text
+    uint8_t kind;               // LogIndexEntryKind
+    uint8_t device;             // LogDevice
+    uint8_t level;              // LogLevel
+    uint8_t reserved;
+} LogIndexEntry;
+
+// Appends entries to one index file
+typedef struct {
+    FILE *file;
+    LogIndexFileHeader header;
+    int templateCount;
+    uint32_t templates[LOG_INDEX_WRITER_TEMPLATES];  // Ids already in the file, 0 for a free slot
+} LogIndexWriter;
+
+/******************************************************************************
+ * Type Definitions
+ ******************************************************************************/
+
+// What to look for. Every condition must hold for a line to match.
+typedef struct {
+    unsigned int deviceMask;    // LOG_SINK_DEVICE bits, 0 for every device
+    LogLevel minLevel;          // Lowest level matched
+    time_t startTime;           // Start of the window (inclusive)
+    time_t endTime;             // End of the window (inclusive)
+    const char *templateText;   // Case-insensitive part of the message template, NULL for any
+} LogIndexQuery;
+
+// Receives one matching log line (without the line ending), oldest first.
+// Return nonzero to stop the query.
+typedef int (*LogIndexLineCallback)(const char *line, time_t timestamp, void *userData);
+
+/******************************************************************************
+ * Public Function Declarations - Writing
+ ******************************************************************************/
+
+/**
+ * Start a new, empty index file
+ * @param writer - Writer to set up
+ * @param indexPath - Index file to create
+ * @return SUCCESS or error code
+ */
+int LogIndex_OpenWriter(LogIndexWriter *writer, const char *indexPath);
+
+/**
+ * Index one log line. Each line is filed under its device, level and message
+ * template - the message with every number replaced by '#', so "Timeout
+ * after 500 ms" and "Timeout after 20 ms" share one template id.
+ * @param writer - Open writer
+ * @param timestamp - Wall time of the line
+ * @param offset - Byte offset of the line in the log file
+ * @param level - Line level
+ * @param device - Line device
+ * @param message - Message text after the level and device tags
+ */
+void LogIndex_AddLine(LogIndexWriter *writer, time_t timestamp, int64_t offset,
+                      LogLevel level, LogDevice device, const char *message);
+
+/**
+ * Record how much of the log file the entries cover and flush the index
+ * @param writer - Open writer
+ * @param indexedSize - Log file size after the last indexed line
+ */
+void LogIndex_SyncWriter(LogIndexWriter *writer, int64_t indexedSize);
+
+/**
+ * Sync and close the index file
+ * @param writer - Open writer, or one that was never opened
+ * @param indexedSize - Log file size after the last indexed line
+ */
+void LogIndex_CloseWriter(LogIndexWriter *writer, int64_t indexedSize);
+
+/******************************************************************************
+ * Public Function Declarations - Querying
+ ******************************************************************************/
+
+/**
+ * Bring the index of a log file up to date by indexing the lines added
+ * since it was last brought up to date. A missing index, or one in an older
+ * format, is built from the start. The index of the segment the logger is
+ * writing is left alone, the logger keeps it current.
+ * @param logPath - Log file to index
+ * @return 1 if lines were indexed, 0 if the index was already current, or error code
+ */
+int LogIndex_BuildFile(const char *logPath);
+
+/**
+ * Bring the index of every log segment in the log directory up to date
+ * @return Number of indices extended or built, or error code
+ */
+int LogIndex_BuildAll(void);
+
+/**
+ * Pass every matching line of the log segments to a callback, oldest first.
+ * Segments outside the window are skipped from their index header, and only
+ * matching lines are read from the log files.
+ * @param query - What to look for
+ * @param callback - Called once per matching line
+ * @param userData - Passed through to the callback
+ * @return Number of matching lines passed to the callback, or error code
+ */
+int LogIndex_Query(const LogIndexQuery *query, LogIndexLineCallback callback, void *userData);
+
+/**
+ * Same as LogIndex_Query for a single log file, e.g. an experiment.log
+ * @param logPath - Log file to search
+ * @param query - What to look for
+ * @param callback - Called once per matching line
+ * @param userData - Passed through to the callback
+ * @return Number of matching lines passed to the callback, or error code
+ */
+int LogIndex_QueryFile(const char *logPath, const LogIndexQuery *query,
+                       LogIndexLineCallback callback, void *userData);
+
+/**
+ * Count matching lines of the log segments per time bucket, e.g. per hour.
+ * Answered from the indices alone, the log files themselves are not read.
+ * @param query - What to look for
+ * @param bucketSeconds - Bucket length, counts[i] covers
+ *                        [startTime + i * bucketSeconds, startTime + (i + 1) * bucketSeconds)
+ * @param counts - Receives the counts, zeroed first
+ * @param bucketCount - Number of elements in counts
+ * @return Total number of matching lines, or error code
+ */
+int LogIndex_Histogram(const LogIndexQuery *query, int bucketSeconds, int *counts, int bucketCount);
+
+#endif // LOG_INDEX_H
@@ -5,11 +5,13 @@
  * Handles logging throughout the application to both UI and file
  ******************************************************************************/
 
+#define LOGGING_IMPLEMENTATION   // Keep the real functions when levels are compiled out
 #include "common.h"
 #include "logging.h"
+#include "log_index.h"
 #include "BatteryTester.h"
 #include <stdarg.h>
-#include <stdint.h> // For intptr_t
+#include <stdint.h> // For intptr_t and int64_t
 #include <errno.h>  // For errno
 
 #ifdef _WIN32
@@ -26,26 +28,78 @@
 #define TAB_WIDTH               4       // Number of spaces to represent a tab
 #define MAX_LOG_LINE_LEN        2048    // Max length for a single formatted log line
 #define MAX_LINES_PER_CALL      10      // Max number of lines to handle in one LogMessage call
-#define LOG_FILE_NAME           "BatteryTester.log"
-#define MAX_LOG_FILE_SIZE       (10 * 1024 * 1024)  // 10MB max log file size
+#define LOG_FILE_BASE_NAME      "BatteryTester"
+#define LOG_SEGMENT_EXT         ".log"
+#define MAX_LOG_FILE_SIZE       (10 * 1024 * 1024)  // Segment size that starts a new segment
+#define LOG_SEGMENT_MAX_AGE_S   3600    // Start a new segment at least hourly
+#define LOG_MAX_SEGMENTS        100     // Older segments are deleted as new ones open
+
+// Asynchronous file writer
+#define LOG_RING_CAPACITY       512     // Records buffered for the writer thread (power of 2)
+#define LOG_WRITER_WAKE_MS      50      // Writer polling interval when nobody signals it
+#define LOG_FLUSH_INTERVAL_MS   500     // Longest time written lines sit in the stdio buffer
+#define LOG_FLUSH_BATCH_BYTES   (64 * 1024)  // Flush early once this much has been written
+#define LOG_SYNC_FLUSH_TIMEOUT_MS 1000  // Longest an ERROR or LogFlush waits for the writer
+#define LOG_MAX_SPEC_LEN        32      // Longest single printf conversion kept for deferred formatting
+
+// Repeat suppression
+#define LOG_SITE_DEFAULT_LIMIT  20      // Lines per call site per window before suppressing
+#define LOG_SITE_WINDOW_MS      5000    // Rate limit window
+#define LOG_SITE_TABLE_SIZE     512     // Tracked call sites (power of 2)
+#define LOG_SITE_PROBE_LENGTH   8       // Slots searched per call site before giving up
+#define LOG_SITE_SWEEP_MS       250     // How often the writer reports finished windows
+#define LOG_SITE_MAX_OVERRIDES  32
+#define LOG_SITE_FORMAT_LEN     128     // Override format strings are compared up to this length
+#define LOG_SITE_SUMMARY_FORMAT "Previous message repeated %d more times in %.1f s: %s"
+
+// Log sinks
+#define LOG_MAX_SINKS           8       // Sinks open at once, each with its own writer thread
+#define LOG_SINK_QUEUE_LINES    256     // Lines buffered per sink before it drops
+
+// Crash ring
+#define LOG_CRASH_RING_NAME     "BatteryTester.ring"
+#define LOG_CRASH_MAGIC         0x474E5242u  // "BRNG"
+#define LOG_CRASH_VERSION       1
+#define LOG_CRASH_SLOT_SIZE     512     // Bytes per record, longer records are cut short
+#define LOG_CRASH_SLOT_COUNT    2048    // Records kept (power of 2) - 1 MB with the slot size
+
+// UI output
+#define LOG_UI_MAX_LINES        2000    // Lines kept in the output textbox, oldest dropped first
+#define LOG_UI_LINE_LEN         512     // Longest line shown in the textbox (the file keeps it all)
 
 /******************************************************************************
  * Module Variables
  ******************************************************************************/
 static FILE *g_logFile = NULL;
 static FILE *g_externalLogFile = NULL;  // External log file pointer
+static LogSinkHandle g_externalLogSink = 0;  // Sink carrying g_externalLogFile
 static int g_logToFile = 1;
 static int g_logToUI = 1;
-static CmtTSQHandle g_logQueue = 0;
 static int g_loggingInitialized = 0;
 static char g_actualLogPath[MAX_PATH_LENGTH] = {0};  // Store the actual log file path
 
-// Log level names for display
+// Segmented log files. Each run, and each MAX_LOG_FILE_SIZE or
+// LOG_SEGMENT_MAX_AGE_S after that, opens BatteryTester_NNNN.log next to a
+// .idx sidecar (see log_index.h) with an entry for every line written.
+static char g_logDirectory[MAX_PATH_LENGTH] = {0};  // With trailing separator, empty for current dir
+static LogIndexWriter g_logIndex;
+static int g_logSegmentNumber = 0;
+static int g_logOldestSegment = 0;
+static long g_logSegmentBytes = 0;
+static time_t g_logSegmentStart = 0;
+
+// Log level names for display (indexed by LogLevel)
 static const char* g_logLevelNames[] = {
+    "DEBUG",
     "INFO",
     "WARN",
-    "ERROR",
-    "DEBUG"
+    "ERROR"
+};
+
+// Lowest level logged per device, checked before any formatting
+static volatile int g_logThresholds[LOG_DEVICE_COUNT] = {
+    LOG_LEVEL_INFO, LOG_LEVEL_INFO, LOG_LEVEL_INFO,
+    LOG_LEVEL_INFO, LOG_LEVEL_INFO, LOG_LEVEL_INFO
 };
 
 // Device names for display
@@ -58,52 +112,325 @@ static const char* g_deviceNames[] = {
 	"DAQ"   // LOG_DEVICE_CDAQ
 };
 
+// Lines waiting for the UI thread. Kept as a ring so a log storm between two
+// UI frames overwrites its own oldest lines instead of growing the backlog.
+typedef struct {
+    char lines[LOG_UI_MAX_LINES][LOG_UI_LINE_LEN];
+    int start;                   // Oldest pending line
+    int count;
+    int skipped;                 // Lines overwritten before the UI got to them
+} UILineBatch;
+
+// Rate limit state for one call site - a format string logged for one device.
+// Logging threads find their site without a lock and count with Interlocked
+// operations; only claiming a slot for a new site takes g_logSiteLock. The
+// identity fields are a seqlock: sequence is odd while a slot is being claimed.
+typedef struct {
+    volatile int sequence;
+    const char *format;          // NULL when the slot is free
+    LogDevice device;
+    LogLevel level;
+    volatile int limit;          // Override for this site, -1 for the default
+    volatile int windowStartMs;  // LogSite_NowMs() at the window start, compared wrapping
+    volatile int count;          // Lines logged in the current window
+    volatile int suppressed;     // Lines dropped in the current window
+} LogSite;
+
+typedef struct {
+    char format[LOG_SITE_FORMAT_LEN];
+    int limit;
+} LogSiteOverride;
+
+// Additional log destination with its own filter and writer thread. The
+// main writer formats each line once and queues a copy for every sink whose
+// filter matches, so a slow sink only ever fills its own queue.
+typedef struct {
+    int active;
+    LogSinkFilter filter;
+    FILE *file;
+    int ownsFile;                // Opened by LogSinkOpen, closed on removal
+    CmtTSQHandle queue;          // Formatted lines, MAX_LOG_LINE_LEN each
+    CmtThreadFunctionID threadId;
+    volatile int stopping;
+    volatile int dropped;        // Lines lost because the queue was full
+} LogSink;
+
+// Crash ring file layout: a header followed by LOG_CRASH_SLOT_COUNT slots.
+// The file is mapped into memory and every record is copied into it as it is
+// logged, so the OS keeps the most recent records even if the process dies.
+typedef struct {
+    unsigned int magic;
+    int version;
+    int slotSize;
+    int slotCount;
+    volatile int writePosition;  // Next position to claim
+    volatile int cleanShutdown;  // Set by CleanupLogging
+    int processId;
+    int reserved;
+    int64_t anchorWallNs;        // Clock anchor for decoding slot timestamps
+    int64_t anchorMonotonicNs;
+} LogCrashHeader;
+
+typedef enum {
+    LOG_CRASH_PREFORMATTED = 0x01,  // data holds the message text
+    LOG_CRASH_NO_ARGS      = 0x02   // data holds the format only, arguments did not fit
+} LogCrashFlags;
+
+typedef struct {
+    volatile int sequence;       // Position + 1 once complete, 0 while being written
+    int threadId;
+    int64_t monotonicNs;
+    unsigned char level;
+    unsigned char device;
+    unsigned char flags;
+    unsigned char reserved;
+    unsigned short formatLength; // Bytes of format text in data, including the NUL
+    unsigned short argsLength;   // Bytes of captured arguments following the format
+    char data[LOG_CRASH_SLOT_SIZE - 24];
+} LogCrashSlot;
+
+// Log record handed from the logging thread to the writer thread. With
+// deferred formatting, format points at the caller's format string literal
+// and message holds the captured arguments instead of text.
+typedef struct {
+    int64_t monotonicNs;         // LogClock_MonotonicNs when the line was logged
+    int threadId;                // CVI thread id of the logging thread
+    LogLevel level;
+    LogDevice device;
+    int experimentId;            // Experiment of the logging thread, 0 if none
+    const char *format;          // NULL when message is already formatted
+    char message[MAX_LOG_LINE_LEN];
+} LogRecord;
+
+// Captured argument tags for deferred formatting
 typedef enum {
-    LOG_LEVEL_INFO = 0,
-    LOG_LEVEL_WARNING,
-    LOG_LEVEL_ERROR,
-    LOG_LEVEL_DEBUG
-} LogLevel;
+    LOG_ARG_INTEGER = 1,         // Stored as long long
+    LOG_ARG_DOUBLE,
+    LOG_ARG_POINTER,
+    LOG_ARG_STRING               // Copied inline, NUL terminated
+} LogArgType;
 
-// Structure for deferred UI update
+// printf length modifiers that change how an integer argument is passed
+typedef enum {
+    LOG_LEN_DEFAULT = 0,
+    LOG_LEN_LONG,
+    LOG_LEN_LONGLONG,
+    LOG_LEN_SIZE,
+    LOG_LEN_LONGDOUBLE
+} LogLengthModifier;
+
+// One parsed conversion specification
+typedef struct {
+    const char *start;           // The '%'
+    int length;                  // Characters from '%' through the conversion
+    int widthStar;
+    int precisionStar;
+    LogLengthModifier lengthModifier;
+    char conversion;
+} LogFormatSpec;
+
+// Ring slot - the sequence number tells producers and the writer whose turn it is
 typedef struct {
-    int panel;
-    int control;
-    char *text;
-} UIUpdateData;
+    volatile int sequence;
+    LogRecord record;
+} LogSlot;
+
+typedef enum {
+    LOG_WRITER_STOPPED = 0,
+    LOG_WRITER_STARTING,
+    LOG_WRITER_RUNNING,
+    LOG_WRITER_STOPPING
+} LogWriterState;
+
+/******************************************************************************
+ * Writer Thread Variables
+ ******************************************************************************/
+// Bounded multi-producer ring drained by a single writer thread. Producers
+// claim a position with a compare-exchange and publish the slot by bumping its
+// sequence, so logging threads never take a lock or touch the disk.
+static LogSlot g_logRing[LOG_RING_CAPACITY];
+static volatile int g_logEnqueuePos = 0;
+static volatile int g_logDequeuePos = 0;        // Advanced by the writer only
+static volatile int g_logWrittenPos = 0;        // Records written and flushed to disk
+static volatile int g_logFlushRequests = 0;     // Threads waiting for a synchronous flush
+static volatile int g_logDroppedRecords = 0;    // Records lost because the ring was full
+static volatile int g_logWriterState = LOG_WRITER_STOPPED;
+static int g_logDeferredFormatting = 1;          // Capture arguments, format on the writer thread
+static CmtThreadPoolHandle g_logWriterPool = 0;
+static CmtThreadFunctionID g_logWriterThreadId = 0;
+static HANDLE g_logWakeEvent = NULL;
+static CmtThreadLockHandle g_logFileLock = 0;   // Guards the FILE pointers against swaps
+
+/******************************************************************************
+ * Clock Variables
+ ******************************************************************************/
+// Records carry a QueryPerformanceCounter timestamp. The writer turns it into
+// wall-clock time from an anchor pair taken at start-up and at every segment
+// open, so wall time in the log never steps between anchors. Guarded by
+// g_logFileLock once logging is initialized.
+static int64_t g_logClockFrequency = 0;
+static int64_t g_logAnchorWallNs = 0;           // Unix time in ns at the anchor
+static int64_t g_logAnchorMonotonicNs = 0;
+
+/******************************************************************************
+ * Crash Ring Variables
+ ******************************************************************************/
+static HANDLE g_logCrashFile = NULL;
+static HANDLE g_logCrashMapping = NULL;
+static LogCrashHeader *g_logCrashHeader = NULL;  // Start of the mapped view
+static LogCrashSlot *g_logCrashSlots = NULL;
+static char g_logCrashRecoveredPath[MAX_PATH_LENGTH] = {0};
+
+/******************************************************************************
+ * Log Sink Variables
+ ******************************************************************************/
+static LogSink g_logSinks[LOG_MAX_SINKS];       // Guarded by g_logFileLock
+static int g_logSinkCount = 0;
+static CmtThreadPoolHandle g_logSinkPool = 0;
+static CmtTLVHandle g_logExperimentTLV = 0;      // Experiment id of each logging thread
+static volatile int g_logNextExperimentId = 0;
+
+/******************************************************************************
+ * Repeat Suppression Variables
+ ******************************************************************************/
+static LogSite g_logSites[LOG_SITE_TABLE_SIZE];
+static LogSiteOverride g_logSiteOverrides[LOG_SITE_MAX_OVERRIDES];
+static int g_logSiteOverrideCount = 0;
+static volatile int g_logSiteLimit = LOG_SITE_DEFAULT_LIMIT;
+static volatile int g_logSiteWindowMs = LOG_SITE_WINDOW_MS;
+static CmtThreadLockHandle g_logSiteLock = 0;
+
+/******************************************************************************
+ * UI Output Variables
+ ******************************************************************************/
+// Logging threads append to the pending batch; a single deferred call swaps
+// in the other batch and inserts everything at once, so the UI thread does
+// one textbox update per frame however many lines arrived.
+static UILineBatch g_uiBatches[2];
+static UILineBatch *g_uiPendingBatch = &g_uiBatches[0];
+static volatile int g_uiFlushPosted = 0;
+static CmtThreadLockHandle g_uiBatchLock = 0;
 
 /******************************************************************************
  * Internal Function Prototypes
  ******************************************************************************/
 static void LogMessageInternalEx(LogDevice device, LogLevel level, const char *format, va_list args);
-static void WriteToLogFile(const char *timestamp, const char *deviceStr, const char *levelStr, const char *message);
+static void LogDispatch(LogDevice device, LogLevel level, const char *format, va_list args, bool waitForDisk);
+static bool LogSite_Admit(LogDevice device, LogLevel level, const char *format);
+static LogSite* LogSite_Lookup(LogDevice device, const char *format);
+static LogSite* LogSite_Claim(LogDevice device, LogLevel level, const char *format, int nowMs);
+static int LogSite_NowMs(void);
+static int LogSite_TakeWindow(LogSite *site, int nowMs, int *suppressed);
+static int LogSite_OverrideFor(const char *format);
+static void LogSite_Sweep(bool force);
+static void LogSite_Report(LogDevice device, LogLevel level, const char *format, ...);
+static int WriteToLogFile(const LogRecord *record, const char *message, time_t recordTime, const char *logLine);
+static void LogSinks_Route(const LogRecord *record, const char *logLine);
+static bool LogSink_Matches(const LogSinkFilter *filter, const LogRecord *record);
+static int CVICALLBACK LogSinkThread(void *functionData);
+static void LogSink_Stop(LogSink *sink);
+static int FindLogSegments(const char *directory, int *first, int *last);
+static void BuildSegmentPath(const char *directory, int number, const char *extension, char *path, int pathSize);
+static int OpenLogSegment(const char *directory, int number);
+static int OpenNextLogSegment(const char *directory);
+static void CloseLogSegment(void);
+static void PruneLogSegments(const char *directory, int newestToDelete);
+static int QueryLogSegment(const char *directory, int number, time_t startTime, time_t endTime,
+                           LogQueryCallback callback, void *userData, int *stop);
+static void FlushLogFiles(void);
+static int WriteLogRecord(const LogRecord *record);
+static void WriteRecordToUI(const LogRecord *record, const char *message);
+static const char* LogFormat_NextSpec(const char *p, LogFormatSpec *spec);
+static int LogArgs_Capture(const char *format, va_list args, char *buffer, int bufferSize);
+static void LogArgs_Format(const char *format, const char *buffer, char *output, int outputSize);
 static void WriteToUI(const char *message);
 static char* ProcessTabs(const char *input);
 static int InitializeLogging(void);
 static void CleanupLogging(void);
 static void CVICALLBACK DeferredTextBoxUpdate(void *callbackData);
+static void UIBatch_Append(const char *line);
+static int StartLogWriter(void);
+static void StopLogWriter(void);
+static int CVICALLBACK LogWriterThread(void *functionData);
+static bool LogRing_Push(LogLevel level, LogDevice device, int experimentId, int64_t monotonicNs,
+                         int threadId, const char *format, va_list args, int *position);
+static int LogCrashRing_Open(const char *directory);
+static void LogCrashRing_Close(void);
+static void LogCrashRing_Write(const LogRecord *record, int argsLength);
+static int LogCrashRing_CompareSlots(const void *a, const void *b);
+static void FormatLogLine(const LogRecord *record, const char *message, int64_t anchorWallNs,
+                          int64_t anchorMonotonicNs, char *line, int lineSize, time_t *wallTime);
+static int64_t LogClock_MonotonicNs(void);
+static void LogClock_Anchor(void);
+static time_t LogClock_ToWall(int64_t anchorWallNs, int64_t anchorMonotonicNs,
+                              int64_t monotonicNs, int *microseconds);
+static void LogClock_WriteAnchor(FILE *file);
+static int LogRing_Drain(void);
+static void WaitForLogWriter(int position);
 
 /******************************************************************************
  * Deferred UI Update Callback
  ******************************************************************************/
 static void CVICALLBACK DeferredTextBoxUpdate(void *callbackData) {
-    UIUpdateData *data = (UIUpdateData*)callbackData;
+    if (!g_uiBatchLock) {
+        return;
+    }
     
-    if (data && data->panel > 0 && data->control > 0 && data->text) {
-        InsertTextBoxLine(data->panel, data->control, -1, data->text);
-        
-        // Auto-scroll to the end
-        int totalLines;
-        GetNumTextBoxLines(data->panel, data->control, &totalLines);
-        if (totalLines > 0) {
-            SetCtrlAttribute(data->panel, data->control, 
-                           ATTR_FIRST_VISIBLE_LINE, totalLines);
-        }
-        
-        // Clean up
-        free(data->text);
-        free(data);
+    // Take the pending batch and let producers fill the other one. Batches
+    // are only ever read here, on the UI thread, so the other one is idle.
+    CmtGetLock(g_uiBatchLock);
+    UILineBatch *batch = g_uiPendingBatch;
+    g_uiPendingBatch = (batch == &g_uiBatches[0]) ? &g_uiBatches[1] : &g_uiBatches[0];
+    g_uiPendingBatch->start = 0;
+    g_uiPendingBatch->count = 0;
+    g_uiPendingBatch->skipped = 0;
+    InterlockedExchange(&g_uiFlushPosted, 0);
+    CmtReleaseLock(g_uiBatchLock);
+    
+    if (g_mainPanelHandle <= 0 || (batch->count == 0 && batch->skipped == 0)) {
+        return;
+    }
+    
+    if (batch->skipped > 0) {
+        char notice[64];
+        snprintf(notice, sizeof(notice), "[WARN] %d log lines not shown (see log file)", batch->skipped);
+        InsertTextBoxLine(g_mainPanelHandle, PANEL_OUTPUT_TEXTBOX, -1, notice);
+    }
+    
+    for (int i = 0; i < batch->count; i++) {
+        int index = (batch->start + i) % LOG_UI_MAX_LINES;
+        InsertTextBoxLine(g_mainPanelHandle, PANEL_OUTPUT_TEXTBOX, -1, batch->lines[index]);
+    }
+    
+    // Keep the textbox bounded, then auto-scroll to the end once
+    int totalLines;
+    GetNumTextBoxLines(g_mainPanelHandle, PANEL_OUTPUT_TEXTBOX, &totalLines);
+    if (totalLines > LOG_UI_MAX_LINES) {
+        DeleteTextBoxLines(g_mainPanelHandle, PANEL_OUTPUT_TEXTBOX, 0, totalLines - LOG_UI_MAX_LINES);
+        totalLines = LOG_UI_MAX_LINES;
+    }
+    if (totalLines > 0) {
+        SetCtrlAttribute(g_mainPanelHandle, PANEL_OUTPUT_TEXTBOX, 
+                       ATTR_FIRST_VISIBLE_LINE, totalLines);
+    }
+}
+
+static void UIBatch_Append(const char *line) {
+    UILineBatch *batch = g_uiPendingBatch;
+    int index;
+    
+    if (batch->count < LOG_UI_MAX_LINES) {
+        index = (batch->start + batch->count) % LOG_UI_MAX_LINES;
+        batch->count++;
+    } else {
+        // Full - the oldest pending line would scroll out of the textbox anyway
+        index = batch->start;
+        batch->start = (batch->start + 1) % LOG_UI_MAX_LINES;
+        batch->skipped++;
     }
+    
+    strncpy(batch->lines[index], line, LOG_UI_LINE_LEN - 1);
+    batch->lines[index][LOG_UI_LINE_LEN - 1] = '\0';
 }
 
 /******************************************************************************
@@ -115,11 +442,25 @@ static int InitializeLogging(void) {
         return SUCCESS;
     }
     
-    // Create thread-safe queue for log messages
-    if (CmtNewTSQ(100, sizeof(char*), 0, &g_logQueue) < 0) {
+    if (CmtNewLock(NULL, 0, &g_logFileLock) < 0) {
+        return ERR_THREAD_SYNC;
+    }
+    
+    if (CmtNewLock(NULL, 0, &g_uiBatchLock) < 0) {
+        return ERR_THREAD_SYNC;
+    }
+    
+    if (CmtNewLock(NULL, 0, &g_logSiteLock) < 0) {
+        return ERR_THREAD_SYNC;
+    }
+    
+    int noExperiment = 0;
+    if (CmtNewThreadLocalVar(sizeof(int), &noExperiment, NULL, NULL, &g_logExperimentTLV) < 0) {
         return ERR_THREAD_SYNC;
     }
     
+    LogClock_Anchor();
+    
     // Mark as initialized early so we can use logging functions
     g_loggingInitialized = 1;
     
@@ -143,54 +484,22 @@ static int InitializeLogging(void) {
         if (len > 0 && logPath[len-1] != PATH_SEPARATOR_CHAR) {
             strcat(logPath, PATH_SEPARATOR);
         }
-        strcat(logPath, LOG_FILE_NAME);
         
-        // Store the attempted log path
-        strncpy(g_actualLogPath, logPath, sizeof(g_actualLogPath));
-        
-        // Debug: Print log file path
+        // Debug: Print log directory
         #ifdef _DEBUG
-        printf("Log file path: %s\n", logPath);
+        printf("Log directory: %s\n", logPath);
         #endif
         
-        /*// Check if log file is too large
-        if (FileExists(logPath)) {
-            FILE *checkFile = fopen(logPath, "r");
-            if (checkFile) {
-                fseek(checkFile, 0, SEEK_END);
-                long fileSize = ftell(checkFile);
-                fclose(checkFile);
-                
-                // If too large, rename old log
-                if (fileSize > MAX_LOG_FILE_SIZE) {
-                    char backupPath[MAX_PATH_LENGTH];
-                    SAFE_SPRINTF(backupPath, sizeof(backupPath), "%s.old", logPath);
-                    remove(backupPath);
-                    rename(logPath, backupPath);
-                }
-            }
-        }*/
-        
-        // Try to open/create the log file
-        g_logFile = fopen(logPath, "w");
-        if (!g_logFile) {
+        // Each run starts a new segment after the ones already on disk
+        if (OpenNextLogSegment(logPath) != SUCCESS) {
             // Try creating in current directory as fallback
-            g_logFile = fopen(LOG_FILE_NAME, "a");
-            
-            if (!g_logFile) {
+            if (OpenNextLogSegment("") != SUCCESS) {
                 // Last resort - try temp directory
                 #ifdef _WIN32
                     char tempPath[MAX_PATH_LENGTH];
                     GetTempPath(sizeof(tempPath), tempPath);
-                    strcat(tempPath, LOG_FILE_NAME);
-                    g_logFile = fopen(tempPath, "a");
-                    if (g_logFile) {
-                        strncpy(g_actualLogPath, tempPath, sizeof(g_actualLogPath));
-                    }
+                    OpenNextLogSegment(tempPath);
                 #endif
-            } else {
-                // Update actual path to current directory
-                strncpy(g_actualLogPath, LOG_FILE_NAME, sizeof(g_actualLogPath));
             }
         }
         
@@ -215,6 +524,18 @@ static int InitializeLogging(void) {
             #ifdef _DEBUG
             printf("Log file created at: %s\n", g_actualLogPath);
             #endif
+            
+            // Keep the most recent records where a crash cannot take them
+            int recovered = LogCrashRing_Open(g_logDirectory);
+            if (recovered > 0) {
+                LogWarning("Previous run ended unexpectedly - its last %d log records were recovered to %s",
+                           recovered, g_logCrashRecoveredPath);
+            }
+            
+            // Disk writes move off the logging threads from here on
+            if (StartLogWriter() != SUCCESS && g_mainPanelHandle > 0) {
+                WriteToUI("[WARNING] Could not start log writer thread - writing log file synchronously");
+            }
         } else {
             // If we still can't open the log file, disable file logging
             g_logToFile = 0;
@@ -225,7 +546,7 @@ static int InitializeLogging(void) {
                 
                 char errorMsg[LARGE_BUFFER_SIZE];
                 snprintf(errorMsg, sizeof(errorMsg), 
-                    "[WARNING] Failed to create log file at: %s", logPath);
+                    "[WARNING] Failed to create log file in: %s", logPath);
                 WriteToUI(errorMsg);
                 
                 WriteToUI("[WARNING] Logging to file has been disabled");
@@ -234,7 +555,7 @@ static int InitializeLogging(void) {
             }
             
             #ifdef _DEBUG
-            printf("Failed to create log file at: %s\n", logPath);
+            printf("Failed to create log file in: %s\n", logPath);
             #endif
         }
     }
@@ -274,22 +595,53 @@ static void CleanupLogging(void) {
         return;
     }
     
+    // Write out everything still buffered before closing, including the
+    // counts of lines suppressed in windows that have not ended yet
+    StopLogWriter();
+    LogSite_Sweep(true);
+    LogCrashRing_Close();
+    
     // Close log file
     if (g_logFile) {
         time_t now = time(NULL);
         char timeStr[64];
         FormatTimestamp(now, timeStr, sizeof(timeStr));
         fprintf(g_logFile, "=== Battery Tester Log Ended: %s ===\n", timeStr);
-        fclose(g_logFile);
-        g_logFile = NULL;
+        CloseLogSegment();
+    }
+    
+    // Stop the sink writers. Sinks given a FILE pointer leave it open, as
+    // g_externalLogFile does - the caller manages those
+    for (int i = 0; i < LOG_MAX_SINKS; i++) {
+        if (g_logSinks[i].active) {
+            LogSinkRemove(i + 1);
+        }
+    }
+    if (g_logSinkPool) {
+        CmtDiscardThreadPool(g_logSinkPool);
+        g_logSinkPool = 0;
+    }
+    g_externalLogFile = NULL;
+    g_externalLogSink = 0;
+    
+    if (g_logFileLock) {
+        CmtDiscardLock(g_logFileLock);
+        g_logFileLock = 0;
+    }
+    
+    if (g_uiBatchLock) {
+        CmtDiscardLock(g_uiBatchLock);
+        g_uiBatchLock = 0;
     }
     
-    // Note: We don't close g_externalLogFile here as it's managed externally
+    if (g_logSiteLock) {
+        CmtDiscardLock(g_logSiteLock);
+        g_logSiteLock = 0;
+    }
     
-    // Dispose of queue
-    if (g_logQueue) {
-        CmtDiscardTSQ(g_logQueue);
-        g_logQueue = 0;
+    if (g_logExperimentTLV) {
+        CmtDiscardThreadLocalVar(g_logExperimentTLV);
+        g_logExperimentTLV = 0;
     }
     
     g_loggingInitialized = 0;
@@ -299,186 +651,1673 @@ static void CleanupLogging(void) {
  * Internal Logging Implementation
  ******************************************************************************/
 static void LogMessageInternalEx(LogDevice device, LogLevel level, const char *format, va_list args) {
-    char rawBuffer[MAX_LOG_LINE_LEN];
-    char timeStr[64];
-    time_t now;
-    
     // Initialize logging if needed
     if (!g_loggingInitialized) {
         InitializeLogging();
     }
     
-    // Format the message
-    vsnprintf(rawBuffer, sizeof(rawBuffer) - 1, format, args);
-    rawBuffer[sizeof(rawBuffer) - 1] = '\0';
+    // Drop repeats from call sites over their rate limit
+    if (!LogSite_Admit(device, level, format)) {
+        return;
+    }
+    
+    LogDispatch(device, level, format, args, level == LOG_LEVEL_ERROR);
+}
+
+static void LogDispatch(LogDevice device, LogLevel level, const char *format, va_list args, bool waitForDisk) {
+    int64_t now = LogClock_MonotonicNs();
+    int threadId = CmtGetCurrentThreadID();
+    int experimentId = LogGetThreadExperiment();
+    
+    // Hand the record to the writer thread, which formats it for the file and
+    // the UI. Errors wait until they are on disk; if the ring is full the line
+    // is counted and reported by the writer.
+    if (g_logWriterState == LOG_WRITER_RUNNING) {
+        int position;
+        if (LogRing_Push(level, device, experimentId, now, threadId, format, args, &position) && waitForDisk) {
+            WaitForLogWriter(position + 1);
+        }
+        return;
+    }
+    
+    // No writer thread - format and write synchronously
+    LogRecord record = {now, threadId, level, device, experimentId, NULL};
+    vsnprintf(record.message, sizeof(record.message) - 1, format, args);
+    record.message[sizeof(record.message) - 1] = '\0';
+    LogCrashRing_Write(&record, 0);
     
-    // Get timestamp
-    now = time(NULL);
-    FormatTimestamp(now, timeStr, sizeof(timeStr));
+    if (g_logFileLock) CmtGetLock(g_logFileLock);
+    WriteLogRecord(&record);
+    FlushLogFiles();
+    if (g_logFileLock) CmtReleaseLock(g_logFileLock);
+}
+
+/******************************************************************************
+ * Repeat Suppression
+ ******************************************************************************/
+
+// Count the line against its call site, returns false once the site has used
+// up its limit for the current window. The first line after a window with
+// suppressed lines is preceded by a summary of how many were dropped. Counts
+// are exact per thread but may be off by a line or two across threads racing
+// a window change, which is fine for a rate limit.
+static bool LogSite_Admit(LogDevice device, LogLevel level, const char *format) {
+    int reportCount = 0;
+    int reportMs = 0;
+    bool admit = true;
     
-    // Get level string
-    const char *levelStr = (level >= 0 && level < ARRAY_SIZE(g_logLevelNames)) 
-                          ? g_logLevelNames[level] : "UNKNOWN";
+    if (!g_logSiteLock || (g_logSiteLimit <= 0 && g_logSiteOverrideCount == 0)) {
+        return true;
+    }
     
-    // Get device string
-    const char *deviceStr = (device >= 0 && device < ARRAY_SIZE(g_deviceNames))
-                           ? g_deviceNames[device] : "";
+    int nowMs = LogSite_NowMs();
     
-    // Write to log file
-    if (g_logToFile && g_logFile) {
-        WriteToLogFile(timeStr, deviceStr, levelStr, rawBuffer);
+    LogSite *site = LogSite_Lookup(device, format);
+    if (!site) {
+        CmtGetLock(g_logSiteLock);
+        site = LogSite_Claim(device, level, format, nowMs);
+        CmtReleaseLock(g_logSiteLock);
     }
     
-    // Write to UI (if not debug or if debug mode is on)
-    if (g_logToUI && g_mainPanelHandle > 0) {
-        if (level != LOG_LEVEL_DEBUG || g_debugMode) {
-            char uiMessage[MAX_LOG_LINE_LEN + 100];
-            
-            // Format message with level and device prefixes (level first)
-            if (device != LOG_DEVICE_NONE && strlen(deviceStr) > 0) {
-                snprintf(uiMessage, sizeof(uiMessage), "[%s] [%s] %s", 
-                         levelStr, deviceStr, rawBuffer);
-            } else {
-                snprintf(uiMessage, sizeof(uiMessage), "[%s] %s", 
-                         levelStr, rawBuffer);
-            }
-            
-            WriteToUI(uiMessage);
+    if (site) {
+        reportMs = LogSite_TakeWindow(site, nowMs, &reportCount);
+        
+        int limit = (site->limit >= 0) ? site->limit : g_logSiteLimit;
+        if (limit > 0 && InterlockedIncrement(&site->count) > limit) {
+            InterlockedIncrement(&site->suppressed);
+            admit = false;
+        }
+    }
+    
+    if (reportCount > 0) {
+        LogSite_Report(device, level, LOG_SITE_SUMMARY_FORMAT, reportCount, reportMs / 1000.0, format);
+    }
+    
+    return admit;
+}
+
+// Milliseconds on the Timer() clock, wrapping; compare with LogSite_ElapsedMs
+static int LogSite_NowMs(void) {
+    return (int)(unsigned int)(long long)(Timer() * 1000.0);
+}
+
+static int LogSite_ElapsedMs(const LogSite *site, int nowMs) {
+    return (int)((unsigned int)nowMs - (unsigned int)site->windowStartMs);
+}
+
+// Start a new window if the current one has ended. The thread that moves the
+// window start takes the suppressed count for its summary and gets the age of
+// the old window back; everyone else gets 0.
+static int LogSite_TakeWindow(LogSite *site, int nowMs, int *suppressed) {
+    int start = site->windowStartMs;
+    int elapsedMs = (int)((unsigned int)nowMs - (unsigned int)start);
+    
+    *suppressed = 0;
+    if (elapsedMs < g_logSiteWindowMs ||
+        InterlockedCompareExchange(&site->windowStartMs, nowMs, start) != start) {
+        return 0;
+    }
+    
+    InterlockedExchange(&site->count, 0);
+    *suppressed = InterlockedExchange(&site->suppressed, 0);
+    return elapsedMs;
+}
+
+// Find the slot of a call site without taking a lock. Returns NULL if the
+// site has no slot yet or its slot is being claimed.
+static LogSite* LogSite_Lookup(LogDevice device, const char *format) {
+    unsigned int hash = (unsigned int)((uintptr_t)format >> 2) ^ ((unsigned int)device * 2654435761u);
+    
+    for (int i = 0; i < LOG_SITE_PROBE_LENGTH; i++) {
+        LogSite *site = &g_logSites[(hash + i) & (LOG_SITE_TABLE_SIZE - 1)];
+        
+        int sequence = site->sequence;
+        if (sequence & 1) continue;
+        if (site->format == format && site->device == device && site->sequence == sequence) {
+            return site;
         }
     }
+    
+    return NULL;
 }
 
-static void WriteToLogFile(const char *timestamp, const char *deviceStr, const char *levelStr, const char *message) {
-    const char *logLine;
-    char formattedLine[MAX_LOG_LINE_LEN];
+// Find or claim the slot for a call site. A site that has gone quiet without
+// pending suppressed lines can be taken over. Returns NULL when the probed
+// slots are all busy, in which case the line is not rate limited. Caller
+// holds g_logSiteLock.
+static LogSite* LogSite_Claim(LogDevice device, LogLevel level, const char *format, int nowMs) {
+    unsigned int hash = (unsigned int)((uintptr_t)format >> 2) ^ ((unsigned int)device * 2654435761u);
+    LogSite *candidate = NULL;
     
-    // Format the log line once
-    if (deviceStr && strlen(deviceStr) > 0) {
-        snprintf(formattedLine, sizeof(formattedLine), "%s [%s] [%s] %s\n", 
-                 timestamp, levelStr, deviceStr, message);
-    } else {
-        snprintf(formattedLine, sizeof(formattedLine), "%s [%s] %s\n", 
-                 timestamp, levelStr, message);
+    for (int i = 0; i < LOG_SITE_PROBE_LENGTH; i++) {
+        LogSite *site = &g_logSites[(hash + i) & (LOG_SITE_TABLE_SIZE - 1)];
+        
+        // Claimed by another thread since our lookup
+        if (site->format == format && site->device == device) {
+            return site;
+        }
+        if (!candidate && (site->format == NULL ||
+            (site->suppressed == 0 && LogSite_ElapsedMs(site, nowMs) >= g_logSiteWindowMs))) {
+            candidate = site;
+        }
     }
-    logLine = formattedLine;
     
-    // Write to main log file
-    if (g_logFile) {
-        fprintf(g_logFile, "%s", logLine);
-        fflush(g_logFile);  // Ensure immediate write
+    if (candidate) {
+        InterlockedIncrement(&candidate->sequence);
+        candidate->format = format;
+        candidate->device = device;
+        candidate->level = level;
+        candidate->limit = LogSite_OverrideFor(format);
+        candidate->windowStartMs = nowMs;
+        candidate->count = 0;
+        candidate->suppressed = 0;
+        InterlockedIncrement(&candidate->sequence);
     }
     
-    // Write to external log file if set
-    if (g_externalLogFile) {
-        fprintf(g_externalLogFile, "%s", logLine);
-        fflush(g_externalLogFile);  // Ensure immediate write
+    return candidate;
+}
+
+// Caller holds g_logSiteLock
+static int LogSite_OverrideFor(const char *format) {
+    for (int i = 0; i < g_logSiteOverrideCount; i++) {
+        if (strncmp(g_logSiteOverrides[i].format, format, LOG_SITE_FORMAT_LEN - 1) == 0) {
+            return g_logSiteOverrides[i].limit;
+        }
     }
+    return -1;
 }
 
-static void WriteToUI(const char *message) {
-    if (g_mainPanelHandle <= 0) {
+// Report sites whose window has ended with suppressed lines, so a burst that
+// stops is still summarised. With force, report every pending count.
+static void LogSite_Sweep(bool force) {
+    struct {
+        LogDevice device;
+        LogLevel level;
+        const char *format;
+        int count;
+        double seconds;
+    } reports[16];
+    int reportCount = 0;
+    
+    if (!g_logSiteLock) {
         return;
     }
     
-    // Process tabs in the message
-    char *processedMessage = ProcessTabs(message);
-    if (!processedMessage) {
-        return;
+    int nowMs = LogSite_NowMs();
+    
+    // The lock keeps slots from being claimed under us; logging threads may
+    // still count against them, the window start decides who reports
+    CmtGetLock(g_logSiteLock);
+    for (int i = 0; i < LOG_SITE_TABLE_SIZE && reportCount < ARRAY_SIZE(reports); i++) {
+        LogSite *site = &g_logSites[i];
+        if (site->format == NULL || site->suppressed == 0) continue;
+        
+        int start = site->windowStartMs;
+        int elapsedMs = LogSite_ElapsedMs(site, nowMs);
+        if (!force && elapsedMs < g_logSiteWindowMs) continue;
+        if (InterlockedCompareExchange(&site->windowStartMs, nowMs, start) != start) continue;
+        
+        InterlockedExchange(&site->count, 0);
+        reports[reportCount].count = InterlockedExchange(&site->suppressed, 0);
+        if (reports[reportCount].count == 0) continue;
+        
+        reports[reportCount].device = site->device;
+        reports[reportCount].level = site->level;
+        reports[reportCount].format = site->format;
+        reports[reportCount].seconds = elapsedMs / 1000.0;
+        reportCount++;
     }
+    CmtReleaseLock(g_logSiteLock);
     
-    // Split by newlines and add to textbox
-    char *processingString = my_strdup(processedMessage);
-    if (!processingString) {
-        free(processedMessage);
-        return;
+    for (int i = 0; i < reportCount; i++) {
+        LogSite_Report(reports[i].device, reports[i].level, LOG_SITE_SUMMARY_FORMAT,
+                       reports[i].count, reports[i].seconds, reports[i].format);
+    }
+}
+
+// Summaries bypass the rate limit and never wait for the writer, since the
+// writer thread itself sends them from its sweep
+static void LogSite_Report(LogDevice device, LogLevel level, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    LogDispatch(device, level, format, args, false);
+    va_end(args);
+}
+
+void SetLogRateLimit(int maxLinesPerWindow, int windowMs) {
+    g_logSiteLimit = MAX(0, maxLinesPerWindow);
+    if (windowMs > 0) {
+        g_logSiteWindowMs = windowMs;
+    }
+}
+
+int SetLogSiteRateLimit(const char *format, int maxLinesPerWindow) {
+    if (!format) {
+        return ERR_NULL_POINTER;
     }
     
-    char *savePtr;
-    char *line = my_strtok_r(processingString, "\n", &savePtr);
-    int lineCount = 0;
+    if (!g_loggingInitialized) {
+        InitializeLogging();
+    }
+    if (!g_logSiteLock) {
+        return ERR_NOT_INITIALIZED;
+    }
     
-    while (line != NULL && lineCount < MAX_LINES_PER_CALL) {
-        // Thread-safe UI update
-        if (GetCurrentThreadId() == MainThreadId()) {
-            // We're in the main thread, update directly
-            InsertTextBoxLine(g_mainPanelHandle, PANEL_OUTPUT_TEXTBOX, -1, line);
-        } else {
-            // We're in a background thread, use PostDeferredCall
-            UIUpdateData *updateData = malloc(sizeof(UIUpdateData));
-            if (updateData) {
-                updateData->panel = g_mainPanelHandle;
-                updateData->control = PANEL_OUTPUT_TEXTBOX;
-                updateData->text = my_strdup(line);
-                
-                if (updateData->text) {
-                    PostDeferredCall(DeferredTextBoxUpdate, updateData);
-                } else {
-                    free(updateData);
-                }
+    int result = SUCCESS;
+    int limit = (maxLinesPerWindow < 0) ? -1 : maxLinesPerWindow;
+    
+    CmtGetLock(g_logSiteLock);
+    
+    int index;
+    for (index = 0; index < g_logSiteOverrideCount; index++) {
+        if (strncmp(g_logSiteOverrides[index].format, format, LOG_SITE_FORMAT_LEN - 1) == 0) break;
+    }
+    
+    if (limit < 0) {
+        // Back to the default - remove the override
+        if (index < g_logSiteOverrideCount) {
+            g_logSiteOverrides[index] = g_logSiteOverrides[--g_logSiteOverrideCount];
+        }
+    } else if (index < g_logSiteOverrideCount) {
+        g_logSiteOverrides[index].limit = limit;
+    } else if (g_logSiteOverrideCount < LOG_SITE_MAX_OVERRIDES) {
+        strncpy(g_logSiteOverrides[index].format, format, LOG_SITE_FORMAT_LEN - 1);
+        g_logSiteOverrides[index].format[LOG_SITE_FORMAT_LEN - 1] = '\0';
+        g_logSiteOverrides[index].limit = limit;
+        g_logSiteOverrideCount++;
+    } else {
+        result = ERR_OPERATION_FAILED;
+    }
+    
+    // Apply to sites already being tracked
+    if (result == SUCCESS) {
+        for (int i = 0; i < LOG_SITE_TABLE_SIZE; i++) {
+            if (g_logSites[i].format &&
+                strncmp(g_logSites[i].format, format, LOG_SITE_FORMAT_LEN - 1) == 0) {
+                g_logSites[i].limit = limit;
             }
         }
-        
-        line = my_strtok_r(NULL, "\n", &savePtr);
-        lineCount++;
     }
     
-    // Auto-scroll to the end if in main thread
-    if (GetCurrentThreadId() == MainThreadId()) {
-        int totalLines;
-        GetNumTextBoxLines(g_mainPanelHandle, PANEL_OUTPUT_TEXTBOX, &totalLines);
-        if (totalLines > 0) {
-            SetCtrlAttribute(g_mainPanelHandle, PANEL_OUTPUT_TEXTBOX, 
-                           ATTR_FIRST_VISIBLE_LINE, totalLines);
+    CmtReleaseLock(g_logSiteLock);
+    return result;
+}
+
+// Writes one line to the main log file without flushing and indexes it,
+// returns the bytes written. Starts a new segment first when the current one
+// is full or old enough. Caller holds g_logFileLock.
+static int WriteToLogFile(const LogRecord *record, const char *message, time_t recordTime, const char *logLine) {
+    int written = 0;
+    
+    if (g_logFile && (g_logSegmentBytes >= MAX_LOG_FILE_SIZE ||
+                      recordTime - g_logSegmentStart >= LOG_SEGMENT_MAX_AGE_S)) {
+        if (OpenLogSegment(g_logDirectory, g_logSegmentNumber + 1) != SUCCESS) {
+            // Keep the current segment and try again after another full interval
+            g_logSegmentBytes = 0;
+            g_logSegmentStart = recordTime;
         }
     }
+    if (g_logFile) {
+        LogIndex_AddLine(&g_logIndex, recordTime, (int64_t)ftell(g_logFile),
+                         record->level, record->device, message);
+        written = fputs(logLine, g_logFile) >= 0 ? (int)strlen(logLine) : 0;
+        g_logSegmentBytes += written;
+    }
     
-    free(processingString);
-    free(processedMessage);
+    return written;
 }
 
-static char* ProcessTabs(const char *input) {
-    if (!input) return NULL;
+// Format a record and send it to the log file, the sinks and the UI, returns
+// the bytes written to the main log file. Caller holds g_logFileLock.
+static int WriteLogRecord(const LogRecord *record) {
+    char formatted[MAX_LOG_LINE_LEN];
+    const char *message = record->message;
+    int written = 0;
     
-    // Allocate buffer large enough for worst case (all tabs)
-    size_t maxLen = strlen(input) * TAB_WIDTH + 1;
-    char *output = (char*)malloc(maxLen);
-    if (!output) return NULL;
+    if (record->format) {
+        LogArgs_Format(record->format, record->message, formatted, sizeof(formatted));
+        message = formatted;
+    }
     
-    int i = 0, j = 0;
-    while (input[i] != '\0' && j < maxLen - 1) {
-        if (input[i] == '\t') {
-            // Replace tab with spaces
-            for (int k = 0; k < TAB_WIDTH && j < maxLen - 1; k++) {
-                output[j++] = ' ';
-            }
-        } else {
-            output[j++] = input[i];
+    if ((g_logToFile && g_logFile) || g_logSinkCount > 0) {
+        char logLine[MAX_LOG_LINE_LEN];
+        time_t wallTime;
+        
+        // Format the log line once for every destination
+        FormatLogLine(record, message, g_logAnchorWallNs, g_logAnchorMonotonicNs,
+                      logLine, sizeof(logLine), &wallTime);
+        
+        if (g_logToFile && g_logFile) {
+            written = WriteToLogFile(record, message, wallTime, logLine);
         }
-        i++;
+        LogSinks_Route(record, logLine);
     }
-    output[j] = '\0';
     
-    return output;
+    WriteRecordToUI(record, message);
+    return written;
 }
 
-/******************************************************************************
- * Public Logging Functions - Extended versions with device support
- ******************************************************************************/
-void LogMessageEx(LogDevice device, const char *format, ...) {
-    va_list args;
-    va_start(args, format);
-    LogMessageInternalEx(device, LOG_LEVEL_INFO, format, args);
-    va_end(args);
+// Render a record as a log file line: wall time (us), monotonic time (ns),
+// thread, level, device, message
+static void FormatLogLine(const LogRecord *record, const char *message, int64_t anchorWallNs,
+                          int64_t anchorMonotonicNs, char *line, int lineSize, time_t *wallTime) {
+    char timeStr[64];
+    int microseconds;
+    
+    *wallTime = LogClock_ToWall(anchorWallNs, anchorMonotonicNs, record->monotonicNs, &microseconds);
+    FormatTimestamp(*wallTime, timeStr, sizeof(timeStr));
+    
+    const char *levelStr = (record->level >= 0 && record->level < ARRAY_SIZE(g_logLevelNames)) 
+                          ? g_logLevelNames[record->level] : "UNKNOWN";
+    const char *deviceStr = (record->device >= 0 && record->device < ARRAY_SIZE(g_deviceNames))
+                           ? g_deviceNames[record->device] : "";
+    long long monoSeconds = (long long)(record->monotonicNs / 1000000000);
+    int monoNanoseconds = (int)(record->monotonicNs % 1000000000);
+    
+    if (strlen(deviceStr) > 0) {
+        snprintf(line, lineSize, "%s.%06d +%lld.%09d [T%d] [%s] [%s] %s\n", 
+                 timeStr, microseconds, monoSeconds, monoNanoseconds, record->threadId,
+                 levelStr, deviceStr, message);
+    } else {
+        snprintf(line, lineSize, "%s.%06d +%lld.%09d [T%d] [%s] %s\n", 
+                 timeStr, microseconds, monoSeconds, monoNanoseconds, record->threadId,
+                 levelStr, message);
+    }
 }
 
-void LogErrorEx(LogDevice device, const char *format, ...) {
-    va_list args;
-    va_start(args, format);
-    LogMessageInternalEx(device, LOG_LEVEL_ERROR, format, args);
-    va_end(args);
+static void WriteRecordToUI(const LogRecord *record, const char *message) {
+    // Write to UI (if not debug or if debug mode is on)
+    if (!g_logToUI || g_mainPanelHandle <= 0) return;
+    if (record->level == LOG_LEVEL_DEBUG && !g_debugMode) return;
+    
+    const char *levelStr = (record->level >= 0 && record->level < ARRAY_SIZE(g_logLevelNames)) 
+                          ? g_logLevelNames[record->level] : "UNKNOWN";
+    const char *deviceStr = (record->device >= 0 && record->device < ARRAY_SIZE(g_deviceNames))
+                           ? g_deviceNames[record->device] : "";
+    char uiMessage[MAX_LOG_LINE_LEN + 100];
+    
+    // Format message with level and device prefixes (level first)
+    if (record->device != LOG_DEVICE_NONE && strlen(deviceStr) > 0) {
+        snprintf(uiMessage, sizeof(uiMessage), "[%s] [%s] %s", 
+                 levelStr, deviceStr, message);
+    } else {
+        snprintf(uiMessage, sizeof(uiMessage), "[%s] %s", 
+                 levelStr, message);
+    }
+    
+    WriteToUI(uiMessage);
 }
 
-void LogWarningEx(LogDevice device, const char *format, ...) {
+/******************************************************************************
+ * Log Clock
+ ******************************************************************************/
+
+static int64_t LogClock_MonotonicNs(void) {
+    LARGE_INTEGER counter;
+    
+    if (g_logClockFrequency == 0) {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        g_logClockFrequency = frequency.QuadPart;
+    }
+    
+    QueryPerformanceCounter(&counter);
+    
+    // Split to keep ticks * 1e9 from overflowing
+    int64_t ticks = counter.QuadPart;
+    return (ticks / g_logClockFrequency) * 1000000000 +
+           (ticks % g_logClockFrequency) * 1000000000 / g_logClockFrequency;
+}
+
+// Pair the monotonic clock with the system clock. Caller holds g_logFileLock
+// once logging is initialized.
+static void LogClock_Anchor(void) {
+    FILETIME fileTime;
+    
+    int64_t monotonicNs = LogClock_MonotonicNs();
+    GetSystemTimeAsFileTime(&fileTime);
+    
+    // FILETIME counts 100 ns intervals since 1601-01-01
+    int64_t intervals = ((int64_t)fileTime.dwHighDateTime << 32) | fileTime.dwLowDateTime;
+    g_logAnchorWallNs = (intervals - 116444736000000000LL) * 100;
+    g_logAnchorMonotonicNs = monotonicNs;
+    
+    if (g_logCrashHeader) {
+        g_logCrashHeader->anchorWallNs = g_logAnchorWallNs;
+        g_logCrashHeader->anchorMonotonicNs = g_logAnchorMonotonicNs;
+    }
+}
+
+static time_t LogClock_ToWall(int64_t anchorWallNs, int64_t anchorMonotonicNs,
+                              int64_t monotonicNs, int *microseconds) {
+    int64_t wallNs = anchorWallNs + (monotonicNs - anchorMonotonicNs);
+    
+    *microseconds = (int)((wallNs % 1000000000) / 1000);
+    return (time_t)(wallNs / 1000000000);
+}
+
+static void LogClock_WriteAnchor(FILE *file) {
+    char timeStr[64];
+    int microseconds;
+    
+    time_t wallTime = LogClock_ToWall(g_logAnchorWallNs, g_logAnchorMonotonicNs,
+                                      g_logAnchorMonotonicNs, &microseconds);
+    FormatTimestamp(wallTime, timeStr, sizeof(timeStr));
+    fprintf(file, "=== Clock anchor: %s.%06d = monotonic %lld ns ===\n",
+            timeStr, microseconds, (long long)g_logAnchorMonotonicNs);
+}
+
+/******************************************************************************
+ * Crash Ring
+ ******************************************************************************/
+
+// Map the crash ring next to the log files. A ring left behind by a run that
+// did not shut down cleanly is decoded first, returns the records recovered.
+static int LogCrashRing_Open(const char *directory) {
+    char path[MAX_PATH_LENGTH];
+    DWORD size = sizeof(LogCrashHeader) + LOG_CRASH_SLOT_COUNT * sizeof(LogCrashSlot);
+    int recovered = 0;
+    
+    // Already mapped by an earlier initialization of this process
+    if (g_logCrashHeader) {
+        g_logCrashHeader->cleanShutdown = 0;
+        return 0;
+    }
+    
+    snprintf(path, sizeof(path), "%s%s", directory, LOG_CRASH_RING_NAME);
+    
+    if (FileExists(path)) {
+        LogCrashHeader previous;
+        int headerRead = 0;
+        
+        FILE *file = fopen(path, "rb");
+        if (file) {
+            headerRead = (fread(&previous, sizeof(previous), 1, file) == 1);
+            fclose(file);
+        }
+        
+        if (headerRead && previous.magic == LOG_CRASH_MAGIC &&
+            !previous.cleanShutdown && previous.writePosition > 0) {
+            char stamp[32];
+            time_t now = time(NULL);
+            strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", localtime(&now));
+            snprintf(g_logCrashRecoveredPath, sizeof(g_logCrashRecoveredPath), "%s%s_crash_%s%s",
+                     directory, LOG_FILE_BASE_NAME, stamp, LOG_SEGMENT_EXT);
+            recovered = LogDecodeCrashRing(path, g_logCrashRecoveredPath);
+        }
+    }
+    
+    HANDLE file = CreateFile(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+                             OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return recovered;
+    }
+    
+    HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READWRITE, 0, size, NULL);
+    void *view = mapping ? MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size) : NULL;
+    if (!view) {
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        return recovered;
+    }
+    
+    memset(view, 0, size);
+    LogCrashHeader *header = (LogCrashHeader*)view;
+    header->magic = LOG_CRASH_MAGIC;
+    header->version = LOG_CRASH_VERSION;
+    header->slotSize = sizeof(LogCrashSlot);
+    header->slotCount = LOG_CRASH_SLOT_COUNT;
+    header->processId = (int)GetCurrentProcessId();
+    header->anchorWallNs = g_logAnchorWallNs;
+    header->anchorMonotonicNs = g_logAnchorMonotonicNs;
+    
+    g_logCrashFile = file;
+    g_logCrashMapping = mapping;
+    g_logCrashSlots = (LogCrashSlot*)(header + 1);
+    g_logCrashHeader = header;
+    
+    return recovered;
+}
+
+// Mark the ring as cleanly shut down. The view stays mapped until the process
+// exits so threads still logging during shutdown never touch unmapped memory.
+static void LogCrashRing_Close(void) {
+    if (g_logCrashHeader) {
+        g_logCrashHeader->cleanShutdown = 1;
+        FlushViewOfFile(g_logCrashHeader, 0);
+    }
+}
+
+// Copy a record into the next slot. Deferred records keep their format and
+// captured arguments; they are only formatted if the ring is ever decoded.
+static void LogCrashRing_Write(const LogRecord *record, int argsLength) {
+    LogCrashHeader *header = g_logCrashHeader;
+    if (!header) {
+        return;
+    }
+    
+    int position = InterlockedIncrement(&header->writePosition) - 1;
+    LogCrashSlot *slot = &g_logCrashSlots[position & (LOG_CRASH_SLOT_COUNT - 1)];
+    
+    slot->sequence = 0;
+    slot->threadId = record->threadId;
+    slot->monotonicNs = record->monotonicNs;
+    slot->level = (unsigned char)record->level;
+    slot->device = (unsigned char)record->device;
+    slot->flags = 0;
+    slot->argsLength = 0;
+    
+    const char *text = record->format ? record->format : record->message;
+    int textLength = MIN((int)strlen(text) + 1, (int)sizeof(slot->data));
+    memcpy(slot->data, text, textLength);
+    slot->data[textLength - 1] = '\0';
+    slot->formatLength = (unsigned short)textLength;
+    
+    if (!record->format) {
+        slot->flags = LOG_CRASH_PREFORMATTED;
+    } else if (argsLength > 0 && textLength + argsLength <= (int)sizeof(slot->data)) {
+        memcpy(slot->data + textLength, record->message, argsLength);
+        slot->argsLength = (unsigned short)argsLength;
+    } else if (argsLength > 0) {
+        slot->flags = LOG_CRASH_NO_ARGS;
+    }
+    
+    InterlockedExchange(&slot->sequence, position + 1);
+}
+
+static int LogCrashRing_CompareSlots(const void *a, const void *b) {
+    int first = ((const LogCrashSlot*)a)->sequence;
+    int second = ((const LogCrashSlot*)b)->sequence;
+    return (first > second) - (first < second);
+}
+
+int LogDecodeCrashRing(const char *ringPath, const char *outputPath) {
+    LogCrashHeader header;
+    
+    if (!ringPath || !outputPath) {
+        return ERR_NULL_POINTER;
+    }
+    
+    FILE *input = fopen(ringPath, "rb");
+    if (!input) {
+        return ERR_OPERATION_FAILED;
+    }
+    
+    if (fread(&header, sizeof(header), 1, input) != 1 || header.magic != LOG_CRASH_MAGIC ||
+        header.version != LOG_CRASH_VERSION || header.slotSize != (int)sizeof(LogCrashSlot) ||
+        header.slotCount <= 0 || header.slotCount > LOG_CRASH_SLOT_COUNT) {
+        fclose(input);
+        return ERR_NOT_SUPPORTED;
+    }
+    
+    LogCrashSlot *slots = malloc(header.slotCount * sizeof(LogCrashSlot));
+    if (!slots) {
+        fclose(input);
+        return ERR_OUT_OF_MEMORY;
+    }
+    
+    int count = (int)fread(slots, sizeof(LogCrashSlot), header.slotCount, input);
+    fclose(input);
+    
+    // Keep the completed slots, oldest first
+    int valid = 0;
+    for (int i = 0; i < count; i++) {
+        if (slots[i].sequence > 0) {
+            slots[valid++] = slots[i];
+        }
+    }
+    qsort(slots, valid, sizeof(LogCrashSlot), LogCrashRing_CompareSlots);
+    
+    FILE *output = fopen(outputPath, "w");
+    if (!output) {
+        free(slots);
+        return ERR_OPERATION_FAILED;
+    }
+    
+    fprintf(output, "=== Recovered from %s: last %d log records of process %d ===\n",
+            ringPath, valid, header.processId);
+    
+    for (int i = 0; i < valid; i++) {
+        LogCrashSlot *slot = &slots[i];
+        LogRecord record = {slot->monotonicNs, slot->threadId, (LogLevel)slot->level,
+                            (LogDevice)slot->device, LOG_EXPERIMENT_ANY, NULL};
+        char data[LOG_CRASH_SLOT_SIZE + 1];
+        char message[MAX_LOG_LINE_LEN];
+        char line[MAX_LOG_LINE_LEN];
+        time_t wallTime;
+        
+        // Zero padding terminates any argument string cut off by a torn write
+        memset(data, 0, sizeof(data));
+        memcpy(data, slot->data, sizeof(slot->data));
+        int formatLength = CLAMP((int)slot->formatLength, 1, (int)sizeof(slot->data));
+        
+        if (slot->flags & LOG_CRASH_PREFORMATTED) {
+            snprintf(message, sizeof(message), "%s", data);
+        } else if (slot->flags & LOG_CRASH_NO_ARGS) {
+            snprintf(message, sizeof(message), "%s (arguments not recorded)", data);
+        } else {
+            LogArgs_Format(data, data + formatLength, message, sizeof(message));
+        }
+        
+        FormatLogLine(&record, message, header.anchorWallNs, header.anchorMonotonicNs,
+                      line, sizeof(line), &wallTime);
+        fputs(line, output);
+    }
+    
+    fclose(output);
+    free(slots);
+    return valid;
+}
+
+static void FlushLogFiles(void) {
+    if (g_logFile) {
+        fflush(g_logFile);
+        LogIndex_SyncWriter(&g_logIndex, (int64_t)ftell(g_logFile));
+    }
+}
+
+/******************************************************************************
+ * Log Sinks
+ ******************************************************************************/
+
+static bool LogSink_Matches(const LogSinkFilter *filter, const LogRecord *record) {
+    if (record->level < filter->minLevel) return false;
+    if (filter->deviceMask != 0 && !(filter->deviceMask & LOG_SINK_DEVICE(record->device))) return false;
+    if (filter->experimentId != LOG_EXPERIMENT_ANY && filter->experimentId != record->experimentId) return false;
+    return true;
+}
+
+// Queue a copy of the line for every matching sink without waiting - a sink
+// that cannot keep up drops lines and reports how many. Caller holds g_logFileLock.
+static void LogSinks_Route(const LogRecord *record, const char *logLine) {
+    for (int i = 0; i < LOG_MAX_SINKS && g_logSinkCount > 0; i++) {
+        LogSink *sink = &g_logSinks[i];
+        if (!sink->active || !LogSink_Matches(&sink->filter, record)) continue;
+        
+        if (CmtWriteTSQData(sink->queue, logLine, 1, 0, NULL) < 1) {
+            InterlockedIncrement(&sink->dropped);
+        }
+    }
+}
+
+static int CVICALLBACK LogSinkThread(void *functionData) {
+    LogSink *sink = (LogSink*)functionData;
+    char line[MAX_LOG_LINE_LEN];
+    double lastFlushTime = Timer();
+    int unflushedBytes = 0;
+    
+    while (1) {
+        int itemsRead = CmtReadTSQData(sink->queue, line, 1, LOG_WRITER_WAKE_MS, 0);
+        if (itemsRead > 0) {
+            if (fputs(line, sink->file) >= 0) {
+                unflushedBytes += (int)strlen(line);
+            }
+        }
+        
+        int dropped = InterlockedExchange(&sink->dropped, 0);
+        if (dropped > 0) {
+            unflushedBytes += fprintf(sink->file, "=== %d log lines dropped - this log could not keep up ===\n", dropped);
+        }
+        
+        // Flush when idle, on size, or on age
+        if (unflushedBytes > 0 &&
+            (itemsRead <= 0 || unflushedBytes >= LOG_FLUSH_BATCH_BYTES ||
+             (Timer() - lastFlushTime) * 1000.0 >= LOG_FLUSH_INTERVAL_MS)) {
+            fflush(sink->file);
+            unflushedBytes = 0;
+            lastFlushTime = Timer();
+        }
+        
+        if (itemsRead <= 0 && sink->stopping) {
+            break;
+        }
+    }
+    
+    return 0;
+}
+
+LogSinkHandle LogSinkAddFile(FILE *file, const LogSinkFilter *filter) {
+    if (!file) {
+        return ERR_NULL_POINTER;
+    }
+    
+    if (!g_loggingInitialized) {
+        InitializeLogging();
+    }
+    
+    CmtGetLock(g_logFileLock);
+    
+    if (!g_logSinkPool && CmtNewThreadPool(LOG_MAX_SINKS, &g_logSinkPool) < 0) {
+        g_logSinkPool = 0;
+        CmtReleaseLock(g_logFileLock);
+        return ERR_THREAD_POOL;
+    }
+    
+    int index;
+    for (index = 0; index < LOG_MAX_SINKS && g_logSinks[index].active; index++);
+    if (index == LOG_MAX_SINKS) {
+        CmtReleaseLock(g_logFileLock);
+        return ERR_QUEUE_FULL;
+    }
+    
+    LogSink *sink = &g_logSinks[index];
+    memset(sink, 0, sizeof(*sink));
+    sink->file = file;
+    if (filter) {
+        sink->filter = *filter;
+    } else {
+        sink->filter.minLevel = LOG_LEVEL_DEBUG;
+        sink->filter.experimentId = LOG_EXPERIMENT_ANY;
+    }
+    
+    if (CmtNewTSQ(LOG_SINK_QUEUE_LINES, MAX_LOG_LINE_LEN, 0, &sink->queue) < 0) {
+        CmtReleaseLock(g_logFileLock);
+        return ERR_THREAD_SYNC;
+    }
+    
+    if (CmtScheduleThreadPoolFunction(g_logSinkPool, LogSinkThread, sink, &sink->threadId) < 0) {
+        CmtDiscardTSQ(sink->queue);
+        sink->queue = 0;
+        CmtReleaseLock(g_logFileLock);
+        return ERR_THREAD_CREATE;
+    }
+    
+    sink->active = 1;
+    g_logSinkCount++;
+    CmtReleaseLock(g_logFileLock);
+    
+    return index + 1;
+}
+
+LogSinkHandle LogSinkOpen(const char *path, const LogSinkFilter *filter) {
+    if (!path) {
+        return ERR_NULL_POINTER;
+    }
+    
+    FILE *file = fopen(path, "a");
+    if (!file) {
+        return ERR_OPERATION_FAILED;
+    }
+    
+    LogSinkHandle handle = LogSinkAddFile(file, filter);
+    if (handle <= 0) {
+        fclose(file);
+        return handle;
+    }
+    
+    g_logSinks[handle - 1].ownsFile = 1;
+    return handle;
+}
+
+// Let the sink's writer empty its queue and exit, then release it
+static void LogSink_Stop(LogSink *sink) {
+    sink->stopping = 1;
+    CmtWaitForThreadPoolFunctionCompletion(g_logSinkPool, sink->threadId, 0);
+    CmtReleaseThreadPoolFunctionID(g_logSinkPool, sink->threadId);
+    sink->threadId = 0;
+    
+    CmtDiscardTSQ(sink->queue);
+    sink->queue = 0;
+    
+    if (sink->ownsFile) {
+        fclose(sink->file);
+    }
+    sink->file = NULL;
+}
+
+int LogSinkRemove(LogSinkHandle sink) {
+    if (sink < 1 || sink > LOG_MAX_SINKS) {
+        return ERR_INVALID_PARAMETER;
+    }
+    
+    // Route everything logged so far before detaching the sink
+    LogFlush();
+    
+    CmtGetLock(g_logFileLock);
+    LogSink *entry = &g_logSinks[sink - 1];
+    if (!entry->active) {
+        CmtReleaseLock(g_logFileLock);
+        return ERR_INVALID_PARAMETER;
+    }
+    entry->active = 0;
+    g_logSinkCount--;
+    CmtReleaseLock(g_logFileLock);
+    
+    // Outside the lock - a slow sink must not hold up the main writer
+    LogSink_Stop(entry);
+    return SUCCESS;
+}
+
+int LogNewExperimentId(void) {
+    return InterlockedIncrement(&g_logNextExperimentId);
+}
+
+void LogSetThreadExperiment(int experimentId) {
+    if (!g_loggingInitialized) {
+        InitializeLogging();
+    }
+    
+    int *threadExperiment;
+    if (g_logExperimentTLV && CmtGetThreadLocalVar(g_logExperimentTLV, &threadExperiment) >= 0) {
+        *threadExperiment = experimentId;
+    }
+}
+
+int LogGetThreadExperiment(void) {
+    int *threadExperiment;
+    if (g_logExperimentTLV && CmtGetThreadLocalVar(g_logExperimentTLV, &threadExperiment) >= 0) {
+        return *threadExperiment;
+    }
+    return LOG_EXPERIMENT_ANY;
+}
+
+/******************************************************************************
+ * Log Segments
+ ******************************************************************************/
+
+static void BuildSegmentPath(const char *directory, int number, const char *extension, char *path, int pathSize) {
+    snprintf(path, pathSize, "%s%s_%04d%s", directory, LOG_FILE_BASE_NAME, number, extension);
+}
+
+// Find the lowest and highest segment numbers in a directory, returns how many exist
+static int FindLogSegments(const char *directory, int *first, int *last) {
+    char pattern[MAX_PATH_LENGTH];
+    char fileName[MAX_PATH_LENGTH];
+    int count = 0;
+    
+    *first = 0;
+    *last = 0;
+    snprintf(pattern, sizeof(pattern), "%s%s_*%s", directory, LOG_FILE_BASE_NAME, LOG_SEGMENT_EXT);
+    
+    int result = GetFirstFile(pattern, 1, 1, 0, 0, 1, 0, fileName);
+    while (result == 0) {
+        int number;
+        if (sscanf(fileName, LOG_FILE_BASE_NAME "_%d", &number) == 1 && number > 0) {
+            if (count == 0 || number < *first) *first = number;
+            if (count == 0 || number > *last) *last = number;
+            count++;
+        }
+        result = GetNextFile(fileName);
+    }
+    
+    return count;
+}
+
+// Open segment 'number' in 'directory' and make it the current log file. The
+// previous segment, if any, is closed with a pointer to the new one. Caller
+// holds g_logFileLock once the writer is running.
+static int OpenLogSegment(const char *directory, int number) {
+    char path[MAX_PATH_LENGTH];
+    char indexPath[MAX_PATH_LENGTH];
+    
+    BuildSegmentPath(directory, number, LOG_SEGMENT_EXT, path, sizeof(path));
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        return ERR_OPERATION_FAILED;
+    }
+    
+    if (g_logFile) {
+        fprintf(g_logFile, "=== Log continues in %s ===\n", path);
+        fprintf(file, "=== Log continued from %s ===\n", g_actualLogPath);
+        CloseLogSegment();
+    }
+    
+    // Re-anchor so wall time follows system clock corrections segment by
+    // segment; the anchor line lets tools convert monotonic times
+    LogClock_Anchor();
+    LogClock_WriteAnchor(file);
+    
+    // A segment without an index is still written, LogQuery just skips it
+    BuildSegmentPath(directory, number, LOG_INDEX_FILE_EXT, indexPath, sizeof(indexPath));
+    LogIndex_OpenWriter(&g_logIndex, indexPath);
+    
+    g_logFile = file;
+    if (directory != g_logDirectory) {
+        strncpy(g_logDirectory, directory, sizeof(g_logDirectory) - 1);
+        g_logDirectory[sizeof(g_logDirectory) - 1] = '\0';
+    }
+    strncpy(g_actualLogPath, path, sizeof(g_actualLogPath) - 1);
+    g_actualLogPath[sizeof(g_actualLogPath) - 1] = '\0';
+    g_logSegmentNumber = number;
+    g_logSegmentBytes = 0;
+    g_logSegmentStart = time(NULL);
+    
+    PruneLogSegments(directory, number - LOG_MAX_SEGMENTS);
+    return SUCCESS;
+}
+
+static int OpenNextLogSegment(const char *directory) {
+    int first, last;
+    
+    if (FindLogSegments(directory, &first, &last) == 0) {
+        first = 1;
+    }
+    g_logOldestSegment = first;
+    
+    return OpenLogSegment(directory, last + 1);
+}
+
+static void CloseLogSegment(void) {
+    if (g_logFile) {
+        fflush(g_logFile);
+        LogIndex_CloseWriter(&g_logIndex, (int64_t)ftell(g_logFile));
+        fclose(g_logFile);
+        g_logFile = NULL;
+    }
+}
+
+// Delete segments from the oldest known up to and including newestToDelete
+static void PruneLogSegments(const char *directory, int newestToDelete) {
+    char path[MAX_PATH_LENGTH];
+    
+    for (; g_logOldestSegment <= newestToDelete; g_logOldestSegment++) {
+        BuildSegmentPath(directory, g_logOldestSegment, LOG_SEGMENT_EXT, path, sizeof(path));
+        remove(path);
+        BuildSegmentPath(directory, g_logOldestSegment, LOG_INDEX_FILE_EXT, path, sizeof(path));
+        remove(path);
+    }
+}
+
+// Pass the lines of one segment logged within [startTime, endTime] to the
+// callback, returns the number of lines passed. Sets *stop once the segment
+// starts after the window, or when the callback asks to stop.
+static int QueryLogSegment(const char *directory, int number, time_t startTime, time_t endTime,
+                           LogQueryCallback callback, void *userData, int *stop) {
+    char path[MAX_PATH_LENGTH];
+    LogIndexFileHeader header;
+    LogIndexEntry entry;
+    int64_t startOffset = -1;
+    int64_t endOffset = -1;
+    int64_t lastOffset = -1;
+    int entryCount = 0;
+    int lineCount = 0;
+    
+    // Only the times and offsets of the line entries are needed here. A
+    // linear pass copes with the clock stepping backwards mid-segment.
+    BuildSegmentPath(directory, number, LOG_INDEX_FILE_EXT, path, sizeof(path));
+    FILE *indexFile = fopen(path, "rb");
+    if (!indexFile) {
+        return 0;
+    }
+    if (fread(&header, sizeof(header), 1, indexFile) != 1 ||
+        header.magic != LOG_INDEX_MAGIC || header.version != LOG_INDEX_VERSION) {
+        fclose(indexFile);
+        return 0;
+    }
+    
+    while (fread(&entry, sizeof(entry), 1, indexFile) == 1) {
+        if (entry.kind == LOG_INDEX_ENTRY_TEMPLATE) {
+            fseek(indexFile, LOG_INDEX_TEMPLATE_LEN, SEEK_CUR);
+            continue;
+        }
+        if (entry.offset <= lastOffset) {
+            continue;   // Indexed again after a crash
+        }
+        lastOffset = entry.offset;
+        
+        if (entryCount++ == 0 && entry.timestamp > (int64_t)endTime) {
+            *stop = 1;  // Segments are in time order, nothing later can match
+            break;
+        }
+        if (startOffset < 0) {
+            if (entry.timestamp >= (int64_t)startTime && entry.timestamp <= (int64_t)endTime) {
+                startOffset = entry.offset;
+            }
+        } else if (entry.timestamp > (int64_t)endTime) {
+            endOffset = entry.offset;
+            break;
+        }
+    }
+    fclose(indexFile);
+    
+    if (startOffset < 0) {
+        return 0;
+    }
+    
+    BuildSegmentPath(directory, number, LOG_SEGMENT_EXT, path, sizeof(path));
+    FILE *logFile = fopen(path, "rb");
+    if (!logFile) {
+        return 0;
+    }
+    
+    char line[MAX_LOG_LINE_LEN + 2];
+    fseek(logFile, (long)startOffset, SEEK_SET);
+    while ((endOffset < 0 || ftell(logFile) < endOffset) &&
+           fgets(line, sizeof(line), logFile) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        lineCount++;
+        if (callback(line, userData) != 0) {
+            *stop = 1;
+            break;
+        }
+    }
+    fclose(logFile);
+    
+    return lineCount;
+}
+
+int GetLogSegments(int *first, int *last) {
+    char directory[MAX_PATH_LENGTH];
+    
+    if (!first || !last) {
+        return ERR_NULL_POINTER;
+    }
+    if (!g_loggingInitialized || g_actualLogPath[0] == '\0') {
+        return ERR_NOT_INITIALIZED;
+    }
+    
+    CmtGetLock(g_logFileLock);
+    strncpy(directory, g_logDirectory, sizeof(directory) - 1);
+    directory[sizeof(directory) - 1] = '\0';
+    CmtReleaseLock(g_logFileLock);
+    
+    return FindLogSegments(directory, first, last);
+}
+
+void GetLogSegmentPath(int number, char *path, int pathSize) {
+    if (!path || pathSize <= 0) {
+        return;
+    }
+    
+    CmtGetLock(g_logFileLock);
+    BuildSegmentPath(g_logDirectory, number, LOG_SEGMENT_EXT, path, pathSize);
+    CmtReleaseLock(g_logFileLock);
+}
+
+int LogQuery(time_t startTime, time_t endTime, LogQueryCallback callback, void *userData) {
+    char directory[MAX_PATH_LENGTH];
+    int first, last;
+    int total = 0;
+    int stop = 0;
+    
+    if (!callback || endTime < startTime) {
+        return ERR_INVALID_PARAMETER;
+    }
+    if (!g_loggingInitialized || g_actualLogPath[0] == '\0') {
+        return ERR_NOT_INITIALIZED;
+    }
+    
+    // Make sure the current segment and its index are on disk
+    LogFlush();
+    CmtGetLock(g_logFileLock);
+    FlushLogFiles();
+    strncpy(directory, g_logDirectory, sizeof(directory) - 1);
+    directory[sizeof(directory) - 1] = '\0';
+    CmtReleaseLock(g_logFileLock);
+    
+    if (FindLogSegments(directory, &first, &last) == 0) {
+        return 0;
+    }
+    
+    for (int number = first; number <= last && !stop; number++) {
+        total += QueryLogSegment(directory, number, startTime, endTime, callback, userData, &stop);
+    }
+    
+    return total;
+}
+
+/******************************************************************************
+ * Asynchronous Log Writer
+ ******************************************************************************/
+
+static int StartLogWriter(void) {
+    if (InterlockedCompareExchange(&g_logWriterState, LOG_WRITER_STARTING, LOG_WRITER_STOPPED) != LOG_WRITER_STOPPED) {
+        return SUCCESS;
+    }
+    
+    for (int i = 0; i < LOG_RING_CAPACITY; i++) {
+        g_logRing[i].sequence = i;
+    }
+    g_logEnqueuePos = 0;
+    g_logDequeuePos = 0;
+    g_logWrittenPos = 0;
+    
+    // The writer gets its own single-thread pool so it never competes with device threads
+    g_logWakeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (!g_logWakeEvent || CmtNewThreadPool(1, &g_logWriterPool) < 0 ||
+        CmtScheduleThreadPoolFunction(g_logWriterPool, LogWriterThread, NULL, &g_logWriterThreadId) < 0) {
+        if (g_logWriterPool) {
+            CmtDiscardThreadPool(g_logWriterPool);
+            g_logWriterPool = 0;
+        }
+        if (g_logWakeEvent) {
+            CloseHandle(g_logWakeEvent);
+            g_logWakeEvent = NULL;
+        }
+        g_logWriterThreadId = 0;
+        InterlockedExchange(&g_logWriterState, LOG_WRITER_STOPPED);
+        return ERR_THREAD_CREATE;
+    }
+    
+    InterlockedExchange(&g_logWriterState, LOG_WRITER_RUNNING);
+    return SUCCESS;
+}
+
+static void StopLogWriter(void) {
+    if (InterlockedCompareExchange(&g_logWriterState, LOG_WRITER_STOPPING, LOG_WRITER_RUNNING) != LOG_WRITER_RUNNING) {
+        return;
+    }
+    
+    SetEvent(g_logWakeEvent);
+    CmtWaitForThreadPoolFunctionCompletionEx(g_logWriterPool, g_logWriterThreadId, 0,
+                                           LOG_SYNC_FLUSH_TIMEOUT_MS);
+    CmtReleaseThreadPoolFunctionID(g_logWriterPool, g_logWriterThreadId);
+    CmtDiscardThreadPool(g_logWriterPool);
+    g_logWriterPool = 0;
+    g_logWriterThreadId = 0;
+    
+    // Pick up anything pushed while the writer was exiting
+    CmtGetLock(g_logFileLock);
+    LogRing_Drain();
+    FlushLogFiles();
+    CmtReleaseLock(g_logFileLock);
+    
+    CloseHandle(g_logWakeEvent);
+    g_logWakeEvent = NULL;
+    InterlockedExchange(&g_logWriterState, LOG_WRITER_STOPPED);
+}
+
+static int CVICALLBACK LogWriterThread(void *functionData) {
+    double lastFlushTime = Timer();
+    double lastSweepTime = Timer();
+    int unflushedBytes = 0;
+    
+    while (g_logWriterState != LOG_WRITER_STOPPING) {
+        WaitForSingleObject(g_logWakeEvent, LOG_WRITER_WAKE_MS);
+        
+        if ((Timer() - lastSweepTime) * 1000.0 >= LOG_SITE_SWEEP_MS) {
+            LogSite_Sweep(false);
+            lastSweepTime = Timer();
+        }
+        
+        CmtGetLock(g_logFileLock);
+        unflushedBytes += LogRing_Drain();
+        int drainedPos = g_logDequeuePos;
+        
+        // Flush on size, on age, or when a thread is waiting for its line
+        if (unflushedBytes > 0 &&
+            (g_logFlushRequests > 0 || unflushedBytes >= LOG_FLUSH_BATCH_BYTES ||
+             (Timer() - lastFlushTime) * 1000.0 >= LOG_FLUSH_INTERVAL_MS)) {
+            FlushLogFiles();
+            unflushedBytes = 0;
+            lastFlushTime = Timer();
+        }
+        CmtReleaseLock(g_logFileLock);
+        
+        if (unflushedBytes == 0) {
+            InterlockedExchange(&g_logWrittenPos, drainedPos);
+        }
+    }
+    
+    return 0;
+}
+
+// Claim a slot and publish the record. Fails without blocking when the ring is full.
+static bool LogRing_Push(LogLevel level, LogDevice device, int experimentId, int64_t monotonicNs,
+                         int threadId, const char *format, va_list args, int *position) {
+    int pos = g_logEnqueuePos;
+    LogSlot *slot;
+    
+    while (1) {
+        slot = &g_logRing[pos & (LOG_RING_CAPACITY - 1)];
+        int diff = (int)((unsigned int)slot->sequence - (unsigned int)pos);
+        
+        if (diff == 0) {
+            if (InterlockedCompareExchange(&g_logEnqueuePos, pos + 1, pos) == pos) break;
+            pos = g_logEnqueuePos;
+        } else if (diff < 0) {
+            InterlockedIncrement(&g_logDroppedRecords);
+            SetEvent(g_logWakeEvent);
+            return false;
+        } else {
+            pos = g_logEnqueuePos;
+        }
+    }
+    
+    slot->record.monotonicNs = monotonicNs;
+    slot->record.threadId = threadId;
+    slot->record.level = level;
+    slot->record.device = device;
+    slot->record.experimentId = experimentId;
+    
+    // Capturing the arguments is much cheaper than formatting them; fall back to
+    // formatting here if the format uses something the capture cannot replay
+    va_list captureArgs;
+    va_copy(captureArgs, args);
+    int argsLength = g_logDeferredFormatting ?
+        LogArgs_Capture(format, captureArgs, slot->record.message, sizeof(slot->record.message)) : -1;
+    if (argsLength >= 0) {
+        slot->record.format = format;
+    } else {
+        slot->record.format = NULL;
+        vsnprintf(slot->record.message, sizeof(slot->record.message) - 1, format, args);
+        slot->record.message[sizeof(slot->record.message) - 1] = '\0';
+    }
+    va_end(captureArgs);
+    
+    LogCrashRing_Write(&slot->record, argsLength);
+    
+    InterlockedExchange(&slot->sequence, pos + 1);
+    
+    // Wake the writer early when the ring is filling up
+    if ((int)((unsigned int)pos - (unsigned int)g_logDequeuePos) >= LOG_RING_CAPACITY / 2) {
+        SetEvent(g_logWakeEvent);
+    }
+    
+    *position = pos;
+    return true;
+}
+
+// Write every published record, returns the bytes written. Caller holds g_logFileLock.
+static int LogRing_Drain(void) {
+    int written = 0;
+    
+    while (1) {
+        int pos = g_logDequeuePos;
+        LogSlot *slot = &g_logRing[pos & (LOG_RING_CAPACITY - 1)];
+        if (slot->sequence != pos + 1) break;
+        
+        written += WriteLogRecord(&slot->record);
+        
+        InterlockedExchange(&slot->sequence, pos + LOG_RING_CAPACITY);
+        InterlockedExchange(&g_logDequeuePos, pos + 1);
+    }
+    
+    int dropped = InterlockedExchange(&g_logDroppedRecords, 0);
+    if (dropped > 0) {
+        LogRecord notice = {LogClock_MonotonicNs(), CmtGetCurrentThreadID(), LOG_LEVEL_WARNING,
+                            LOG_DEVICE_NONE, LOG_EXPERIMENT_ANY, NULL};
+        snprintf(notice.message, sizeof(notice.message), "%d log messages dropped - log buffer full", dropped);
+        written += WriteLogRecord(&notice);
+    }
+    
+    return written;
+}
+
+// Wait until the writer has written and flushed everything before position
+static void WaitForLogWriter(int position) {
+    InterlockedIncrement(&g_logFlushRequests);
+    SetEvent(g_logWakeEvent);
+    
+    double deadline = Timer() + LOG_SYNC_FLUSH_TIMEOUT_MS / 1000.0;
+    while ((int)((unsigned int)g_logWrittenPos - (unsigned int)position) < 0 &&
+           g_logWriterState == LOG_WRITER_RUNNING && Timer() < deadline) {
+        Delay(0.001);
+    }
+    
+    InterlockedDecrement(&g_logFlushRequests);
+}
+
+void LogFlush(void) {
+    if (g_logWriterState == LOG_WRITER_RUNNING) {
+        WaitForLogWriter(g_logEnqueuePos);
+    }
+}
+
+static void WriteToUI(const char *message) {
+    if (g_mainPanelHandle <= 0) {
+        return;
+    }
+    
+    // Process tabs in the message
+    char *processedMessage = ProcessTabs(message);
+    if (!processedMessage) {
+        return;
+    }
+    
+    // Split by newlines and add to textbox
+    char *processingString = my_strdup(processedMessage);
+    if (!processingString) {
+        free(processedMessage);
+        return;
+    }
+    
+    if (!g_uiBatchLock) {
+        free(processingString);
+        free(processedMessage);
+        return;
+    }
+    
+    char *savePtr;
+    char *line = my_strtok_r(processingString, "\n", &savePtr);
+    int lineCount = 0;
+    
+    CmtGetLock(g_uiBatchLock);
+    while (line != NULL && lineCount < MAX_LINES_PER_CALL) {
+        UIBatch_Append(line);
+        line = my_strtok_r(NULL, "\n", &savePtr);
+        lineCount++;
+    }
+    CmtReleaseLock(g_uiBatchLock);
+    
+    if (GetCurrentThreadId() == MainThreadId()) {
+        // We're in the main thread, update directly
+        DeferredTextBoxUpdate(NULL);
+    } else if (InterlockedCompareExchange(&g_uiFlushPosted, 1, 0) == 0) {
+        // One deferred call picks up everything appended until it runs
+        if (PostDeferredCall(DeferredTextBoxUpdate, NULL) < 0) {
+            InterlockedExchange(&g_uiFlushPosted, 0);
+        }
+    }
+    
+    free(processingString);
+    free(processedMessage);
+}
+
+static char* ProcessTabs(const char *input) {
+    if (!input) return NULL;
+    
+    // Allocate buffer large enough for worst case (all tabs)
+    size_t maxLen = strlen(input) * TAB_WIDTH + 1;
+    char *output = (char*)malloc(maxLen);
+    if (!output) return NULL;
+    
+    int i = 0, j = 0;
+    while (input[i] != '\0' && j < maxLen - 1) {
+        if (input[i] == '\t') {
+            // Replace tab with spaces
+            for (int k = 0; k < TAB_WIDTH && j < maxLen - 1; k++) {
+                output[j++] = ' ';
+            }
+        } else {
+            output[j++] = input[i];
+        }
+        i++;
+    }
+    output[j] = '\0';
+    
+    return output;
+}
+
+/******************************************************************************
+ * Deferred Formatting
+ *
+ * Captured arguments are a packed sequence of a LogArgType byte followed by
+ * the value. Strings are copied since the caller's buffer may be gone by the
+ * time the writer formats the record.
+ ******************************************************************************/
+
+// Find the next conversion in a format string, NULL at the end. "%%" is
+// returned as a conversion of '%' that takes no argument.
+static const char* LogFormat_NextSpec(const char *p, LogFormatSpec *spec) {
+    while (*p && *p != '%') p++;
+    if (!*p) return NULL;
+    
+    memset(spec, 0, sizeof(LogFormatSpec));
+    spec->start = p++;
+    
+    while (*p && strchr("-+ #0", *p)) p++;
+    if (*p == '*') {
+        spec->widthStar = 1;
+        p++;
+    } else {
+        while (isdigit((unsigned char)*p)) p++;
+    }
+    
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            spec->precisionStar = 1;
+            p++;
+        } else {
+            while (isdigit((unsigned char)*p)) p++;
+        }
+    }
+    
+    if (p[0] == 'h') {
+        p += (p[1] == 'h') ? 2 : 1;
+    } else if (p[0] == 'l' && p[1] == 'l') {
+        spec->lengthModifier = LOG_LEN_LONGLONG;
+        p += 2;
+    } else if (p[0] == 'l') {
+        spec->lengthModifier = LOG_LEN_LONG;
+        p++;
+    } else if (p[0] == 'I' && p[1] == '6' && p[2] == '4') {
+        spec->lengthModifier = LOG_LEN_LONGLONG;
+        p += 3;
+    } else if (p[0] == 'j') {
+        spec->lengthModifier = LOG_LEN_LONGLONG;
+        p++;
+    } else if (p[0] == 'z' || p[0] == 't') {
+        spec->lengthModifier = LOG_LEN_SIZE;
+        p++;
+    } else if (p[0] == 'L') {
+        spec->lengthModifier = LOG_LEN_LONGDOUBLE;
+        p++;
+    }
+    
+    spec->conversion = *p;
+    if (*p) p++;
+    spec->length = (int)(p - spec->start);
+    return spec->start;
+}
+
+static bool LogArgs_Put(char **cursor, char *end, LogArgType type, const void *value, int size) {
+    if (*cursor + 1 + size > end) return false;
+    
+    **cursor = (char)type;
+    memcpy(*cursor + 1, value, size);
+    *cursor += 1 + size;
+    return true;
+}
+
+// Copy the arguments a format string consumes. Returns the bytes used, or -1
+// if the format uses something that cannot be replayed or the arguments do not fit.
+static int LogArgs_Capture(const char *format, va_list args, char *buffer, int bufferSize) {
+    char *cursor = buffer;
+    char *end = buffer + bufferSize;
+    LogFormatSpec spec;
+    const char *p = format;
+    
+    while ((p = LogFormat_NextSpec(p, &spec)) != NULL) {
+        p += MAX(spec.length, 1);
+        if (spec.conversion == '%') continue;
+        if (spec.length >= LOG_MAX_SPEC_LEN) return -1;
+        
+        long long starValue;
+        if (spec.widthStar) {
+            starValue = va_arg(args, int);
+            if (!LogArgs_Put(&cursor, end, LOG_ARG_INTEGER, &starValue, sizeof(starValue))) return -1;
+        }
+        if (spec.precisionStar) {
+            starValue = va_arg(args, int);
+            if (!LogArgs_Put(&cursor, end, LOG_ARG_INTEGER, &starValue, sizeof(starValue))) return -1;
+        }
+        
+        switch (spec.conversion) {
+            case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c': {
+                long long value;
+                switch (spec.lengthModifier) {
+                    case LOG_LEN_LONG:      value = va_arg(args, long); break;
+                    case LOG_LEN_LONGLONG:  value = va_arg(args, long long); break;
+                    case LOG_LEN_SIZE:      value = (long long)va_arg(args, size_t); break;
+                    default:                value = va_arg(args, int); break;
+                }
+                if (!LogArgs_Put(&cursor, end, LOG_ARG_INTEGER, &value, sizeof(value))) return -1;
+                break;
+            }
+            
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A': {
+                double value = (spec.lengthModifier == LOG_LEN_LONGDOUBLE) ?
+                               (double)va_arg(args, long double) : va_arg(args, double);
+                if (!LogArgs_Put(&cursor, end, LOG_ARG_DOUBLE, &value, sizeof(value))) return -1;
+                break;
+            }
+            
+            case 'p': {
+                void *value = va_arg(args, void*);
+                if (!LogArgs_Put(&cursor, end, LOG_ARG_POINTER, &value, sizeof(value))) return -1;
+                break;
+            }
+            
+            case 's': {
+                const char *value = va_arg(args, const char*);
+                if (!value) value = "(null)";
+                if (!LogArgs_Put(&cursor, end, LOG_ARG_STRING, value, (int)strlen(value) + 1)) return -1;
+                break;
+            }
+            
+            default:
+                return -1;  // %n, wide strings and anything unknown
+        }
+    }
+    
+    return (int)(cursor - buffer);
+}
+
+static bool LogArgs_Get(const char **cursor, LogArgType type, void *value, int size) {
+    if (**cursor != (char)type) return false;
+    
+    memcpy(value, *cursor + 1, size);
+    *cursor += 1 + size;
+    return true;
+}
+
+// Replay a format string against captured arguments, one conversion at a time
+static void LogArgs_Format(const char *format, const char *buffer, char *output, int outputSize) {
+    const char *cursor = buffer;
+    const char *p = format;
+    int used = 0;
+    LogFormatSpec spec;
+    
+    output[0] = '\0';
+    
+    while (used < outputSize - 1) {
+        const char *specStart = LogFormat_NextSpec(p, &spec);
+        
+        // Literal text up to the next conversion
+        int literalLength = specStart ? (int)(specStart - p) : (int)strlen(p);
+        literalLength = MIN(literalLength, outputSize - 1 - used);
+        memcpy(output + used, p, literalLength);
+        used += literalLength;
+        output[used] = '\0';
+        
+        if (!specStart || used >= outputSize - 1) break;
+        p = specStart + MAX(spec.length, 1);
+        
+        if (spec.conversion == '%') {
+            output[used++] = '%';
+            output[used] = '\0';
+            continue;
+        }
+        
+        // Rebuild the conversion with '*' replaced by the captured values and
+        // without an 'L' modifier, since long doubles were narrowed on capture
+        char specText[LOG_MAX_SPEC_LEN + 24];
+        int specUsed = 0;
+        for (int i = 0; i < spec.length && specUsed < (int)sizeof(specText) - 12; i++) {
+            char c = spec.start[i];
+            if (c == '*') {
+                long long starValue = 0;
+                LogArgs_Get(&cursor, LOG_ARG_INTEGER, &starValue, sizeof(starValue));
+                specUsed += snprintf(specText + specUsed, sizeof(specText) - specUsed, "%d", (int)starValue);
+            } else if (c != 'L' || spec.lengthModifier != LOG_LEN_LONGDOUBLE) {
+                specText[specUsed++] = c;
+            }
+        }
+        specText[specUsed] = '\0';
+        
+        int remaining = outputSize - used;
+        int n = 0;
+        switch (spec.conversion) {
+            case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c': {
+                long long value = 0;
+                LogArgs_Get(&cursor, LOG_ARG_INTEGER, &value, sizeof(value));
+                switch (spec.lengthModifier) {
+                    case LOG_LEN_LONG:      n = snprintf(output + used, remaining, specText, (long)value); break;
+                    case LOG_LEN_LONGLONG:  n = snprintf(output + used, remaining, specText, value); break;
+                    case LOG_LEN_SIZE:      n = snprintf(output + used, remaining, specText, (size_t)value); break;
+                    default:                n = snprintf(output + used, remaining, specText, (int)value); break;
+                }
+                break;
+            }
+            
+            case 'p': {
+                void *value = NULL;
+                LogArgs_Get(&cursor, LOG_ARG_POINTER, &value, sizeof(value));
+                n = snprintf(output + used, remaining, specText, value);
+                break;
+            }
+            
+            case 's': {
+                const char *value = "";
+                if (*cursor == (char)LOG_ARG_STRING) {
+                    value = cursor + 1;
+                    cursor += 1 + strlen(value) + 1;
+                }
+                n = snprintf(output + used, remaining, specText, value);
+                break;
+            }
+            
+            default: {
+                double value = 0.0;
+                LogArgs_Get(&cursor, LOG_ARG_DOUBLE, &value, sizeof(value));
+                n = snprintf(output + used, remaining, specText, value);
+                break;
+            }
+        }
+        
+        used += CLAMP(n, 0, remaining - 1);
+    }
+}
+
+/******************************************************************************
+ * Level Filtering
+ ******************************************************************************/
+int LogIsEnabled(LogDevice device, LogLevel level) {
+    if (level < LOG_COMPILE_MIN_LEVEL) return 0;
+    
+    int threshold = g_logThresholds[(device >= 0 && device < LOG_DEVICE_COUNT) ? device : LOG_DEVICE_NONE];
+    
+    // Debug mode turns on debug output for every device not quietened below INFO
+    if (g_debugMode && threshold <= LOG_LEVEL_INFO) {
+        threshold = LOG_LEVEL_DEBUG;
+    }
+    
+    return level >= threshold;
+}
+
+void SetLogLevel(LogDevice device, LogLevel minLevel) {
+    if (device >= 0 && device < LOG_DEVICE_COUNT) {
+        g_logThresholds[device] = CLAMP(minLevel, LOG_LEVEL_DEBUG, LOG_LEVEL_NONE);
+    }
+}
+
+void SetLogLevelAll(LogLevel minLevel) {
+    for (int i = 0; i < LOG_DEVICE_COUNT; i++) {
+        SetLogLevel((LogDevice)i, minLevel);
+    }
+}
+
+LogLevel GetLogLevel(LogDevice device) {
+    if (device < 0 || device >= LOG_DEVICE_COUNT) return LOG_LEVEL_NONE;
+    return (LogLevel)g_logThresholds[device];
+}
+
+/******************************************************************************
+ * Public Logging Functions - Extended versions with device support
+ ******************************************************************************/
+void LogMessageEx(LogDevice device, const char *format, ...) {
+    if (!LogIsEnabled(device, LOG_LEVEL_INFO)) return;
+    
+    va_list args;
+    va_start(args, format);
+    LogMessageInternalEx(device, LOG_LEVEL_INFO, format, args);
+    va_end(args);
+}
+
+void LogErrorEx(LogDevice device, const char *format, ...) {
+    if (!LogIsEnabled(device, LOG_LEVEL_ERROR)) return;
+    
+    va_list args;
+    va_start(args, format);
+    LogMessageInternalEx(device, LOG_LEVEL_ERROR, format, args);
+    va_end(args);
+}
+
+void LogWarningEx(LogDevice device, const char *format, ...) {
+    if (!LogIsEnabled(device, LOG_LEVEL_WARNING)) return;
+    
     va_list args;
     va_start(args, format);
     LogMessageInternalEx(device, LOG_LEVEL_WARNING, format, args);
@@ -486,7 +2325,7 @@ void LogWarningEx(LogDevice device, const char *format, ...) {
 }
 
 void LogDebugEx(LogDevice device, const char *format, ...) {
-    if (!g_debugMode) return;
+    if (!LogIsEnabled(device, LOG_LEVEL_DEBUG)) return;
     
     va_list args;
     va_start(args, format);
@@ -498,6 +2337,8 @@ void LogDebugEx(LogDevice device, const char *format, ...) {
  * Public Logging Functions - Original versions (no device prefix)
  ******************************************************************************/
 void LogMessage(const char *format, ...) {
+    if (!LogIsEnabled(LOG_DEVICE_NONE, LOG_LEVEL_INFO)) return;
+    
     va_list args;
     va_start(args, format);
     LogMessageInternalEx(LOG_DEVICE_NONE, LOG_LEVEL_INFO, format, args);
@@ -505,6 +2346,8 @@ void LogMessage(const char *format, ...) {
 }
 
 void LogError(const char *format, ...) {
+    if (!LogIsEnabled(LOG_DEVICE_NONE, LOG_LEVEL_ERROR)) return;
+    
     va_list args;
     va_start(args, format);
     LogMessageInternalEx(LOG_DEVICE_NONE, LOG_LEVEL_ERROR, format, args);
@@ -512,6 +2355,8 @@ void LogError(const char *format, ...) {
 }
 
 void LogWarning(const char *format, ...) {
+    if (!LogIsEnabled(LOG_DEVICE_NONE, LOG_LEVEL_WARNING)) return;
+    
     va_list args;
     va_start(args, format);
     LogMessageInternalEx(LOG_DEVICE_NONE, LOG_LEVEL_WARNING, format, args);
@@ -519,7 +2364,7 @@ void LogWarning(const char *format, ...) {
 }
 
 void LogDebug(const char *format, ...) {
-    if (!g_debugMode) return;
+    if (!LogIsEnabled(LOG_DEVICE_NONE, LOG_LEVEL_DEBUG)) return;
     
     va_list args;
     va_start(args, format);
@@ -537,9 +2382,11 @@ void SetLogToFile(int enable) {
         // Re-open log file
         InitializeLogging();
     } else if (!enable && g_logFile) {
-        // Close log file
-        fclose(g_logFile);
-        g_logFile = NULL;
+        // Close log file once the writer has caught up
+        LogFlush();
+        CmtGetLock(g_logFileLock);
+        CloseLogSegment();
+        CmtReleaseLock(g_logFileLock);
     }
 }
 
@@ -547,7 +2394,20 @@ void SetLogToUI(int enable) {
     g_logToUI = enable;
 }
 
+void SetLogDeferredFormatting(int enable) {
+    g_logDeferredFormatting = enable;
+}
+
 void ClearLogDisplay(void) {
+    // Drop lines still waiting for the UI thread as well
+    if (g_uiBatchLock) {
+        CmtGetLock(g_uiBatchLock);
+        g_uiPendingBatch->start = 0;
+        g_uiPendingBatch->count = 0;
+        g_uiPendingBatch->skipped = 0;
+        CmtReleaseLock(g_uiBatchLock);
+    }
+    
     if (g_mainPanelHandle > 0) {
         DeleteTextBoxLines(g_mainPanelHandle, PANEL_OUTPUT_TEXTBOX, 0, -1);
     }
@@ -559,19 +2419,31 @@ const char* GetLogFilePath(void) {
         return g_actualLogPath;
     }
     
-    // Otherwise return default location (current directory)
-    return LOG_FILE_NAME;
+    // Otherwise no segment has been opened yet
+    return "";
 }
 
 /******************************************************************************
  * External File Support Functions
  ******************************************************************************/
+// Compatibility wrappers - the external file is a sink that takes every line
 void SetExternalLogFile(FILE *externalFile) {
-    g_externalLogFile = externalFile;
+    // Lines logged before the switch still belong to the old file
+    if (g_externalLogSink > 0) {
+        LogSinkRemove(g_externalLogSink);
+        g_externalLogSink = 0;
+    }
+    g_externalLogFile = NULL;
     
-    // Log that external file has been set/cleared
     if (externalFile) {
-        LogDebug("External log file pointer set");
+        LogSinkHandle sink = LogSinkAddFile(externalFile, NULL);
+        if (sink > 0) {
+            g_externalLogSink = sink;
+            g_externalLogFile = externalFile;
+            LogDebug("External log file pointer set");
+        } else {
+            LogWarning("Could not add external log file (error %d)", sink);
+        }
     } else {
         LogDebug("External log file pointer cleared");
     }
@@ -582,8 +2454,8 @@ FILE* GetExternalLogFile(void) {
 }
 
 void ClearExternalLogFile(void) {
-    g_externalLogFile = NULL;
-    LogDebug("External log file pointer cleared");
+    // The caller closes the file next - the sink is drained and stopped first
+    SetExternalLogFile(NULL);
 }
 
 /******************************************************************************
@@ -604,8 +2476,7 @@ int CreateLogFileInCurrentDir(void) {
     }
     
     // Try to create in current directory
-    g_logFile = fopen(LOG_FILE_NAME, "a");
-    if (g_logFile) {
+    if (OpenNextLogSegment("") == SUCCESS) {
         g_logToFile = 1;
         
         // Write header
@@ -613,9 +2484,10 @@ int CreateLogFileInCurrentDir(void) {
         char timeStr[64];
         FormatTimestamp(now, timeStr, sizeof(timeStr));
         fprintf(g_logFile, "\n=== Battery Tester Log Started: %s ===\n", timeStr);
-        fprintf(g_logFile, "Log file location: %s (current directory)\n", LOG_FILE_NAME);
+        fprintf(g_logFile, "Log file location: %s (current directory)\n", g_actualLogPath);
         fflush(g_logFile);
         
+        StartLogWriter();
         return SUCCESS;
     }
     
@@ -18,8 +18,46 @@ typedef enum {
 	LOG_DEVICE_DTB,         // [DTB] prefix
 	LOG_DEVICE_TNY,         // [TNY] prefix
 	LOG_DEVICE_CDAQ,        // [DAQ] prefix
+	LOG_DEVICE_COUNT        // Number of device identifiers, keep last
 } LogDevice;
 
+//==============================================================================
+// Log Levels
+//==============================================================================
+// Ordered by severity so thresholds can be compared directly
+typedef enum {
+    LOG_LEVEL_DEBUG = 0,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_WARNING,
+    LOG_LEVEL_ERROR,
+    LOG_LEVEL_NONE          // Threshold only - suppresses everything
+} LogLevel;
+
+//==============================================================================
+// Log Sinks
+//==============================================================================
+typedef int LogSinkHandle;              // > 0 when valid
+
+#define LOG_SINK_DEVICE(device)     (1u << (device))    // Bit for LogSinkFilter.deviceMask
+#define LOG_EXPERIMENT_ANY          0                   // Experiment id matching every line
+
+// Which lines a sink receives
+typedef struct {
+    unsigned int deviceMask;    // LOG_SINK_DEVICE bits, 0 for every device
+    LogLevel minLevel;          // Lowest level passed on
+    int experimentId;           // Only lines logged for this experiment, or LOG_EXPERIMENT_ANY
+} LogSinkFilter;
+
+// Receives one log file line per call from LogQuery (without the line ending).
+// Return nonzero to stop the query.
+typedef int (*LogQueryCallback)(const char *line, void *userData);
+
+// Calls below this level are compiled out entirely, arguments included
+// (0 = keep all, 1 = strip DEBUG, 2 = also strip INFO, 3 = also strip WARNING)
+#ifndef LOG_COMPILE_MIN_LEVEL
+#define LOG_COMPILE_MIN_LEVEL   0
+#endif
+
 //==============================================================================
 // Public Function Declarations
 //==============================================================================
@@ -97,6 +135,14 @@ void LogDebug(const char *format, ...);
  * Special Purpose Logging Functions
  ******************************************************************************/
 
+/**
+ * Check whether a message would be logged, before doing any work to build it
+ * @param device - Device identifier
+ * @param level - Message level
+ * @return 1 if the device's threshold lets the level through, 0 otherwise
+ */
+int LogIsEnabled(LogDevice device, LogLevel level);
+
 /**
  * Log a startup message (used before full initialization)
  * @param message - Message to log
@@ -113,23 +159,122 @@ void LogStartupMessage(const char *message);
  */
 void SetLogToFile(int enable);
 
+/**
+ * Set the lowest level logged for one device (default LOG_LEVEL_INFO).
+ * Debug mode lowers INFO thresholds to DEBUG; a device set to LOG_LEVEL_DEBUG
+ * logs its debug lines to file even with debug mode off.
+ * @param device - Device identifier
+ * @param minLevel - Lowest level to log, LOG_LEVEL_NONE to silence the device
+ */
+void SetLogLevel(LogDevice device, LogLevel minLevel);
+
+/**
+ * Set the lowest level logged for every device
+ * @param minLevel - Lowest level to log
+ */
+void SetLogLevelAll(LogLevel minLevel);
+
+/**
+ * Get the lowest level logged for a device
+ * @param device - Device identifier
+ * @return Current threshold
+ */
+LogLevel GetLogLevel(LogDevice device);
+
+/**
+ * Decode a crash ring into a text log. Every record is also kept in a
+ * memory-mapped ring (BatteryTester.ring, next to the log files) that survives
+ * the process being killed; on the next start a ring from a run that did not
+ * shut down cleanly is decoded automatically to BatteryTester_crash_<time>.log.
+ * @param ringPath - Ring file to read
+ * @param outputPath - Text file to write
+ * @return Number of records decoded, or error code
+ */
+int LogDecodeCrashRing(const char *ringPath, const char *outputPath);
+
+/**
+ * Limit how many lines each call site may log per window. A call site is a
+ * format string logged for one device. Lines over the limit are dropped and
+ * summarised as "Previous message repeated N more times" once the window
+ * ends. The default is 20 lines per 5 seconds.
+ * @param maxLinesPerWindow - Lines allowed per call site per window, 0 to disable
+ * @param windowMs - Window length in milliseconds (ignored if not positive)
+ */
+void SetLogRateLimit(int maxLinesPerWindow, int windowMs);
+
+/**
+ * Override the rate limit for one call site
+ * @param format - Format string used at the call site
+ * @param maxLinesPerWindow - Lines allowed per window, 0 for no limit, negative to use the default again
+ * @return SUCCESS or error code
+ */
+int SetLogSiteRateLimit(const char *format, int maxLinesPerWindow);
+
 /**
  * Enable or disable logging to UI textbox
  * @param enable - 1 to enable UI logging, 0 to disable
  */
 void SetLogToUI(int enable);
 
+/**
+ * Enable or disable deferred formatting (enabled by default). When enabled,
+ * logging calls only capture the format string and a copy of the arguments;
+ * the writer thread formats them. Format strings must therefore be string
+ * literals or otherwise outlive the log call.
+ * @param enable - 1 to defer formatting to the writer thread, 0 to format in the caller
+ */
+void SetLogDeferredFormatting(int enable);
+
+/**
+ * Block until every line logged so far is written and flushed to the log files.
+ * Log file writes happen on a background writer thread; ERROR lines are
+ * flushed before LogError returns, everything else within a fraction of a second.
+ */
+void LogFlush(void);
+
 /**
  * Clear the log display in the UI
  */
 void ClearLogDisplay(void);
 
 /**
- * Get the full path to the log file
+ * Get the full path to the log file segment currently being written
+ * Log files rotate into numbered segments (BatteryTester_NNNN.log) at every
+ * start, every 10 MB and every hour; the oldest are deleted beyond 100 segments.
+ * Lines read "<local date time>.<us> +<monotonic s>.<ns> [T<thread id>] [LEVEL] [DEV] message";
+ * each segment starts with the anchor pairing wall-clock and monotonic time
  * @return Pointer to static string containing log file path
  */
 const char* GetLogFilePath(void);
 
+/**
+ * Get the range of log segment numbers currently on disk
+ * @param first - Receives the oldest segment number
+ * @param last - Receives the newest segment number (the one being written)
+ * @return Number of segments found, or error code
+ */
+int GetLogSegments(int *first, int *last);
+
+/**
+ * Build the path of a log segment in the current log directory
+ * @param number - Segment number
+ * @param path - Receives the path
+ * @param pathSize - Size of the path buffer
+ */
+void GetLogSegmentPath(int number, char *path, int pathSize);
+
+/**
+ * Read back the log file lines written between two times, oldest first.
+ * Uses each segment's .idx sidecar to seek straight to the window, so only
+ * the matching part of the log history is read.
+ * @param startTime - Start of the window (inclusive)
+ * @param endTime - End of the window (inclusive)
+ * @param callback - Called once per line
+ * @param userData - Passed through to the callback
+ * @return Number of lines passed to the callback, or error code
+ */
+int LogQuery(time_t startTime, time_t endTime, LogQueryCallback callback, void *userData);
+
 /**
  * Register logging cleanup function with atexit()
  * Should be called once during application initialization
@@ -143,12 +288,63 @@ void RegisterLoggingCleanup(void);
  */
 int CreateLogFileInCurrentDir(void);
 
+/******************************************************************************
+ * Log Sinks
+ ******************************************************************************/
+
+/**
+ * Send a filtered copy of the log to an open file. Each sink has its own
+ * writer thread and queue, so a slow file (network share, USB disk) only
+ * drops its own lines and never holds up the main log or other sinks.
+ * The caller keeps ownership of the file and closes it after LogSinkRemove.
+ * @param file - Open FILE pointer to write to
+ * @param filter - Lines to pass on, NULL for every line
+ * @return Sink handle (> 0) or error code
+ */
+LogSinkHandle LogSinkAddFile(FILE *file, const LogSinkFilter *filter);
+
+/**
+ * Open (append to) a file and send a filtered copy of the log to it.
+ * The file is closed when the sink is removed.
+ * @param path - File to open
+ * @param filter - Lines to pass on, NULL for every line
+ * @return Sink handle (> 0) or error code
+ */
+LogSinkHandle LogSinkOpen(const char *path, const LogSinkFilter *filter);
+
+/**
+ * Write out everything routed to a sink so far and remove it
+ * @param sink - Handle from LogSinkAddFile or LogSinkOpen
+ * @return SUCCESS or error code
+ */
+int LogSinkRemove(LogSinkHandle sink);
+
+/**
+ * Allocate a new experiment id for tagging log lines
+ * @return Experiment id (> 0)
+ */
+int LogNewExperimentId(void);
+
+/**
+ * Tag every line the calling thread logs from now on with an experiment id.
+ * Device queues pass the tag on to the commands the thread submits.
+ * @param experimentId - Experiment id, or LOG_EXPERIMENT_ANY to clear
+ */
+void LogSetThreadExperiment(int experimentId);
+
+/**
+ * Get the experiment id the calling thread is tagged with
+ * @return Experiment id, or LOG_EXPERIMENT_ANY if none
+ */
+int LogGetThreadExperiment(void);
+
 /******************************************************************************
  * External File Support Functions
  ******************************************************************************/
 
 /**
  * Set an external FILE pointer to receive copies of all log entries
+ * Kept for compatibility - this is an unfiltered sink from LogSinkAddFile
  * The caller is responsible for opening, maintaining, and closing the file
  * @param externalFile - FILE pointer to write log copies to, or NULL to disable
  */
@@ -165,6 +361,24 @@ FILE* GetExternalLogFile(void);
  */
 void ClearExternalLogFile(void);
 
+//==============================================================================
+// Compile-time Level Stripping
+//==============================================================================
+#ifndef LOGGING_IMPLEMENTATION
+#if LOG_COMPILE_MIN_LEVEL > 0
+    #define LogDebug(...)           ((void)0)
+    #define LogDebugEx(...)         ((void)0)
+#endif
+#if LOG_COMPILE_MIN_LEVEL > 1
+    #define LogMessage(...)         ((void)0)
+    #define LogMessageEx(...)       ((void)0)
+#endif
+#if LOG_COMPILE_MIN_LEVEL > 2
+    #define LogWarning(...)         ((void)0)
+    #define LogWarningEx(...)       ((void)0)
+#endif
+#endif
+
 //==============================================================================
 // End of Header
 //==============================================================================
@@ -32,7 +32,7 @@ static const char* errorStrings[] = {
  ******************************************************************************/
 
 static void PrintHexDump(const char *label, unsigned char *data, int length) {
-    if (!g_debugMode) return;
+    if (!LogIsEnabled(LOG_DEVICE_PSB, LOG_LEVEL_DEBUG)) return;
     
     char hexBuffer[LARGE_BUFFER_SIZE];
     char *ptr = hexBuffer;
@@ -19,6 +19,9 @@
 #include "logging.h"
 #include "controls.h"
 #include "cdaq_utils.h"
+#include "telemetry.h"
+#include "ui_update.h"
+#include "history.h"
 #include <toolbox.h>
 
 /******************************************************************************
@@ -36,12 +39,22 @@ typedef struct {
     double callStartTime;
     ConnectionState lastState;
     bool enabled;
+    volatile int queueOverloaded;   // Device queue signalled overload - skip polling
+    
+    // Adaptive polling
+    volatile double pollPeriodMs;   // Period chosen from the device activity
+    double busTimeMs;               // Smoothed duration of one status poll, 0 until measured
+    double lastValue;               // PSB current / DTB reference temperature
+    double lastValueTime;           // When lastValue was taken, 0 before the first reading
+    double lastSetPoint;            // DTB set point at the last reading
+    double stableSince;             // DTB: when the temperature entered the stable band
 } DeviceStatusState;
 
 // Module variables
 static struct {
     int panelHandle;
     CmtThreadFunctionID timerThreadId;
+    HANDLE wakeEvent;               // Wakes the timer thread to recompute its deadline
     
     // Per-device state
     DeviceStatusState devices[DEVICE_COUNT];
@@ -49,6 +62,9 @@ static struct {
     // Remote mode change tracking (PSB specific)
     volatile int remoteModeChangePending;
     volatile int pendingRemoteModeValue;
+    
+    // Readings reach the UI through the telemetry cache, whoever polled them
+    int telemetrySubscription;
 } g_status = {0};
 
 /******************************************************************************
@@ -59,13 +75,18 @@ static struct {
 static StatusModuleState Status_GetState(void);
 static void Status_SetState(StatusModuleState newState);
 static bool Status_ShouldProcessUpdates(void);
+static void Status_Wake(void);
 
 // Timer and device management
 static int CVICALLBACK Status_TimerThread(void *functionData);
-static void Status_ProcessDeviceUpdates(void);
-static bool Status_IsDeviceReadyForUpdate(int deviceType);
+static double Status_ProcessDeviceUpdates(void);
+static double Status_ReadThermocouples(double nextReadTime);
 static bool Status_CanSendCommand(int deviceType);
 static void Status_RequestDeviceUpdate(int deviceType);
+static double Status_GetPollPeriodMs(int deviceIndex);
+static void Status_RecordPollTime(int deviceIndex);
+static void Status_AdaptPSBRate(const PSB_Status *status);
+static void Status_AdaptDTBRate(int deviceIndex, const DTB_Status *status);
 
 // Device-specific update functions
 static void PSB_RequestStatusUpdate(void);
@@ -78,14 +99,8 @@ static void Status_HandleDeviceTimeout(int deviceType);
 // UI update functions
 static void UpdateDeviceLED(int deviceType, ConnectionState state);
 static void UpdateDeviceStatus(int deviceType, const char* message);
-static void UpdatePSBValues(PSB_Status* status);
-static void UpdateDTBValues(int deviceIndex, DTB_Status* status);
-
-// Deferred callback functions
-static void CVICALLBACK DeferredLEDUpdate(void* data);
-static void CVICALLBACK DeferredStatusUpdate(void* data);
-static void CVICALLBACK DeferredNumericUpdate(void* data);
-static void CVICALLBACK DeferredToggleUpdate(void* data);
+static void UpdatePSBValues(const PSB_Status* status);
+static void UpdateDTBValues(int deviceIndex, const DTB_Status* status);
 
 // Device callbacks
 static void PSBStatusCallback(CommandID cmdId, PSBCommandType type, 
@@ -93,22 +108,24 @@ static void PSBStatusCallback(CommandID cmdId, PSBCommandType type,
 static void DTBStatusCallback(CommandID cmdId, DTBCommandType type,
                             void *result, void *userData);
 
+// Telemetry
+static void Status_TelemetryCallback(const TelemetrySnapshot *snapshot, void *userData);
+static bool Status_HasFreshTelemetry(int deviceIndex, double *timestamp);
+static void Status_ApplyPSBStatus(const PSB_Status *status);
+static void Status_ApplyDTBStatus(int deviceIndex, int slaveAddress, const DTB_Status *status);
+static int Status_FindDTBDeviceIndex(int slaveAddress);
+
+// Queue overload handling
+static void Status_SubscribeOverload(bool subscribe);
+static void Status_QueueOverloadCallback(DeviceQueueManager *mgr, DevicePriority priority,
+                                        int overloaded, void *userData);
+
 // Helper functions
 static const char* intToString(int deviceType);
 static const char* StateToString(StatusModuleState state);
 static bool GetDTBUIControls(int slaveAddress, int *ledControl,
 							 int *statusControl, int *tempControl);
 
-/******************************************************************************
- * UI Update Data Structure
- ******************************************************************************/
-typedef struct {
-    int control;
-    int intValue;    // For LED color/state
-    double dblValue; // For numeric values
-    char strValue[MEDIUM_BUFFER_SIZE]; // For string values
-} UIUpdateData;
-
 /******************************************************************************
  * State Management Functions
  ******************************************************************************/
@@ -129,6 +146,9 @@ static void Status_SetState(StatusModuleState newState) {
     
     LogMessage("Status module state: %s -> %s", 
                StateToString(oldState), StateToString(newState));
+    
+    // Pause, resume and stop take effect without waiting for the next deadline
+    Status_Wake();
 }
 
 static bool Status_ShouldProcessUpdates(void) {
@@ -136,6 +156,13 @@ static bool Status_ShouldProcessUpdates(void) {
     return (state == STATUS_STATE_RUNNING);
 }
 
+// Call whenever a device deadline may have moved earlier
+static void Status_Wake(void) {
+    if (g_status.wakeEvent) {
+        SetEvent(g_status.wakeEvent);
+    }
+}
+
 /******************************************************************************
  * Public Interface Implementation
  ******************************************************************************/
@@ -163,6 +190,13 @@ int Status_Initialize(int panelHandle) {
     memset(&g_status, 0, sizeof(g_status));
     g_status.panelHandle = panelHandle;
     
+    g_status.wakeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (!g_status.wakeEvent) {
+        LogError("Failed to create status wake event");
+        Status_SetState(STATUS_STATE_UNINITIALIZED);
+        return ERR_THREAD_SYNC;
+    }
+    
     // Initialize device states
     Status_InitializeDeviceStates();
     
@@ -198,6 +232,12 @@ int Status_Start(void) {
     
     Status_SetState(STATUS_STATE_RUNNING);
     
+    // Shed status polling while a device queue is overloaded
+    Status_SubscribeOverload(true);
+    
+    // Show readings taken by experiments too, and skip polls they made unnecessary
+    g_status.telemetrySubscription = Telemetry_Subscribe(Status_TelemetryCallback, NULL);
+    
     // Update initial status messages to "Monitoring..."
     for (int i = 0; i < DEVICE_COUNT; i++) {
         if (g_status.devices[i].enabled) {
@@ -219,6 +259,9 @@ int Status_Stop(void) {
     
     LogMessage("Stopping device status monitoring...");
     Status_SetState(STATUS_STATE_STOPPING);
+    Status_SubscribeOverload(false);
+    Telemetry_Unsubscribe(g_status.telemetrySubscription);
+    g_status.telemetrySubscription = 0;
     
     // Wait for timer thread to complete
     if (g_status.timerThreadId != 0) {
@@ -243,6 +286,11 @@ void Status_Cleanup(void) {
     // Set final state
     Status_SetState(STATUS_STATE_UNINITIALIZED);
     
+    if (g_status.wakeEvent) {
+        CloseHandle(g_status.wakeEvent);
+        g_status.wakeEvent = NULL;
+    }
+    
     // Clean up state lock
     if (g_stateLock != 0) {
         CmtDiscardLock(g_stateLock);
@@ -284,11 +332,12 @@ int Status_Resume(void) {
     double currentTime = GetTimestamp();
     for (int i = 0; i < DEVICE_COUNT; i++) {
         if (g_status.devices[i].enabled) {
-            g_status.devices[i].lastUpdateTime = currentTime - (STATUS_UPDATE_PERIOD_MS / 1000.0);
+            g_status.devices[i].lastUpdateTime = currentTime - (Status_GetPollPeriodMs(i) / 1000.0);
             g_status.devices[i].pendingCall = false;
             UpdateDeviceStatus(i, "Resuming...");
         }
     }
+    Status_Wake();
     
     return SUCCESS;
 }
@@ -305,12 +354,14 @@ static void Status_InitializeDeviceStates(void) {
     g_status.devices[DEVICE_PSB].lastUpdateTime = currentTime;
     g_status.devices[DEVICE_PSB].pendingCall = false;
     g_status.devices[DEVICE_PSB].lastState = CONN_STATE_IDLE;
+    g_status.devices[DEVICE_PSB].pollPeriodMs = STATUS_PSB_IDLE_PERIOD_MS;
     
     // Initialize BioLogic state
     g_status.devices[DEVICE_BIOLOGIC].enabled = ENABLE_BIOLOGIC;
     g_status.devices[DEVICE_BIOLOGIC].lastUpdateTime = currentTime;
     g_status.devices[DEVICE_BIOLOGIC].pendingCall = false;
     g_status.devices[DEVICE_BIOLOGIC].lastState = CONN_STATE_IDLE;
+    g_status.devices[DEVICE_BIOLOGIC].pollPeriodMs = STATUS_UPDATE_PERIOD_MS;
     
     // Initialize DTB states dynamically from queue manager
     if (ENABLE_DTB) {
@@ -324,6 +375,7 @@ static void Status_InitializeDeviceStates(void) {
                     g_status.devices[deviceIndex].lastUpdateTime = currentTime;
                     g_status.devices[deviceIndex].pendingCall = false;
                     g_status.devices[deviceIndex].lastState = CONN_STATE_IDLE;
+                    g_status.devices[deviceIndex].pollPeriodMs = STATUS_DTB_PERIOD_MS;
                 }
                 LogMessage("Device states initialized (DTB devices: %d)", ctx->numDevices);
                 return;
@@ -340,47 +392,41 @@ static void Status_InitializeDeviceStates(void) {
  ******************************************************************************/
 
 static int CVICALLBACK Status_TimerThread(void *functionData) {
+    DeviceQueue_SetThreadName("Status");
     LogMessage("Status timer thread started");
     
+    double nextThermocoupleTime = 0.0;
+    
+    // Sleep until the earliest device deadline (next poll or callback
+    // timeout), or until a state change or completed poll wakes us
     while (Status_GetState() != STATUS_STATE_STOPPING) {
-        // Process device updates if in running state
+        double waitMs = STATUS_MAX_SLEEP_MS;
+        
         if (Status_ShouldProcessUpdates()) {
-            Status_ProcessDeviceUpdates();
+            waitMs = MIN(waitMs, Status_ProcessDeviceUpdates());
+            
+            // Update thermocouple readings using cDAQ module
+            if (ENABLE_CDAQ) {
+                nextThermocoupleTime = Status_ReadThermocouples(nextThermocoupleTime);
+                waitMs = MIN(waitMs, (nextThermocoupleTime - GetTimestamp()) * 1000.0);
+            }
         }
         
-        // Update thermocouple readings using cDAQ module
-		if (ENABLE_CDAQ && Status_ShouldProcessUpdates()) {
-		    // Read TC0 and TC1 from slot 2 for UI display
-		    double temp;
-		    if (CDAQ_ReadTC(2, 0, &temp) == SUCCESS) {
-		        UIUpdateData* tcData = malloc(sizeof(UIUpdateData));
-		        if (tcData) {
-		            tcData->control = PANEL_NUM_TC0;
-		            tcData->dblValue = temp;
-		            PostDeferredCall(DeferredNumericUpdate, tcData);
-		        }
-		    }
-		    
-		    if (CDAQ_ReadTC(2, 1, &temp) == SUCCESS) {
-		        UIUpdateData* tcData = malloc(sizeof(UIUpdateData));
-		        if (tcData) {
-		            tcData->control = PANEL_NUM_TC1;
-		            tcData->dblValue = temp;
-		            PostDeferredCall(DeferredNumericUpdate, tcData);
-		        }
-		    }
-		}
-        
-        // Sleep for timer interval
-        Delay(0.01);  // 10ms
+        if (waitMs > 0.0) {
+            WaitForSingleObject(g_status.wakeEvent, (DWORD)ceil(waitMs));
+        }
     }
     
     LogMessage("Status timer thread stopped");
+    DeviceQueue_ClearThreadName();
     return 0;
 }
 
-static void Status_ProcessDeviceUpdates(void) {
+// Poll every device that is due and return the time in ms until the next
+// device deadline
+static double Status_ProcessDeviceUpdates(void) {
     double currentTime = GetTimestamp();
+    double nextDeadline = currentTime + STATUS_MAX_SLEEP_MS / 1000.0;
     
     // Process each device independently
     for (int i = 0; i < DEVICE_COUNT; i++) {
@@ -392,28 +438,149 @@ static void Status_ProcessDeviceUpdates(void) {
         
         // Check for timeout on pending calls
         if (device->pendingCall) {
-            double callDuration = (currentTime - device->callStartTime) * 1000.0;
-            if (callDuration > STATUS_CALLBACK_TIMEOUT_MS) {
-                LogWarning("%s status callback timed out after %.1f ms", 
-                          intToString(i), callDuration);
-                Status_HandleDeviceTimeout(i);
+            double timeoutTime = device->callStartTime + STATUS_CALLBACK_TIMEOUT_MS / 1000.0;
+            if (currentTime < timeoutTime) {
+                nextDeadline = MIN(nextDeadline, timeoutTime);
+                continue; // Skip update request if call is still pending
             }
-            continue; // Skip update request if call is still pending
+            
+            LogWarning("%s status callback timed out after %.1f ms", 
+                      intToString(i), (currentTime - device->callStartTime) * 1000.0);
+            Status_HandleDeviceTimeout(i);
         }
         
-        // Check if device is ready for update and queue allows commands
-        if (Status_IsDeviceReadyForUpdate(i) && Status_CanSendCommand(i)) {
-            Status_RequestDeviceUpdate(i);
+        double periodSeconds = Status_GetPollPeriodMs(i) / 1000.0;
+        double dueTime = device->lastUpdateTime + periodSeconds;
+        
+        if (currentTime >= dueTime) {
+            double readingTime;
+            
+            if (!Status_CanSendCommand(i)) {
+                // Disconnected or overloaded - look again a period from now
+                dueTime = currentTime + periodSeconds;
+            } else if (Status_HasFreshTelemetry(i, &readingTime)) {
+                // Another consumer read the device within the period - its
+                // reading already reached the UI, so count it as this poll.
+                // A device an experiment samples faster than this is never polled.
+                device->lastUpdateTime = readingTime;
+                dueTime = readingTime + periodSeconds;
+            } else {
+                Status_RequestDeviceUpdate(i);
+                dueTime = device->pendingCall ?
+                          device->callStartTime + STATUS_CALLBACK_TIMEOUT_MS / 1000.0 :
+                          device->lastUpdateTime + periodSeconds;
+            }
         }
+        
+        nextDeadline = MIN(nextDeadline, dueTime);
     }
+    
+    return MAX(0.0, (nextDeadline - GetTimestamp()) * 1000.0);
 }
 
-static bool Status_IsDeviceReadyForUpdate(int deviceType) {
-    DeviceStatusState *device = &g_status.devices[deviceType];
+// Read TC0 and TC1 from slot 2 for UI display if due, return the next read time
+static double Status_ReadThermocouples(double nextReadTime) {
+    double currentTime = GetTimestamp();
+    if (currentTime < nextReadTime) {
+        return nextReadTime;
+    }
+    
+    double temperatures[CDAQ_CHANNELS_PER_SLOT];
+    int numRead = 0;
+    if (CDAQ_ReadTCArray(2, temperatures, &numRead) == SUCCESS && numRead >= 2) {
+        UIUpdate_SetDouble(g_status.panelHandle, PANEL_NUM_TC0, temperatures[0]);
+        UIUpdate_SetDouble(g_status.panelHandle, PANEL_NUM_TC1, temperatures[1]);
+        History_Add(HISTORY_CHANNEL_TC0, currentTime, temperatures[0]);
+        History_Add(HISTORY_CHANNEL_TC1, currentTime, temperatures[1]);
+    }
+    
+    return currentTime + STATUS_CDAQ_PERIOD_MS / 1000.0;
+}
+
+// The activity-based period, stretched if polling at it would exceed the bus budget
+static double Status_GetPollPeriodMs(int deviceIndex) {
+    DeviceStatusState *device = &g_status.devices[deviceIndex];
+    double periodMs = device->pollPeriodMs > 0 ? device->pollPeriodMs : STATUS_UPDATE_PERIOD_MS;
+    double budgetPeriodMs = 0.0;
+    
+    if (deviceIndex == DEVICE_PSB) {
+        budgetPeriodMs = device->busTimeMs * 1000.0 / STATUS_PSB_BUS_BUDGET_MS;
+    } else if (deviceIndex >= DEVICE_DTB_BASE) {
+        // The DTBs share one bus, so they share one budget
+        int dtbCount = 0;
+        for (int i = DEVICE_DTB_BASE; i < DEVICE_COUNT; i++) {
+            if (g_status.devices[i].enabled) {
+                dtbCount++;
+            }
+        }
+        budgetPeriodMs = device->busTimeMs * dtbCount * 1000.0 / STATUS_DTB_BUS_BUDGET_MS;
+    }
+    
+    return MAX(periodMs, budgetPeriodMs);
+}
+
+// Called when a status poll completes. The duration includes time spent queued
+// behind other commands, so a busy link is polled less as well.
+static void Status_RecordPollTime(int deviceIndex) {
+    DeviceStatusState *device = &g_status.devices[deviceIndex];
+    double durationMs = (GetTimestamp() - device->callStartTime) * 1000.0;
+    
+    if (device->busTimeMs <= 0.0) {
+        device->busTimeMs = durationMs;
+    } else {
+        device->busTimeMs += STATUS_POLL_TIME_SMOOTHING * (durationMs - device->busTimeMs);
+    }
+}
+
+// Fast while the output is on or the current is moving, then back off to idle
+static void Status_AdaptPSBRate(const PSB_Status *status) {
+    DeviceStatusState *device = &g_status.devices[DEVICE_PSB];
     double currentTime = GetTimestamp();
-    double timeSinceLastUpdate = (currentTime - device->lastUpdateTime) * 1000.0;
+    bool active = status->outputEnabled;
     
-    return (timeSinceLastUpdate >= STATUS_UPDATE_PERIOD_MS && !device->pendingCall);
+    if (device->lastValueTime > 0.0 && currentTime > device->lastValueTime) {
+        double slew = fabs(status->current - device->lastValue) / (currentTime - device->lastValueTime);
+        if (slew > STATUS_PSB_CURRENT_SLEW_A_S) {
+            active = true;
+        }
+    }
+    device->lastValue = status->current;
+    device->lastValueTime = currentTime;
+    
+    double periodMs = active ? STATUS_PSB_FAST_PERIOD_MS :
+                      MIN(device->pollPeriodMs * 2.0, STATUS_PSB_IDLE_PERIOD_MS);
+    if (periodMs != device->pollPeriodMs) {
+        LogDebugEx(LOG_DEVICE_PSB, "PSB status period %.0f ms", periodMs);
+        device->pollPeriodMs = periodMs;
+        Status_Wake();
+    }
+}
+
+// Normal rate while the temperature moves, backing off once it has held
+// within the stable band for a while
+static void Status_AdaptDTBRate(int deviceIndex, const DTB_Status *status) {
+    DeviceStatusState *device = &g_status.devices[deviceIndex];
+    double currentTime = GetTimestamp();
+    double periodMs = device->pollPeriodMs;
+    
+    if (device->lastValueTime <= 0.0 ||
+        fabs(status->processValue - device->lastValue) > STATUS_DTB_STABLE_BAND_C ||
+        status->setPoint != device->lastSetPoint) {
+        // Moving (or new set point) - restart the stable window from here
+        device->lastValue = status->processValue;
+        device->stableSince = currentTime;
+        periodMs = STATUS_DTB_PERIOD_MS;
+    } else if ((currentTime - device->stableSince) * 1000.0 >= STATUS_DTB_STABLE_TIME_MS) {
+        periodMs = MIN(periodMs * 2.0, STATUS_DTB_STABLE_PERIOD_MS);
+    }
+    device->lastSetPoint = status->setPoint;
+    device->lastValueTime = currentTime;
+    
+    if (periodMs != device->pollPeriodMs) {
+        LogDebugEx(LOG_DEVICE_DTB, "%s status period %.0f ms", intToString(deviceIndex), periodMs);
+        device->pollPeriodMs = periodMs;
+        Status_Wake();
+    }
 }
 
 static void Status_RequestDeviceUpdate(int deviceIndex) {
@@ -462,6 +629,11 @@ static bool Status_CanSendCommand(int deviceIndex) {
     // Check queue connection state to determine if we should attempt sending commands
     // This does NOT update the UI - only determines if command should be sent
     
+    // Polling adds load to a queue that is already backed up - wait for it to drain
+    if (g_status.devices[deviceIndex].queueOverloaded) {
+        return false;
+    }
+    
     if (deviceIndex == DEVICE_PSB) {
         PSBQueueManager *mgr = PSB_GetGlobalQueueManager();
         if (mgr) {
@@ -492,6 +664,48 @@ static bool Status_CanSendCommand(int deviceIndex) {
     return false;
 }
 
+/******************************************************************************
+ * Queue Overload Handling
+ ******************************************************************************/
+
+static void Status_SubscribeOverload(bool subscribe) {
+    PSBQueueManager *psbMgr = PSB_GetGlobalQueueManager();
+    if (psbMgr && g_status.devices[DEVICE_PSB].enabled) {
+        DeviceQueue_SetOverloadCallback(psbMgr, subscribe ? Status_QueueOverloadCallback : NULL,
+                                      (void*)(intptr_t)DEVICE_PSB);
+    }
+    
+    // All DTB devices share one queue manager
+    DTBQueueManager *dtbMgr = DTB_GetGlobalQueueManager();
+    if (dtbMgr && ENABLE_DTB) {
+        DeviceQueue_SetOverloadCallback(dtbMgr, subscribe ? Status_QueueOverloadCallback : NULL,
+                                      (void*)(intptr_t)DEVICE_DTB_BASE);
+    }
+}
+
+static void Status_QueueOverloadCallback(DeviceQueueManager *mgr, DevicePriority priority,
+                                        int overloaded, void *userData) {
+    int deviceIndex = (int)(intptr_t)userData;
+    
+    // Shed polling while any priority of the device queue is overloaded
+    int anyOverloaded = DeviceQueue_IsOverloaded(mgr, DEVICE_PRIORITY_HIGH) ||
+                        DeviceQueue_IsOverloaded(mgr, DEVICE_PRIORITY_NORMAL) ||
+                        DeviceQueue_IsOverloaded(mgr, DEVICE_PRIORITY_LOW);
+    
+    if (deviceIndex >= DEVICE_DTB_BASE) {
+        for (int i = DEVICE_DTB_BASE; i < DEVICE_COUNT; i++) {
+            g_status.devices[i].queueOverloaded = anyOverloaded;
+        }
+    } else if (deviceIndex >= 0 && deviceIndex < DEVICE_COUNT) {
+        g_status.devices[deviceIndex].queueOverloaded = anyOverloaded;
+    }
+    
+    LogDebug("%s status polling %s", intToString(deviceIndex), anyOverloaded ? "paused" : "resumed");
+    if (!anyOverloaded) {
+        Status_Wake();
+    }
+}
+
 /******************************************************************************
  * Device-Specific Status Request Functions
  ******************************************************************************/
@@ -566,7 +780,9 @@ static void PSBStatusCallback(CommandID cmdId, PSBCommandType type,
     }
     
     // Clear pending call flag
+    Status_RecordPollTime(DEVICE_PSB);
     g_status.devices[DEVICE_PSB].pendingCall = false;
+    Status_Wake();
     
     PSBCommandResult *cmdResult = (PSBCommandResult *)result;
     if (!cmdResult) {
@@ -576,44 +792,12 @@ static void PSBStatusCallback(CommandID cmdId, PSBCommandType type,
     }
     
     if (cmdResult->errorCode == PSB_SUCCESS) {
-        PSB_Status *status = &cmdResult->data.status;
-        
-        // Update PSB measurement values
-        UpdatePSBValues(status);
-        
-        // Update remote mode LED (separate from status LED)
-        UIUpdateData* ledData = malloc(sizeof(UIUpdateData));
-        if (ledData) {
-            ledData->control = PANEL_LED_REMOTE_MODE;
-            ledData->intValue = status->remoteMode;
-            PostDeferredCall(DeferredLEDUpdate, ledData);
-        }
-        
-        // Determine device state based on remote mode
-        ConnectionState newState = status->remoteMode ? CONN_STATE_CONNECTED : CONN_STATE_IDLE;
-        g_status.devices[DEVICE_PSB].lastState = newState;
-        
-        // Update status LED based on remote mode
-        UpdateDeviceLED(DEVICE_PSB, newState);
-        
-        // Update status message
-        const char* statusMsg = status->remoteMode ? 
-            "PSB Connected - Remote Mode" : "PSB Connected - Local Mode";
-        UpdateDeviceStatus(DEVICE_PSB, statusMsg);
-        
-        // Update toggle to match actual state (if no change is pending)
-        if (!g_status.remoteModeChangePending) {
-            UIUpdateData* toggleData = malloc(sizeof(UIUpdateData));
-            if (toggleData) {
-                toggleData->control = PANEL_TOGGLE_REMOTE_MODE;
-                toggleData->intValue = status->remoteMode;
-                PostDeferredCall(DeferredToggleUpdate, toggleData);
-            }
+        // The telemetry subscription updates the UI
+        if (g_status.telemetrySubscription > 0) {
+            Telemetry_PublishPSBStatus(&cmdResult->data.status);
+        } else {
+            Status_ApplyPSBStatus(&cmdResult->data.status);
         }
-        
-        LogDebugEx(LOG_DEVICE_PSB, "PSB status updated: V=%.2fV, I=%.2fA, P=%.2fW, Remote=%s",
-                  status->voltage, status->current, status->power,
-                  status->remoteMode ? "ON" : "OFF");
     } else {
         // Communication error - set error state
         LogErrorEx(LOG_DEVICE_PSB, "Failed to get PSB status: %s", 
@@ -635,27 +819,16 @@ static void DTBStatusCallback(CommandID cmdId, DTBCommandType type,
     int slaveAddress = (int)(intptr_t)userData;
     
     // Find device index by slave address dynamically
-    int deviceIndex = -1;
-    DTBQueueManager *dtbMgr = DTB_GetGlobalQueueManager();
-    if (dtbMgr) {
-        DTBDeviceContext *ctx = (DTBDeviceContext*)DeviceQueue_GetDeviceContext(dtbMgr);
-        if (ctx) {
-            for (int i = 0; i < ctx->numDevices; i++) {
-                if (ctx->slaveAddresses[i] == slaveAddress) {
-                    deviceIndex = DEVICE_DTB_BASE + i;
-                    break;
-                }
-            }
-        }
-    }
-    
+    int deviceIndex = Status_FindDTBDeviceIndex(slaveAddress);
     if (deviceIndex < 0) {
         LogError("DTBStatusCallback: Could not find device index for slave address %d", slaveAddress);
         return;
     }
     
     // Clear pending call flag
+    Status_RecordPollTime(deviceIndex);
     g_status.devices[deviceIndex].pendingCall = false;
+    Status_Wake();
     
     DTBCommandResult *cmdResult = (DTBCommandResult *)result;
     if (!cmdResult) {
@@ -665,23 +838,11 @@ static void DTBStatusCallback(CommandID cmdId, DTBCommandType type,
     }
     
     if (cmdResult->errorCode == DTB_SUCCESS) {
-        DTB_Status *status = &cmdResult->data.status;
-        
-        // Update DTB measurement values
-        UpdateDTBValues(deviceIndex, status);
-        
-        // Update device state based on output enabled status
-        ConnectionState newState = status->outputEnabled ? CONN_STATE_CONNECTED : CONN_STATE_IDLE;
-        g_status.devices[deviceIndex].lastState = newState;
-        
-        // Update status LED and message
-        UpdateDeviceLED(deviceIndex, newState);
-        
-        const char* statusMsg = status->outputEnabled ? "DTB Running" : "DTB Connected - Stopped";
-        UpdateDeviceStatus(deviceIndex, statusMsg);
-        
-        LogDebugEx(LOG_DEVICE_DTB, "DTB slave %d status updated: Temp=%.1fC, Output=%s",
-                  slaveAddress, status->processValue, status->outputEnabled ? "ON" : "OFF");
+        if (g_status.telemetrySubscription > 0) {
+            Telemetry_PublishDTBStatus(slaveAddress, &cmdResult->data.status);
+        } else {
+            Status_ApplyDTBStatus(deviceIndex, slaveAddress, &cmdResult->data.status);
+        }
     } else {
         LogErrorEx(LOG_DEVICE_DTB, "Failed to get DTB slave %d status: %s",
                  slaveAddress, DTB_GetErrorString(cmdResult->errorCode));
@@ -691,160 +852,233 @@ static void DTBStatusCallback(CommandID cmdId, DTBCommandType type,
     }
 }
 
+/******************************************************************************
+ * Telemetry - readings from any consumer update the UI
+ ******************************************************************************/
+
+static void Status_TelemetryCallback(const TelemetrySnapshot *snapshot, void *userData) {
+    if (!Status_ShouldProcessUpdates()) {
+        return;
+    }
+    
+    if (snapshot->source == TELEMETRY_SOURCE_PSB) {
+        if (g_status.devices[DEVICE_PSB].enabled) {
+            Status_ApplyPSBStatus(&snapshot->data.psb);
+        }
+    } else if (snapshot->source == TELEMETRY_SOURCE_DTB) {
+        int deviceIndex = Status_FindDTBDeviceIndex(snapshot->slaveAddress);
+        if (deviceIndex >= 0 && g_status.devices[deviceIndex].enabled) {
+            Status_ApplyDTBStatus(deviceIndex, snapshot->slaveAddress, &snapshot->data.dtb);
+        }
+    }
+}
+
+// True if the cache holds a reading of the device younger than its poll period
+static bool Status_HasFreshTelemetry(int deviceIndex, double *timestamp) {
+    TelemetrySnapshot snapshot;
+    int result;
+    
+    if (g_status.telemetrySubscription <= 0) {
+        return false;
+    }
+    
+    if (deviceIndex == DEVICE_PSB) {
+        result = Telemetry_GetLatest(TELEMETRY_SOURCE_PSB, 0, &snapshot);
+    } else if (deviceIndex >= DEVICE_DTB_BASE) {
+        DTBQueueManager *dtbMgr = DTB_GetGlobalQueueManager();
+        DTBDeviceContext *ctx = dtbMgr ? (DTBDeviceContext*)DeviceQueue_GetDeviceContext(dtbMgr) : NULL;
+        int dtbIndex = deviceIndex - DEVICE_DTB_BASE;
+        if (!ctx || dtbIndex >= ctx->numDevices) {
+            return false;
+        }
+        result = Telemetry_GetLatest(TELEMETRY_SOURCE_DTB, ctx->slaveAddresses[dtbIndex], &snapshot);
+    } else {
+        return false;
+    }
+    
+    if (result != SUCCESS || (GetTimestamp() - snapshot.timestamp) * 1000.0 >= Status_GetPollPeriodMs(deviceIndex)) {
+        return false;
+    }
+    
+    *timestamp = snapshot.timestamp;
+    return true;
+}
+
+static void Status_ApplyPSBStatus(const PSB_Status *status) {
+    Status_AdaptPSBRate(status);
+    
+    // Update PSB measurement values
+    UpdatePSBValues(status);
+    
+    // Update remote mode LED (separate from status LED)
+    Status_UpdateRemoteLED(status->remoteMode);
+    
+    // Determine device state based on remote mode
+    ConnectionState newState = status->remoteMode ? CONN_STATE_CONNECTED : CONN_STATE_IDLE;
+    g_status.devices[DEVICE_PSB].lastState = newState;
+    
+    // Update status LED based on remote mode
+    UpdateDeviceLED(DEVICE_PSB, newState);
+    
+    // Update status message
+    const char* statusMsg = status->remoteMode ? 
+        "PSB Connected - Remote Mode" : "PSB Connected - Local Mode";
+    UpdateDeviceStatus(DEVICE_PSB, statusMsg);
+    
+    // Update toggle to match actual state (if no change is pending)
+    if (!g_status.remoteModeChangePending) {
+        UIUpdate_SetInt(g_status.panelHandle, PANEL_TOGGLE_REMOTE_MODE, status->remoteMode);
+    }
+    
+    LogDebugEx(LOG_DEVICE_PSB, "PSB status updated: V=%.2fV, I=%.2fA, P=%.2fW, Remote=%s",
+              status->voltage, status->current, status->power,
+              status->remoteMode ? "ON" : "OFF");
+}
+
+static void Status_ApplyDTBStatus(int deviceIndex, int slaveAddress, const DTB_Status *status) {
+    Status_AdaptDTBRate(deviceIndex, status);
+    
+    // Update DTB measurement values
+    UpdateDTBValues(deviceIndex, status);
+    
+    // Update device state based on output enabled status
+    ConnectionState newState = status->outputEnabled ? CONN_STATE_CONNECTED : CONN_STATE_IDLE;
+    g_status.devices[deviceIndex].lastState = newState;
+    
+    // Update status LED and message
+    UpdateDeviceLED(deviceIndex, newState);
+    
+    const char* statusMsg = status->outputEnabled ? "DTB Running" : "DTB Connected - Stopped";
+    UpdateDeviceStatus(deviceIndex, statusMsg);
+    
+    LogDebugEx(LOG_DEVICE_DTB, "DTB slave %d status updated: Temp=%.1fC, Output=%s",
+              slaveAddress, status->processValue, status->outputEnabled ? "ON" : "OFF");
+}
+
+static int Status_FindDTBDeviceIndex(int slaveAddress) {
+    DTBQueueManager *dtbMgr = DTB_GetGlobalQueueManager();
+    if (dtbMgr) {
+        DTBDeviceContext *ctx = (DTBDeviceContext*)DeviceQueue_GetDeviceContext(dtbMgr);
+        if (ctx) {
+            for (int i = 0; i < ctx->numDevices; i++) {
+                if (ctx->slaveAddresses[i] == slaveAddress) {
+                    return DEVICE_DTB_BASE + i;
+                }
+            }
+        }
+    }
+    
+    return -1;
+}
+
 /******************************************************************************
  * UI Update Functions
  ******************************************************************************/
 
 static void UpdateDeviceLED(int deviceType, ConnectionState state) {
-    UIUpdateData* data = malloc(sizeof(UIUpdateData));
-    if (!data) return;
+    int control;
     
     if (deviceType < DEVICE_DTB_BASE) {
         // Handle PSB and BioLogic as before
         switch (deviceType) {
             case DEVICE_PSB:
-                data->control = PANEL_LED_PSB_STATUS;
+                control = PANEL_LED_PSB_STATUS;
                 break;
             case DEVICE_BIOLOGIC:
-                data->control = PANEL_LED_BIOLOGIC_STATUS;
+                control = PANEL_LED_BIOLOGIC_STATUS;
                 break;
             default:
-                free(data);
                 return;
         }
     } else {
         // Handle DTB devices dynamically
         DTBQueueManager *dtbMgr = DTB_GetGlobalQueueManager();
-        if (dtbMgr) {
-            DTBDeviceContext *ctx = (DTBDeviceContext*)DeviceQueue_GetDeviceContext(dtbMgr);
-            if (ctx) {
-                int dtbIndex = deviceType - DEVICE_DTB_BASE;
-                if (dtbIndex >= 0 && dtbIndex < ctx->numDevices) {
-                    int slaveAddress = ctx->slaveAddresses[dtbIndex];
-                    int ledControl, statusControl, tempControl;
-                    
-                    if (GetDTBUIControls(slaveAddress, &ledControl, &statusControl, &tempControl)) {
-                        data->control = ledControl;
-                    } else {
-                        LogError("No UI controls defined for DTB slave address %d", slaveAddress);
-                        free(data);
-                        return;
-                    }
-                } else {
-                    free(data);
-                    return;
-                }
-            } else {
-                free(data);
-                return;
-            }
-        } else {
-            free(data);
+        if (!dtbMgr) return;
+        
+        DTBDeviceContext *ctx = (DTBDeviceContext*)DeviceQueue_GetDeviceContext(dtbMgr);
+        if (!ctx) return;
+        
+        int dtbIndex = deviceType - DEVICE_DTB_BASE;
+        if (dtbIndex < 0 || dtbIndex >= ctx->numDevices) return;
+        
+        int slaveAddress = ctx->slaveAddresses[dtbIndex];
+        int ledControl, statusControl, tempControl;
+        
+        if (!GetDTBUIControls(slaveAddress, &ledControl, &statusControl, &tempControl)) {
+            LogError("No UI controls defined for DTB slave address %d", slaveAddress);
             return;
         }
+        control = ledControl;
     }
     
     // Determine LED color based on state
+    int color;
     switch (state) {
         case CONN_STATE_IDLE:
-            data->intValue = VAL_YELLOW;  // Yellow for idle/stopped
+            color = VAL_YELLOW;  // Yellow for idle/stopped
             break;
         case CONN_STATE_ERROR:
-            data->intValue = VAL_RED;      // Red for errors
+            color = VAL_RED;      // Red for errors
             break;
         case CONN_STATE_CONNECTED:
-            data->intValue = VAL_GREEN;    // Green for connected/running
+            color = VAL_GREEN;    // Green for connected/running
             break;
         default:
-            data->intValue = VAL_DK_YELLOW;
+            color = VAL_DK_YELLOW;
             break;
     }
     
-    PostDeferredCall(DeferredLEDUpdate, data);
+    // Device status LEDs stay lit and show the connection state by color
+    UIUpdate_SetAttributeInt(g_status.panelHandle, control, ATTR_ON_COLOR, color);
+    UIUpdate_SetInt(g_status.panelHandle, control, 1);
 }
 
 static void UpdateDeviceStatus(int deviceType, const char* message) {
-    UIUpdateData* data = malloc(sizeof(UIUpdateData));
-    if (!data) return;
+    int control;
     
     if (deviceType < DEVICE_DTB_BASE) {
         // Handle PSB and BioLogic as before
         switch (deviceType) {
             case DEVICE_PSB:
-                data->control = PANEL_STR_PSB_STATUS;
+                control = PANEL_STR_PSB_STATUS;
                 break;
             case DEVICE_BIOLOGIC:
-                data->control = PANEL_STR_BIOLOGIC_STATUS;
+                control = PANEL_STR_BIOLOGIC_STATUS;
                 break;
             default:
-                free(data);
                 return;
         }
     } else {
         // Handle DTB devices dynamically
         DTBQueueManager *dtbMgr = DTB_GetGlobalQueueManager();
-        if (dtbMgr) {
-            DTBDeviceContext *ctx = (DTBDeviceContext*)DeviceQueue_GetDeviceContext(dtbMgr);
-            if (ctx) {
-                int dtbIndex = deviceType - DEVICE_DTB_BASE;
-                if (dtbIndex >= 0 && dtbIndex < ctx->numDevices) {
-                    int slaveAddress = ctx->slaveAddresses[dtbIndex];
-                    int ledControl, statusControl, tempControl;
-                    
-                    if (GetDTBUIControls(slaveAddress, &ledControl, &statusControl, &tempControl)) {
-                        data->control = statusControl;
-                    } else {
-                        LogError("No UI controls defined for DTB slave address %d", slaveAddress);
-                        free(data);
-                        return;
-                    }
-                } else {
-                    free(data);
-                    return;
-                }
-            } else {
-                free(data);
-                return;
-            }
-        } else {
-            free(data);
+        if (!dtbMgr) return;
+        
+        DTBDeviceContext *ctx = (DTBDeviceContext*)DeviceQueue_GetDeviceContext(dtbMgr);
+        if (!ctx) return;
+        
+        int dtbIndex = deviceType - DEVICE_DTB_BASE;
+        if (dtbIndex < 0 || dtbIndex >= ctx->numDevices) return;
+        
+        int slaveAddress = ctx->slaveAddresses[dtbIndex];
+        int ledControl, statusControl, tempControl;
+        
+        if (!GetDTBUIControls(slaveAddress, &ledControl, &statusControl, &tempControl)) {
+            LogError("No UI controls defined for DTB slave address %d", slaveAddress);
             return;
         }
+        control = statusControl;
     }
     
-    strncpy(data->strValue, message, sizeof(data->strValue) - 1);
-    data->strValue[sizeof(data->strValue) - 1] = '\0';
-    
-    PostDeferredCall(DeferredStatusUpdate, data);
+    UIUpdate_SetString(g_status.panelHandle, control, message);
 }
 
-static void UpdatePSBValues(PSB_Status* status) {
-    // Update voltage
-    UIUpdateData* vData = malloc(sizeof(UIUpdateData));
-    if (vData) {
-        vData->control = PANEL_NUM_VOLTAGE;
-        vData->dblValue = status->voltage;
-        PostDeferredCall(DeferredNumericUpdate, vData);
-    }
-    
-    // Update current
-    UIUpdateData* iData = malloc(sizeof(UIUpdateData));
-    if (iData) {
-        iData->control = PANEL_NUM_CURRENT;
-        iData->dblValue = status->current;
-        PostDeferredCall(DeferredNumericUpdate, iData);
-    }
-    
-    // Update power
-    UIUpdateData* pData = malloc(sizeof(UIUpdateData));
-    if (pData) {
-        pData->control = PANEL_NUM_POWER;
-        pData->dblValue = status->power;
-        PostDeferredCall(DeferredNumericUpdate, pData);
-    }
+static void UpdatePSBValues(const PSB_Status* status) {
+    UIUpdate_SetDouble(g_status.panelHandle, PANEL_NUM_VOLTAGE, status->voltage);
+    UIUpdate_SetDouble(g_status.panelHandle, PANEL_NUM_CURRENT, status->current);
+    UIUpdate_SetDouble(g_status.panelHandle, PANEL_NUM_POWER, status->power);
 }
 
-static void UpdateDTBValues(int deviceIndex, DTB_Status* status) {
+static void UpdateDTBValues(int deviceIndex, const DTB_Status* status) {
     DTBQueueManager *dtbMgr = DTB_GetGlobalQueueManager();
     if (!dtbMgr) return;
     
@@ -858,70 +1092,7 @@ static void UpdateDTBValues(int deviceIndex, DTB_Status* status) {
     int ledControl, statusControl, tempControl;
     
     if (GetDTBUIControls(slaveAddress, &ledControl, &statusControl, &tempControl)) {
-        UIUpdateData* tempData = malloc(sizeof(UIUpdateData));
-        if (tempData) {
-            tempData->control = tempControl;
-            tempData->dblValue = status->processValue;
-            PostDeferredCall(DeferredNumericUpdate, tempData);
-        }
-    }
-}
-
-/******************************************************************************
- * Deferred Callback Functions
- ******************************************************************************/
-
-static void CVICALLBACK DeferredLEDUpdate(void* data) {
-    UIUpdateData* updateData = (UIUpdateData*)data;
-    if (updateData && g_status.panelHandle > 0) {
-        if (updateData->control == PANEL_LED_REMOTE_MODE) {
-            // Set Remote LED to green when ON
-            SetCtrlAttribute(g_status.panelHandle, updateData->control, 
-                            ATTR_ON_COLOR, VAL_GREEN);  
-            SetCtrlVal(g_status.panelHandle, updateData->control, updateData->intValue);
-        } else {
-            // Device status LEDs use color scheme based on connection state
-            SetCtrlAttribute(g_status.panelHandle, updateData->control, 
-                            ATTR_ON_COLOR, updateData->intValue);
-            SetCtrlVal(g_status.panelHandle, updateData->control, 1);
-        }
-        free(updateData);
-    }
-}
-
-static void CVICALLBACK DeferredStatusUpdate(void* data) {
-    UIUpdateData* updateData = (UIUpdateData*)data;
-    if (updateData && g_status.panelHandle > 0) {
-        SetCtrlVal(g_status.panelHandle, updateData->control, updateData->strValue);
-        ProcessDrawEvents();
-        free(updateData);
-    }
-}
-
-static void CVICALLBACK DeferredNumericUpdate(void* data) {
-    UIUpdateData* updateData = (UIUpdateData*)data;
-    if (updateData && g_status.panelHandle > 0) {
-        SetCtrlVal(g_status.panelHandle, updateData->control, updateData->dblValue);
-        free(updateData);
-    }
-}
-
-static void CVICALLBACK DeferredToggleUpdate(void* data) {
-    UIUpdateData* updateData = (UIUpdateData*)data;
-    if (updateData && g_status.panelHandle > 0) {
-        // Don't update toggle if a change is pending
-        if (!g_status.remoteModeChangePending) {
-            // Get current toggle value to avoid unnecessary updates
-            int currentValue;
-            GetCtrlVal(g_status.panelHandle, updateData->control, &currentValue);
-            
-            // Only update if value has changed
-            if (currentValue != updateData->intValue) {
-                SetCtrlVal(g_status.panelHandle, updateData->control, updateData->intValue);
-            }
-        }
-        
-        free(updateData);
+        UIUpdate_SetDouble(g_status.panelHandle, tempControl, status->processValue);
     }
 }
 
@@ -930,12 +1101,9 @@ static void CVICALLBACK DeferredToggleUpdate(void* data) {
  ******************************************************************************/
 
 void Status_UpdateRemoteLED(int isOn) {
-    UIUpdateData* data = malloc(sizeof(UIUpdateData));
-    if (data) {
-        data->control = PANEL_LED_REMOTE_MODE;
-        data->intValue = isOn;
-        PostDeferredCall(DeferredLEDUpdate, data);
-    }
+    // Remote LED is green when ON
+    UIUpdate_SetAttributeInt(g_status.panelHandle, PANEL_LED_REMOTE_MODE, ATTR_ON_COLOR, VAL_GREEN);
+    UIUpdate_SetInt(g_status.panelHandle, PANEL_LED_REMOTE_MODE, isOn);
 }
 
 /******************************************************************************
@@ -13,9 +13,28 @@
  * Configuration Constants
  ******************************************************************************/
 // Update rates
-#define STATUS_UPDATE_RATE_HZ           1    // Status update frequency in Hz
+#define STATUS_UPDATE_RATE_HZ           1    // Status update frequency in Hz (BioLogic)
 #define STATUS_UPDATE_PERIOD_MS         (1000 / STATUS_UPDATE_RATE_HZ)  // 1000ms
 #define STATUS_CALLBACK_TIMEOUT_MS      5000 // Timeout for async status callbacks
+#define STATUS_MAX_SLEEP_MS             1000 // Longest the status thread sleeps between checks
+#define STATUS_CDAQ_PERIOD_MS           250  // Thermocouple display refresh
+
+// Adaptive polling - each device's period moves between its fast and slow
+// period with what the device is doing, and is never shorter than its bus
+// budget allows. Budgets are milliseconds of bus time per second, measured
+// from the status polls themselves.
+#define STATUS_POLL_TIME_SMOOTHING      0.25 // Weight of the newest poll in the bus time average
+
+#define STATUS_PSB_FAST_PERIOD_MS       200  // Output on or current changing
+#define STATUS_PSB_IDLE_PERIOD_MS       1000 // Output off and current steady
+#define STATUS_PSB_CURRENT_SLEW_A_S     0.5  // |dI/dt| above this counts as changing
+#define STATUS_PSB_BUS_BUDGET_MS        150  // PSB link time per second for status polls
+
+#define STATUS_DTB_PERIOD_MS            1000 // Temperature moving
+#define STATUS_DTB_STABLE_PERIOD_MS     5000 // Temperature settled
+#define STATUS_DTB_STABLE_BAND_C        0.2  // Readings within this band count as stable
+#define STATUS_DTB_STABLE_TIME_MS       30000 // Stable this long before backing off
+#define STATUS_DTB_BUS_BUDGET_MS        100  // RS-485 time per second, shared by all DTBs
 
 #define DEVICE_PSB 0
 #define DEVICE_BIOLOGIC 1
@@ -36,7 +36,7 @@ static const char* errorStrings[] = {
  ******************************************************************************/
 
 static void PrintDebug(const char *format, ...) {
-    if (!g_debugMode) return;
+    if (!LogIsEnabled(LOG_DEVICE_TNY, LOG_LEVEL_DEBUG)) return;
     
     char buffer[256];
     va_list args;
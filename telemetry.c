@@ -0,0 +1,342 @@
+/******************************************************************************
+ * telemetry.c
+ *
+ * Telemetry Cache Module Implementation
+ * Holds the latest reading of each device and publishes new readings to
+ * subscribers. status.c polls the devices on its schedule and publishes here;
+ * experiments and controls read from the cache and only touch the device
+ * queues when the cached reading is older than they can accept.
+ ******************************************************************************/
+
+#include "common.h"
+#include "telemetry.h"
+#include "logging.h"
+
+/******************************************************************************
+ * Module Variables
+ ******************************************************************************/
+
+typedef struct {
+    int handle;                 // 0 for a free slot
+    TelemetryCallback callback;
+    void *userData;
+} TelemetrySubscriber;
+
+typedef struct {
+    bool valid;
+    TelemetrySnapshot snapshot;
+} TelemetryEntry;
+
+static struct {
+    volatile int initialized;
+    CmtThreadLockHandle lock;               // Guards the entries and subscribers
+    CmtThreadLockHandle psbRefreshLock;     // One PSB read in flight at a time
+    CmtThreadLockHandle dtbRefreshLock;     // One DTB read in flight at a time (shared bus)
+
+    TelemetryEntry psb;
+    TelemetryEntry dtb[MAX_DTB_DEVICES];    // In order of first publish
+
+    TelemetrySubscriber subscribers[TELEMETRY_MAX_SUBSCRIBERS];
+    int nextHandle;
+} g_telemetry = {0};
+
+/******************************************************************************
+ * Internal Function Prototypes
+ ******************************************************************************/
+
+static TelemetryEntry* Telemetry_FindEntry(TelemetrySource source, int slaveAddress, bool create);
+static void Telemetry_Publish(const TelemetrySnapshot *snapshot);
+static bool Telemetry_GetIfFresh(TelemetrySource source, int slaveAddress, int maxAgeMs,
+                                 TelemetrySnapshot *snapshot);
+
+/******************************************************************************
+ * Public Interface Implementation
+ ******************************************************************************/
+
+int Telemetry_Initialize(void) {
+    if (g_telemetry.initialized) {
+        return SUCCESS;
+    }
+
+    memset(&g_telemetry, 0, sizeof(g_telemetry));
+
+    if (CmtNewLock(NULL, 0, &g_telemetry.lock) < 0 ||
+        CmtNewLock(NULL, 0, &g_telemetry.psbRefreshLock) < 0 ||
+        CmtNewLock(NULL, 0, &g_telemetry.dtbRefreshLock) < 0) {
+        LogError("Failed to create telemetry locks");
+        Telemetry_Cleanup();
+        return ERR_THREAD_SYNC;
+    }
+
+    g_telemetry.initialized = 1;
+    LogMessage("Telemetry cache initialized");
+    return SUCCESS;
+}
+
+void Telemetry_Cleanup(void) {
+    g_telemetry.initialized = 0;
+
+    if (g_telemetry.dtbRefreshLock) {
+        CmtDiscardLock(g_telemetry.dtbRefreshLock);
+        g_telemetry.dtbRefreshLock = 0;
+    }
+    if (g_telemetry.psbRefreshLock) {
+        CmtDiscardLock(g_telemetry.psbRefreshLock);
+        g_telemetry.psbRefreshLock = 0;
+    }
+    if (g_telemetry.lock) {
+        CmtDiscardLock(g_telemetry.lock);
+        g_telemetry.lock = 0;
+    }
+}
+
+int Telemetry_Subscribe(TelemetryCallback callback, void *userData) {
+    if (!callback) {
+        return ERR_NULL_POINTER;
+    }
+    if (!g_telemetry.initialized) {
+        return ERR_NOT_INITIALIZED;
+    }
+
+    int handle = ERR_OPERATION_FAILED;
+    CmtGetLock(g_telemetry.lock);
+    for (int i = 0; i < TELEMETRY_MAX_SUBSCRIBERS; i++) {
+        TelemetrySubscriber *subscriber = &g_telemetry.subscribers[i];
+        if (subscriber->handle == 0) {
+            subscriber->handle = ++g_telemetry.nextHandle;
+            subscriber->callback = callback;
+            subscriber->userData = userData;
+            handle = subscriber->handle;
+            break;
+        }
+    }
+    CmtReleaseLock(g_telemetry.lock);
+
+    if (handle < 0) {
+        LogError("No free telemetry subscriber slots");
+    }
+    return handle;
+}
+
+void Telemetry_Unsubscribe(int handle) {
+    if (handle <= 0 || !g_telemetry.initialized) {
+        return;
+    }
+
+    CmtGetLock(g_telemetry.lock);
+    for (int i = 0; i < TELEMETRY_MAX_SUBSCRIBERS; i++) {
+        if (g_telemetry.subscribers[i].handle == handle) {
+            memset(&g_telemetry.subscribers[i], 0, sizeof(TelemetrySubscriber));
+            break;
+        }
+    }
+    CmtReleaseLock(g_telemetry.lock);
+}
+
+void Telemetry_PublishPSBStatus(const PSB_Status *status) {
+    if (!status) {
+        return;
+    }
+
+    TelemetrySnapshot snapshot;
+    memset(&snapshot, 0, sizeof(snapshot));
+    snapshot.source = TELEMETRY_SOURCE_PSB;
+    snapshot.timestamp = GetTimestamp();
+    snapshot.data.psb = *status;
+    Telemetry_Publish(&snapshot);
+}
+
+void Telemetry_PublishDTBStatus(int slaveAddress, const DTB_Status *status) {
+    if (!status) {
+        return;
+    }
+
+    TelemetrySnapshot snapshot;
+    memset(&snapshot, 0, sizeof(snapshot));
+    snapshot.source = TELEMETRY_SOURCE_DTB;
+    snapshot.slaveAddress = slaveAddress;
+    snapshot.timestamp = GetTimestamp();
+    snapshot.data.dtb = *status;
+    Telemetry_Publish(&snapshot);
+}
+
+int Telemetry_GetLatest(TelemetrySource source, int slaveAddress, TelemetrySnapshot *snapshot) {
+    if (!snapshot) {
+        return ERR_NULL_POINTER;
+    }
+    if (!g_telemetry.initialized) {
+        return ERR_NOT_INITIALIZED;
+    }
+
+    int result = ERR_NOT_INITIALIZED;
+    CmtGetLock(g_telemetry.lock);
+    TelemetryEntry *entry = Telemetry_FindEntry(source, slaveAddress, false);
+    if (entry && entry->valid) {
+        *snapshot = entry->snapshot;
+        result = SUCCESS;
+    }
+    CmtReleaseLock(g_telemetry.lock);
+
+    return result;
+}
+
+int Telemetry_GetPSBStatus(PSB_Status *status, int maxAgeMs, DevicePriority priority) {
+    TelemetrySnapshot snapshot;
+
+    if (!status) {
+        return ERR_NULL_POINTER;
+    }
+    if (!g_telemetry.initialized) {
+        return PSB_GetStatusQueued(status, priority);
+    }
+
+    if (Telemetry_GetIfFresh(TELEMETRY_SOURCE_PSB, 0, maxAgeMs, &snapshot)) {
+        *status = snapshot.data.psb;
+        return SUCCESS;
+    }
+
+    // Whoever gets here first reads the device, the rest wait and take its reading
+    CmtGetLock(g_telemetry.psbRefreshLock);
+    int result = SUCCESS;
+    if (Telemetry_GetIfFresh(TELEMETRY_SOURCE_PSB, 0, maxAgeMs, &snapshot)) {
+        *status = snapshot.data.psb;
+    } else {
+        result = PSB_GetStatusQueued(status, priority);
+        if (result == PSB_SUCCESS) {
+            Telemetry_PublishPSBStatus(status);
+        }
+    }
+    CmtReleaseLock(g_telemetry.psbRefreshLock);
+
+    return result;
+}
+
+int Telemetry_GetDTBStatus(int slaveAddress, DTB_Status *status, int maxAgeMs, DevicePriority priority) {
+    TelemetrySnapshot snapshot;
+
+    if (!status) {
+        return ERR_NULL_POINTER;
+    }
+    if (!g_telemetry.initialized) {
+        return DTB_GetStatusQueued(slaveAddress, status, priority);
+    }
+
+    if (Telemetry_GetIfFresh(TELEMETRY_SOURCE_DTB, slaveAddress, maxAgeMs, &snapshot)) {
+        *status = snapshot.data.dtb;
+        return SUCCESS;
+    }
+
+    CmtGetLock(g_telemetry.dtbRefreshLock);
+    int result = SUCCESS;
+    if (Telemetry_GetIfFresh(TELEMETRY_SOURCE_DTB, slaveAddress, maxAgeMs, &snapshot)) {
+        *status = snapshot.data.dtb;
+    } else {
+        result = DTB_GetStatusQueued(slaveAddress, status, priority);
+        if (result == DTB_SUCCESS) {
+            Telemetry_PublishDTBStatus(slaveAddress, status);
+        }
+    }
+    CmtReleaseLock(g_telemetry.dtbRefreshLock);
+
+    return result;
+}
+
+int Telemetry_GetDTBStatusAll(DTB_Status *statuses, int *numDevices, int maxAgeMs, DevicePriority priority) {
+    if (!statuses || !numDevices) {
+        return ERR_NULL_POINTER;
+    }
+
+    DTBQueueManager *queueMgr = DTB_GetGlobalQueueManager();
+    if (!queueMgr) {
+        return ERR_QUEUE_NOT_INIT;
+    }
+
+    DTBDeviceContext *ctx = (DTBDeviceContext*)DeviceQueue_GetDeviceContext(queueMgr);
+    if (!ctx) {
+        return ERR_QUEUE_NOT_INIT;
+    }
+
+    *numDevices = 0;
+    int firstError = DTB_SUCCESS;
+    int successCount = 0;
+
+    for (int i = 0; i < ctx->numDevices && i < MAX_DTB_DEVICES; i++) {
+        int result = Telemetry_GetDTBStatus(ctx->slaveAddresses[i], &statuses[i], maxAgeMs, priority);
+        if (result == DTB_SUCCESS) {
+            successCount++;
+        } else {
+            LogErrorEx(LOG_DEVICE_DTB, "Failed to get status from DTB slave %d: %s",
+                       ctx->slaveAddresses[i], DTB_GetErrorString(result));
+            if (firstError == DTB_SUCCESS) {
+                firstError = result;
+            }
+        }
+    }
+
+    *numDevices = ctx->numDevices;
+
+    if (successCount < ctx->numDevices) {
+        LogWarningEx(LOG_DEVICE_DTB, "Got status from %d of %d DTB devices",
+                     successCount, ctx->numDevices);
+    }
+    return firstError;
+}
+
+/******************************************************************************
+ * Internal Functions
+ ******************************************************************************/
+
+// Caller holds g_telemetry.lock
+static TelemetryEntry* Telemetry_FindEntry(TelemetrySource source, int slaveAddress, bool create) {
+    if (source == TELEMETRY_SOURCE_PSB) {
+        return &g_telemetry.psb;
+    }
+
+    for (int i = 0; i < MAX_DTB_DEVICES; i++) {
+        TelemetryEntry *entry = &g_telemetry.dtb[i];
+        if (entry->valid && entry->snapshot.slaveAddress == slaveAddress) {
+            return entry;
+        }
+        if (!entry->valid) {
+            return create ? entry : NULL;
+        }
+    }
+
+    return NULL;
+}
+
+static void Telemetry_Publish(const TelemetrySnapshot *snapshot) {
+    TelemetrySubscriber subscribers[TELEMETRY_MAX_SUBSCRIBERS];
+
+    if (!g_telemetry.initialized) {
+        return;
+    }
+
+    CmtGetLock(g_telemetry.lock);
+    TelemetryEntry *entry = Telemetry_FindEntry(snapshot->source, snapshot->slaveAddress, true);
+    if (entry) {
+        entry->snapshot = *snapshot;
+        entry->valid = true;
+    }
+    memcpy(subscribers, g_telemetry.subscribers, sizeof(subscribers));
+    CmtReleaseLock(g_telemetry.lock);
+
+    // Outside the lock so subscribers may read the cache
+    for (int i = 0; i < TELEMETRY_MAX_SUBSCRIBERS; i++) {
+        if (subscribers[i].handle != 0) {
+            subscribers[i].callback(snapshot, subscribers[i].userData);
+        }
+    }
+}
+
+static bool Telemetry_GetIfFresh(TelemetrySource source, int slaveAddress, int maxAgeMs,
+                                 TelemetrySnapshot *snapshot) {
+    if (maxAgeMs <= TELEMETRY_MAX_AGE_FRESH) {
+        return false;
+    }
+    if (Telemetry_GetLatest(source, slaveAddress, snapshot) != SUCCESS) {
+        return false;
+    }
+
+    return (GetTimestamp() - snapshot->timestamp) * 1000.0 <= maxAgeMs;
+}
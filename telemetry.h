@@ -0,0 +1,131 @@
+/******************************************************************************
+ * telemetry.h
+ *
+ * Telemetry Cache Module Header
+ * Keeps the latest timestamped status of each device and publishes every new
+ * reading to subscribers, so consumers share one poll schedule instead of
+ * each issuing their own status commands on the slow device links
+ ******************************************************************************/
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "common.h"
+#include "psb10000_queue.h"
+#include "dtb4848_queue.h"
+
+/******************************************************************************
+ * Configuration Constants
+ ******************************************************************************/
+#define TELEMETRY_MAX_SUBSCRIBERS       16
+#define TELEMETRY_MAX_AGE_FRESH         0       // Always read the device, e.g. safety checks
+
+/******************************************************************************
+ * Type Definitions
+ ******************************************************************************/
+
+typedef enum {
+    TELEMETRY_SOURCE_PSB = 0,
+    TELEMETRY_SOURCE_DTB
+} TelemetrySource;
+
+// One device reading
+typedef struct {
+    TelemetrySource source;
+    int slaveAddress;           // DTB slave address, 0 for the PSB
+    double timestamp;           // GetTimestamp() when the reading completed
+    union {
+        PSB_Status psb;
+        DTB_Status dtb;
+    } data;
+} TelemetrySnapshot;
+
+// Called on the publishing thread for every new reading. Keep it short and
+// do not call back into the device queues from it.
+typedef void (*TelemetryCallback)(const TelemetrySnapshot *snapshot, void *userData);
+
+/******************************************************************************
+ * Public Function Declarations
+ ******************************************************************************/
+
+/**
+ * Initialize the telemetry cache. Before this (and after cleanup) the Get
+ * functions read straight from the device queues.
+ * @return SUCCESS or error code
+ */
+int Telemetry_Initialize(void);
+
+/**
+ * Drop all cached readings and subscribers and release resources
+ */
+void Telemetry_Cleanup(void);
+
+/**
+ * Receive every new reading
+ * @param callback - Function to call
+ * @param userData - Passed through to the callback
+ * @return Subscription handle (> 0) or error code
+ */
+int Telemetry_Subscribe(TelemetryCallback callback, void *userData);
+
+/**
+ * Stop receiving readings. The callback may still be running on another
+ * thread when this returns.
+ * @param handle - Handle from Telemetry_Subscribe
+ */
+void Telemetry_Unsubscribe(int handle);
+
+/**
+ * Store a PSB status read by the caller and pass it to subscribers
+ * @param status - Status just read from the device
+ */
+void Telemetry_PublishPSBStatus(const PSB_Status *status);
+
+/**
+ * Store a DTB status read by the caller and pass it to subscribers
+ * @param slaveAddress - Slave the status was read from
+ * @param status - Status just read from the device
+ */
+void Telemetry_PublishDTBStatus(int slaveAddress, const DTB_Status *status);
+
+/**
+ * Get the latest cached reading of a device, however old
+ * @param source - Device type
+ * @param slaveAddress - DTB slave address, ignored for the PSB
+ * @param snapshot - Receives the reading
+ * @return SUCCESS, or ERR_NOT_INITIALIZED if there is no reading yet
+ */
+int Telemetry_GetLatest(TelemetrySource source, int slaveAddress, TelemetrySnapshot *snapshot);
+
+/**
+ * Get a PSB status no older than maxAgeMs. Served from the cache when it is
+ * fresh enough; otherwise the PSB is read once and the reading published, and
+ * callers arriving meanwhile share that reading instead of queuing their own.
+ * @param status - Receives the status
+ * @param maxAgeMs - Oldest acceptable reading, TELEMETRY_MAX_AGE_FRESH to always read
+ * @param priority - Queue priority if the device has to be read
+ * @return SUCCESS or error code
+ */
+int Telemetry_GetPSBStatus(PSB_Status *status, int maxAgeMs, DevicePriority priority);
+
+/**
+ * Get a DTB status no older than maxAgeMs, see Telemetry_GetPSBStatus
+ * @param slaveAddress - DTB slave address
+ * @param status - Receives the status
+ * @param maxAgeMs - Oldest acceptable reading, TELEMETRY_MAX_AGE_FRESH to always read
+ * @param priority - Queue priority if the device has to be read
+ * @return SUCCESS or error code
+ */
+int Telemetry_GetDTBStatus(int slaveAddress, DTB_Status *status, int maxAgeMs, DevicePriority priority);
+
+/**
+ * Get the status of every configured DTB, no older than maxAgeMs.
+ * Same contract as DTB_GetStatusAllQueued.
+ * @param statuses - Array of at least MAX_DTB_DEVICES elements
+ * @param numDevices - Receives the number of configured devices
+ * @param maxAgeMs - Oldest acceptable reading, TELEMETRY_MAX_AGE_FRESH to always read
+ * @param priority - Queue priority for devices that have to be read
+ * @return SUCCESS or the first error encountered
+ */
+int Telemetry_GetDTBStatusAll(DTB_Status *statuses, int *numDevices, int maxAgeMs, DevicePriority priority);
+
+#endif // TELEMETRY_H
@@ -0,0 +1,307 @@
+/******************************************************************************
+ * telemetry_export.c
+ *
+ * Telemetry Export Module Implementation
+ * The segment is backed by the paging file and lives as long as the tester
+ * or a reader keeps it mapped. Publishers are serialized by a lock on the
+ * tester side only; readers never write to the segment, they check the
+ * sequence numbers around each copy instead.
+ ******************************************************************************/
+
+#include "common.h"
+#include "telemetry_export.h"
+#include "history.h"
+#include "logging.h"
+
+/******************************************************************************
+ * Module Variables
+ ******************************************************************************/
+
+static struct {
+    volatile int initialized;
+    CmtThreadLockHandle lock;       // Serializes publishers
+    HANDLE mapping;
+    TelemetryExportHeader *header;
+    TelemetryExportRingSlot *ring;
+} g_export = {0};
+
+/******************************************************************************
+ * Internal Function Prototypes
+ ******************************************************************************/
+
+static bool TelemetryExport_OwnedElsewhere(const TelemetryExportHeader *header);
+
+/******************************************************************************
+ * Public Interface Implementation - Tester Side
+ ******************************************************************************/
+
+int TelemetryExport_Initialize(void) {
+    if (g_export.initialized) {
+        return SUCCESS;
+    }
+    if (HISTORY_CHANNEL_COUNT > TELEMETRY_EXPORT_MAX_CHANNELS) {
+        LogError("Telemetry export holds %d channels, history has %d",
+                 TELEMETRY_EXPORT_MAX_CHANNELS, HISTORY_CHANNEL_COUNT);
+        return ERR_INVALID_STATE;
+    }
+
+    // Mapped by an earlier initialization of this process
+    if (g_export.header) {
+        g_export.header->active = 1;
+        g_export.initialized = 1;
+        return SUCCESS;
+    }
+
+    if (CmtNewLock(NULL, 0, &g_export.lock) < 0) {
+        LogError("Failed to create telemetry export lock");
+        return ERR_THREAD_SYNC;
+    }
+
+    DWORD size = sizeof(TelemetryExportHeader) + TELEMETRY_EXPORT_RING_SAMPLES * sizeof(TelemetryExportRingSlot);
+    HANDLE mapping = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, size, TELEMETRY_EXPORT_NAME);
+    bool existed = mapping && GetLastError() == ERROR_ALREADY_EXISTS;
+    void *view = mapping ? MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size) : NULL;
+    TelemetryExportHeader *header = (TelemetryExportHeader*)view;
+    int result = SUCCESS;
+
+    if (!view) {
+        LogError("Failed to create telemetry export segment %s", TELEMETRY_EXPORT_NAME);
+        result = ERR_OPERATION_FAILED;
+    } else if (existed && header->magic != 0 &&
+               (header->magic != TELEMETRY_EXPORT_MAGIC || header->version != TELEMETRY_EXPORT_VERSION)) {
+        LogError("Telemetry export segment %s is held open by an incompatible reader or tester",
+                 TELEMETRY_EXPORT_NAME);
+        result = ERR_INVALID_STATE;
+    } else if (existed && TelemetryExport_OwnedElsewhere(header)) {
+        LogError("Telemetry export segment %s is owned by another running tester (process %d)",
+                 TELEMETRY_EXPORT_NAME, header->processId);
+        result = ERR_INVALID_STATE;
+    }
+
+    if (result != SUCCESS) {
+        if (view) UnmapViewOfFile(view);
+        if (mapping) CloseHandle(mapping);
+        CmtDiscardLock(g_export.lock);
+        g_export.lock = 0;
+        return result;
+    }
+
+    if (existed) {
+        // Left by a tester that exited and kept by its readers. Empty the ring
+        // and latest values before the new generation tells readers to start
+        // over, so they never mix the two testers' samples.
+        TelemetryExportRingSlot *ring = (TelemetryExportRingSlot*)((char*)view + sizeof(TelemetryExportHeader));
+        InterlockedExchange(&header->writePosition, 0);
+        for (int i = 0; i < TELEMETRY_EXPORT_RING_SAMPLES; i++) {
+            InterlockedExchange(&ring[i].sequence, 0);
+        }
+        for (int i = 0; i < TELEMETRY_EXPORT_MAX_CHANNELS; i++) {
+            TelemetryExportLatestSlot *latest = &header->latest[i];
+            InterlockedIncrement(&latest->sequence);
+            latest->count = 0;
+            latest->timestamp = 0.0;
+            latest->value = 0.0;
+            InterlockedIncrement(&latest->sequence);
+        }
+        LogWarning("Reusing telemetry export segment %s left open by a reader", TELEMETRY_EXPORT_NAME);
+    } else {
+        // Readers check the magic last, so fill everything else first
+        memset(view, 0, size);
+    }
+    header->version = TELEMETRY_EXPORT_VERSION;
+    header->headerSize = sizeof(TelemetryExportHeader);
+    header->channelCount = HISTORY_CHANNEL_COUNT;
+    header->ringCapacity = TELEMETRY_EXPORT_RING_SAMPLES;
+    header->ringOffset = sizeof(TelemetryExportHeader);
+    header->processId = (int)GetCurrentProcessId();
+
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    long long ticks = ((long long)now.dwHighDateTime << 32) | now.dwLowDateTime;
+    header->wallClockOffset = (ticks - 116444736000000000LL) / 1e7 - GetTimestamp();
+
+    for (int i = 0; i < HISTORY_CHANNEL_COUNT; i++) {
+        strncpy(header->channelNames[i], History_GetChannelName(i), TELEMETRY_EXPORT_NAME_LENGTH - 1);
+        header->channelNames[i][TELEMETRY_EXPORT_NAME_LENGTH - 1] = '\0';
+    }
+
+    header->active = 1;
+    InterlockedIncrement(&header->generation);
+    InterlockedExchange((volatile int*)&header->magic, TELEMETRY_EXPORT_MAGIC);
+
+    g_export.mapping = mapping;
+    g_export.ring = (TelemetryExportRingSlot*)((char*)view + header->ringOffset);
+    g_export.header = header;
+    g_export.initialized = 1;
+
+    LogMessage("Telemetry export published as %s (%d channels, %d samples)",
+               TELEMETRY_EXPORT_NAME, HISTORY_CHANNEL_COUNT, TELEMETRY_EXPORT_RING_SAMPLES);
+    return SUCCESS;
+}
+
+void TelemetryExport_Cleanup(void) {
+    if (!g_export.initialized) {
+        return;
+    }
+
+    CmtGetLock(g_export.lock);
+    g_export.initialized = 0;
+    g_export.header->active = 0;
+    CmtReleaseLock(g_export.lock);
+}
+
+void TelemetryExport_Publish(int channel, double timestamp, double value) {
+    if (!g_export.initialized || channel < 0 || channel >= HISTORY_CHANNEL_COUNT) {
+        return;
+    }
+
+    CmtGetLock(g_export.lock);
+    TelemetryExportHeader *header = g_export.header;
+
+    // Latest value: odd sequence while the fields change
+    TelemetryExportLatestSlot *latest = &header->latest[channel];
+    InterlockedIncrement(&latest->sequence);
+    latest->timestamp = timestamp;
+    latest->value = value;
+    latest->count++;
+    InterlockedIncrement(&latest->sequence);
+
+    // Ring: clear the slot's sequence, fill it, then stamp it with its position
+    int position = header->writePosition;
+    TelemetryExportRingSlot *slot = &g_export.ring[position & (TELEMETRY_EXPORT_RING_SAMPLES - 1)];
+    InterlockedExchange(&slot->sequence, 0);
+    slot->channel = channel;
+    slot->timestamp = timestamp;
+    slot->value = value;
+    InterlockedExchange(&slot->sequence, position + 1);
+    InterlockedExchange(&header->writePosition, position + 1);
+
+    CmtReleaseLock(g_export.lock);
+}
+
+/******************************************************************************
+ * Public Interface Implementation - Reader Side
+ ******************************************************************************/
+
+const TelemetryExportHeader* TelemetryExport_OpenReader(void) {
+    HANDLE mapping = OpenFileMapping(FILE_MAP_READ, FALSE, TELEMETRY_EXPORT_NAME);
+    if (!mapping) {
+        return NULL;
+    }
+
+    // The view keeps the segment alive, the handle is not needed after mapping
+    const TelemetryExportHeader *header = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+
+    if (header && (header->magic != TELEMETRY_EXPORT_MAGIC || header->version != TELEMETRY_EXPORT_VERSION)) {
+        UnmapViewOfFile(header);
+        return NULL;
+    }
+    return header;
+}
+
+void TelemetryExport_CloseReader(const TelemetryExportHeader *header) {
+    if (header) {
+        UnmapViewOfFile(header);
+    }
+}
+
+int TelemetryExport_ReadLatest(const TelemetryExportHeader *header, int channel,
+                               TelemetryExportSample *sample) {
+    if (!header || !sample) {
+        return ERR_NULL_POINTER;
+    }
+    if (channel < 0 || channel >= header->channelCount) {
+        return ERR_INVALID_PARAMETER;
+    }
+
+    const TelemetryExportLatestSlot *latest = &header->latest[channel];
+
+    for (int attempt = 0; attempt < TELEMETRY_EXPORT_READ_ATTEMPTS; attempt++) {
+        int before = latest->sequence;
+        if (before & 1) {
+            continue;   // Being written
+        }
+
+        sample->channel = channel;
+        sample->count = latest->count;
+        sample->timestamp = latest->timestamp;
+        sample->value = latest->value;
+
+        if (latest->sequence == before) {
+            return SUCCESS;
+        }
+    }
+
+    return ERR_TIMEOUT;
+}
+
+int TelemetryExport_ReadSamples(const TelemetryExportHeader *header, TelemetryExportCursor *cursor,
+                                TelemetryExportSample *samples, int maxSamples) {
+    if (!header || !cursor || !samples) {
+        return ERR_NULL_POINTER;
+    }
+    if (maxSamples <= 0) {
+        return ERR_INVALID_PARAMETER;
+    }
+
+    const TelemetryExportRingSlot *ring =
+        (const TelemetryExportRingSlot*)((const char*)header + header->ringOffset);
+    // A new tester took over the segment, its positions start over
+    int generation = header->generation;
+    if (cursor->generation != generation) {
+        cursor->generation = generation;
+        cursor->position = 0;
+    }
+
+    int end = header->writePosition;
+    int next = MAX(cursor->position, 0);
+    int count = 0;
+
+    // Fell behind by more than the ring, continue at the oldest sample kept
+    if (end - next > header->ringCapacity) {
+        next = end - header->ringCapacity;
+    }
+
+    for (; next < end && count < maxSamples; next++) {
+        const TelemetryExportRingSlot *slot = &ring[next & (header->ringCapacity - 1)];
+
+        if (slot->sequence != next + 1) {
+            continue;   // Already rewritten for a later position
+        }
+
+        TelemetryExportSample *sample = &samples[count];
+        sample->channel = slot->channel;
+        sample->count = 0;
+        sample->timestamp = slot->timestamp;
+        sample->value = slot->value;
+
+        if (slot->sequence == next + 1) {
+            count++;
+        }
+    }
+
+    cursor->position = next;
+    return count;
+}
+
+/******************************************************************************
+ * Internal Functions
+ ******************************************************************************/
+
+// Whether a segment that already existed belongs to a tester still running.
+// One whose tester exited is only kept alive by readers.
+static bool TelemetryExport_OwnedElsewhere(const TelemetryExportHeader *header) {
+    if (header->magic != TELEMETRY_EXPORT_MAGIC || !header->active ||
+        header->processId == (int)GetCurrentProcessId()) {
+        return false;
+    }
+
+    HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, (DWORD)header->processId);
+    if (!process) {
+        return false;
+    }
+    bool running = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+    CloseHandle(process);
+    return running;
+}
@@ -0,0 +1,162 @@
+/******************************************************************************
+ * telemetry_export.h
+ *
+ * Telemetry Export Module Header
+ * Publishes every sample the history store records into a named shared
+ * memory segment, so other processes on the machine can read the latest
+ * value of each channel and a ring of recent samples without system calls,
+ * locks or any work in the tester. The layout below is the contract with
+ * readers; change TELEMETRY_EXPORT_VERSION with it.
+ *
+ * Readers map TELEMETRY_EXPORT_NAME read-only (TelemetryExport_OpenReader
+ * does this) and use TelemetryExport_ReadLatest and
+ * TelemetryExport_ReadSamples, which retry or skip entries the tester is
+ * writing. The reads rely on x86/x64 store and load ordering.
+ *
+ * A reader keeps the segment alive after the tester exits, and the next
+ * tester reuses it: the ring and latest values start over and the header's
+ * generation goes up, which makes TelemetryExport_ReadSamples restart its
+ * cursor. A tester does not take over a segment another running tester owns.
+ ******************************************************************************/
+#ifndef TELEMETRY_EXPORT_H
+#define TELEMETRY_EXPORT_H
+
+#include "common.h"
+
+/******************************************************************************
+ * Configuration Constants
+ ******************************************************************************/
+#define TELEMETRY_EXPORT_NAME           "Local\\BatteryTesterTelemetry"
+#define TELEMETRY_EXPORT_MAGIC          0x58455442      // "BTEX"
+#define TELEMETRY_EXPORT_VERSION        2
+#define TELEMETRY_EXPORT_MAX_CHANNELS   32
+#define TELEMETRY_EXPORT_NAME_LENGTH    32
+#define TELEMETRY_EXPORT_RING_SAMPLES   8192            // Power of two
+#define TELEMETRY_EXPORT_READ_ATTEMPTS  100             // ReadLatest retries while a value is being written
+
+/******************************************************************************
+ * Shared Memory Layout
+ ******************************************************************************/
+
+// Latest value of a channel, a seqlock: the sequence is odd while the tester
+// writes the fields, and a reader's copy is good if it saw the same even
+// sequence before and after.
+typedef struct {
+    volatile int sequence;
+    volatile int count;             // Samples published on the channel
+    volatile double timestamp;      // Tester seconds, add wallClockOffset for Unix time
+    volatile double value;
+} TelemetryExportLatestSlot;
+
+// One ring entry. The sequence is the entry's position + 1 once written and
+// 0 while the tester rewrites the slot for a later position.
+typedef struct {
+    volatile int sequence;
+    volatile int channel;
+    volatile double timestamp;
+    volatile double value;
+} TelemetryExportRingSlot;
+
+// Segment start. The ring follows at ringOffset bytes from the header.
+typedef struct {
+    unsigned int magic;
+    int version;
+    int headerSize;
+    int channelCount;
+    int ringCapacity;
+    int ringOffset;
+    int processId;                  // Tester process
+    volatile int active;            // 0 once the tester has shut down
+    volatile int writePosition;     // Ring positions written so far; position p is in slot p % ringCapacity
+    volatile int generation;        // Goes up each time a tester starts publishing to the segment
+    double wallClockOffset;         // Unix time in seconds at tester time 0
+    char channelNames[TELEMETRY_EXPORT_MAX_CHANNELS][TELEMETRY_EXPORT_NAME_LENGTH];
+    TelemetryExportLatestSlot latest[TELEMETRY_EXPORT_MAX_CHANNELS];
+} TelemetryExportHeader;
+
+/******************************************************************************
+ * Reader Types
+ ******************************************************************************/
+
+typedef struct {
+    int channel;
+    int count;                      // ReadLatest: samples published on the channel, 0 if none yet
+    double timestamp;
+    double value;
+} TelemetryExportSample;
+
+// Where a reader is in the ring. Zero it to read from the oldest sample.
+typedef struct {
+    int generation;                 // Segment generation the position belongs to
+    int position;                   // Next ring position to read
+} TelemetryExportCursor;
+
+/******************************************************************************
+ * Public Function Declarations - Tester Side
+ ******************************************************************************/
+
+/**
+ * Create the shared memory segment, or reuse one a reader kept open after an
+ * earlier tester exited. The history store publishes to it from then on.
+ * @return SUCCESS, ERR_INVALID_STATE if another running tester or an
+ *         incompatible version owns the segment, or error code
+ */
+int TelemetryExport_Initialize(void);
+
+/**
+ * Mark the segment inactive and stop publishing. The view stays mapped until
+ * the process exits so late publishers never touch unmapped memory.
+ */
+void TelemetryExport_Cleanup(void);
+
+/**
+ * Publish a sample as the channel's latest value and append it to the ring.
+ * Does nothing before initialization.
+ * @param channel - History channel
+ * @param timestamp - GetTimestamp() seconds
+ * @param value - Sample value
+ */
+void TelemetryExport_Publish(int channel, double timestamp, double value);
+
+/******************************************************************************
+ * Public Function Declarations - Reader Side
+ ******************************************************************************/
+
+/**
+ * Map the segment of a running tester read-only
+ * @return Header, or NULL if no tester has created the segment
+ */
+const TelemetryExportHeader* TelemetryExport_OpenReader(void);
+
+/**
+ * Unmap a segment from TelemetryExport_OpenReader
+ * @param header - Mapped header
+ */
+void TelemetryExport_CloseReader(const TelemetryExportHeader *header);
+
+/**
+ * Copy a consistent latest value of a channel
+ * @param header - Mapped header
+ * @param channel - Channel index, below header->channelCount
+ * @param sample - Receives the value
+ * @return SUCCESS, ERR_INVALID_PARAMETER, or ERR_TIMEOUT if the value kept changing
+ */
+int TelemetryExport_ReadLatest(const TelemetryExportHeader *header, int channel,
+                               TelemetryExportSample *sample);
+
+/**
+ * Copy ring samples from a cursor on, oldest first. Start with a zeroed
+ * cursor, or {header->generation, header->writePosition} for new samples
+ * only. A reader that fell more than a ring behind continues at the oldest
+ * sample still in the ring, and one whose generation is out of date - a new
+ * tester took over the segment - at the new tester's first sample.
+ * @param header - Mapped header
+ * @param cursor - Where to read, advanced past the samples read
+ * @param samples - Receives the samples
+ * @param maxSamples - Size of samples
+ * @return Number of samples copied, or error code
+ */
+int TelemetryExport_ReadSamples(const TelemetryExportHeader *header, TelemetryExportCursor *cursor,
+                                TelemetryExportSample *samples, int maxSamples);
+
+#endif // TELEMETRY_EXPORT_H
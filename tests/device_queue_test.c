@@ -57,7 +57,11 @@ static TestCase g_testCases[] = {
 	{"Large Transactions", Test_LargeTransactions, 0, "", 0.0},
 	{"NULL Callbacks", Test_NullCallbacks, 0, "", 0.0},
 	{"Mixed Commands and Transactions", Test_MixedCommandsAndTransactions, 0, "", 0.0},
-	{"Transaction Timeout", Test_TransactionTimeout, 0, "", 0.0}
+	{"Transaction Timeout", Test_TransactionTimeout, 0, "", 0.0},
+	{"Admission Control", Test_AdmissionControl, 0, "", 0.0},
+	{"Queue Snapshot", Test_QueueSnapshot, 0, "", 0.0},
+	{"Offline Deadline", Test_OfflineDeadline, 0, "", 0.0},
+	{"Stress Soak", Test_StressSoak, 0, "", 0.0}
 };
 
 static int g_numTestCases = sizeof(g_testCases) / sizeof(TestCase);
@@ -2147,9 +2151,33 @@ int Test_QueueOverflow(DeviceQueueTestContext *ctx, char *errorMsg, int errorMsg
         goto cleanup;
     }
     
+    // Overflow should be visible in the statistics
+    DeviceQueueStats stats;
+    DeviceQueue_GetStats(ctx->queueManager, &stats);
+    
+    if (stats.highPriorityHighWater < DEVICE_QUEUE_HIGH_PRIORITY_SIZE - 1) {
+        snprintf(errorMsg, errorMsgSize, "High priority high-water mark too low: %d", 
+                stats.highPriorityHighWater);
+        goto cleanup;
+    }
+    
+    if (stats.enqueueRetries == 0 || stats.enqueueFailures == 0) {
+        snprintf(errorMsg, errorMsgSize, "Enqueue retries/failures not counted: %d/%d", 
+                stats.enqueueRetries, stats.enqueueFailures);
+        goto cleanup;
+    }
+    
     // Cancel all to clean up
     DeviceQueue_CancelAll(ctx->queueManager);
     
+    // Depth drops back to zero, the high-water mark is kept
+    DeviceQueue_GetStats(ctx->queueManager, &stats);
+    if (stats.highPriorityQueued != 0 || stats.highPriorityHighWater < DEVICE_QUEUE_HIGH_PRIORITY_SIZE - 1) {
+        snprintf(errorMsg, errorMsgSize, "Unexpected stats after cancel: queued=%d, high-water=%d", 
+                stats.highPriorityQueued, stats.highPriorityHighWater);
+        goto cleanup;
+    }
+    
     // Restore normal delay
     Mock_SetCommandDelay(ctx->mockContext, MOCK_COMMAND_DELAY_MS);
     
@@ -2688,6 +2716,14 @@ int Test_ReconnectionLogic(DeviceQueueTestContext *ctx, char *errorMsg, int erro
         goto cleanup;
     }
     
+    // The outage lasted at least the 5 seconds spent disconnected above
+    if (stats.reconnectCount != 1 || stats.lastReconnectDurationMs < 5000 ||
+        stats.maxReconnectDurationMs < stats.lastReconnectDurationMs) {
+        snprintf(errorMsg, errorMsgSize, "Reconnect stats incorrect: count=%d, last=%d ms, max=%d ms", 
+                stats.reconnectCount, stats.lastReconnectDurationMs, stats.maxReconnectDurationMs);
+        goto cleanup;
+    }
+    
     // Test command execution after reconnection
     MockCommandResult result;
     int error = DeviceQueue_CommandBlocking(ctx->queueManager, MOCK_CMD_TEST_CONNECTION,
@@ -3628,4 +3664,956 @@ cleanup:
     DestroyTestQueueManager(ctx, ctx->queueManager);
     ctx->queueManager = NULL;
     return ctx->cancelRequested ? -1 : -1;
-}
\ No newline at end of file
+}
+
+typedef struct {
+    volatile int raised;
+    volatile int cleared;
+} OverloadTracker;
+
+static void AdmissionOverloadCallback(DeviceQueueManager *mgr, DevicePriority priority,
+                                    int overloaded, void *userData) {
+    OverloadTracker *tracker = (OverloadTracker*)userData;
+    if (priority != DEVICE_PRIORITY_LOW) return;
+    
+    if (overloaded) {
+        InterlockedIncrement(&tracker->raised);
+    } else {
+        InterlockedIncrement(&tracker->cleared);
+    }
+}
+
+int Test_AdmissionControl(DeviceQueueTestContext *ctx, char *errorMsg, int errorMsgSize) {
+    if (ctx->cancelRequested) return -1;
+    
+    ctx->queueManager = CreateTestQueueManager(ctx, &g_mockAdapter, ctx->mockContext, NULL);
+    if (!ctx->queueManager) {
+        snprintf(errorMsg, errorMsgSize, "Failed to create queue manager");
+        return -1;
+    }
+    
+    OverloadTracker tracker = {0};
+    DeviceQueue_SetOverloadCallback(ctx->queueManager, AdmissionOverloadCallback, &tracker);
+    
+    // Keep the processing thread busy on one slow command so the low queue only fills
+    Mock_SetCommandDelay(ctx->mockContext, 2000);
+    MockCommandParams params = {.value = 0};
+    DeviceQueue_CommandAsync(ctx->queueManager, MOCK_CMD_SET_VALUE, &params,
+                           DEVICE_PRIORITY_HIGH, NULL, NULL);
+    Delay(0.1);
+    
+    // Reject policy: excess commands fail immediately
+    int error = DeviceQueue_SetAdmissionPolicy(ctx->queueManager, DEVICE_PRIORITY_LOW,
+                                             4, DEVICE_ADMIT_REJECT, 0);
+    if (error != SUCCESS) {
+        snprintf(errorMsg, errorMsgSize, "Failed to set admission policy: %s", GetErrorString(error));
+        goto cleanup;
+    }
+    
+    int accepted = 0;
+    double startTime = Timer();
+    for (int i = 0; i < 6; i++) {
+        params.value = i;
+        if (DeviceQueue_CommandAsync(ctx->queueManager, MOCK_CMD_GET_VALUE, &params,
+                                   DEVICE_PRIORITY_LOW, NULL, NULL) != 0) {
+            accepted++;
+        }
+    }
+    double elapsedMs = (Timer() - startTime) * 1000.0;
+    
+    if (accepted != 4) {
+        snprintf(errorMsg, errorMsgSize, "Reject policy accepted %d of 6 commands (capacity 4)", accepted);
+        goto cleanup;
+    }
+    
+    if (elapsedMs > 200.0) {
+        snprintf(errorMsg, errorMsgSize, "Rejecting commands took %.1f ms", elapsedMs);
+        goto cleanup;
+    }
+    
+    if (tracker.raised != 1 || !DeviceQueue_IsOverloaded(ctx->queueManager, DEVICE_PRIORITY_LOW)) {
+        snprintf(errorMsg, errorMsgSize, "Overload not signalled (raised %d times)", tracker.raised);
+        goto cleanup;
+    }
+    
+    // Drop-oldest policy: new commands replace the oldest queued ones
+    DeviceQueue_SetAdmissionPolicy(ctx->queueManager, DEVICE_PRIORITY_LOW, 4, DEVICE_ADMIT_DROP_OLDEST, 0);
+    for (int i = 0; i < 2; i++) {
+        if (DeviceQueue_CommandAsync(ctx->queueManager, MOCK_CMD_GET_VALUE, &params,
+                                   DEVICE_PRIORITY_LOW, NULL, NULL) == 0) {
+            snprintf(errorMsg, errorMsgSize, "Drop-oldest policy rejected a command");
+            goto cleanup;
+        }
+    }
+    
+    DeviceQueueStats stats;
+    DeviceQueue_GetStats(ctx->queueManager, &stats);
+    if (stats.evictedCommands != 2 || stats.lowPriorityQueued != 4) {
+        snprintf(errorMsg, errorMsgSize, "Drop-oldest: evicted %d, queued %d (expected 2, 4)",
+                stats.evictedCommands, stats.lowPriorityQueued);
+        goto cleanup;
+    }
+    
+    // Non-blocking policies ignore the deadline and fail at once with ERR_QUEUE_FULL
+    DeviceQueue_SetAdmissionPolicy(ctx->queueManager, DEVICE_PRIORITY_LOW, 4, DEVICE_ADMIT_REJECT,
+                                 DEVICE_QUEUE_ADMIT_DEADLINE_MS);
+    MockCommandResult result;
+    startTime = Timer();
+    error = DeviceQueue_CommandBlocking(ctx->queueManager, MOCK_CMD_GET_VALUE, &params,
+                                      DEVICE_PRIORITY_LOW, &result, 3000);
+    elapsedMs = (Timer() - startTime) * 1000.0;
+    
+    if (error != ERR_QUEUE_FULL || elapsedMs > 100.0) {
+        snprintf(errorMsg, errorMsgSize, "Reject policy with deadline: %s after %.1f ms (expected ERR_QUEUE_FULL at once)",
+                GetErrorString(error), elapsedMs);
+        goto cleanup;
+    }
+    
+    // Drop-oldest never evicts for a transaction
+    DeviceQueue_SetAdmissionPolicy(ctx->queueManager, DEVICE_PRIORITY_LOW, 4, DEVICE_ADMIT_DROP_OLDEST, 500);
+    DeviceTransactionHandle txn = DeviceQueue_BeginTransaction(ctx->queueManager);
+    DeviceQueue_SetTransactionPriority(ctx->queueManager, txn, DEVICE_PRIORITY_LOW);
+    DeviceQueue_AddToTransaction(ctx->queueManager, txn, MOCK_CMD_GET_VALUE, &params);
+    DeviceQueue_AddToTransaction(ctx->queueManager, txn, MOCK_CMD_GET_VALUE, &params);
+    startTime = Timer();
+    error = DeviceQueue_CommitTransaction(ctx->queueManager, txn, NULL, NULL);
+    elapsedMs = (Timer() - startTime) * 1000.0;
+    DeviceQueue_CancelTransaction(ctx->queueManager, txn);
+    
+    DeviceQueue_GetStats(ctx->queueManager, &stats);
+    if (error != ERR_QUEUE_FULL || elapsedMs > 100.0 || stats.evictedCommands != 2) {
+        snprintf(errorMsg, errorMsgSize, "Drop-oldest transaction: %s after %.1f ms, evicted %d (expected ERR_QUEUE_FULL at once, 2)",
+                GetErrorString(error), elapsedMs, stats.evictedCommands);
+        goto cleanup;
+    }
+    
+    // Block policy: the producer waits no longer than the deadline
+    DeviceQueue_SetAdmissionPolicy(ctx->queueManager, DEVICE_PRIORITY_LOW, 4, DEVICE_ADMIT_BLOCK, 200);
+    startTime = Timer();
+    DeviceCommandID cmdId = DeviceQueue_CommandAsync(ctx->queueManager, MOCK_CMD_GET_VALUE, &params,
+                                                   DEVICE_PRIORITY_LOW, NULL, NULL);
+    elapsedMs = (Timer() - startTime) * 1000.0;
+    
+    if (cmdId != 0 || elapsedMs < 150.0 || elapsedMs > 500.0) {
+        snprintf(errorMsg, errorMsgSize, "Block policy: cmdId %u after %.1f ms (expected 0 after ~200 ms)",
+                cmdId, elapsedMs);
+        goto cleanup;
+    }
+    
+    // Draining the queue clears the overload signal
+    DeviceQueue_CancelAll(ctx->queueManager);
+    if (tracker.cleared != 1 || DeviceQueue_IsOverloaded(ctx->queueManager, DEVICE_PRIORITY_LOW)) {
+        snprintf(errorMsg, errorMsgSize, "Overload not cleared after drain (cleared %d times)", tracker.cleared);
+        goto cleanup;
+    }
+    
+    DeviceQueue_SetOverloadCallback(ctx->queueManager, NULL, NULL);
+    Mock_SetCommandDelay(ctx->mockContext, MOCK_COMMAND_DELAY_MS);
+    DestroyTestQueueManager(ctx, ctx->queueManager);
+    ctx->queueManager = NULL;
+    return 1;
+    
+cleanup:
+    DeviceQueue_SetOverloadCallback(ctx->queueManager, NULL, NULL);
+    Mock_SetCommandDelay(ctx->mockContext, MOCK_COMMAND_DELAY_MS);
+    DeviceQueue_CancelAll(ctx->queueManager);
+    DestroyTestQueueManager(ctx, ctx->queueManager);
+    ctx->queueManager = NULL;
+    return ctx->cancelRequested ? -1 : -1;
+}
+
+int Test_QueueSnapshot(DeviceQueueTestContext *ctx, char *errorMsg, int errorMsgSize) {
+    if (ctx->cancelRequested) return -1;
+    
+    ctx->queueManager = CreateTestQueueManager(ctx, &g_mockAdapter, ctx->mockContext, NULL);
+    if (!ctx->queueManager) {
+        snprintf(errorMsg, errorMsgSize, "Failed to create queue manager");
+        return -1;
+    }
+    
+    DeviceQueueSnapshot *snapshot = malloc(sizeof(DeviceQueueSnapshot));
+    if (!snapshot) {
+        snprintf(errorMsg, errorMsgSize, "Failed to allocate snapshot");
+        goto cleanup;
+    }
+    
+    DeviceQueue_SetThreadName("Snapshot Test");
+    
+    // Hold the processing thread on one slow command
+    Mock_SetCommandDelay(ctx->mockContext, 2000);
+    MockCommandParams params = {.value = 0};
+    DeviceCommandID runningId = DeviceQueue_CommandAsync(ctx->queueManager, MOCK_CMD_SET_VALUE, &params,
+                                                       DEVICE_PRIORITY_HIGH, NULL, NULL);
+    Delay(0.1);
+    
+    // Queue low priority work first so the snapshot has to reorder by priority
+    DeviceCommandID lowIds[3], normalIds[2];
+    for (int i = 0; i < 3; i++) {
+        lowIds[i] = DeviceQueue_CommandAsync(ctx->queueManager, MOCK_CMD_GET_VALUE, &params,
+                                           DEVICE_PRIORITY_LOW, NULL, NULL);
+    }
+    for (int i = 0; i < 2; i++) {
+        normalIds[i] = DeviceQueue_CommandAsync(ctx->queueManager, MOCK_CMD_GET_VALUE, &params,
+                                              DEVICE_PRIORITY_NORMAL, NULL, NULL);
+    }
+    
+    int error = DeviceQueue_Snapshot(ctx->queueManager, snapshot);
+    if (error != SUCCESS) {
+        snprintf(errorMsg, errorMsgSize, "Snapshot failed: %s", GetErrorString(error));
+        goto cleanup;
+    }
+    
+    if (snapshot->entryCount != 6 || snapshot->totalCommands != 6) {
+        snprintf(errorMsg, errorMsgSize, "Snapshot has %d entries, %d total (expected 6)",
+                snapshot->entryCount, snapshot->totalCommands);
+        goto cleanup;
+    }
+    
+    DeviceCommandID expectedIds[6] = {runningId, normalIds[0], normalIds[1], lowIds[0], lowIds[1], lowIds[2]};
+    int expectedPositions[6] = {0, 0, 1, 0, 1, 2};
+    for (int i = 0; i < 6; i++) {
+        DeviceQueueSnapshotEntry *entry = &snapshot->entries[i];
+        DeviceCommandSnapshotState expectedState = (i == 0) ? DEVICE_CMD_EXECUTING : DEVICE_CMD_QUEUED;
+        
+        if (entry->id != expectedIds[i] || entry->state != expectedState ||
+            entry->position != expectedPositions[i]) {
+            snprintf(errorMsg, errorMsgSize, "Entry %d: id %u state %d position %d (expected %u, %d, %d)",
+                    i, entry->id, entry->state, entry->position, expectedIds[i], expectedState,
+                    expectedPositions[i]);
+            goto cleanup;
+        }
+        
+        if (strcmp(entry->submitter, "Snapshot Test") != 0) {
+            snprintf(errorMsg, errorMsgSize, "Entry %d submitted by '%s'", i, entry->submitter);
+            goto cleanup;
+        }
+    }
+    
+    if (strcmp(snapshot->entries[0].typeName, "SET_VALUE") != 0 || snapshot->entries[0].ageMs < 50.0) {
+        snprintf(errorMsg, errorMsgSize, "Executing entry: type '%s', age %.1f ms",
+                snapshot->entries[0].typeName, snapshot->entries[0].ageMs);
+        goto cleanup;
+    }
+    
+    // Cancelled commands drop out of the next snapshot
+    DeviceQueue_CancelCommand(ctx->queueManager, lowIds[1]);
+    DeviceQueue_Snapshot(ctx->queueManager, snapshot);
+    if (snapshot->entryCount != 5 || snapshot->entries[4].id != lowIds[2] ||
+        snapshot->entries[4].position != 1) {
+        snprintf(errorMsg, errorMsgSize, "After cancel: %d entries (expected 5 ending in %u)",
+                snapshot->entryCount, lowIds[2]);
+        goto cleanup;
+    }
+    
+    // The name is taken when a command is submitted, clearing it only
+    // affects commands submitted afterwards
+    DeviceQueue_ClearThreadName();
+    DeviceCommandID unnamedId = DeviceQueue_CommandAsync(ctx->queueManager, MOCK_CMD_GET_VALUE, &params,
+                                                       DEVICE_PRIORITY_LOW, NULL, NULL);
+    DeviceQueue_Snapshot(ctx->queueManager, snapshot);
+    if (snapshot->entryCount != 6 || snapshot->entries[5].id != unnamedId ||
+        snapshot->entries[5].submitter[0] != '\0' || strcmp(snapshot->entries[4].submitter, "Snapshot Test") != 0) {
+        snprintf(errorMsg, errorMsgSize, "After clearing the name: '%s' then '%s'",
+                snapshot->entries[4].submitter, snapshot->entries[5].submitter);
+        goto cleanup;
+    }
+    
+    free(snapshot);
+    Mock_SetCommandDelay(ctx->mockContext, MOCK_COMMAND_DELAY_MS);
+    DeviceQueue_CancelAll(ctx->queueManager);
+    DestroyTestQueueManager(ctx, ctx->queueManager);
+    ctx->queueManager = NULL;
+    return 1;
+    
+cleanup:
+    DeviceQueue_ClearThreadName();
+    free(snapshot);
+    Mock_SetCommandDelay(ctx->mockContext, MOCK_COMMAND_DELAY_MS);
+    DeviceQueue_CancelAll(ctx->queueManager);
+    DestroyTestQueueManager(ctx, ctx->queueManager);
+    ctx->queueManager = NULL;
+    return ctx->cancelRequested ? -1 : -1;
+}
+
+int Test_OfflineDeadline(DeviceQueueTestContext *ctx, char *errorMsg, int errorMsgSize) {
+    if (ctx->cancelRequested) return -1;
+    
+    ctx->queueManager = CreateTestQueueManager(ctx, &g_mockAdapter, ctx->mockContext, NULL);
+    if (!ctx->queueManager) {
+        snprintf(errorMsg, errorMsgSize, "Failed to create queue manager");
+        return -1;
+    }
+    
+    // Lose the connection and keep the device away
+    ctx->mockContext->shouldFailConnection = 1;
+    ctx->mockContext->simulateDisconnect = 1;
+    MockCommandResult result;
+    DeviceQueue_CommandBlocking(ctx->queueManager, MOCK_CMD_TEST_CONNECTION,
+                              NULL, DEVICE_PRIORITY_HIGH, &result, 1000);
+    
+    DeviceQueueStats stats;
+    DeviceQueue_GetStats(ctx->queueManager, &stats);
+    if (stats.isConnected) {
+        snprintf(errorMsg, errorMsgSize, "Connection loss not detected");
+        goto cleanup;
+    }
+    
+    // A command that cannot outlast the next probe fails fast instead of timing out
+    DeviceQueue_SetOfflineDeadline(ctx->queueManager, 200);
+    double startTime = Timer();
+    int error = DeviceQueue_CommandBlocking(ctx->queueManager, MOCK_CMD_TEST_CONNECTION,
+                                          NULL, DEVICE_PRIORITY_HIGH, &result, 5000);
+    double elapsedMs = (Timer() - startTime) * 1000.0;
+    
+    if (error != ERR_NOT_CONNECTED || elapsedMs > 500.0) {
+        snprintf(errorMsg, errorMsgSize, "Offline command returned %d after %.1f ms (expected %d within 500 ms)",
+                error, elapsedMs, ERR_NOT_CONNECTED);
+        goto cleanup;
+    }
+    
+    // Async commands are dropped the same way
+    MockCommandParams params = {.value = 1};
+    for (int i = 0; i < 3; i++) {
+        DeviceQueue_CommandAsync(ctx->queueManager, MOCK_CMD_SET_VALUE, &params,
+                               DEVICE_PRIORITY_LOW, NULL, NULL);
+    }
+    Delay(0.5);
+    
+    DeviceQueue_GetStats(ctx->queueManager, &stats);
+    if (stats.offlineFailures != 4 || stats.lowPriorityQueued != 0) {
+        snprintf(errorMsg, errorMsgSize, "Offline failures %d, low queued %d (expected 4, 0)",
+                stats.offlineFailures, stats.lowPriorityQueued);
+        goto cleanup;
+    }
+    
+    // A committed transaction fails as a whole and still calls back once
+    TransactionTracker tracker = {0};
+    DeviceTransactionHandle txn = DeviceQueue_BeginTransaction(ctx->queueManager);
+    for (int i = 0; i < 3; i++) {
+        DeviceQueue_AddToTransaction(ctx->queueManager, txn, MOCK_CMD_SET_VALUE, &params);
+    }
+    DeviceQueue_CommitTransaction(ctx->queueManager, txn, TransactionCallback, &tracker);
+    
+    startTime = Timer();
+    while (!tracker.completed && (Timer() - startTime) < 2.0) {
+        Delay(0.01);
+    }
+    if (!tracker.completed || tracker.successCount != 0 || tracker.failureCount != 3) {
+        snprintf(errorMsg, errorMsgSize, "Offline transaction: completed %d, %d ok, %d failed (expected 1, 0, 3)",
+                tracker.completed, tracker.successCount, tracker.failureCount);
+        goto cleanup;
+    }
+    
+    // Without a deadline the command waits and runs as soon as the device is back
+    DeviceQueue_SetOfflineDeadline(ctx->queueManager, -1);
+    ctx->mockContext->shouldFailConnection = 0;
+    ctx->mockContext->simulateDisconnect = 0;
+    Mock_SetConnectionState(ctx->mockContext, 1);
+    
+    error = DeviceQueue_CommandBlocking(ctx->queueManager, MOCK_CMD_TEST_CONNECTION,
+                                      NULL, DEVICE_PRIORITY_HIGH, &result, DEVICE_QUEUE_MAX_RECONNECT_DELAY + 5000);
+    if (error != SUCCESS) {
+        snprintf(errorMsg, errorMsgSize, "Command after recovery failed: %s", GetErrorString(error));
+        goto cleanup;
+    }
+    
+    DeviceQueue_GetStats(ctx->queueManager, &stats);
+    if (!stats.isConnected || stats.reconnectCount != 1 || stats.nextProbeInMs != 0) {
+        snprintf(errorMsg, errorMsgSize, "After recovery: connected %d, reconnects %d, next probe %d ms",
+                stats.isConnected, stats.reconnectCount, stats.nextProbeInMs);
+        goto cleanup;
+    }
+    
+    // Connection dropped in the middle of a transaction - with no offline
+    // deadline the transaction timeout still ends it and calls back
+    memset(&tracker, 0, sizeof(tracker));
+    txn = DeviceQueue_BeginTransaction(ctx->queueManager);
+    for (int i = 0; i < 3; i++) {
+        DeviceQueue_AddToTransaction(ctx->queueManager, txn, MOCK_CMD_SET_VALUE, &params);
+    }
+    DeviceQueue_SetTransactionTimeout(ctx->queueManager, txn, 300);
+    ctx->mockContext->shouldFailConnection = 1;
+    ctx->mockContext->simulateDisconnect = 1;
+    DeviceQueue_CommitTransaction(ctx->queueManager, txn, TransactionCallback, &tracker);
+    
+    startTime = Timer();
+    while (!tracker.completed && (Timer() - startTime) < 3.0) {
+        Delay(0.01);
+    }
+    if (!tracker.completed || tracker.successCount != 0 || tracker.failureCount != 3) {
+        snprintf(errorMsg, errorMsgSize, "Transaction cut off by disconnect: completed %d, %d ok, %d failed (expected 1, 0, 3)",
+                tracker.completed, tracker.successCount, tracker.failureCount);
+        goto cleanup;
+    }
+    
+    ctx->mockContext->shouldFailConnection = 0;
+    ctx->mockContext->simulateDisconnect = 0;
+    Mock_SetConnectionState(ctx->mockContext, 1);
+    DestroyTestQueueManager(ctx, ctx->queueManager);
+    ctx->queueManager = NULL;
+    return 1;
+    
+cleanup:
+    ctx->mockContext->shouldFailConnection = 0;
+    ctx->mockContext->simulateDisconnect = 0;
+    Mock_SetConnectionState(ctx->mockContext, 1);
+    DestroyTestQueueManager(ctx, ctx->queueManager);
+    ctx->queueManager = NULL;
+    return ctx->cancelRequested ? -1 : -1;
+}
+
+/******************************************************************************
+ * Stress / Soak Test
+ *
+ * Randomized workers hammer one queue with async and blocking commands,
+ * transactions and every cancel flavour while the device flaps its
+ * connection. Each round ends by destroying the queue with work still queued.
+ * Command parameters are tagged and tracked per command so the run can check:
+ *   - no lost callbacks (every executed async command calls back exactly once)
+ *   - no double release (every parameter copy is freed exactly once)
+ *   - bounded memory (live parameter copies never exceed the queue capacity)
+ * Failures are reproducible from the logged seed.
+ ******************************************************************************/
+
+#define STRESS_PARAMS_TAG       0x53545253u
+#define STRESS_PARAMS_DEAD      0xDEADC0DEu
+#define STRESS_TXN_MAX_COMMANDS 4
+#define STRESS_RECENT_IDS       8
+
+// Upper bound on live parameter copies: every queue full plus what each
+// worker can hold outside the queues, plus the command being executed
+#define STRESS_MAX_LIVE_PARAMS  (DEVICE_QUEUE_HIGH_PRIORITY_SIZE + DEVICE_QUEUE_NORMAL_PRIORITY_SIZE + \
+                                 DEVICE_QUEUE_LOW_PRIORITY_SIZE + DEVICE_QUEUE_DEFERRED_SIZE + \
+                                 STRESS_WORKER_COUNT * (STRESS_TXN_MAX_COMMANDS + 2) + 1)
+
+typedef enum {
+    STRESS_KIND_ASYNC = 1,
+    STRESS_KIND_BLOCKING,
+    STRESS_KIND_TRANSACTION
+} StressCommandKind;
+
+// Parameters handed to the queue - copied by the stress adapter
+typedef struct {
+    unsigned int tag;
+    int slot;
+    int value;
+} StressCommandParams;
+
+// Per-command lifecycle counters
+typedef struct {
+    volatile int kind;
+    volatile int paramsCreated;
+    volatile int paramsFreed;
+    volatile int executed;
+    volatile int callbacks;
+} StressSlot;
+
+typedef struct {
+    StressSlot *slots;
+    volatile int nextSlot;
+    volatile int liveParams;
+    volatile int peakLiveParams;
+    volatile int badTags;
+    volatile int transactionsCommitted;
+    volatile int transactionCallbacks;
+    volatile int transactionCountMismatches;
+} StressTracker;
+
+typedef struct {
+    DeviceQueueManager *queueManager;
+    MockDeviceContext *mockContext;
+    StressTracker *tracker;
+    volatile int *cancelFlag;
+    int workerIndex;
+    unsigned int seed;
+    double stopTime;
+    
+    // Transactions are committed one at a time per worker
+    volatile int transactionInFlight;
+    
+    DeviceCommandID recentIds[STRESS_RECENT_IDS];
+    int recentCount;
+    
+    volatile int operations;
+    volatile int unexpectedErrors;
+} StressWorkerData;
+
+// The adapter's parameter hooks carry no context, so the tracker is global
+static StressTracker *g_stressTracker = NULL;
+
+static void* Stress_CreateCommandParams(int commandType, void *sourceParams);
+static void Stress_FreeCommandParams(int commandType, void *params);
+static int Stress_ExecuteCommand(void *deviceContext, int commandType, void *params, void *result);
+
+// Mock adapter with tracked parameters
+static const DeviceAdapter g_stressAdapter = {
+    .deviceName = "Stress Mock Device",
+    .connect = Mock_Connect,
+    .disconnect = Mock_Disconnect,
+    .testConnection = Mock_TestConnection,
+    .isConnected = Mock_IsConnected,
+    .executeCommand = Stress_ExecuteCommand,
+    .createCommandParams = Stress_CreateCommandParams,
+    .freeCommandParams = Stress_FreeCommandParams,
+    .createCommandResult = Mock_CreateCommandResult,
+    .freeCommandResult = Mock_FreeCommandResult,
+    .copyCommandResult = Mock_CopyCommandResult,
+    .getCommandTypeName = Mock_GetCommandTypeName,
+    .getCommandDelay = NULL,
+    .getErrorString = GetErrorString
+};
+
+static int Stress_Rand(unsigned int *seed) {
+    *seed = *seed * 1103515245u + 12345u;
+    return (int)((*seed >> 16) & 0x7FFF);
+}
+
+static StressSlot* Stress_GetSlot(int slot) {
+    StressTracker *tracker = g_stressTracker;
+    if (!tracker || slot < 0 || slot >= STRESS_MAX_COMMANDS) return NULL;
+    return &tracker->slots[slot];
+}
+
+static int Stress_AllocSlot(StressTracker *tracker, StressCommandKind kind) {
+    int slot = InterlockedIncrement(&tracker->nextSlot) - 1;
+    if (slot >= STRESS_MAX_COMMANDS) return -1;
+    tracker->slots[slot].kind = kind;
+    return slot;
+}
+
+static void* Stress_CreateCommandParams(int commandType, void *sourceParams) {
+    StressCommandParams *source = (StressCommandParams*)sourceParams;
+    if (!source || source->tag != STRESS_PARAMS_TAG) return NULL;
+    
+    StressCommandParams *params = malloc(sizeof(StressCommandParams));
+    if (!params) return NULL;
+    *params = *source;
+    
+    StressSlot *slot = Stress_GetSlot(params->slot);
+    if (slot) {
+        InterlockedIncrement(&slot->paramsCreated);
+    }
+    
+    // Track the high-water mark of live copies
+    int live = InterlockedIncrement(&g_stressTracker->liveParams);
+    int peak;
+    while ((peak = g_stressTracker->peakLiveParams) < live) {
+        if (InterlockedCompareExchange(&g_stressTracker->peakLiveParams, live, peak) == peak) break;
+    }
+    
+    return params;
+}
+
+static void Stress_FreeCommandParams(int commandType, void *params) {
+    StressCommandParams *p = (StressCommandParams*)params;
+    if (!p) return;
+    
+    if (p->tag != STRESS_PARAMS_TAG) {
+        InterlockedIncrement(&g_stressTracker->badTags);
+        return;  // Already freed or corrupt - leak rather than double free
+    }
+    
+    StressSlot *slot = Stress_GetSlot(p->slot);
+    if (slot) {
+        InterlockedIncrement(&slot->paramsFreed);
+    }
+    
+    InterlockedDecrement(&g_stressTracker->liveParams);
+    p->tag = STRESS_PARAMS_DEAD;
+    free(p);
+}
+
+static int Stress_ExecuteCommand(void *deviceContext, int commandType, void *params, void *result) {
+    StressCommandParams *p = (StressCommandParams*)params;
+    if (p) {
+        if (p->tag != STRESS_PARAMS_TAG) {
+            InterlockedIncrement(&g_stressTracker->badTags);
+        } else {
+            StressSlot *slot = Stress_GetSlot(p->slot);
+            if (slot) InterlockedIncrement(&slot->executed);
+        }
+    }
+    
+    return Mock_ExecuteCommand(deviceContext, commandType, NULL, result);
+}
+
+static void StressCommandCallback(DeviceCommandID cmdId, int commandType, void *result, void *userData) {
+    StressSlot *slot = (StressSlot*)userData;
+    if (slot) {
+        InterlockedIncrement(&slot->callbacks);
+    }
+}
+
+static void StressTransactionCallback(DeviceTransactionHandle txnId, int success, int failed,
+                                    TransactionCommandResult *results, int resultCount,
+                                    void *userData) {
+    StressWorkerData *data = (StressWorkerData*)userData;
+    InterlockedIncrement(&data->tracker->transactionCallbacks);
+    if (success + failed != resultCount) {
+        InterlockedIncrement(&data->tracker->transactionCountMismatches);
+    }
+    data->transactionInFlight = 0;
+}
+
+// Results a blocking command may legitimately see under flapping and cancellation
+static int Stress_IsExpectedError(int error) {
+    return error == SUCCESS || error == ERR_CANCELLED || error == ERR_TIMEOUT ||
+           error == ERR_NOT_CONNECTED || error == ERR_COMM_FAILED || error == ERR_QUEUE_FULL;
+}
+
+static void Stress_SubmitAsync(StressWorkerData *data, int r) {
+    int slot = Stress_AllocSlot(data->tracker, STRESS_KIND_ASYNC);
+    if (slot < 0) return;
+    
+    // High priority is kept for transactions so async floods cannot starve them
+    StressCommandParams params = {STRESS_PARAMS_TAG, slot, r};
+    int commandType = (r & 1) ? MOCK_CMD_GET_VALUE : MOCK_CMD_SET_VALUE;
+    DevicePriority priority = (r & 2) ? DEVICE_PRIORITY_NORMAL : DEVICE_PRIORITY_LOW;
+    
+    DeviceCommandID cmdId = DeviceQueue_CommandAsync(data->queueManager, commandType, &params,
+                                                   priority, StressCommandCallback,
+                                                   &data->tracker->slots[slot]);
+    if (cmdId != 0) {
+        data->recentIds[data->recentCount++ % STRESS_RECENT_IDS] = cmdId;
+    }
+}
+
+static void Stress_SubmitBlocking(StressWorkerData *data, int r) {
+    int slot = Stress_AllocSlot(data->tracker, STRESS_KIND_BLOCKING);
+    if (slot < 0) return;
+    
+    StressCommandParams params = {STRESS_PARAMS_TAG, slot, r};
+    MockCommandResult result;
+    int error = DeviceQueue_CommandBlocking(data->queueManager, MOCK_CMD_SET_VALUE, &params,
+                                          DEVICE_PRIORITY_NORMAL, &result, 50 + (r % 2000));
+    if (!Stress_IsExpectedError(error)) {
+        InterlockedIncrement(&data->unexpectedErrors);
+        LogWarning("Stress worker %d: unexpected blocking result %d", data->workerIndex, error);
+    }
+}
+
+static void Stress_RunTransaction(StressWorkerData *data, int r) {
+    // Every committed transaction calls back, even one whose commands were all cancelled
+    if (data->transactionInFlight) return;
+    
+    DeviceTransactionHandle txn = DeviceQueue_BeginTransaction(data->queueManager);
+    if (txn == 0) {
+        InterlockedIncrement(&data->unexpectedErrors);
+        return;
+    }
+    
+    int numCommands = 1 + (r % STRESS_TXN_MAX_COMMANDS);
+    for (int i = 0; i < numCommands; i++) {
+        int slot = Stress_AllocSlot(data->tracker, STRESS_KIND_TRANSACTION);
+        if (slot < 0) break;
+        
+        StressCommandParams params = {STRESS_PARAMS_TAG, slot, r + i};
+        if (DeviceQueue_AddToTransaction(data->queueManager, txn, MOCK_CMD_SET_VALUE, &params) != SUCCESS) {
+            InterlockedIncrement(&data->unexpectedErrors);
+        }
+    }
+    
+    // Sometimes abandon the transaction instead of committing it
+    if ((r & 7) == 0) {
+        DeviceQueue_CancelTransaction(data->queueManager, txn);
+        return;
+    }
+    
+    if (DeviceQueue_SetTransactionFlags(data->queueManager, txn,
+                                      (r & 8) ? DEVICE_TXN_ABORT_ON_ERROR : DEVICE_TXN_CONTINUE_ON_ERROR) != SUCCESS) {
+        InterlockedIncrement(&data->unexpectedErrors);
+    }
+    
+    data->transactionInFlight = 1;
+    int error = DeviceQueue_CommitTransaction(data->queueManager, txn, StressTransactionCallback, data);
+    if (error == SUCCESS) {
+        InterlockedIncrement(&data->tracker->transactionsCommitted);
+    } else {
+        // Empty transactions (slots exhausted) are rejected and stay uncommitted
+        data->transactionInFlight = 0;
+        DeviceQueue_CancelTransaction(data->queueManager, txn);
+    }
+}
+
+static int CVICALLBACK StressWorkerFunction(void *functionData) {
+    StressWorkerData *data = (StressWorkerData*)functionData;
+    
+    while (Timer() < data->stopTime && !*data->cancelFlag &&
+           data->tracker->nextSlot < STRESS_MAX_COMMANDS) {
+        int r = Stress_Rand(&data->seed);
+        int op = r % 100;
+        
+        if (op < 40) {
+            Stress_SubmitAsync(data, r);
+        } else if (op < 52) {
+            Stress_SubmitBlocking(data, r);
+        } else if (op < 64) {
+            Stress_RunTransaction(data, r);
+        } else if (op < 74) {
+            if (data->recentCount > 0) {
+                DeviceQueue_CancelCommand(data->queueManager,
+                                        data->recentIds[r % MIN(data->recentCount, STRESS_RECENT_IDS)]);
+            }
+        } else if (op < 79) {
+            DeviceQueue_CancelByType(data->queueManager, MOCK_CMD_GET_VALUE);
+        } else if (op < 84) {
+            DeviceQueue_CancelByAge(data->queueManager, (r % 50) / 1000.0);
+        } else if (op < 86) {
+            DeviceQueue_CancelAll(data->queueManager);
+        } else {
+            // Readers racing the writers
+            DeviceQueueStats stats;
+            DeviceQueue_GetStats(data->queueManager, &stats);
+            DeviceQueue_IsInTransaction(data->queueManager);
+        }
+        
+        InterlockedIncrement(&data->operations);
+        
+        if ((r & 15) == 0) {
+            Delay((r % 5) / 1000.0);
+        }
+    }
+    
+    return 0;
+}
+
+static int CVICALLBACK StressFlapperFunction(void *functionData) {
+    StressWorkerData *data = (StressWorkerData*)functionData;
+    
+    while (Timer() < data->stopTime && !*data->cancelFlag) {
+        Delay(STRESS_FLAP_INTERVAL_S * (0.5 + (Stress_Rand(&data->seed) % 100) / 100.0));
+        if (Timer() >= data->stopTime || *data->cancelFlag) break;
+        
+        // Drop the link briefly; the first reconnect attempt should succeed
+        data->mockContext->simulateDisconnect = 1;
+        Delay(0.1 + (Stress_Rand(&data->seed) % 200) / 1000.0);
+        data->mockContext->simulateDisconnect = 0;
+        InterlockedIncrement(&data->operations);
+    }
+    
+    data->mockContext->simulateDisconnect = 0;
+    return 0;
+}
+
+// Check per-command invariants once every command of a round has been released
+static int Stress_VerifyRound(StressTracker *tracker, char *errorMsg, int errorMsgSize) {
+    int used = MIN(tracker->nextSlot, STRESS_MAX_COMMANDS);
+    int leaked = 0, doubleFreed = 0, doubleExecuted = 0;
+    int lostCallbacks = 0, extraCallbacks = 0;
+    
+    for (int i = 0; i < used; i++) {
+        StressSlot *slot = &tracker->slots[i];
+        
+        if (slot->paramsFreed > 1) doubleFreed++;
+        else if (slot->paramsCreated != slot->paramsFreed) leaked++;
+        if (slot->executed > 1) doubleExecuted++;
+        
+        if (slot->kind == STRESS_KIND_ASYNC) {
+            if (slot->executed && slot->callbacks == 0) lostCallbacks++;
+            if (slot->callbacks > 1 || (slot->callbacks && !slot->executed)) extraCallbacks++;
+        }
+    }
+    
+    if (tracker->badTags > 0) {
+        snprintf(errorMsg, errorMsgSize, "%d parameter blocks freed or executed after release",
+                tracker->badTags);
+        return -1;
+    }
+    if (doubleFreed > 0 || doubleExecuted > 0) {
+        snprintf(errorMsg, errorMsgSize, "Double release: %d commands freed twice, %d executed twice",
+                doubleFreed, doubleExecuted);
+        return -1;
+    }
+    if (leaked > 0 || tracker->liveParams != 0) {
+        snprintf(errorMsg, errorMsgSize, "%d commands leaked (%d parameter blocks still live)",
+                leaked, tracker->liveParams);
+        return -1;
+    }
+    if (lostCallbacks > 0 || extraCallbacks > 0) {
+        snprintf(errorMsg, errorMsgSize, "Async callbacks: %d lost, %d duplicated or spurious",
+                lostCallbacks, extraCallbacks);
+        return -1;
+    }
+    if (tracker->transactionCallbacks != tracker->transactionsCommitted ||
+        tracker->transactionCountMismatches > 0) {
+        snprintf(errorMsg, errorMsgSize, "Transaction callbacks: %d for %d commits, %d count mismatches",
+                tracker->transactionCallbacks, tracker->transactionsCommitted,
+                tracker->transactionCountMismatches);
+        return -1;
+    }
+    if (tracker->peakLiveParams > STRESS_MAX_LIVE_PARAMS) {
+        snprintf(errorMsg, errorMsgSize, "Memory not bounded: %d live parameter blocks (limit %d)",
+                tracker->peakLiveParams, STRESS_MAX_LIVE_PARAMS);
+        return -1;
+    }
+    
+    return 1;
+}
+
+// One round: concurrent workers, drain, then shutdown with work still queued
+static int Stress_RunRound(DeviceQueueTestContext *ctx, MockDeviceContext *mockContext,
+                          StressTracker *tracker, unsigned int seed, double duration,
+                          char *errorMsg, int errorMsgSize) {
+    StressWorkerData workerData[STRESS_WORKER_COUNT + 1];
+    CmtThreadFunctionID threads[STRESS_WORKER_COUNT + 1] = {0};
+    int result = -1;
+    
+    memset(tracker->slots, 0, STRESS_MAX_COMMANDS * sizeof(StressSlot));
+    tracker->nextSlot = 0;
+    tracker->liveParams = 0;
+    tracker->peakLiveParams = 0;
+    tracker->badTags = 0;
+    tracker->transactionsCommitted = 0;
+    tracker->transactionCallbacks = 0;
+    tracker->transactionCountMismatches = 0;
+    
+    Mock_SetConnectionState(mockContext, 0);
+    mockContext->simulateDisconnect = 0;
+    
+    DeviceQueueManager *mgr = CreateTestQueueManager(ctx, &g_stressAdapter, mockContext, NULL);
+    if (!mgr) {
+        snprintf(errorMsg, errorMsgSize, "Failed to create queue manager");
+        return -1;
+    }
+    
+    // Workers plus one connection flapper (the last entry)
+    memset(workerData, 0, sizeof(workerData));
+    for (int i = 0; i <= STRESS_WORKER_COUNT; i++) {
+        workerData[i].queueManager = mgr;
+        workerData[i].mockContext = mockContext;
+        workerData[i].tracker = tracker;
+        workerData[i].cancelFlag = &ctx->cancelRequested;
+        workerData[i].workerIndex = i;
+        workerData[i].seed = seed + 7919u * (unsigned int)i;
+        workerData[i].stopTime = Timer() + duration;
+    }
+    
+    for (int i = 0; i <= STRESS_WORKER_COUNT; i++) {
+        int error = CmtScheduleThreadPoolFunction(ctx->testThreadPool,
+                                                (i < STRESS_WORKER_COUNT) ? StressWorkerFunction : StressFlapperFunction,
+                                                &workerData[i], &threads[i]);
+        if (error != 0) {
+            snprintf(errorMsg, errorMsgSize, "Failed to start stress thread %d", i);
+            break;
+        }
+    }
+    
+    for (int i = 0; i <= STRESS_WORKER_COUNT; i++) {
+        if (threads[i] != 0) {
+            CmtWaitForThreadPoolFunctionCompletion(ctx->testThreadPool, threads[i],
+                                                 OPT_TP_PROCESS_EVENTS_WHILE_WAITING);
+        }
+    }
+    
+    if (errorMsg[0] != '\0' || ctx->cancelRequested) goto cleanup;
+    
+    // Let the queue drain and every committed transaction call back
+    double drainTimeout = Timer() + STRESS_DRAIN_TIMEOUT_S;
+    while (Timer() < drainTimeout && !ctx->cancelRequested) {
+        DeviceQueueStats stats;
+        DeviceQueue_GetStats(mgr, &stats);
+        if (stats.isConnected && !stats.isInTransactionMode &&
+            stats.highPriorityQueued + stats.normalPriorityQueued +
+            stats.lowPriorityQueued + stats.deferredQueued == 0 &&
+            tracker->transactionCallbacks == tracker->transactionsCommitted) {
+            break;
+        }
+        ProcessSystemEvents();
+        Delay(0.05);
+    }
+    
+    if (Timer() >= drainTimeout) {
+        if (tracker->transactionCallbacks != tracker->transactionsCommitted) {
+            snprintf(errorMsg, errorMsgSize, "Transaction callbacks: %d for %d commits after %.0f s",
+                    tracker->transactionCallbacks, tracker->transactionsCommitted, STRESS_DRAIN_TIMEOUT_S);
+        } else {
+            snprintf(errorMsg, errorMsgSize, "Queues did not drain within %.0f s", STRESS_DRAIN_TIMEOUT_S);
+        }
+        goto cleanup;
+    }
+    
+    // Shutdown under load: queue a burst plus an uncommitted transaction and destroy
+    Mock_SetCommandDelay(mockContext, 20);
+    for (int i = 0; i < DEVICE_QUEUE_LOW_PRIORITY_SIZE; i++) {
+        Stress_SubmitAsync(&workerData[0], i);
+    }
+    DeviceTransactionHandle txn = DeviceQueue_BeginTransaction(mgr);
+    for (int i = 0; i < STRESS_TXN_MAX_COMMANDS && txn != 0; i++) {
+        int slot = Stress_AllocSlot(tracker, STRESS_KIND_TRANSACTION);
+        if (slot < 0) break;
+        StressCommandParams params = {STRESS_PARAMS_TAG, slot, i};
+        DeviceQueue_AddToTransaction(mgr, txn, MOCK_CMD_SET_VALUE, &params);
+    }
+    
+    DestroyTestQueueManager(ctx, mgr);
+    mgr = NULL;
+    Mock_SetCommandDelay(mockContext, 1);
+    
+    int operations = 0, unexpectedErrors = 0;
+    for (int i = 0; i <= STRESS_WORKER_COUNT; i++) {
+        operations += workerData[i].operations;
+        unexpectedErrors += workerData[i].unexpectedErrors;
+    }
+    
+    if (unexpectedErrors > 0) {
+        snprintf(errorMsg, errorMsgSize, "%d unexpected errors from queue API calls", unexpectedErrors);
+        goto cleanup;
+    }
+    
+    result = Stress_VerifyRound(tracker, errorMsg, errorMsgSize);
+    
+    LogMessage("Stress round: %d operations, %d commands, %d transactions (%d called back), peak %d live params",
+               operations, MIN(tracker->nextSlot, STRESS_MAX_COMMANDS), tracker->transactionsCommitted,
+               tracker->transactionCallbacks, tracker->peakLiveParams);
+    
+cleanup:
+    if (mgr) {
+        DestroyTestQueueManager(ctx, mgr);
+    }
+    return result;
+}
+
+int Test_StressSoak(DeviceQueueTestContext *ctx, char *errorMsg, int errorMsgSize) {
+    if (ctx->cancelRequested) return -1;
+    
+    StressTracker tracker = {0};
+    tracker.slots = calloc(STRESS_MAX_COMMANDS, sizeof(StressSlot));
+    MockDeviceContext *mockContext = Mock_CreateContext();
+    
+    if (!tracker.slots || !mockContext) {
+        snprintf(errorMsg, errorMsgSize, "Failed to allocate stress test state");
+        free(tracker.slots);
+        Mock_DestroyContext(mockContext);
+        return -1;
+    }
+    
+    g_stressTracker = &tracker;
+    Mock_SetCommandDelay(mockContext, 1);
+    
+    unsigned int seed = (unsigned int)time(NULL);
+    LogMessage("Stress test: seed %u, %.0f s in %.0f s rounds, %d workers",
+               seed, STRESS_TEST_DURATION_S, STRESS_ROUND_DURATION_S, STRESS_WORKER_COUNT);
+    
+    int result = 1;
+    int round = 0;
+    double endTime = Timer() + STRESS_TEST_DURATION_S;
+    
+    while (result > 0 && Timer() < endTime && !ctx->cancelRequested) {
+        double duration = MIN(STRESS_ROUND_DURATION_S, endTime - Timer());
+        result = Stress_RunRound(ctx, mockContext, &tracker, seed + 104729u * (unsigned int)round,
+                               MAX(duration, 0.5), errorMsg, errorMsgSize);
+        round++;
+    }
+    
+    if (result < 0 && !ctx->cancelRequested) {
+        LogError("Stress test failed in round %d (seed %u): %s", round, seed, errorMsg);
+    } else if (result > 0) {
+        LogMessage("Stress test passed: %d rounds", round);
+    }
+    
+    g_stressTracker = NULL;
+    Mock_DestroyContext(mockContext);
+    free(tracker.slots);
+    
+    return ctx->cancelRequested ? -1 : result;
+}
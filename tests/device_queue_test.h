@@ -37,6 +37,16 @@
 #define TEST_MAX_COMMANDS       100     // Maximum commands for stress testing
 #define TEST_QUEUE_OVERFLOW     200     // Commands to cause overflow
 
+// Stress/soak testing - define STRESS_TEST_DURATION_S at build time for long soak runs
+#ifndef STRESS_TEST_DURATION_S
+#define STRESS_TEST_DURATION_S  20.0    // Total length of the randomized stress test
+#endif
+#define STRESS_ROUND_DURATION_S 5.0     // Each round ends by destroying a loaded queue
+#define STRESS_WORKER_COUNT     4       // Concurrent submitting/cancelling workers
+#define STRESS_MAX_COMMANDS     20000   // Tracked commands per round
+#define STRESS_FLAP_INTERVAL_S  2.0     // Time between simulated disconnects
+#define STRESS_DRAIN_TIMEOUT_S  30.0    // Time allowed for queues to drain after a round
+
 /******************************************************************************
  * Mock Device Command Types
  ******************************************************************************/
@@ -196,6 +206,10 @@ int Test_LargeTransactions(DeviceQueueTestContext *ctx, char *errorMsg, int erro
 int Test_NullCallbacks(DeviceQueueTestContext *ctx, char *errorMsg, int errorMsgSize);
 int Test_MixedCommandsAndTransactions(DeviceQueueTestContext *ctx, char *errorMsg, int errorMsgSize);
 int Test_TransactionTimeout(DeviceQueueTestContext *ctx, char *errorMsg, int errorMsgSize);
+int Test_AdmissionControl(DeviceQueueTestContext *ctx, char *errorMsg, int errorMsgSize);
+int Test_QueueSnapshot(DeviceQueueTestContext *ctx, char *errorMsg, int errorMsgSize);
+int Test_OfflineDeadline(DeviceQueueTestContext *ctx, char *errorMsg, int errorMsgSize);
+int Test_StressSoak(DeviceQueueTestContext *ctx, char *errorMsg, int errorMsgSize);
 
 // Mock device helper functions
 MockDeviceContext* Mock_CreateContext(void);
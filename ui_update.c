@@ -0,0 +1,418 @@
+/******************************************************************************
+ * ui_update.c
+ *
+ * UI Update Bus Module Implementation
+ * Every control value or attribute set through the bus lands in one entry per
+ * control/attribute pair. The first change after a frame posts the next frame
+ * to the UI thread, no sooner than UI_UPDATE_FRAME_MS after the last one, and
+ * that frame applies whatever entries changed meanwhile. UI thread load then
+ * depends on the frame rate and the number of controls that actually changed,
+ * not on how often the devices report.
+ ******************************************************************************/
+
+#include "common.h"
+#include "ui_update.h"
+#include "logging.h"
+
+/******************************************************************************
+ * Module Variables
+ ******************************************************************************/
+
+typedef enum {
+    UI_UPDATE_TYPE_INT = 0,
+    UI_UPDATE_TYPE_DOUBLE,
+    UI_UPDATE_TYPE_STRING
+} UIUpdateType;
+
+typedef struct {
+    int panel;
+    int control;
+    int attribute;              // UI_UPDATE_VALUE or an ATTR_ id
+    UIUpdateType type;
+    bool known;                 // Value is shown, or will be after the next frame
+    bool dirty;                 // Value changed since the last frame
+    bool bypassWarned;          // A direct write to the control has been logged
+    int intValue;
+    double dblValue;
+    double shownDblValue;       // dblValue as the control holds it, after its rounding
+    char strValue[MEDIUM_BUFFER_SIZE];
+} UIUpdateEntry;
+
+static struct {
+    volatile int initialized;
+    CmtThreadLockHandle lock;       // Guards the entries and frame scheduling
+
+    UIUpdateEntry entries[UI_UPDATE_MAX_ENTRIES];
+    int numEntries;
+
+    bool frameScheduled;
+    double lastFrameTime;
+    double lastVerifyTime;
+    bool fullWarned;
+} g_uiUpdate = {0};
+
+// Entries applied by the current frame, only touched on the UI thread
+static UIUpdateEntry g_frameEntries[UI_UPDATE_MAX_ENTRIES];
+
+/******************************************************************************
+ * Internal Function Prototypes
+ ******************************************************************************/
+
+static int UIUpdate_Set(const UIUpdateEntry *update);
+static UIUpdateEntry* UIUpdate_FindEntry(int panel, int control, int attribute);
+static bool UIUpdate_SameValue(const UIUpdateEntry *entry, const UIUpdateEntry *update);
+static void CVICALLBACK UIUpdate_ApplyFrame(void *data);
+static void UIUpdate_Verify(void);
+static bool UIUpdate_ControlShows(const UIUpdateEntry *entry);
+
+/******************************************************************************
+ * Public Interface Implementation
+ ******************************************************************************/
+
+int UIUpdate_Initialize(void) {
+    if (g_uiUpdate.initialized) {
+        return SUCCESS;
+    }
+
+    memset(&g_uiUpdate, 0, sizeof(g_uiUpdate));
+
+    if (CmtNewLock(NULL, 0, &g_uiUpdate.lock) < 0) {
+        LogError("Failed to create UI update lock");
+        return ERR_THREAD_SYNC;
+    }
+
+    g_uiUpdate.initialized = 1;
+    LogMessage("UI update bus initialized");
+    return SUCCESS;
+}
+
+void UIUpdate_Cleanup(void) {
+    // Frames run on the UI thread, as does cleanup, so none is running now
+    g_uiUpdate.initialized = 0;
+
+    if (g_uiUpdate.lock) {
+        CmtDiscardLock(g_uiUpdate.lock);
+        g_uiUpdate.lock = 0;
+    }
+}
+
+int UIUpdate_SetInt(int panel, int control, int value) {
+    UIUpdateEntry update = {0};
+    update.panel = panel;
+    update.control = control;
+    update.attribute = UI_UPDATE_VALUE;
+    update.type = UI_UPDATE_TYPE_INT;
+    update.intValue = value;
+    return UIUpdate_Set(&update);
+}
+
+int UIUpdate_SetDouble(int panel, int control, double value) {
+    UIUpdateEntry update = {0};
+    update.panel = panel;
+    update.control = control;
+    update.attribute = UI_UPDATE_VALUE;
+    update.type = UI_UPDATE_TYPE_DOUBLE;
+    update.dblValue = value;
+    return UIUpdate_Set(&update);
+}
+
+int UIUpdate_SetString(int panel, int control, const char *value) {
+    if (!value) {
+        return ERR_NULL_POINTER;
+    }
+
+    UIUpdateEntry update = {0};
+    update.panel = panel;
+    update.control = control;
+    update.attribute = UI_UPDATE_VALUE;
+    update.type = UI_UPDATE_TYPE_STRING;
+    strncpy(update.strValue, value, sizeof(update.strValue) - 1);
+    update.strValue[sizeof(update.strValue) - 1] = '\0';
+    return UIUpdate_Set(&update);
+}
+
+int UIUpdate_SetAttributeInt(int panel, int control, int attribute, int value) {
+    UIUpdateEntry update = {0};
+    update.panel = panel;
+    update.control = control;
+    update.attribute = attribute;
+    update.type = UI_UPDATE_TYPE_INT;
+    update.intValue = value;
+    return UIUpdate_Set(&update);
+}
+
+int UIUpdate_SetAttributeString(int panel, int control, int attribute, const char *value) {
+    if (!value) {
+        return ERR_NULL_POINTER;
+    }
+
+    UIUpdateEntry update = {0};
+    update.panel = panel;
+    update.control = control;
+    update.attribute = attribute;
+    update.type = UI_UPDATE_TYPE_STRING;
+    strncpy(update.strValue, value, sizeof(update.strValue) - 1);
+    update.strValue[sizeof(update.strValue) - 1] = '\0';
+    return UIUpdate_Set(&update);
+}
+
+void UIUpdate_Invalidate(int panel, int control) {
+    if (!g_uiUpdate.initialized) {
+        return;
+    }
+
+    CmtGetLock(g_uiUpdate.lock);
+    for (int i = 0; i < g_uiUpdate.numEntries; i++) {
+        UIUpdateEntry *entry = &g_uiUpdate.entries[i];
+        if (entry->panel == panel && entry->control == control && !entry->dirty) {
+            entry->known = false;
+        }
+    }
+    CmtReleaseLock(g_uiUpdate.lock);
+}
+
+/******************************************************************************
+ * Internal Functions
+ ******************************************************************************/
+
+static int UIUpdate_Set(const UIUpdateEntry *update) {
+    if (update->panel <= 0) {
+        return ERR_INVALID_PARAMETER;
+    }
+    if (!g_uiUpdate.initialized) {
+        return ERR_NOT_INITIALIZED;
+    }
+
+    bool postFrame = false;
+    double delayMs = 0.0;
+
+    CmtGetLock(g_uiUpdate.lock);
+
+    UIUpdateEntry *entry = UIUpdate_FindEntry(update->panel, update->control, update->attribute);
+    if (!entry) {
+        bool warn = !g_uiUpdate.fullWarned;
+        g_uiUpdate.fullWarned = true;
+        CmtReleaseLock(g_uiUpdate.lock);
+        if (warn) {
+            LogWarning("UI update bus full (%d entries), dropping updates to new controls",
+                       UI_UPDATE_MAX_ENTRIES);
+        }
+        return ERR_OPERATION_FAILED;
+    }
+
+    // Unchanged - the control already shows it or the next frame will
+    if (entry->known && UIUpdate_SameValue(entry, update)) {
+        CmtReleaseLock(g_uiUpdate.lock);
+        return SUCCESS;
+    }
+
+    entry->type = update->type;
+    entry->intValue = update->intValue;
+    entry->dblValue = update->dblValue;
+    memcpy(entry->strValue, update->strValue, sizeof(entry->strValue));
+    entry->known = true;
+    entry->dirty = true;
+
+    if (!g_uiUpdate.frameScheduled) {
+        g_uiUpdate.frameScheduled = true;
+        postFrame = true;
+        delayMs = UI_UPDATE_FRAME_MS - (GetTimestamp() - g_uiUpdate.lastFrameTime) * 1000.0;
+    }
+
+    CmtReleaseLock(g_uiUpdate.lock);
+
+    if (postFrame) {
+        int result = (delayMs > 0.0) ? PostDelayedCall(UIUpdate_ApplyFrame, NULL, delayMs / 1000.0)
+                                     : PostDeferredCall(UIUpdate_ApplyFrame, NULL);
+        if (result < 0) {
+            LogError("Failed to post UI update frame: %d", result);
+            CmtGetLock(g_uiUpdate.lock);
+            g_uiUpdate.frameScheduled = false;
+            CmtReleaseLock(g_uiUpdate.lock);
+            return ERR_OPERATION_FAILED;
+        }
+    }
+
+    return SUCCESS;
+}
+
+// Caller holds g_uiUpdate.lock. Returns NULL only when the table is full.
+static UIUpdateEntry* UIUpdate_FindEntry(int panel, int control, int attribute) {
+    for (int i = 0; i < g_uiUpdate.numEntries; i++) {
+        UIUpdateEntry *entry = &g_uiUpdate.entries[i];
+        if (entry->panel == panel && entry->control == control && entry->attribute == attribute) {
+            return entry;
+        }
+    }
+
+    if (g_uiUpdate.numEntries >= UI_UPDATE_MAX_ENTRIES) {
+        return NULL;
+    }
+
+    UIUpdateEntry *entry = &g_uiUpdate.entries[g_uiUpdate.numEntries++];
+    memset(entry, 0, sizeof(UIUpdateEntry));
+    entry->panel = panel;
+    entry->control = control;
+    entry->attribute = attribute;
+    return entry;
+}
+
+static bool UIUpdate_SameValue(const UIUpdateEntry *entry, const UIUpdateEntry *update) {
+    if (entry->type != update->type) {
+        return false;
+    }
+
+    switch (entry->type) {
+        case UI_UPDATE_TYPE_INT:
+            return entry->intValue == update->intValue;
+        case UI_UPDATE_TYPE_DOUBLE:
+            return entry->dblValue == update->dblValue;
+        case UI_UPDATE_TYPE_STRING:
+            return strcmp(entry->strValue, update->strValue) == 0;
+    }
+    return false;
+}
+
+static void CVICALLBACK UIUpdate_ApplyFrame(void *data) {
+    if (!g_uiUpdate.initialized) {
+        return;
+    }
+
+    // Take the changed entries and let the next change schedule a new frame
+    int count = 0;
+    CmtGetLock(g_uiUpdate.lock);
+    for (int i = 0; i < g_uiUpdate.numEntries; i++) {
+        UIUpdateEntry *entry = &g_uiUpdate.entries[i];
+        if (entry->dirty) {
+            g_frameEntries[count++] = *entry;
+            entry->dirty = false;
+        }
+    }
+    g_uiUpdate.frameScheduled = false;
+    g_uiUpdate.lastFrameTime = GetTimestamp();
+    CmtReleaseLock(g_uiUpdate.lock);
+
+    // Apply outside the lock so device threads are never held up by drawing
+    for (int i = 0; i < count; i++) {
+        UIUpdateEntry *entry = &g_frameEntries[i];
+
+        if (entry->attribute == UI_UPDATE_VALUE) {
+            switch (entry->type) {
+                case UI_UPDATE_TYPE_INT:
+                    SetCtrlVal(entry->panel, entry->control, entry->intValue);
+                    break;
+                case UI_UPDATE_TYPE_DOUBLE:
+                    SetCtrlVal(entry->panel, entry->control, entry->dblValue);
+                    if (GetCtrlVal(entry->panel, entry->control, &entry->shownDblValue) < 0) {
+                        entry->shownDblValue = entry->dblValue;
+                    }
+                    break;
+                case UI_UPDATE_TYPE_STRING:
+                    SetCtrlVal(entry->panel, entry->control, entry->strValue);
+                    break;
+            }
+        } else if (entry->type == UI_UPDATE_TYPE_STRING) {
+            SetCtrlAttribute(entry->panel, entry->control, entry->attribute, entry->strValue);
+        } else {
+            SetCtrlAttribute(entry->panel, entry->control, entry->attribute, entry->intValue);
+        }
+    }
+
+    if (count > 0) {
+        ProcessDrawEvents();
+    }
+
+    // Keep the value each double control took, the check compares with that
+    CmtGetLock(g_uiUpdate.lock);
+    for (int i = 0; i < count; i++) {
+        UIUpdateEntry *applied = &g_frameEntries[i];
+        if (applied->attribute == UI_UPDATE_VALUE && applied->type == UI_UPDATE_TYPE_DOUBLE) {
+            UIUpdateEntry *entry = UIUpdate_FindEntry(applied->panel, applied->control, applied->attribute);
+            if (entry) {
+                entry->shownDblValue = applied->shownDblValue;
+            }
+        }
+    }
+    CmtReleaseLock(g_uiUpdate.lock);
+
+    if ((GetTimestamp() - g_uiUpdate.lastVerifyTime) * 1000.0 >= UI_UPDATE_VERIFY_MS) {
+        g_uiUpdate.lastVerifyTime = GetTimestamp();
+        UIUpdate_Verify();
+    }
+}
+
+// Find controls that no longer show the value the bus believes they show -
+// something wrote them directly - and forget their value so the next one set
+// is applied. Runs on the UI thread after a frame.
+static void UIUpdate_Verify(void) {
+    int count = 0;
+
+    CmtGetLock(g_uiUpdate.lock);
+    for (int i = 0; i < g_uiUpdate.numEntries; i++) {
+        UIUpdateEntry *entry = &g_uiUpdate.entries[i];
+        if (entry->known && !entry->dirty) {
+            g_frameEntries[count++] = *entry;
+        }
+    }
+    CmtReleaseLock(g_uiUpdate.lock);
+
+    for (int i = 0; i < count; i++) {
+        UIUpdateEntry *shown = &g_frameEntries[i];
+        if (UIUpdate_ControlShows(shown)) {
+            continue;
+        }
+
+        bool warn = false;
+        CmtGetLock(g_uiUpdate.lock);
+        UIUpdateEntry *entry = UIUpdate_FindEntry(shown->panel, shown->control, shown->attribute);
+        if (entry && entry->known && !entry->dirty && UIUpdate_SameValue(entry, shown)) {
+            entry->known = false;
+            warn = !entry->bypassWarned;
+            entry->bypassWarned = true;
+        }
+        CmtReleaseLock(g_uiUpdate.lock);
+
+        if (warn) {
+            LogWarning("Control %d (attribute %d) was written outside the UI update bus",
+                       shown->control, shown->attribute);
+        }
+    }
+}
+
+// Compare what a control shows with an entry. Doubles are compared with the
+// value read back when they were applied, since the control rounds them to
+// its precision. String attributes have no generic length query and are not
+// checked.
+static bool UIUpdate_ControlShows(const UIUpdateEntry *entry) {
+    int intValue = 0;
+    double dblValue = 0.0;
+    int length = 0;
+    char strValue[MEDIUM_BUFFER_SIZE];
+
+    if (entry->attribute != UI_UPDATE_VALUE) {
+        if (entry->type == UI_UPDATE_TYPE_STRING) {
+            return true;
+        }
+        return GetCtrlAttribute(entry->panel, entry->control, entry->attribute, &intValue) < 0 ||
+               intValue == entry->intValue;
+    }
+
+    switch (entry->type) {
+        case UI_UPDATE_TYPE_INT:
+            return GetCtrlVal(entry->panel, entry->control, &intValue) < 0 ||
+                   intValue == entry->intValue;
+        case UI_UPDATE_TYPE_DOUBLE:
+            return GetCtrlVal(entry->panel, entry->control, &dblValue) < 0 ||
+                   dblValue == entry->shownDblValue;
+        case UI_UPDATE_TYPE_STRING:
+            if (GetCtrlAttribute(entry->panel, entry->control, ATTR_STRING_TEXT_LENGTH, &length) < 0) {
+                return true;
+            }
+            if (length != (int)strlen(entry->strValue)) {
+                return false;
+            }
+            return GetCtrlVal(entry->panel, entry->control, strValue) < 0 ||
+                   strcmp(strValue, entry->strValue) == 0;
+    }
+    return true;
+}
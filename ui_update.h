@@ -0,0 +1,100 @@
+/******************************************************************************
+ * ui_update.h
+ *
+ * UI Update Bus Module Header
+ * Collects control values set from any thread and applies them on the UI
+ * thread in one deferred call per display frame. Values are kept per control
+ * and attribute, so only the latest value of each is applied and values equal
+ * to what the control already shows are skipped.
+ *
+ * A control set through the bus must not be written directly, or the bus
+ * keeps skipping values it believes are shown. Frames check for this every
+ * UI_UPDATE_VERIFY_MS, log the control and apply its next value again.
+ ******************************************************************************/
+#ifndef UI_UPDATE_H
+#define UI_UPDATE_H
+
+#include "common.h"
+
+/******************************************************************************
+ * Configuration Constants
+ ******************************************************************************/
+#define UI_UPDATE_FRAME_MS          50      // Minimum time between frames (20 fps)
+#define UI_UPDATE_MAX_ENTRIES       128     // Distinct control/attribute pairs tracked
+#define UI_UPDATE_VALUE             0       // Attribute id for the control value itself
+#define UI_UPDATE_VERIFY_MS         1000    // How often frames check controls for writes that bypassed the bus
+
+/******************************************************************************
+ * Public Function Declarations
+ ******************************************************************************/
+
+/**
+ * Initialize the update bus. Updates set before this are dropped.
+ * @return SUCCESS or error code
+ */
+int UIUpdate_Initialize(void);
+
+/**
+ * Drop pending updates and release resources. A frame already posted to the
+ * UI thread does nothing when it runs.
+ */
+void UIUpdate_Cleanup(void);
+
+/**
+ * Set an integer control value (LEDs, toggles, rings)
+ * @param panel - Panel handle
+ * @param control - Control id
+ * @param value - New value
+ * @return SUCCESS or error code
+ */
+int UIUpdate_SetInt(int panel, int control, int value);
+
+/**
+ * Set a numeric control value
+ * @param panel - Panel handle
+ * @param control - Control id
+ * @param value - New value
+ * @return SUCCESS or error code
+ */
+int UIUpdate_SetDouble(int panel, int control, double value);
+
+/**
+ * Set a string control value
+ * @param panel - Panel handle
+ * @param control - Control id
+ * @param value - New value, truncated to MEDIUM_BUFFER_SIZE - 1 characters
+ * @return SUCCESS or error code
+ */
+int UIUpdate_SetString(int panel, int control, const char *value);
+
+/**
+ * Set an integer control attribute, e.g. ATTR_ON_COLOR or ATTR_DIMMED.
+ * Within a frame, entries are applied in the order they were first set.
+ * @param panel - Panel handle
+ * @param control - Control id
+ * @param attribute - Attribute id
+ * @param value - New value
+ * @return SUCCESS or error code
+ */
+int UIUpdate_SetAttributeInt(int panel, int control, int attribute, int value);
+
+/**
+ * Set a string control attribute, e.g. ATTR_LABEL_TEXT
+ * @param panel - Panel handle
+ * @param control - Control id
+ * @param attribute - Attribute id
+ * @param value - New value, truncated to MEDIUM_BUFFER_SIZE - 1 characters
+ * @return SUCCESS or error code
+ */
+int UIUpdate_SetAttributeString(int panel, int control, int attribute, const char *value);
+
+/**
+ * Forget what a control shows, so the next value set is applied even if it
+ * equals the last one. Call it when the user can change the control, e.g.
+ * from the control's commit callback.
+ * @param panel - Panel handle
+ * @param control - Control id
+ */
+void UIUpdate_Invalidate(int panel, int control);
+
+#endif // UI_UPDATE_H